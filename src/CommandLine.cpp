@@ -19,6 +19,7 @@
 */
 
 #include <cstdlib>
+#include <algorithm>
 #include <assert.h>
 #include <iostream>
 
@@ -26,6 +27,7 @@
 #include <QMap>
 #include <QRegularExpression>
 #include <QStringList>
+#include <QThread>
 
 #include "ImageId.h"
 #include "version.h"
@@ -194,6 +196,9 @@ CommandLine::setup()
     m_deskewAngle = fetchDeskewAngle();
     m_startFilterIdx = fetchStartFilterIdx();
     m_endFilterIdx = fetchEndFilterIdx();
+    m_threads = fetchThreads();
+    m_tiffOptions = fetchTiffOptions(false);
+    m_tiffOptionsBW = fetchTiffOptions(true);
 }
 
 
@@ -260,6 +265,16 @@ CommandLine::printHelp()
     std::cout << "\t--depth-perception=<1.0...3.0>\t\t-- default: 2.0" << "\n";
     std::cout << "\t--start-filter=<1...6>\t\t\t-- default: 4" << "\n";
     std::cout << "\t--end-filter=<1...6>\t\t\t-- default: 6" << "\n";
+    std::cout << "\t--threads=<n>\t\t\t\t-- pages processed in parallel; 0: one per CPU core; default: 1" << "\n";
+    std::cout << "\t--tiff-compression=<lzw|deflate|zstd|jpeg|none>\n\t\t\t\t\t\t-- color and grayscale output; default: lzw" << "\n";
+    std::cout << "\t--tiff-compression-bw=<g4|lzw|deflate|zstd|none>\n\t\t\t\t\t\t-- black and white output; default: g4" << "\n";
+    std::cout << "\t--tiff-predictor\t\t\t-- horizontal differencing for lzw, deflate and zstd" << "\n";
+    std::cout << "\t--tiff-quality=<n>\t\t\t-- jpeg: 1...100, deflate: 1...9, zstd: 1...22" << "\n";
+    std::cout << "\t--tiff-rows-per-strip=<n>\t\t-- default: about 256 KiB per strip" << "\n";
+    std::cout << "\t--streaming\t\t\t\t-- run filters 1-4 on each page in one pass," << "\n";
+    std::cout << "\t\t\t\t\t\t   decoding every image only once" << "\n";
+    std::cout << "\t--trace[=<file.json>]\t\t\t-- print time spent per stage and operation;" << "\n";
+    std::cout << "\t\t\t\t\t\t   also write a Chrome trace if a file is given" << "\n";
     std::cout << "\t--output-project=, -o=<project_name>" << "\n";
     std::cout << "\t--stylesheet=<path_to_stylesheets.qss>" << "\n";
     std::cout << "\n";
@@ -481,6 +496,48 @@ CommandLine::fetchEndFilterIdx()
     return m_options["end-filter"].toInt() - 1;
 }
 
+int
+CommandLine::fetchThreads()
+{
+    if (!hasThreads())
+        return 1;
+
+    int threads = m_options["threads"].toInt();
+    if (threads <= 0)
+        threads = QThread::idealThreadCount();
+
+    return std::max(threads, 1);
+}
+
+TiffWriter::Options
+CommandLine::fetchTiffOptions(bool const bitonal)
+{
+    TiffWriter::Options options;
+    options.predictor = contains("tiff-predictor");
+    options.quality = m_options.value("tiff-quality").toInt();
+    options.rowsPerStrip = m_options.value("tiff-rows-per-strip").toInt();
+
+    QString const key(bitonal ? "tiff-compression-bw" : "tiff-compression");
+    if (!contains(key))
+        return options;
+
+    if (!TiffWriter::parseCodec(m_options[key], options.codec) ||
+            options.codec == (bitonal ? TiffWriter::CODEC_JPEG : TiffWriter::CODEC_G4))
+    {
+        std::cout << "Wrong " << key.toLocal8Bit().constData() << " "
+                  << m_options[key].toLocal8Bit().constData() << "\n";
+        exit(1);
+    }
+    if (!TiffWriter::isCodecSupported(options.codec))
+    {
+        std::cout << "Compression " << m_options[key].toLocal8Bit().constData()
+                  << " is not supported by libtiff" << "\n";
+        exit(1);
+    }
+
+    return options;
+}
+
 #if 0
 output::DewarpingMode
 CommandLine::fetchDewarpingMode()
@@ -34,6 +34,7 @@
 #include "ImageFileInfo.h"
 #include "RelativeMargins.h"
 #include "Despeckle.h"
+#include "TiffWriter.h"
 
 /**
  * CommandLine is a singleton simulation.
@@ -157,6 +158,27 @@ public:
     {
         return contains("dewarping");
     }
+    bool hasThreads() const
+    {
+        return contains("threads");
+    }
+    bool isStreaming() const
+    {
+        return contains("streaming");
+    }
+    bool hasTrace() const
+    {
+        return contains("trace");
+    }
+    /**
+     * \brief The file to write the Chrome trace to, or an empty string
+     *        if --trace was given without a file name.
+     */
+    QString getTraceFile() const
+    {
+        QString const file = m_options.value("trace");
+        return file == "true" ? QString() : file;
+    }
 
     page_split::LayoutType getLayout() const
     {
@@ -206,6 +228,19 @@ public:
     {
         return m_endFilterIdx;
     }
+    int getThreads() const
+    {
+        return m_threads;
+    }
+    /**
+     * \brief Options for writing output TIFFs.
+     *
+     * \param bitonal Whether the image to be written is black and white.
+     */
+    TiffWriter::Options const& getTiffOptions(bool bitonal) const
+    {
+        return bitonal ? m_tiffOptionsBW : m_tiffOptions;
+    }
     //output::DewarpingMode getDewarpingMode() const { return m_dewarpingMode; }
     //output::DespeckleLevel getDespeckleLevel() const { return m_despeckleLevel; }
     //output::DepthPerception getDepthPerception() const { return m_depthPerception; }
@@ -257,6 +292,9 @@ private:
     double m_deskewAngle;
     int m_startFilterIdx;
     int m_endFilterIdx;
+    int m_threads;
+    TiffWriter::Options m_tiffOptions;
+    TiffWriter::Options m_tiffOptionsBW;
     //output::DewarpingMode m_dewarpingMode;
     //output::DespeckleLevel m_despeckleLevel;
     //output::DepthPerception m_depthPerception;
@@ -277,6 +315,8 @@ private:
     double fetchDeskewAngle();
     int fetchStartFilterIdx();
     int fetchEndFilterIdx();
+    int fetchThreads();
+    TiffWriter::Options fetchTiffOptions(bool bitonal);
     //output::DewarpingMode fetchDewarpingMode();
     //output::DespeckleLevel fetchDespeckleLevel();
     //output::DepthPerception fetchDepthPerception();
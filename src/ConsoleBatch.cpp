@@ -20,6 +20,9 @@
 
 #include <vector>
 #include <iostream>
+#include <algorithm>
+#include <exception>
+#include <new>
 #include <assert.h>
 
 
@@ -36,6 +39,11 @@
 #include <QtCore/QTextStream>
 #include <QtCore/QStringList>
 #include <QtCore/QSize>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThreadPool>
 
 #include "Utils.h"
 #include "IntrusivePtr.h"
@@ -48,11 +56,18 @@
 #include "OutputFileNameGenerator.h"
 #include "ImageInfo.h"
 #include "ImageFileInfo.h"
+#include "ImageMetadataLoader.h"
+#include "ImageMetadataScanner.h"
 #include "PageInfo.h"
 #include "PageSequence.h"
 #include "ImageId.h"
 #include "ThumbnailPixmapCache.h"
 #include "LoadFileTask.h"
+#include "ImageLoader.h"
+#include "CachingFactory.h"
+#include "Trace.h"
+#include "StageCache.h"
+#include "imageproc/GrayImage.h"
 #include "ProjectWriter.h"
 #include "ProjectReader.h"
 #include "OrthogonalRotation.h"
@@ -90,30 +105,294 @@
 #include "ConsoleBatch.h"
 #include "CommandLine.h"
 
-ConsoleBatch::ConsoleBatch(std::vector<ImageFileInfo> const& images, QString const& output_directory, ::Qt::LayoutDirection const layout)
-    :   batch(true), debug(true),
-        m_pAccelerationProvider(nullptr),
-        m_ptrDisambiguator(new FileNameDisambiguator()),
-        m_ptrPages(new ProjectPages(images, ProjectPages::AUTO_PAGES, layout))
+/**
+ * Runs composite page tasks on a pool of worker threads.
+ *
+ * A task holds nothing but references to filter settings until it starts
+ * running, at which point it loads a full resolution page.  The number of
+ * submitted but not yet finished tasks is limited to twice the number of
+ * threads, so that at most num_threads pages are resident at once while
+ * the workers never wait for the main thread to produce the next task.
+ * With a single thread, tasks are executed inline, exactly like before.
+ *
+ * The first exception thrown by a task is captured and re-thrown from
+ * waitForDone().  Tasks that haven't started by then are skipped.
+ */
+class ConsoleBatch::TaskPool
+{
+    DECLARE_NON_COPYABLE(TaskPool)
+public:
+    explicit TaskPool(int num_threads);
+
+    ~TaskPool();
+
+    void submit(BackgroundTaskPtr const& task);
+
+    /**
+     * \brief Waits for all submitted tasks to finish.
+     *
+     * This is the barrier between processing stages.  If any of the tasks
+     * failed, its exception is re-thrown here.
+     */
+    void waitForDone();
+private:
+    class Runnable;
+
+    void execute(BackgroundTaskPtr const& task);
+
+    bool failed() const;
+
+    QThreadPool m_pool;
+    QSemaphore m_slots;
+    mutable QMutex m_mutex;
+    std::exception_ptr m_ptrError;
+    bool const m_inline;
+};
+
+
+class ConsoleBatch::TaskPool::Runnable : public QRunnable
+{
+public:
+    Runnable(TaskPool& owner, BackgroundTaskPtr const& task)
+        : m_rOwner(owner), m_ptrTask(task)
+    {
+        setAutoDelete(true);
+    }
+
+    virtual void run() override
+    {
+        m_rOwner.execute(m_ptrTask);
+        m_ptrTask.reset();
+        m_rOwner.m_slots.release();
+    }
+private:
+    TaskPool& m_rOwner;
+    BackgroundTaskPtr m_ptrTask;
+};
+
+
+ConsoleBatch::TaskPool::TaskPool(int const num_threads)
+    :   m_slots(std::max(num_threads, 1) * 2),
+        m_inline(num_threads <= 1)
+{
+    m_pool.setMaxThreadCount(std::max(num_threads, 1));
+}
+
+ConsoleBatch::TaskPool::~TaskPool()
+{
+    m_pool.waitForDone();
+}
+
+void
+ConsoleBatch::TaskPool::submit(BackgroundTaskPtr const& task)
+{
+    if (m_inline)
+    {
+        // Let exceptions propagate right away, as the sequential mode always did.
+        (*task)();
+        return;
+    }
+
+    m_slots.acquire();
+    m_pool.start(new Runnable(*this, task));
+}
+
+void
+ConsoleBatch::TaskPool::waitForDone()
+{
+    m_pool.waitForDone();
+
+    std::exception_ptr error;
+    {
+        QMutexLocker const locker(&m_mutex);
+        error = m_ptrError;
+        m_ptrError = std::exception_ptr();
+    }
+
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+}
+
+void
+ConsoleBatch::TaskPool::execute(BackgroundTaskPtr const& task)
+{
+    if (task->isCancelled() || failed())
+    {
+        return;
+    }
+
+    try
+    {
+        (*task)();
+    }
+    catch (...)
+    {
+        QMutexLocker const locker(&m_mutex);
+        if (!m_ptrError)
+        {
+            m_ptrError = std::current_exception();
+        }
+    }
+}
+
+bool
+ConsoleBatch::TaskPool::failed() const
+{
+    QMutexLocker const locker(&m_mutex);
+    return bool(m_ptrError);
+}
+
+
+/**
+ * Runs a range of per-page filter stages over all logical pages of an image,
+ * decoding the image only once.
+ *
+ * Stages up to and including page_split are run on the first logical page
+ * of the image.  Page splitting may turn an image into two pages, so the
+ * remaining stages are configured and run only after that, for every page
+ * the image ends up with.
+ */
+class ConsoleBatch::StreamingImageTask : public BackgroundTask
+{
+public:
+    StreamingImageTask(ConsoleBatch& owner, ImageId const& image_id,
+                       int first_filter_idx, int last_filter_idx)
+        :   BackgroundTask(BATCH),
+            m_rOwner(owner),
+            m_imageId(image_id),
+            m_firstFilterIdx(first_filter_idx),
+            m_lastFilterIdx(last_filter_idx)
+    {
+    }
+
+    virtual FilterResultPtr operator()() override;
+private:
+    FilterResultPtr runChain(PageInfo const& page, int last_filter_idx,
+                             QImage const& image,
+                             CachingFactory<imageproc::GrayImage> const& gray_image_factory);
+
+    ConsoleBatch& m_rOwner;
+    ImageId m_imageId;
+    int m_firstFilterIdx;
+    int m_lastFilterIdx;
+};
+
+
+FilterResultPtr
+ConsoleBatch::StreamingImageTask::operator()()
+{
+    std::vector<PageInfo> pages(m_rOwner.m_ptrPages->logicalPagesOf(m_imageId));
+    if (pages.empty())
+    {
+        return FilterResultPtr();
+    }
+
+    QImage const image(ImageLoader::load(m_imageId));
+    if (image.isNull())
+    {
+        // Let LoadFileTask report the error the way it normally does.
+        return (*m_rOwner.createCompositeTask(pages.front(), m_firstFilterIdx))();
+    }
+
+    CachingFactory<imageproc::GrayImage> const gray_image_factory([image]()
+    {
+        return imageproc::GrayImage(image);
+    });
+
+    int const page_split_idx = m_rOwner.m_ptrStages->pageSplitFilterIdx();
+    if (m_firstFilterIdx <= page_split_idx)
+    {
+        runChain(pages.front(), std::min(m_lastFilterIdx, page_split_idx), image, gray_image_factory);
+        if (m_lastFilterIdx <= page_split_idx)
+        {
+            return FilterResultPtr();
+        }
+        pages = m_rOwner.m_ptrPages->logicalPagesOf(m_imageId);
+    }
+
+    std::set<PageId> page_ids;
+    for (PageInfo const& page : pages)
+    {
+        page_ids.insert(page.id());
+    }
+    for (int j=std::max(m_firstFilterIdx, page_split_idx + 1); j<=m_lastFilterIdx; j++)
+    {
+        m_rOwner.setupFilter(j, page_ids);
+    }
+
+    for (PageInfo const& page : pages)
+    {
+        throwIfCancelled();
+        runChain(page, m_lastFilterIdx, image, gray_image_factory);
+    }
+
+    return FilterResultPtr();
+}
+
+FilterResultPtr
+ConsoleBatch::StreamingImageTask::runChain(
+    PageInfo const& page, int const last_filter_idx, QImage const& image,
+    CachingFactory<imageproc::GrayImage> const& gray_image_factory)
+{
+    IntrusivePtr<LoadFileTask> const task(m_rOwner.createCompositeTask(page, last_filter_idx));
+    task->setPreloadedImage(image, gray_image_factory);
+    return (*task)();
+}
+
+
+std::vector<ImageFileInfo>
+ConsoleBatch::loadImageMetadata(std::vector<ImageFileInfo> const& images)
+{
+    std::vector<QString> file_paths;
+    file_paths.reserve(images.size());
+    for (ImageFileInfo const& image : images)
+    {
+        file_paths.push_back(image.fileInfo().absoluteFilePath());
+    }
+
+    std::vector<ImageMetadataScanner::Result> const results(
+        ImageMetadataScanner::scan(file_paths)
+    );
+
+    std::vector<ImageFileInfo> loaded(images);
+    for (ImageMetadataScanner::Result const& result : results)
+    {
+        if (result.status == ImageMetadataLoader::LOADED && !result.perPageMetadata.empty())
+        {
+            loaded[result.fileIdx].imageInfo() = result.perPageMetadata;
+        }
+    }
+
+    return loaded;
+}
+
+
+void
+ConsoleBatch::setupAcceleration()
 {
     try {
         m_pAccelerationProvider = new DefaultAccelerationProvider(::QCoreApplication::instance());
+        m_ptrAccelOps = m_pAccelerationProvider->getOperations();
     } catch (...) {
-        std::cerr << "Warning: Failed to initialize acceleration provider, continuing without acceleration." << std::endl;
+        std::cerr << "Warning: Failed to initialize acceleration, continuing without it." << std::endl;
     }
-    
+}
+
+
+ConsoleBatch::ConsoleBatch(std::vector<ImageFileInfo> const& images, QString const& output_directory, ::Qt::LayoutDirection const layout)
+    :   batch(true), debug(true),
+        m_pAccelerationProvider(nullptr),
+        m_ptrDisambiguator(new FileNameDisambiguator()),
+        m_ptrPages(new ProjectPages(loadImageMetadata(images), ProjectPages::AUTO_PAGES, layout))
+{
+    setupAcceleration();
+
     PageSelectionAccessor const accessor((::IntrusivePtr<PageSelectionProvider>())); // Won't really be used anyway.
     m_ptrStages = ::IntrusivePtr<StageSequence>(new StageSequence(m_ptrPages, accessor));
 
-    std::shared_ptr<AcceleratableOperations> accel_ops;
-    if (m_pAccelerationProvider) {
-        try {
-            accel_ops = m_pAccelerationProvider->getOperations();
-        } catch (...) {
-            std::cerr << "Warning: Failed to get acceleration operations, using non-accelerated mode." << std::endl;
-        }
-    }
-    m_ptrThumbnailCache = Utils::createThumbnailCache(output_directory, accel_ops);
+    m_ptrThumbnailCache = Utils::createThumbnailCache(output_directory, m_ptrAccelOps);
     m_outFileNameGen = OutputFileNameGenerator(m_ptrDisambiguator, output_directory, m_ptrPages->layoutDirection());
 }
 
@@ -121,12 +400,8 @@ ConsoleBatch::ConsoleBatch(::QString const project_file)
     :   batch(true), debug(true),
         m_pAccelerationProvider(nullptr)
 {
-    try {
-        m_pAccelerationProvider = new DefaultAccelerationProvider(::QCoreApplication::instance());
-    } catch (...) {
-        std::cerr << "Warning: Failed to initialize acceleration provider, continuing without acceleration." << std::endl;
-    }
-    
+    setupAcceleration();
+
     ::QFile file(project_file);
     if (!file.open(::QIODevice::ReadOnly))
     {
@@ -157,25 +432,16 @@ ConsoleBatch::ConsoleBatch(::QString const project_file)
         output_directory = cli.outputDirectory();
     }
 
-    // Create thumbnail cache with null pointer check
-    std::shared_ptr<AcceleratableOperations> accel_ops;
-    if (m_pAccelerationProvider) {
-        try {
-            // Use public interface to get operations
-            accel_ops = std::shared_ptr<AcceleratableOperations>();
-        } catch (...) {
-            std::cerr << "Warning: Failed to get acceleration operations, using non-accelerated mode." << std::endl;
-        }
-    }
-    m_ptrThumbnailCache = Utils::createThumbnailCache(output_directory, accel_ops);
+    // Create thumbnail cache
+    m_ptrThumbnailCache = Utils::createThumbnailCache(output_directory, m_ptrAccelOps);
     m_outFileNameGen = OutputFileNameGenerator(m_ptrDisambiguator, output_directory, m_ptrPages->layoutDirection());
 }
 
 
-BackgroundTaskPtr
+IntrusivePtr<LoadFileTask>
 ConsoleBatch::createCompositeTask(
     PageInfo const& page,
-    int const last_filter_idx)
+    int const last_filter_idx) const
 {
     ::IntrusivePtr<fix_orientation::Task> fix_orientation_task;
     ::IntrusivePtr<page_split::Task> page_split_task;
@@ -184,68 +450,57 @@ ConsoleBatch::createCompositeTask(
     IntrusivePtr<page_layout::Task> page_layout_task;
     IntrusivePtr<output::Task> output_task;
 
-    if (batch)
-    {
-        debug = false;
-    }
+    // Only the last stage may produce debug images.  This function may be
+    // called from worker threads, so it doesn't modify any members.
+    bool last_stage_debug = debug && !batch;
     if (last_filter_idx >= m_ptrStages->outputFilterIdx())
     {
         output_task = m_ptrStages->outputFilter()->createTask(
-                          page.id(), m_ptrThumbnailCache, m_outFileNameGen, batch, debug
+                          page.id(), m_ptrThumbnailCache, m_outFileNameGen, batch, last_stage_debug
                       );
-        debug = false;
+        last_stage_debug = false;
     }
     if (last_filter_idx >= m_ptrStages->pageLayoutFilterIdx())
     {
         page_layout_task = m_ptrStages->pageLayoutFilter()->createTask(
-                               page.id(), output_task, batch, debug
+                               page.id(), output_task, batch, last_stage_debug
                            );
-        debug = false;
+        last_stage_debug = false;
     }
     if (last_filter_idx >= m_ptrStages->selectContentFilterIdx())
     {
         select_content_task = m_ptrStages->selectContentFilter()->createTask(
-                                  page.id(), page_layout_task, batch, debug
+                                  page.id(), page_layout_task, batch, last_stage_debug
                               );
-        debug = false;
+        last_stage_debug = false;
     }
     if (last_filter_idx >= m_ptrStages->deskewFilterIdx())
     {
         deskew_task = m_ptrStages->deskewFilter()->createTask(
-                          page.id(), select_content_task, batch, debug
+                          page.id(), select_content_task, batch, last_stage_debug
                       );
-        debug = false;
+        last_stage_debug = false;
     }
     if (last_filter_idx >= m_ptrStages->pageSplitFilterIdx())
     {
         page_split_task = m_ptrStages->pageSplitFilter()->createTask(
-                              page, deskew_task, batch, debug
+                              page, deskew_task, batch, last_stage_debug
                           );
-        debug = false;
+        last_stage_debug = false;
     }
     if (last_filter_idx >= m_ptrStages->fixOrientationFilterIdx())
     {
         fix_orientation_task = m_ptrStages->fixOrientationFilter()->createTask(
                                    page.id(), page_split_task, batch
                                );
-        debug = false;
+        last_stage_debug = false;
     }
     assert(fix_orientation_task);
 
-    std::shared_ptr<AcceleratableOperations> accel_ops;
-    if (m_pAccelerationProvider) {
-        try {
-            // Use public interface to get operations
-            accel_ops = std::shared_ptr<AcceleratableOperations>();
-        } catch (...) {
-            std::cerr << "Warning: Failed to get acceleration operations, using non-accelerated mode." << std::endl;
-        }
-    }
-    
-    return BackgroundTaskPtr(
+    return IntrusivePtr<LoadFileTask>(
                new LoadFileTask(
                    BackgroundTask::BATCH, page,
-                   accel_ops,
+                   m_ptrAccelOps,
                    m_ptrThumbnailCache, m_ptrPages, fix_orientation_task
                )
            );
@@ -277,7 +532,49 @@ ConsoleBatch::process()
         endFilterIdx = ef;
     }
 
-    for (int j=startFilterIdx; j<=endFilterIdx; j++)
+    // Each page goes through the output stage once, so writing its
+    // intermediate images to disk would only cost time and space.
+    StageCache::instance().disableDiskTier();
+
+    TaskPool pool(cli.getThreads());
+
+    // Stages up to select_content only look at the page being processed,
+    // so in streaming mode they are run back to back on every image while
+    // it's still in memory.  The remaining stages need results from all
+    // pages and are processed in the usual stage-by-stage manner.
+    int const last_streamed_idx = std::min(endFilterIdx, m_ptrStages->selectContentFilterIdx());
+    if (cli.isStreaming() && last_streamed_idx > startFilterIdx)
+    {
+        processStreaming(startFilterIdx, last_streamed_idx, pool);
+        startFilterIdx = last_streamed_idx + 1;
+    }
+
+    processStaged(startFilterIdx, endFilterIdx, pool);
+
+    if (Trace::isEnabled())
+    {
+        std::cout << "\nTime spent per stage and operation:\n";
+        Trace::printSummary(std::cout);
+
+        QString const trace_file(cli.getTraceFile());
+        if (!trace_file.isEmpty() && !Trace::writeChromeTrace(trace_file))
+        {
+            std::cerr << "Failed to write the trace to " << trace_file.toLocal8Bit().constData() << std::endl;
+        }
+    }
+}
+
+void
+ConsoleBatch::processStaged(int const first_filter_idx, int const last_filter_idx, TaskPool& pool)
+{
+    CommandLine const& cli = CommandLine::get();
+
+    // Pages within a stage are independent of each other, so they are
+    // dispatched to the pool.  Stages themselves are separated by a barrier:
+    // page_split may change the set of pages the following stages see,
+    // and page_layout / output depend on the aggregate content size
+    // collected from every page by the preceding stage.
+    for (int j=first_filter_idx; j<=last_filter_idx; j++)
     {
         if (cli.isVerbose())
             std::cout << "Filter: " << (j+1) << "\n";
@@ -290,11 +587,44 @@ ConsoleBatch::process()
             if (cli.isVerbose())
                 std::cout << "\tProcessing: " << page.imageId().filePath().toLocal8Bit().constData() << "\n";
             BackgroundTaskPtr bgTask = createCompositeTask(page, j);
-            (*bgTask)();
+            pool.submit(bgTask);
         }
+
+        pool.waitForDone();
     }
 }
 
+void
+ConsoleBatch::processStreaming(int const first_filter_idx, int const last_filter_idx, TaskPool& pool)
+{
+    CommandLine const& cli = CommandLine::get();
+
+    if (cli.isVerbose())
+        std::cout << "Filters: " << (first_filter_idx+1) << "-" << (last_filter_idx+1) << "\n";
+
+    // Filters preceding page splitting are configured per image, so that
+    // can be done upfront.  The rest depend on the outcome of page splitting
+    // and are configured by StreamingImageTask.
+    PageSequence const page_sequence = m_ptrPages->toPageSequence(PAGE_VIEW);
+    for (int j=first_filter_idx; j<=std::min(last_filter_idx, m_ptrStages->pageSplitFilterIdx()); j++)
+    {
+        setupFilter(j, page_sequence.selectAll());
+    }
+
+    PageSequence const image_sequence = m_ptrPages->toPageSequence(IMAGE_VIEW);
+    for (unsigned i=0; i<image_sequence.numPages(); i++)
+    {
+        ImageId const& image_id = image_sequence.pageAt(i).imageId();
+        if (cli.isVerbose())
+            std::cout << "\tProcessing: " << image_id.filePath().toLocal8Bit().constData() << "\n";
+        pool.submit(BackgroundTaskPtr(
+            new StreamingImageTask(*this, image_id, first_filter_idx, last_filter_idx)
+        ));
+    }
+
+    pool.waitForDone();
+}
+
 void
 ConsoleBatch::saveProject(QString const project_file)
 {
@@ -23,6 +23,7 @@
 
 #include <QString>
 #include <vector>
+#include <memory>
 
 #include "IntrusivePtr.h"
 #include "BackgroundTask.h"
@@ -40,6 +41,8 @@
 #include "ProjectReader.h"
 
 class DefaultAccelerationProvider;
+class AcceleratableOperations;
+class LoadFileTask;
 
 class ConsoleBatch
 {
@@ -55,9 +58,30 @@ public:
     void saveProject(QString const project_file);
 
 private:
+    class TaskPool;
+    class StreamingImageTask;
+
+    /**
+     * \brief Replaces the placeholder metadata of command line images
+     *        with the actual one, probing all files in parallel.
+     *
+     * Files that fail to load keep their placeholder metadata, leaving it
+     * to the processing stages to report the error.
+     */
+    static std::vector<ImageFileInfo> loadImageMetadata(
+        std::vector<ImageFileInfo> const& images);
+
+    /**
+     * \brief Creates the acceleration provider and takes its operations,
+     *        so that batch runs use the plugin selected in the settings,
+     *        such as the multithreaded CPU one.
+     */
+    void setupAcceleration();
+
     bool batch;
     bool debug;
     DefaultAccelerationProvider* m_pAccelerationProvider;
+    std::shared_ptr<AcceleratableOperations> m_ptrAccelOps;
     IntrusivePtr<FileNameDisambiguator> m_ptrDisambiguator;
     IntrusivePtr<ProjectPages> m_ptrPages;
     IntrusivePtr<StageSequence> m_ptrStages;
@@ -73,10 +97,13 @@ private:
     void setupPageLayout(std::set<PageId> allPages);
     void setupOutput(std::set<PageId> allPages);
 
-    BackgroundTaskPtr createCompositeTask(
+    void processStaged(int first_filter_idx, int last_filter_idx, TaskPool& pool);
+    void processStreaming(int first_filter_idx, int last_filter_idx, TaskPool& pool);
+
+    IntrusivePtr<LoadFileTask> createCompositeTask(
         PageInfo const& page,
         int const last_filter_idx
-    );
+    ) const;
 };
 
 #endif
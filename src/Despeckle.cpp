@@ -29,10 +29,14 @@
 #include <QImage>
 #include <QSize>
 #include <QDebug>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThreadPool>
 #include "Despeckle.h"
 #include "TaskStatus.h"
 #include "DebugImages.h"
 #include "FastQueue.h"
+#include "ParallelFor.h"
 #include "imageproc/BinaryImage.h"
 #include "imageproc/ConnectivityMap.h"
 #include "imageproc/Connectivity.h"
@@ -169,38 +173,6 @@ uint32_t const Component::ANCHORED_TO_BIG;
 uint32_t const Component::ANCHORED_TO_SMALL;
 uint32_t const Component::TAG_MASK;
 
-struct BoundingBox
-{
-    int top;
-    int left;
-    int bottom;
-    int right;
-
-    BoundingBox()
-    {
-        top = left = std::numeric_limits<int>::max();
-        bottom = right = std::numeric_limits<int>::min();
-    }
-
-    int width() const
-    {
-        return right - left + 1;
-    }
-
-    int height() const
-    {
-        return bottom - top + 1;
-    }
-
-    void extend(int x, int y)
-    {
-        top = std::min(top, y);
-        left = std::min(left, x);
-        bottom = std::max(bottom, y);
-        right = std::max(right, x);
-    }
-};
-
 struct Vector
 {
     int16_t x;
@@ -390,119 +362,273 @@ bool canBeAttachedTo(
     return false;
 }
 
-void voronoi(ConnectivityMap& cmap, std::vector<Distance>& dist)
+/**
+ * The number of rows a single task propagates distances over.
+ */
+int const BAND_HEIGHT = 256;
+
+/**
+ * Propagates distances into a single row of the padded distance matrix.
+ *
+ * \param dist_line The row to process.  On input, holds the initial
+ *        distances, on output, the propagated ones.
+ * \param cmap_line Labels of the row being processed.
+ * \param sqdist_line Receives squared distances of the row being processed.
+ * \param adj_dist_line The row distances are propagated from: the one above
+ *        for top to bottom passes or the one below for bottom to top passes.
+ * \param adj_cmap_line Labels of the adjacent row.
+ * \param adj_sqdist_line Squared distances of the adjacent row.
+ * \param width The width of the padded matrices.
+ * \param special_distance Only used by voronoiSpecial() passes.
+ */
+typedef void (*RowPass)(
+    Distance* dist_line, uint32_t* cmap_line, uint32_t* sqdist_line,
+    Distance const* adj_dist_line, uint32_t const* adj_cmap_line,
+    uint32_t const* adj_sqdist_line, int width, Distance special_distance);
+
+/**
+ * Initializes distances the way the padding row above the image is
+ * initialized, that is as if the nearest object was far away.
+ */
+void resetRow(Distance* dist_line, int const width)
 {
-    int const width = cmap.size().width() + 2;
-    int const height = cmap.size().height() + 2;
+    dist_line[0].reset(0);
+    for (int x = 1; x < width; ++x)
+    {
+        dist_line[x].vec.x = dist_line[x - 1].vec.x - 1;
+        dist_line[x].vec.y = 0;
+    }
+}
 
-    assert(dist.empty());
-    dist.resize(width * height, Distance::zero());
+void voronoiDown(
+    Distance* const dist_line, uint32_t* const cmap_line, uint32_t* const this_sqdist_line,
+    Distance const* const top_dist_line, uint32_t const* const top_cmap_line,
+    uint32_t const* const prev_sqdist_line, int const width, Distance)
+{
+    dist_line[0].reset(0);
+    dist_line[width - 1].reset(width - 1);
+    this_sqdist_line[0] = dist_line[0].sqdist();
+    this_sqdist_line[width - 1] = dist_line[width - 1].sqdist();
+    // Left to right scan.
+    for (int x = 1; x < width - 1; ++x)
+    {
+        if (cmap_line[x])
+        {
+            this_sqdist_line[x] = 0;
+            assert(dist_line[x] == Distance::zero());
+            continue;
+        }
 
-    std::vector<uint32_t> sqdists(width * 2, 0);
-    uint32_t* prev_sqdist_line = &sqdists[0];
-    uint32_t* this_sqdist_line = &sqdists[width];
+        // Propagate from left.
+        Distance left_dist = dist_line[x - 1];
+        uint32_t sqdist_left = this_sqdist_line[x - 1];
+        sqdist_left += 1 - (int(left_dist.vec.x) << 1);
 
-    Distance* dist_line = &dist[0];
-    uint32_t* cmap_line = cmap.paddedData();
+        // Propagate from top.
+        Distance top_dist = top_dist_line[x];
+        uint32_t sqdist_top = prev_sqdist_line[x];
+        sqdist_top += VERTICAL_SCALE_SQ - 2 * VERTICAL_SCALE_SQ * int(top_dist.vec.y);
 
+        if (sqdist_left < sqdist_top)
+        {
+            this_sqdist_line[x] = sqdist_left;
+            --left_dist.vec.x;
+            dist_line[x] = left_dist;
+            cmap_line[x] = cmap_line[x - 1];
+        }
+        else
+        {
+            this_sqdist_line[x] = sqdist_top;
+            --top_dist.vec.y;
+            dist_line[x] = top_dist;
+            cmap_line[x] = top_cmap_line[x];
+        }
+    }
+
+    // Right to left scan.
+    for (int x = width - 2; x >= 1; --x)
+    {
+        // Propagate from right.
+        Distance right_dist = dist_line[x + 1];
+        uint32_t sqdist_right = this_sqdist_line[x + 1];
+        sqdist_right += 1 + (int(right_dist.vec.x) << 1);
+
+        if (sqdist_right < this_sqdist_line[x])
+        {
+            this_sqdist_line[x] = sqdist_right;
+            ++right_dist.vec.x;
+            dist_line[x] = right_dist;
+            cmap_line[x] = cmap_line[x + 1];
+        }
+    }
+}
+
+void voronoiUp(
+    Distance* const dist_line, uint32_t* const cmap_line, uint32_t* const this_sqdist_line,
+    Distance const* const bottom_dist_line, uint32_t const* const bottom_cmap_line,
+    uint32_t const* const prev_sqdist_line, int const width, Distance)
+{
     dist_line[0].reset(0);
-    prev_sqdist_line[0] = dist_line[0].sqdist();
-    for (int x = 1; x < width; ++x)
+    dist_line[width - 1].reset(width - 1);
+    this_sqdist_line[0] = dist_line[0].sqdist();
+    this_sqdist_line[width - 1] = dist_line[width - 1].sqdist();
+    // Right to left scan.
+    for (int x = width - 2; x >= 1; --x)
     {
-        dist_line[x].vec.x = dist_line[x - 1].vec.x - 1;
-        prev_sqdist_line[x] = prev_sqdist_line[x - 1]
-                              - (int(dist_line[x - 1].vec.x) << 1) + 1;
+        // Propagate from right.
+        Distance right_dist = dist_line[x + 1];
+        uint32_t sqdist_right = this_sqdist_line[x + 1];
+        sqdist_right += 1 + (int(right_dist.vec.x) << 1);
+
+        // Propagate from bottom.
+        Distance bottom_dist = bottom_dist_line[x];
+        uint32_t sqdist_bottom = prev_sqdist_line[x];
+        sqdist_bottom += VERTICAL_SCALE_SQ + 2 * VERTICAL_SCALE_SQ * int(bottom_dist.vec.y);
+
+        this_sqdist_line[x] = dist_line[x].sqdist();
+
+        if (sqdist_right < this_sqdist_line[x])
+        {
+            this_sqdist_line[x] = sqdist_right;
+            ++right_dist.vec.x;
+            dist_line[x] = right_dist;
+            assert(cmap_line[x] == 0 || cmap_line[x + 1] != 0);
+            cmap_line[x] = cmap_line[x + 1];
+        }
+        if (sqdist_bottom < this_sqdist_line[x])
+        {
+            this_sqdist_line[x] = sqdist_bottom;
+            ++bottom_dist.vec.y;
+            dist_line[x] = bottom_dist;
+            assert(cmap_line[x] == 0 || bottom_cmap_line[x] != 0);
+            cmap_line[x] = bottom_cmap_line[x];
+        }
     }
 
-    // Top to bottom scan.
-    for (int y = 1; y < height; ++y)
+    // Left to right scan.
+    for (int x = 1; x < width - 1; ++x)
     {
-        dist_line += width;
-        cmap_line += width;
-        dist_line[0].reset(0);
-        dist_line[width - 1].reset(width - 1);
-        this_sqdist_line[0] = dist_line[0].sqdist();
-        this_sqdist_line[width - 1] = dist_line[width - 1].sqdist();
-        // Left to right scan.
-        for (int x = 1; x < width - 1; ++x)
+        // Propagate from left.
+        Distance left_dist = dist_line[x - 1];
+        uint32_t sqdist_left = this_sqdist_line[x - 1];
+        sqdist_left += 1 - (int(left_dist.vec.x) << 1);
+
+        if (sqdist_left < this_sqdist_line[x])
         {
-            if (cmap_line[x])
-            {
-                this_sqdist_line[x] = 0;
-                assert(dist_line[x] == Distance::zero());
-                continue;
-            }
+            this_sqdist_line[x] = sqdist_left;
+            --left_dist.vec.x;
+            dist_line[x] = left_dist;
+            assert(cmap_line[x] == 0 || cmap_line[x - 1] != 0);
+            cmap_line[x] = cmap_line[x - 1];
+        }
+    }
+}
 
-            // Propagate from left.
-            Distance left_dist = dist_line[x - 1];
-            uint32_t sqdist_left = this_sqdist_line[x - 1];
-            sqdist_left += 1 - (int(left_dist.vec.x) << 1);
+void voronoiSpecialDown(
+    Distance* const dist_line, uint32_t* const cmap_line, uint32_t* const this_sqdist_line,
+    Distance const* const top_dist_line, uint32_t const* const top_cmap_line,
+    uint32_t const* const prev_sqdist_line, int const width,
+    Distance const special_distance)
+{
+    dist_line[0].reset(0);
+    dist_line[width - 1].reset(width - 1);
+    this_sqdist_line[0] = dist_line[0].sqdist();
+    this_sqdist_line[width - 1] = dist_line[width - 1].sqdist();
+    // Left to right scan.
+    for (int x = 1; x < width - 1; ++x)
+    {
+        if (dist_line[x] == special_distance)
+        {
+            continue;
+        }
 
-            // Propagate from top.
-            Distance top_dist = dist_line[x - width];
-            uint32_t sqdist_top = prev_sqdist_line[x];
-            sqdist_top += VERTICAL_SCALE_SQ - 2 * VERTICAL_SCALE_SQ * int(top_dist.vec.y);
+        this_sqdist_line[x] = dist_line[x].sqdist();
 
-            if (sqdist_left < sqdist_top)
+        // Propagate from left.
+        Distance left_dist = dist_line[x - 1];
+        if (left_dist != special_distance)
+        {
+            uint32_t sqdist_left = this_sqdist_line[x - 1];
+            sqdist_left += 1 - (int(left_dist.vec.x) << 1);
+            if (sqdist_left < this_sqdist_line[x])
             {
                 this_sqdist_line[x] = sqdist_left;
                 --left_dist.vec.x;
                 dist_line[x] = left_dist;
+                assert(cmap_line[x] == 0 || cmap_line[x - 1] != 0);
                 cmap_line[x] = cmap_line[x - 1];
             }
-            else
+        }
+
+        // Propagate from top.
+        Distance top_dist = top_dist_line[x];
+        if (top_dist != special_distance)
+        {
+            uint32_t sqdist_top = prev_sqdist_line[x];
+            sqdist_top += VERTICAL_SCALE_SQ - 2 * VERTICAL_SCALE_SQ * int(top_dist.vec.y);
+            if (sqdist_top < this_sqdist_line[x])
             {
                 this_sqdist_line[x] = sqdist_top;
                 --top_dist.vec.y;
                 dist_line[x] = top_dist;
-                cmap_line[x] = cmap_line[x - width];
+                assert(cmap_line[x] == 0 || top_cmap_line[x] != 0);
+                cmap_line[x] = top_cmap_line[x];
             }
         }
+    }
 
-        // Right to left scan.
-        for (int x = width - 2; x >= 1; --x)
+    // Right to left scan.
+    for (int x = width - 2; x >= 1; --x)
+    {
+        if (dist_line[x] == special_distance)
+        {
+            continue;
+        }
+
+        // Propagate from right.
+        Distance right_dist = dist_line[x + 1];
+        if (right_dist != special_distance)
         {
-            // Propagate from right.
-            Distance right_dist = dist_line[x + 1];
             uint32_t sqdist_right = this_sqdist_line[x + 1];
             sqdist_right += 1 + (int(right_dist.vec.x) << 1);
-
             if (sqdist_right < this_sqdist_line[x])
             {
                 this_sqdist_line[x] = sqdist_right;
                 ++right_dist.vec.x;
                 dist_line[x] = right_dist;
+                assert(cmap_line[x] == 0 || cmap_line[x + 1] != 0);
                 cmap_line[x] = cmap_line[x + 1];
             }
         }
-
-        std::swap(this_sqdist_line, prev_sqdist_line);
     }
+}
 
-    // Bottom to top scan.
-    for (int y = height - 2; y >= 1; --y)
+void voronoiSpecialUp(
+    Distance* const dist_line, uint32_t* const cmap_line, uint32_t* const this_sqdist_line,
+    Distance const* const bottom_dist_line, uint32_t const* const bottom_cmap_line,
+    uint32_t const* const prev_sqdist_line, int const width,
+    Distance const special_distance)
+{
+    dist_line[0].reset(0);
+    dist_line[width - 1].reset(width - 1);
+    this_sqdist_line[0] = dist_line[0].sqdist();
+    this_sqdist_line[width - 1] = dist_line[width - 1].sqdist();
+    // Right to left scan.
+    for (int x = width - 2; x >= 1; --x)
     {
-        dist_line -= width;
-        cmap_line -= width;
-        dist_line[0].reset(0);
-        dist_line[width - 1].reset(width - 1);
-        this_sqdist_line[0] = dist_line[0].sqdist();
-        this_sqdist_line[width - 1] = dist_line[width - 1].sqdist();
-        // Right to left scan.
-        for (int x = width - 2; x >= 1; --x)
+        if (dist_line[x] == special_distance)
         {
-            // Propagate from right.
-            Distance right_dist = dist_line[x + 1];
-            uint32_t sqdist_right = this_sqdist_line[x + 1];
-            sqdist_right += 1 + (int(right_dist.vec.x) << 1);
-
-            // Propagate from bottom.
-            Distance bottom_dist = dist_line[x + width];
-            uint32_t sqdist_bottom = prev_sqdist_line[x];
-            sqdist_bottom += VERTICAL_SCALE_SQ + 2 * VERTICAL_SCALE_SQ * int(bottom_dist.vec.y);
+            continue;
+        }
 
-            this_sqdist_line[x] = dist_line[x].sqdist();
+        this_sqdist_line[x] = dist_line[x].sqdist();
 
+        // Propagate from right.
+        Distance right_dist = dist_line[x + 1];
+        if (right_dist != special_distance)
+        {
+            uint32_t sqdist_right = this_sqdist_line[x + 1];
+            sqdist_right += 1 + (int(right_dist.vec.x) << 1);
             if (sqdist_right < this_sqdist_line[x])
             {
                 this_sqdist_line[x] = sqdist_right;
@@ -511,24 +637,39 @@ void voronoi(ConnectivityMap& cmap, std::vector<Distance>& dist)
                 assert(cmap_line[x] == 0 || cmap_line[x + 1] != 0);
                 cmap_line[x] = cmap_line[x + 1];
             }
+        }
+
+        // Propagate from bottom.
+        Distance bottom_dist = bottom_dist_line[x];
+        if (bottom_dist != special_distance)
+        {
+            uint32_t sqdist_bottom = prev_sqdist_line[x];
+            sqdist_bottom += VERTICAL_SCALE_SQ + 2 * VERTICAL_SCALE_SQ * int(bottom_dist.vec.y);
             if (sqdist_bottom < this_sqdist_line[x])
             {
                 this_sqdist_line[x] = sqdist_bottom;
                 ++bottom_dist.vec.y;
                 dist_line[x] = bottom_dist;
-                assert(cmap_line[x] == 0 || cmap_line[x + width] != 0);
-                cmap_line[x] = cmap_line[x + width];
+                assert(cmap_line[x] == 0 || bottom_cmap_line[x] != 0);
+                cmap_line[x] = bottom_cmap_line[x];
             }
         }
+    }
+
+    // Left to right scan.
+    for (int x = 1; x < width - 1; ++x)
+    {
+        if (dist_line[x] == special_distance)
+        {
+            continue;
+        }
 
-        // Left to right scan.
-        for (int x = 1; x < width - 1; ++x)
+        // Propagate from left.
+        Distance left_dist = dist_line[x - 1];
+        if (left_dist != special_distance)
         {
-            // Propagate from left.
-            Distance left_dist = dist_line[x - 1];
             uint32_t sqdist_left = this_sqdist_line[x - 1];
             sqdist_left += 1 - (int(left_dist.vec.x) << 1);
-
             if (sqdist_left < this_sqdist_line[x])
             {
                 this_sqdist_line[x] = sqdist_left;
@@ -538,191 +679,184 @@ void voronoi(ConnectivityMap& cmap, std::vector<Distance>& dist)
                 cmap_line[x] = cmap_line[x - 1];
             }
         }
-
-        std::swap(this_sqdist_line, prev_sqdist_line);
     }
 }
 
-void voronoiSpecial(ConnectivityMap& cmap, std::vector<Distance>& dist, Distance const special_distance)
+/**
+ * \brief Applies a RowPass to a sequence of rows of the padded matrices.
+ *
+ * Rows first_row, first_row + step, ... are processed, num_rows in total.
+ * Row first_row - step is expected to be final already.
+ *
+ * Each row only depends on itself and the row processed before it.
+ * That allows processing bands of rows in parallel: the first band of
+ * a group starts from the real preceding row, while the others start
+ * from a row initialized the way padding rows are, and save their
+ * input first.  Once the preceding band is final, a band is recomputed from
+ * its saved input and the real preceding row, stopping as soon as
+ * a recomputed row matches the one computed speculatively, as all
+ * the subsequent rows will match as well.  The result is therefore
+ * identical to processing all rows in order, while extra memory is
+ * limited to a band per thread.
+ */
+void propagate(
+    std::vector<Distance>& dist, ConnectivityMap& cmap,
+    int const first_row, int const num_rows, int const step,
+    RowPass const row_pass, Distance const special_distance = Distance::zero())
 {
-    int const width = cmap.size().width() + 2;
-    int const height = cmap.size().height() + 2;
+    if (num_rows <= 0)
+    {
+        return;
+    }
 
-    std::vector<uint32_t> sqdists(width * 2, 0);
-    uint32_t* prev_sqdist_line = &sqdists[0];
-    uint32_t* this_sqdist_line = &sqdists[width];
+    int const width = cmap.stride();
+    Distance* const dist_data = &dist[0];
+    uint32_t* const cmap_data = cmap.paddedData();
 
-    Distance* dist_line = &dist[0];
-    uint32_t* cmap_line = cmap.paddedData();
+    int const num_bands = (num_rows + BAND_HEIGHT - 1) / BAND_HEIGHT;
+    int const group_size = std::min(
+        num_bands, std::max(1, QThreadPool::globalInstance()->maxThreadCount())
+    );
 
-    dist_line[0].reset(0);
-    prev_sqdist_line[0] = dist_line[0].sqdist();
-    for (int x = 1; x < width; ++x)
-    {
-        dist_line[x].vec.x = dist_line[x - 1].vec.x - 1;
-        prev_sqdist_line[x] = prev_sqdist_line[x - 1]
-                              - (int(dist_line[x - 1].vec.x) << 1) + 1;
-    }
+    std::vector<Distance> far_dist(width);
+    std::vector<uint32_t> far_cmap(width, 0);
+    resetRow(&far_dist[0], width);
 
-    // Top to bottom scan.
-    for (int y = 1; y < height - 1; ++y)
+    // Inputs of the bands processed speculatively.
+    size_t const saved_band_size = size_t(BAND_HEIGHT) * width;
+    std::vector<Distance> saved_dist((group_size - 1) * saved_band_size);
+    std::vector<uint32_t> saved_cmap((group_size - 1) * saved_band_size);
+
+    auto const process_rows = [&](
+        int const begin, int const end,
+        Distance const* adj_dist_line, uint32_t const* adj_cmap_line)
     {
-        dist_line += width;
-        cmap_line += width;
-        dist_line[0].reset(0);
-        dist_line[width - 1].reset(width - 1);
-        this_sqdist_line[0] = dist_line[0].sqdist();
-        this_sqdist_line[width - 1] = dist_line[width - 1].sqdist();
-        // Left to right scan.
-        for (int x = 1; x < width - 1; ++x)
+        std::vector<uint32_t> sqdists(width * 2);
+        uint32_t* prev_sqdist_line = &sqdists[0];
+        uint32_t* this_sqdist_line = &sqdists[width];
+        for (int x = 0; x < width; ++x)
         {
-            if (dist_line[x] == special_distance)
-            {
-                continue;
-            }
+            prev_sqdist_line[x] = adj_dist_line[x].sqdist();
+        }
 
-            this_sqdist_line[x] = dist_line[x].sqdist();
+        for (int i = begin; i < end; ++i)
+        {
+            size_t const offset = size_t(first_row + i * step) * width;
+            row_pass(
+                dist_data + offset, cmap_data + offset, this_sqdist_line,
+                adj_dist_line, adj_cmap_line, prev_sqdist_line,
+                width, special_distance
+            );
+            adj_dist_line = dist_data + offset;
+            adj_cmap_line = cmap_data + offset;
+            std::swap(this_sqdist_line, prev_sqdist_line);
+        }
+    };
 
-            // Propagate from left.
-            Distance left_dist = dist_line[x - 1];
-            if (left_dist != special_distance)
+    for (int group_begin = 0; group_begin < num_bands; group_begin += group_size)
+    {
+        int const group_end = std::min(num_bands, group_begin + group_size);
+
+        parallelFor(group_begin, group_end, [&](int const band_begin, int const band_end)
+        {
+            for (int band = band_begin; band < band_end; ++band)
             {
-                uint32_t sqdist_left = this_sqdist_line[x - 1];
-                sqdist_left += 1 - (int(left_dist.vec.x) << 1);
-                if (sqdist_left < this_sqdist_line[x])
+                int const begin = band * BAND_HEIGHT;
+                int const end = std::min(num_rows, begin + BAND_HEIGHT);
+                if (band == group_begin)
                 {
-                    this_sqdist_line[x] = sqdist_left;
-                    --left_dist.vec.x;
-                    dist_line[x] = left_dist;
-                    assert(cmap_line[x] == 0 || cmap_line[x - 1] != 0);
-                    cmap_line[x] = cmap_line[x - 1];
+                    size_t const offset = size_t(first_row + (begin - 1) * step) * width;
+                    process_rows(begin, end, dist_data + offset, cmap_data + offset);
+                    continue;
                 }
-            }
 
-            // Propagate from top.
-            Distance top_dist = dist_line[x - width];
-            if (top_dist != special_distance)
-            {
-                uint32_t sqdist_top = prev_sqdist_line[x];
-                sqdist_top += VERTICAL_SCALE_SQ - 2 * VERTICAL_SCALE_SQ * int(top_dist.vec.y);
-                if (sqdist_top < this_sqdist_line[x])
+                size_t saved_offset = (band - group_begin - 1) * saved_band_size;
+                for (int i = begin; i < end; ++i, saved_offset += width)
                 {
-                    this_sqdist_line[x] = sqdist_top;
-                    --top_dist.vec.y;
-                    dist_line[x] = top_dist;
-                    assert(cmap_line[x] == 0 || cmap_line[x - width] != 0);
-                    cmap_line[x] = cmap_line[x - width];
+                    size_t const offset = size_t(first_row + i * step) * width;
+                    std::copy(dist_data + offset, dist_data + offset + width, &saved_dist[saved_offset]);
+                    std::copy(cmap_data + offset, cmap_data + offset + width, &saved_cmap[saved_offset]);
                 }
+                process_rows(begin, end, &far_dist[0], &far_cmap[0]);
             }
-        }
+        });
 
-        // Right to left scan.
-        for (int x = width - 2; x >= 1; --x)
+        // Fix up the speculatively processed bands.
+        std::vector<Distance> row_dist(width);
+        std::vector<uint32_t> row_cmap(width);
+        std::vector<uint32_t> sqdists(width * 2);
+        for (int band = group_begin + 1; band < group_end; ++band)
         {
-            if (dist_line[x] == special_distance)
+            int const begin = band * BAND_HEIGHT;
+            int const end = std::min(num_rows, begin + BAND_HEIGHT);
+
+            size_t adj_offset = size_t(first_row + (begin - 1) * step) * width;
+            uint32_t* prev_sqdist_line = &sqdists[0];
+            uint32_t* this_sqdist_line = &sqdists[width];
+            for (int x = 0; x < width; ++x)
             {
-                continue;
+                prev_sqdist_line[x] = dist_data[adj_offset + x].sqdist();
             }
 
-            // Propagate from right.
-            Distance right_dist = dist_line[x + 1];
-            if (right_dist != special_distance)
+            size_t saved_offset = (band - group_begin - 1) * saved_band_size;
+            for (int i = begin; i < end; ++i, saved_offset += width)
             {
-                uint32_t sqdist_right = this_sqdist_line[x + 1];
-                sqdist_right += 1 + (int(right_dist.vec.x) << 1);
-                if (sqdist_right < this_sqdist_line[x])
+                size_t const offset = size_t(first_row + i * step) * width;
+                std::copy(&saved_dist[saved_offset], &saved_dist[saved_offset] + width, row_dist.begin());
+                std::copy(&saved_cmap[saved_offset], &saved_cmap[saved_offset] + width, row_cmap.begin());
+                row_pass(
+                    &row_dist[0], &row_cmap[0], this_sqdist_line,
+                    dist_data + adj_offset, cmap_data + adj_offset, prev_sqdist_line,
+                    width, special_distance
+                );
+
+                if (std::equal(row_dist.begin(), row_dist.end(), dist_data + offset) &&
+                        std::equal(row_cmap.begin(), row_cmap.end(), cmap_data + offset))
                 {
-                    this_sqdist_line[x] = sqdist_right;
-                    ++right_dist.vec.x;
-                    dist_line[x] = right_dist;
-                    assert(cmap_line[x] == 0 || cmap_line[x + 1] != 0);
-                    cmap_line[x] = cmap_line[x + 1];
+                    break;
                 }
+
+                std::copy(row_dist.begin(), row_dist.end(), dist_data + offset);
+                std::copy(row_cmap.begin(), row_cmap.end(), cmap_data + offset);
+                adj_offset = offset;
+                std::swap(this_sqdist_line, prev_sqdist_line);
             }
         }
-
-        std::swap(this_sqdist_line, prev_sqdist_line);
     }
+}
 
-    // Bottom to top scan.
-    for (int y = height - 2; y >= 1; --y)
-    {
-        dist_line -= width;
-        cmap_line -= width;
-        dist_line[0].reset(0);
-        dist_line[width - 1].reset(width - 1);
-        this_sqdist_line[0] = dist_line[0].sqdist();
-        this_sqdist_line[width - 1] = dist_line[width - 1].sqdist();
-        // Right to left scan.
-        for (int x = width - 2; x >= 1; --x)
-        {
-            if (dist_line[x] == special_distance)
-            {
-                continue;
-            }
+void voronoi(ConnectivityMap& cmap, std::vector<Distance>& dist)
+{
+    int const width = cmap.size().width() + 2;
+    int const height = cmap.size().height() + 2;
 
-            this_sqdist_line[x] = dist_line[x].sqdist();
+    assert(dist.empty());
+    dist.resize(width * height, Distance::zero());
 
-            // Propagate from right.
-            Distance right_dist = dist_line[x + 1];
-            if (right_dist != special_distance)
-            {
-                uint32_t sqdist_right = this_sqdist_line[x + 1];
-                sqdist_right += 1 + (int(right_dist.vec.x) << 1);
-                if (sqdist_right < this_sqdist_line[x])
-                {
-                    this_sqdist_line[x] = sqdist_right;
-                    ++right_dist.vec.x;
-                    dist_line[x] = right_dist;
-                    assert(cmap_line[x] == 0 || cmap_line[x + 1] != 0);
-                    cmap_line[x] = cmap_line[x + 1];
-                }
-            }
+    resetRow(&dist[0], width);
 
-            // Propagate from bottom.
-            Distance bottom_dist = dist_line[x + width];
-            if (bottom_dist != special_distance)
-            {
-                uint32_t sqdist_bottom = prev_sqdist_line[x];
-                sqdist_bottom += VERTICAL_SCALE_SQ + 2 * VERTICAL_SCALE_SQ * int(bottom_dist.vec.y);
-                if (sqdist_bottom < this_sqdist_line[x])
-                {
-                    this_sqdist_line[x] = sqdist_bottom;
-                    ++bottom_dist.vec.y;
-                    dist_line[x] = bottom_dist;
-                    assert(cmap_line[x] == 0 || cmap_line[x + width] != 0);
-                    cmap_line[x] = cmap_line[x + width];
-                }
-            }
-        }
+    // Top to bottom scan.
+    propagate(dist, cmap, 1, height - 1, 1, &voronoiDown);
 
-        // Left to right scan.
-        for (int x = 1; x < width - 1; ++x)
-        {
-            if (dist_line[x] == special_distance)
-            {
-                continue;
-            }
+    // Bottom to top scan.
+    propagate(dist, cmap, height - 2, height - 2, -1, &voronoiUp);
+}
 
-            // Propagate from left.
-            Distance left_dist = dist_line[x - 1];
-            if (left_dist != special_distance)
-            {
-                uint32_t sqdist_left = this_sqdist_line[x - 1];
-                sqdist_left += 1 - (int(left_dist.vec.x) << 1);
-                if (sqdist_left < this_sqdist_line[x])
-                {
-                    this_sqdist_line[x] = sqdist_left;
-                    --left_dist.vec.x;
-                    dist_line[x] = left_dist;
-                    assert(cmap_line[x] == 0 || cmap_line[x - 1] != 0);
-                    cmap_line[x] = cmap_line[x - 1];
-                }
-            }
-        }
+void voronoiSpecial(ConnectivityMap& cmap, std::vector<Distance>& dist, Distance const special_distance)
+{
+    int const width = cmap.size().width() + 2;
+    int const height = cmap.size().height() + 2;
 
-        std::swap(this_sqdist_line, prev_sqdist_line);
-    }
+    resetRow(&dist[0], width);
+
+    // Top to bottom scan.  Unlike voronoi(), the bottom padding line
+    // is left alone.
+    propagate(dist, cmap, 1, height - 2, 1, &voronoiSpecialDown, special_distance);
+
+    // Bottom to top scan.  Processing starts one line above the last
+    // line of the image and includes the top padding line.  That's
+    // how it has always worked, and the results depend on it.
+    propagate(dist, cmap, height - 3, height - 2, -1, &voronoiSpecialUp, special_distance);
 }
 
 /**
@@ -741,37 +875,51 @@ void voronoiDistances(
 
     uint32_t const* const cmap_data = cmap.data();
     Distance const* const distance_data = &distance_matrix[0] + width + 3;
-    for (int y = 0, offset = 0; y < height; ++y, offset += 2)
+
+    QMutex mutex;
+    parallelFor(0, height, [&](int const first_row, int const last_row)
     {
-        for (int x = 0; x < width; ++x, ++offset)
+        std::map<Connection, uint32_t> band_conns;
+
+        for (int y = first_row, offset = first_row * (width + 2); y < last_row; ++y, offset += 2)
         {
-            uint32_t const label = cmap_data[offset];
-            assert(label != 0);
+            for (int x = 0; x < width; ++x, ++offset)
+            {
+                uint32_t const label = cmap_data[offset];
+                assert(label != 0);
 
-            int const x1 = x + distance_data[offset].vec.x;
-            int const y1 = y + distance_data[offset].vec.y;
+                int const x1 = x + distance_data[offset].vec.x;
+                int const y1 = y + distance_data[offset].vec.y;
 
-            for (int i = 0; i < 4; ++i)
-            {
-                int const nbh_offset = offset + offsets[i];
-                uint32_t const nbh_label = cmap_data[nbh_offset];
-                if (nbh_label == 0 || nbh_label == label)
+                for (int i = 0; i < 4; ++i)
                 {
-                    // label 0 can be encountered in
-                    // padding lines.
-                    continue;
-                }
+                    int const nbh_offset = offset + offsets[i];
+                    uint32_t const nbh_label = cmap_data[nbh_offset];
+                    if (nbh_label == 0 || nbh_label == label)
+                    {
+                        // label 0 can be encountered in
+                        // padding lines.
+                        continue;
+                    }
 
-                int const x2 = x + distance_data[nbh_offset].vec.x;
-                int const y2 = y + distance_data[nbh_offset].vec.y;
-                int const dx = x1 - x2;
-                int const dy = y1 - y2;
-                uint32_t const sqdist = dx * dx + dy * dy;
+                    int const x2 = x + distance_data[nbh_offset].vec.x;
+                    int const y2 = y + distance_data[nbh_offset].vec.y;
+                    int const dx = x1 - x2;
+                    int const dy = y1 - y2;
+                    uint32_t const sqdist = dx * dx + dy * dy;
 
-                updateDistance(conns, label, nbh_label, sqdist);
+                    updateDistance(band_conns, label, nbh_label, sqdist);
+                }
             }
         }
-    }
+
+        QMutexLocker const locker(&mutex);
+        typedef std::map<Connection, uint32_t>::value_type Conn;
+        BOOST_FOREACH(Conn const& conn, band_conns)
+        {
+            updateDistance(conns, conn.first.lesser_label, conn.first.greater_label, conn.second);
+        }
+    });
 }
 
 } // anonymous namespace
@@ -794,7 +942,8 @@ Despeckle::despeckleInPlace(
 {
     Settings const settings(Settings::get(despeckle_factor, image.size()));
 
-    ConnectivityMap cmap(image, CONN8);
+    std::vector<ConnectivityMap::ComponentStats> stats;
+    ConnectivityMap cmap(image, CONN8, &stats);
     if (cmap.maxLabel() == 0)
     {
         // Completely white image?
@@ -803,38 +952,23 @@ Despeckle::despeckleInPlace(
 
     status.throwIfCancelled();
 
-    std::vector<Component> components(cmap.maxLabel() + 1);
-    std::vector<BoundingBox> bounding_boxes(cmap.maxLabel() + 1);
-
     int const width = image.width();
     int const height = image.height();
 
-    uint32_t* const cmap_data = cmap.data();
-
-    // Count the number of pixels and a bounding rect of each component.
-    uint32_t* cmap_line = cmap_data;
-    int const cmap_stride = cmap.stride();
-    for (int y = 0; y < height; ++y)
+    std::vector<Component> components(cmap.maxLabel() + 1);
+    for (uint32_t label = 1; label <= cmap.maxLabel(); ++label)
     {
-        for (int x = 0; x < width; ++x)
-        {
-            uint32_t const label = cmap_line[x];
-            ++components[label].num_pixels;
-            bounding_boxes[label].extend(x, y);
-        }
-        cmap_line += cmap_stride;
+        components[label].num_pixels = stats[label].pixCount;
     }
 
-    status.throwIfCancelled();
-
     // Unify big components into one.
     std::vector<uint32_t> remapping_table(components.size());
     uint32_t unified_big_component = 0;
     uint32_t next_avail_component = 1;
     for (uint32_t label = 1; label <= cmap.maxLabel(); ++label)
     {
-        if (bounding_boxes[label].width() < settings.bigObjectThreshold &&
-                bounding_boxes[label].height() < settings.bigObjectThreshold)
+        if (stats[label].width() < settings.bigObjectThreshold &&
+                stats[label].height() < settings.bigObjectThreshold)
         {
             components[next_avail_component] = components[label];
             remapping_table[label] = next_avail_component;
@@ -855,22 +989,27 @@ Despeckle::despeckleInPlace(
         }
     }
     components.resize(next_avail_component);
-    std::vector<BoundingBox>().swap(bounding_boxes); // We don't need them any more.
+    std::vector<ConnectivityMap::ComponentStats>().swap(stats); // We don't need them any more.
 
     status.throwIfCancelled();
 
     uint32_t const max_label = next_avail_component - 1;
 
     // Remapping individual pixels.
-    cmap_line = cmap_data;
-    for (int y = 0; y < height; ++y)
+    uint32_t* const cmap_data = cmap.data();
+    int const cmap_stride = cmap.stride();
+    parallelFor(0, height, [&](int const first_row, int const last_row)
     {
-        for (int x = 0; x < width; ++x)
+        uint32_t* cmap_line = cmap_data + first_row * cmap_stride;
+        for (int y = first_row; y < last_row; ++y)
         {
-            cmap_line[x] = remapping_table[cmap_line[x]];
+            for (int x = 0; x < width; ++x)
+            {
+                cmap_line[x] = remapping_table[cmap_line[x]];
+            }
+            cmap_line += cmap_stride;
         }
-        cmap_line += cmap_stride;
-    }
+    });
     if (dbg)
     {
         dbg->add(cmap.visualized(), "big_components_unified");
@@ -938,33 +1077,36 @@ Despeckle::despeckleInPlace(
 
         Distance const zero_distance(Distance::zero());
         Distance const special_distance(Distance::special());
-        for (int y = 0, offset = 0; y < height; ++y, offset += 2)
+        parallelFor(0, height, [&](int const first_row, int const last_row)
         {
-            for (int x = 0; x < width; ++x, ++offset)
+            for (int y = first_row, offset = first_row * (width + 2); y < last_row; ++y, offset += 2)
             {
-                uint32_t const label = cmap_data[offset];
-                assert(label != 0);
-
-                Component const& comp = components[label];
-                if (!comp.anchoredToSmallButNotBig())
+                for (int x = 0; x < width; ++x, ++offset)
                 {
-                    if (distance_data[offset] == zero_distance)
-                    {
-                        // Prevent this region from growing
-                        // and from being taken over by another
-                        // by another region.
-                        distance_data[offset] = special_distance;
-                    }
-                    else
+                    uint32_t const label = cmap_data[offset];
+                    assert(label != 0);
+
+                    Component const& comp = components[label];
+                    if (!comp.anchoredToSmallButNotBig())
                     {
-                        // Allow this region to be taken over by others.
-                        // Note: x + 1 here is equivalent to x
-                        // in voronoi() or voronoiSpecial().
-                        distance_data[offset].reset(x + 1);
+                        if (distance_data[offset] == zero_distance)
+                        {
+                            // Prevent this region from growing
+                            // and from being taken over by another
+                            // by another region.
+                            distance_data[offset] = special_distance;
+                        }
+                        else
+                        {
+                            // Allow this region to be taken over by others.
+                            // Note: x + 1 here is equivalent to x
+                            // in voronoi() or voronoiSpecial().
+                            distance_data[offset].reset(x + 1);
+                        }
                     }
                 }
             }
-        }
+        });
 
         status.throwIfCancelled();
 
@@ -1074,19 +1216,23 @@ Despeckle::despeckleInPlace(
 
     // Remove unmarked components from the binary image.
     uint32_t const msb = uint32_t(1) << 31;
-    uint32_t* image_line = image.data();
+    uint32_t* const image_data = image.data();
     int const image_stride = image.wordsPerLine();
-    cmap_line = cmap_data;
-    for (int y = 0; y < height; ++y)
+    parallelFor(0, height, [&](int const first_row, int const last_row)
     {
-        for (int x = 0; x < width; ++x)
+        uint32_t* image_line = image_data + first_row * image_stride;
+        uint32_t const* cmap_line = cmap_data + first_row * cmap_stride;
+        for (int y = first_row; y < last_row; ++y)
         {
-            if (!components[cmap_line[x]].anchoredToBig())
+            for (int x = 0; x < width; ++x)
             {
-                image_line[x >> 5] &= ~(msb >> (x & 31));
+                if (!components[cmap_line[x]].anchoredToBig())
+                {
+                    image_line[x >> 5] &= ~(msb >> (x & 31));
+                }
             }
+            image_line += image_stride;
+            cmap_line += cmap_stride;
         }
-        image_line += image_stride;
-        cmap_line += cmap_stride;
-    }
+    });
 }
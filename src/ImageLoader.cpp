@@ -20,7 +20,9 @@
 #include "TiffReader.h"
 #include "ImageId.h"
 #include <QImage>
+#include <QImageReader>
 #include <QString>
+#include <QSize>
 #include <QIODevice>
 #include <QFile>
 
@@ -59,3 +61,51 @@ ImageLoader::load(QIODevice& io_dev, int const page_num)
     image.load(&io_dev, 0);
     return image;
 }
+
+QImage
+ImageLoader::loadScaled(ImageId const& image_id, QSize const& hint)
+{
+    return loadScaled(image_id.filePath(), image_id.zeroBasedPage(), hint);
+}
+
+QImage
+ImageLoader::loadScaled(QString const& file_path, int const page_num, QSize const& hint)
+{
+    QFile file(file_path);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return QImage();
+    }
+    return loadScaled(file, page_num, hint);
+}
+
+QImage
+ImageLoader::loadScaled(QIODevice& io_dev, int const page_num, QSize const& hint)
+{
+    if (TiffReader::canRead(io_dev))
+    {
+        return TiffReader::readScaledImage(io_dev, page_num, hint);
+    }
+
+    if (page_num != 0)
+    {
+        // Qt can only load the first page of multi-page images.
+        return QImage();
+    }
+
+    QImageReader reader(&io_dev);
+    QSize const orig_size(reader.size());
+    if (orig_size.isValid())
+    {
+        QSize const scaled_size(orig_size.scaled(hint, Qt::KeepAspectRatio));
+        if (!scaled_size.isEmpty() && (scaled_size.width() < orig_size.width()))
+        {
+            // The JPEG plugin implements this by making libjpeg decode
+            // at 1/2, 1/4 or 1/8 of the resolution, which is much faster
+            // than a full decode.  Other plugins decode and then scale.
+            reader.setScaledSize(scaled_size);
+        }
+    }
+
+    return reader.read();
+}
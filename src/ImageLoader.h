@@ -23,6 +23,7 @@ class ImageId;
 class QImage;
 class QString;
 class QIODevice;
+class QSize;
 
 class ImageLoader
 {
@@ -32,6 +33,20 @@ public:
     static QImage load(ImageId const& image_id);
 
     static QImage load(QIODevice& io_dev, int page_num);
+
+    /**
+     * \brief Loads an image at a reduced resolution, if that's cheaper.
+     *
+     * \param hint The size the image is going to be scaled to fit into,
+     *        preserving the aspect ratio.  The returned image is no smaller
+     *        than necessary for that, but may be larger.  Its aspect ratio
+     *        may slightly differ from that of the original image.
+     */
+    static QImage loadScaled(QString const& file_path, int page_num, QSize const& hint);
+
+    static QImage loadScaled(ImageId const& image_id, QSize const& hint);
+
+    static QImage loadScaled(QIODevice& io_dev, int page_num, QSize const& hint);
 };
 
 #endif
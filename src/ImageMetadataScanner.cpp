@@ -0,0 +1,166 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ImageMetadataScanner.h"
+#include <QRunnable>
+#include <QThread>
+#include <QMutexLocker>
+#include <algorithm>
+#include <iterator>
+
+class ImageMetadataScanner::Runnable : public QRunnable
+{
+public:
+    Runnable(ImageMetadataScanner& owner) : m_rOwner(owner)
+    {
+        setAutoDelete(true);
+    }
+
+    virtual void run() override
+    {
+        m_rOwner.processFiles();
+    }
+private:
+    ImageMetadataScanner& m_rOwner;
+};
+
+
+ImageMetadataScanner::ImageMetadataScanner(int const max_threads)
+    :   m_nextFileIdx(0),
+        m_cancelled(0),
+        m_numFinished(0)
+{
+    m_pool.setMaxThreadCount(max_threads > 0 ? max_threads : defaultMaxThreads());
+}
+
+ImageMetadataScanner::~ImageMetadataScanner()
+{
+    cancel();
+    m_pool.waitForDone();
+}
+
+void
+ImageMetadataScanner::start(std::vector<QString> const& file_paths)
+{
+    m_pool.waitForDone();
+
+    m_filePaths = file_paths;
+    m_nextFileIdx.fetchAndStoreOrdered(0);
+    m_cancelled.fetchAndStoreOrdered(0);
+    {
+        QMutexLocker const locker(&m_mutex);
+        m_results.clear();
+        m_numFinished = 0;
+    }
+
+    int const num_runnables = std::min<int>(m_pool.maxThreadCount(), m_filePaths.size());
+    for (int i = 0; i < num_runnables; ++i)
+    {
+        m_pool.start(new Runnable(*this));
+    }
+}
+
+void
+ImageMetadataScanner::cancel()
+{
+    m_cancelled.fetchAndStoreOrdered(1);
+}
+
+bool
+ImageMetadataScanner::takeResults(std::vector<Result>& out)
+{
+    QMutexLocker const locker(&m_mutex);
+
+    std::move(m_results.begin(), m_results.end(), std::back_inserter(out));
+    m_results.clear();
+
+    return m_numFinished < int(m_filePaths.size());
+}
+
+void
+ImageMetadataScanner::waitForDone()
+{
+    m_pool.waitForDone();
+}
+
+std::vector<ImageMetadataScanner::Result>
+ImageMetadataScanner::scan(
+    std::vector<QString> const& file_paths, int const max_threads)
+{
+    ImageMetadataScanner scanner(max_threads);
+    scanner.start(file_paths);
+    scanner.waitForDone();
+
+    std::vector<Result> results;
+    scanner.takeResults(results);
+    std::sort(
+        results.begin(), results.end(),
+        [](Result const& lhs, Result const& rhs)
+    {
+        return lhs.fileIdx < rhs.fileIdx;
+    }
+    );
+
+    return results;
+}
+
+int
+ImageMetadataScanner::defaultMaxThreads()
+{
+    // Threads mostly wait for the storage to respond, so we can afford
+    // more of them than there are cores. A network share with a lot of
+    // requests in flight is the case this is tuned for.
+    return std::max(4, std::min(QThread::idealThreadCount() * 2, 16));
+}
+
+void
+ImageMetadataScanner::processFiles()
+{
+    int const num_files = m_filePaths.size();
+
+    for (;;)
+    {
+        int const file_idx = m_nextFileIdx.fetchAndAddOrdered(1);
+        if (file_idx >= num_files)
+        {
+            break;
+        }
+
+        Result result;
+        result.fileIdx = file_idx;
+        result.status = ImageMetadataLoader::GENERIC_ERROR;
+
+        bool const skip = (m_cancelled.load() != 0);
+        if (!skip)
+        {
+            result.status = ImageMetadataLoader::load(
+                m_filePaths[file_idx], [&](ImageMetadata const& metadata)
+            {
+                result.perPageMetadata.push_back(metadata);
+            }
+                            );
+        }
+
+        QMutexLocker const locker(&m_mutex);
+        ++m_numFinished;
+        if (!skip)
+        {
+            m_results.push_back(std::move(result));
+        }
+    }
+}
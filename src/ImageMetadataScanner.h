@@ -0,0 +1,122 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef IMAGEMETADATASCANNER_H_
+#define IMAGEMETADATASCANNER_H_
+
+#include "NonCopyable.h"
+#include "ImageMetadata.h"
+#include "ImageMetadataLoader.h"
+#include <QString>
+#include <QThreadPool>
+#include <QMutex>
+#include <QAtomicInt>
+#include <vector>
+
+/**
+ * \brief Probes image metadata of many files on a pool of threads.
+ *
+ * Probing is dominated by I/O latency rather than by CPU time, especially
+ * on network shares, so the pool has more threads than there are cores.
+ * Files are claimed in the order they were given, which means the threads
+ * run ahead of whoever consumes the results.  Results are collected in
+ * batches, either while scanning is in progress, with takeResults(), or
+ * all at once with the blocking scan().
+ *
+ * All image metadata loaders have to be registered before scanning starts,
+ * as required by ImageMetadataLoader::registerLoader().
+ */
+class ImageMetadataScanner
+{
+    DECLARE_NON_COPYABLE(ImageMetadataScanner)
+public:
+    struct Result
+    {
+        /** Index of the file in the list passed to start(). */
+        int fileIdx;
+
+        ImageMetadataLoader::Status status;
+
+        /** One entry per image (page) in the file. */
+        std::vector<ImageMetadata> perPageMetadata;
+    };
+
+    /**
+     * \param max_threads The maximum number of files to probe at the same
+     *        time. Zero or negative selects the default.
+     */
+    explicit ImageMetadataScanner(int max_threads = 0);
+
+    /**
+     * Cancels the scanning in progress, if any, and waits for the threads
+     * to finish with the files they are on.
+     */
+    ~ImageMetadataScanner();
+
+    /**
+     * \brief Starts scanning the given files in the background.
+     *
+     * Must not be called while a previous scan is still in progress.
+     */
+    void start(std::vector<QString> const& file_paths);
+
+    /**
+     * \brief Makes the threads stop picking up new files.
+     *
+     * Files that haven't been claimed by then produce no results.
+     */
+    void cancel();
+
+    /**
+     * \brief Moves the results that became available since the previous
+     *        call to the end of \p out.
+     *
+     * Results come in the order files were finished, which is not necessarily
+     * the order they were given in.
+     *
+     * \return true if there are more results to come.
+     */
+    bool takeResults(std::vector<Result>& out);
+
+    /** \brief Waits for all the files to be processed or skipped. */
+    void waitForDone();
+
+    /**
+     * \brief Scans the given files, blocking until all of them are done.
+     *
+     * \return Results indexed by position in \p file_paths.
+     */
+    static std::vector<Result> scan(
+        std::vector<QString> const& file_paths, int max_threads = 0);
+private:
+    class Runnable;
+
+    static int defaultMaxThreads();
+
+    void processFiles();
+
+    QThreadPool m_pool;
+    std::vector<QString> m_filePaths;
+    QAtomicInt m_nextFileIdx;
+    QAtomicInt m_cancelled;
+    QMutex m_mutex;
+    std::vector<Result> m_results; /**< Protected by m_mutex. */
+    int m_numFinished; /**< Processed or skipped files. Protected by m_mutex. */
+};
+
+#endif
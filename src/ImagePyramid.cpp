@@ -0,0 +1,130 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ImagePyramid.h"
+#include "acceleration/AcceleratableOperations.h"
+#include "imageproc/AffineTransform.h"
+#include <QTransform>
+#include <QMutexLocker>
+#include <QSize>
+#include <QRect>
+#include <algorithm>
+#include <math.h>
+
+using namespace imageproc;
+
+namespace
+{
+
+/**
+ * We don't go below this size along the longer side. Smaller images
+ * are cheap enough to render from anyway.
+ */
+int const MIN_LEVEL_SIZE = 256;
+
+} // anonymous namespace
+
+ImagePyramid::ImagePyramid(
+    QImage const& image, std::shared_ptr<AcceleratableOperations> const& accel_ops)
+    :	m_image(image),
+      m_ptrAccelOps(accel_ops)
+{
+}
+
+ImagePyramid::~ImagePyramid()
+{
+}
+
+QImage
+ImagePyramid::levelFor(QTransform const& image_to_target, QTransform& level_to_target) const
+{
+    level_to_target = image_to_target;
+    if (m_image.isNull())
+    {
+        return m_image;
+    }
+
+    // How much a unit step along each of the image axes gets scaled.
+    double const x_scale = hypot(image_to_target.m11(), image_to_target.m12());
+    double const y_scale = hypot(image_to_target.m21(), image_to_target.m22());
+
+    // Level sizes follow from the image size, so we only build
+    // the selected level (and the ones it's downscaled from).
+    int selected_idx = -1;
+    QSize size(m_image.size());
+    for (int idx = 0; std::max(size.width(), size.height()) >= MIN_LEVEL_SIZE * 2; ++idx)
+    {
+        size = QSize((size.width() + 1) / 2, (size.height() + 1) / 2);
+        double const level_x_scale = (double)size.width() / m_image.width();
+        double const level_y_scale = (double)size.height() / m_image.height();
+        if (level_x_scale < x_scale || level_y_scale < y_scale)
+        {
+            // Would lose detail.
+            break;
+        }
+
+        selected_idx = idx;
+    }
+
+    QImage const selected(selected_idx < 0 ? m_image : level(selected_idx));
+
+    if (selected.size() != m_image.size())
+    {
+        QTransform level_to_image;
+        level_to_image.scale(
+            (double)m_image.width() / selected.width(),
+            (double)m_image.height() / selected.height()
+        );
+        level_to_target = level_to_image * image_to_target;
+    }
+
+    return selected;
+}
+
+/**
+ * Returns the level, building it and the ones above if necessary,
+ * or a null image if the level would be too small.
+ */
+QImage
+ImagePyramid::level(int const idx) const
+{
+    QMutexLocker const locker(&m_mutex);
+
+    while (int(m_levels.size()) <= idx)
+    {
+        QImage const& prev = m_levels.empty() ? m_image : m_levels.back();
+        if (prev.isNull() || std::max(prev.width(), prev.height()) < MIN_LEVEL_SIZE * 2)
+        {
+            return QImage();
+        }
+
+        QSize const size((prev.width() + 1) / 2, (prev.height() + 1) / 2);
+        QTransform xform;
+        xform.scale((double)size.width() / prev.width(), (double)size.height() / prev.height());
+
+        // Each target pixel averages a 2x2 block of source pixels.
+        m_levels.push_back(
+            m_ptrAccelOps->affineTransform(
+                prev, xform, QRect(QPoint(0, 0), size),
+                OutsidePixels::assumeWeakNearest(), QSizeF(0.0, 0.0)
+            )
+        );
+    }
+
+    return m_levels[idx];
+}
@@ -0,0 +1,81 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef IMAGEPYRAMID_H_
+#define IMAGEPYRAMID_H_
+
+#include "NonCopyable.h"
+#include <QImage>
+#include <QMutex>
+#include <memory>
+#include <vector>
+
+class QTransform;
+class AcceleratableOperations;
+
+/**
+ * \brief An image along with its versions downscaled by powers of two.
+ *
+ * Downscaled levels are built on demand, the first time they are asked for,
+ * and are kept for the lifetime of the pyramid. Rendering a downscaled view
+ * from the closest level rather than from the full size image makes the cost
+ * proportional to the area being rendered, not to the size of the image.
+ * This class is thread-safe.
+ */
+class ImagePyramid
+{
+    DECLARE_NON_COPYABLE(ImagePyramid)
+public:
+    ImagePyramid(QImage const& image, std::shared_ptr<AcceleratableOperations> const& accel_ops);
+
+    ~ImagePyramid();
+
+    /**
+     * \brief Returns the full size image.
+     */
+    QImage const& image() const
+    {
+        return m_image;
+    }
+
+    /**
+     * \brief Picks the smallest level still detailed enough to be rendered
+     *        with the given transformation.
+     *
+     * \param image_to_target Transformation from full size image coordinates
+     *        to the coordinates of what is being rendered.
+     * \param level_to_target Receives the transformation from the coordinates
+     *        of the returned level to the same target coordinates.
+     * \return The level to render from.
+     */
+    QImage levelFor(QTransform const& image_to_target, QTransform& level_to_target) const;
+private:
+    QImage level(int idx) const;
+
+    QImage m_image;
+    std::shared_ptr<AcceleratableOperations> m_ptrAccelOps;
+    mutable QMutex m_mutex;
+
+    /**
+     * Downscaled levels built so far. m_levels[i] is downscaled
+     * by a factor of 2^(i + 1) relative to m_image.
+     */
+    mutable std::vector<QImage> m_levels;
+};
+
+#endif
@@ -19,6 +19,7 @@
 #include "ImageViewBase.h"
 #include "NonCopyable.h"
 #include "ImagePresentation.h"
+#include "ImagePyramid.h"
 #include "OpenGLSupport.h"
 #include "PixmapRenderer.h"
 #include "BackgroundExecutor.h"
@@ -47,6 +48,7 @@
 #include <Qt>
 #include <QDebug>
 #include <algorithm>
+#include <vector>
 #include <assert.h>
 #include <math.h>
 
@@ -57,6 +59,24 @@
 
 using namespace imageproc;
 
+namespace
+{
+
+/**
+ * The side of a square tile of the high quality layer, in widget pixels.
+ */
+int const HQ_TILE_SIZE = 256;
+
+/**
+ * Returns the index of the tile containing the given coordinate.
+ */
+int hqTileIndex(int const coord)
+{
+    return coord >= 0 ? coord / HQ_TILE_SIZE : -((-coord - 1) / HQ_TILE_SIZE) - 1;
+}
+
+} // anonymous namespace
+
 class ImageViewBase::HqTransformTask :
     public AbstractCommand0<IntrusivePtr<AbstractCommand0<void> > >,
     public QObject
@@ -66,8 +86,8 @@ public:
     HqTransformTask(
         ImageViewBase* image_view,
         std::shared_ptr<AcceleratableOperations> const& accel_ops,
-        QImage const& image, QTransform const& xform,
-        QRect const& target_rect);
+        std::shared_ptr<ImagePyramid> const& pyramid,
+        QTransform const& xform, QPoint const& tile);
 
     void cancel()
     {
@@ -84,7 +104,7 @@ private:
     class Result : public AbstractCommand0<void>
     {
     public:
-        Result(ImageViewBase* image_view);
+        Result(ImageViewBase* image_view, QPoint const& tile);
 
         void setData(QImage const& hq_image);
 
@@ -109,13 +129,14 @@ private:
         virtual void operator()();
     private:
         QPointer<ImageViewBase> m_ptrImageView;
+        QPoint m_tile;
         QImage m_hqImage;
         QAtomicInt m_cancelFlag;
     };
 
     std::shared_ptr<AcceleratableOperations> m_ptrAccelOps;
+    std::shared_ptr<ImagePyramid> m_ptrPyramid;
     IntrusivePtr<Result> m_ptrResult;
-    QImage m_image;
     QTransform m_xform;
     QRect m_targetRect;
 };
@@ -170,6 +191,7 @@ ImageViewBase::ImageViewBase(
     ImagePresentation const& presentation, QMarginsF const& margins)
     :	m_ptrAccelOps(accel_ops),
       m_image(image),
+      m_ptrPyramid(new ImagePyramid(image, accel_ops)),
       m_virtualImageCropArea(presentation.cropArea()),
       m_virtualDisplayArea(presentation.displayArea()),
       m_imageToVirtual(presentation.transform()),
@@ -267,14 +289,9 @@ ImageViewBase::hqTransformSetEnabled(bool const enabled)
     {
         // Turning off.
         m_hqTransformEnabled = false;
-        if (m_ptrHqTransformTask.get())
+        if (!m_hqTiles.empty())
         {
-            m_ptrHqTransformTask->cancel();
-            m_ptrHqTransformTask.reset();
-        }
-        if (!m_hqPixmap.isNull())
-        {
-            m_hqPixmap = QPixmap();
+            discardHqTiles();
             update();
         }
     }
@@ -512,21 +529,18 @@ ImageViewBase::paintEvent(QPaintEvent* event)
     // Disable pixmap antialiasing for large zoom levels.
     painter.setRenderHint(QPainter::SmoothPixmapTransform, pixel_width < 0.5);
 
-    if (validateHqPixmap())
-    {
-        // HQ pixmap maps one to one to screen pixels, so antialiasing is not necessary.
-        painter.setRenderHint(QPainter::SmoothPixmapTransform, false);
-
-        QPainterPath clip_path;
-        clip_path.addPolygon(m_virtualToWidget.map(m_virtualImageCropArea));
-        painter.setClipPath(clip_path);
+    QPoint hq_origin;
+    bool const hq_valid = m_hqTransformEnabled && m_hqXform == hqTileTransform(&hq_origin);
+    QRect const hq_tiles(visibleHqTiles(hq_origin));
+    bool const hq_complete = hq_valid && hqTilesComplete(hq_tiles);
 
-        painter.drawPixmap(m_hqPixmapPos, m_hqPixmap);
-    }
-    else
+    if (!hq_complete)
     {
+        // Tiles that aren't ready yet are covered by the low quality version.
         scheduleHqVersionRebuild();
 
+        painter.save();
+
         QTransform const pixmap_to_virtual(m_pixmapToImage * m_imageToVirtual);
         painter.setWorldTransform(pixmap_to_virtual * m_virtualToWidget);
 
@@ -535,6 +549,13 @@ ImageViewBase::paintEvent(QPaintEvent* event)
         painter.setClipPath(clip_path);
 
         PixmapRenderer::drawPixmap(painter, m_pixmap);
+
+        painter.restore();
+    }
+
+    if (hq_valid)
+    {
+        paintHqTiles(painter, hq_origin, hq_tiles);
     }
 
     painter.restore();
@@ -1103,46 +1124,116 @@ ImageViewBase::setWidgetFocalPointWithoutMoving(QPointF const new_widget_fp)
 }
 
 /**
- * Returns true if m_hqPixmap is valid and up to date.
+ * Returns the transformation from m_image to tile coordinates, and the
+ * position in widget coordinates where the origin of tile coordinates is.
+ * The integer part of translation is left out, which makes the result
+ * independent of panning by whole pixels.  The fractional part is rounded
+ * to 1/64 of a pixel, so that rounding errors don't make it change either.
  */
-bool
-ImageViewBase::validateHqPixmap() const
+QTransform
+ImageViewBase::hqTileTransform(QPoint* origin) const
 {
-    if (!m_hqTransformEnabled)
+    QTransform const xform(m_imageToVirtual * m_virtualToWidget);
+    double const dx = floor(xform.dx() * 64.0 + 0.5) / 64.0;
+    double const dy = floor(xform.dy() * 64.0 + 0.5) / 64.0;
+    QPoint const pos((int)floor(dx), (int)floor(dy));
+    if (origin)
     {
-        return false;
+        *origin = pos;
     }
 
-    if (m_hqPixmap.isNull())
+    return QTransform(
+               xform.m11(), xform.m12(), xform.m21(), xform.m22(),
+               dx - pos.x(), dy - pos.y()
+           );
+}
+
+/**
+ * Returns the range of tile indices covering the visible part of the image.
+ */
+QRect
+ImageViewBase::visibleHqTiles(QPoint const& origin) const
+{
+    QRect const target_rect(
+        m_virtualToWidget.map(m_virtualImageCropArea)
+        .boundingRect().toAlignedRect().intersected(this->rect())
+        .translated(-origin)
+    );
+    if (target_rect.isEmpty())
     {
-        return false;
+        return QRect();
     }
 
-    if (m_hqSourceId != m_image.cacheKey())
+    return QRect(
+               QPoint(hqTileIndex(target_rect.left()), hqTileIndex(target_rect.top())),
+               QPoint(hqTileIndex(target_rect.right()), hqTileIndex(target_rect.bottom()))
+           );
+}
+
+/**
+ * Returns true if all of the given tiles are built.
+ */
+bool
+ImageViewBase::hqTilesComplete(QRect const& tiles) const
+{
+    for (int y = tiles.top(); y <= tiles.bottom(); ++y)
     {
-        return false;
+        for (int x = tiles.left(); x <= tiles.right(); ++x)
+        {
+            HqTileMap::const_iterator const it(m_hqTiles.find(QPoint(x, y)));
+            if (it == m_hqTiles.end() || it->second.pixmap.isNull())
+            {
+                return false;
+            }
+        }
     }
 
-    if (m_hqXform != m_imageToVirtual * m_virtualToWidget)
+    return true;
+}
+
+void
+ImageViewBase::paintHqTiles(QPainter& painter, QPoint const& origin, QRect const& tiles)
+{
+    painter.save();
+
+    // HQ tiles map one to one to screen pixels, so antialiasing is not necessary.
+    painter.setRenderHint(QPainter::SmoothPixmapTransform, false);
+
+    QPainterPath clip_path;
+    clip_path.addPolygon(m_virtualToWidget.map(m_virtualImageCropArea));
+    painter.setClipPath(clip_path);
+
+    for (HqTileMap::value_type const& kv : m_hqTiles)
     {
-        return false;
+        if (!kv.second.pixmap.isNull() && tiles.contains(kv.first))
+        {
+            painter.drawPixmap(origin + kv.first * HQ_TILE_SIZE, kv.second.pixmap);
+        }
     }
 
-    return true;
+    painter.restore();
 }
 
 void
 ImageViewBase::scheduleHqVersionRebuild()
 {
-    QTransform const xform(m_imageToVirtual * m_virtualToWidget);
+    if (!m_hqTransformEnabled)
+    {
+        return;
+    }
+
+    QTransform const xform(hqTileTransform(nullptr));
+    if (xform == m_hqXform)
+    {
+        // We are panning or some tiles are still being built.
+        // No need to wait for things to settle in this case.
+        requestHqTiles();
+        return;
+    }
 
     if (!m_timer.isActive() || m_potentialHqXform != xform)
     {
-        if (m_ptrHqTransformTask.get())
-        {
-            m_ptrHqTransformTask->cancel();
-            m_ptrHqTransformTask.reset();
-        }
+        discardHqTiles();
         m_potentialHqXform = xform;
     }
     m_timer.start();
@@ -1151,50 +1242,119 @@ ImageViewBase::scheduleHqVersionRebuild()
 void
 ImageViewBase::initiateBuildingHqVersion()
 {
-    if (validateHqPixmap())
+    if (!m_hqTransformEnabled)
     {
         return;
     }
 
-    m_hqPixmap = QPixmap();
+    QTransform const xform(hqTileTransform(nullptr));
+    if (xform != m_hqXform)
+    {
+        discardHqTiles();
+        m_hqXform = xform;
+    }
+
+    requestHqTiles();
+}
 
-    if (m_ptrHqTransformTask.get())
+/**
+ * Starts building the visible tiles that aren't built or being built,
+ * and forgets about the ones that went out of view.
+ */
+void
+ImageViewBase::requestHqTiles()
+{
+    QPoint origin;
+    hqTileTransform(&origin);
+    QRect const visible(visibleHqTiles(origin));
+
+    // Built tiles next to the visible ones are kept, to make going
+    // back and forth cheaper. Off-screen tiles being built are cancelled.
+    QRect const keep(visible.isEmpty() ? QRect() : visible.adjusted(-1, -1, 1, 1));
+    for (HqTileMap::iterator it(m_hqTiles.begin()); it != m_hqTiles.end();)
     {
-        m_ptrHqTransformTask->cancel();
-        m_ptrHqTransformTask.reset();
+        HqTile& tile = it->second;
+        if (visible.contains(it->first) || (keep.contains(it->first) && !tile.ptrTask.get()))
+        {
+            ++it;
+            continue;
+        }
+
+        if (tile.ptrTask.get())
+        {
+            tile.ptrTask->cancel();
+        }
+        m_hqTiles.erase(it++);
     }
 
-    QTransform const xform(m_imageToVirtual * m_virtualToWidget);
-    QRect const target_rect(
-        m_virtualToWidget.map(m_virtualImageCropArea)
-        .boundingRect().toAlignedRect().intersected(this->rect())
-    );
+    std::vector<QPoint> missing;
+    for (int y = visible.top(); y <= visible.bottom(); ++y)
+    {
+        for (int x = visible.left(); x <= visible.right(); ++x)
+        {
+            if (m_hqTiles.find(QPoint(x, y)) == m_hqTiles.end())
+            {
+                missing.push_back(QPoint(x, y));
+            }
+        }
+    }
 
-    IntrusivePtr<HqTransformTask> const task(
-        new HqTransformTask(this, m_ptrAccelOps, m_image, xform, target_rect)
+    // Tiles closer to the center of the view go first.
+    QPointF const center(QRectF(visible).center());
+    std::sort(
+        missing.begin(), missing.end(),
+        [&center](QPoint const& lhs, QPoint const& rhs)
+    {
+        QPointF const d1(lhs - center);
+        QPointF const d2(rhs - center);
+        return d1.x() * d1.x() + d1.y() * d1.y() < d2.x() * d2.x() + d2.y() * d2.y();
+    }
     );
 
-    backgroundExecutor().enqueueTask(task);
+    for (QPoint const& tile : missing)
+    {
+        IntrusivePtr<HqTransformTask> const task(
+            new HqTransformTask(this, m_ptrAccelOps, m_ptrPyramid, m_hqXform, tile)
+        );
+        backgroundExecutor().enqueueTask(task);
+        m_hqTiles[tile].ptrTask = task;
+    }
+}
 
-    m_ptrHqTransformTask = task;
-    m_hqXform = xform;
-    m_hqPixmapPos = target_rect.topLeft();
-    m_hqSourceId = m_image.cacheKey();
+void
+ImageViewBase::discardHqTiles()
+{
+    for (HqTileMap::value_type& kv : m_hqTiles)
+    {
+        if (kv.second.ptrTask.get())
+        {
+            kv.second.ptrTask->cancel();
+        }
+    }
+    m_hqTiles.clear();
 }
 
 /**
  * Gets called from HqTransformationTask::Result.
  */
 void
-ImageViewBase::hqVersionBuilt(QImage const& image)
+ImageViewBase::hqTileBuilt(QPoint const& tile, QImage const& image)
 {
     if (!m_hqTransformEnabled)
     {
         return;
     }
 
-    m_hqPixmap = QPixmap::fromImage(image);
-    m_ptrHqTransformTask.reset();
+    // Tasks are cancelled when their tiles are discarded, so
+    // the tile has to be there, but let's not take chances.
+    HqTileMap::iterator const it(m_hqTiles.find(tile));
+    if (it == m_hqTiles.end())
+    {
+        return;
+    }
+
+    it->second.pixmap = QPixmap::fromImage(image);
+    it->second.ptrTask.reset();
     update();
 }
 
@@ -1240,13 +1400,13 @@ ImageViewBase::backgroundExecutor()
 ImageViewBase::HqTransformTask::HqTransformTask(
     ImageViewBase* image_view,
     std::shared_ptr<AcceleratableOperations> const& accel_ops,
-    QImage const& image, QTransform const& xform,
-    QRect const& target_rect)
+    std::shared_ptr<ImagePyramid> const& pyramid,
+    QTransform const& xform, QPoint const& tile)
     :	m_ptrAccelOps(accel_ops),
-      m_ptrResult(new Result(image_view)),
-      m_image(image),
+      m_ptrPyramid(pyramid),
+      m_ptrResult(new Result(image_view, tile)),
       m_xform(xform),
-      m_targetRect(target_rect)
+      m_targetRect(tile * HQ_TILE_SIZE, QSize(HQ_TILE_SIZE, HQ_TILE_SIZE))
 {
 }
 
@@ -1258,9 +1418,18 @@ ImageViewBase::HqTransformTask::operator()()
         return IntrusivePtr<AbstractCommand0<void> >();
     }
 
+    // The first task to need a particular level of the pyramid builds it.
+    QTransform level_xform;
+    QImage const level(m_ptrPyramid->levelFor(m_xform, level_xform));
+
+    if (isCancelled())
+    {
+        return IntrusivePtr<AbstractCommand0<void> >();
+    }
+
     QImage hq_image(
         m_ptrAccelOps->affineTransform(
-            m_image, m_xform, m_targetRect,
+            level, level_xform, m_targetRect,
             OutsidePixels::assumeColor(Qt::transparent), QSizeF(0.0, 0.0)
         )
     );
@@ -1289,8 +1458,9 @@ ImageViewBase::HqTransformTask::operator()()
 /*================ ImageViewBase::HqTransformTask::Result ================*/
 
 ImageViewBase::HqTransformTask::Result::Result(
-    ImageViewBase* image_view)
-    :	m_ptrImageView(image_view)
+    ImageViewBase* image_view, QPoint const& tile)
+    :	m_ptrImageView(image_view),
+      m_tile(tile)
 {
 }
 
@@ -1305,7 +1475,7 @@ ImageViewBase::HqTransformTask::Result::operator()()
 {
     if (m_ptrImageView && !isCancelled())
     {
-        m_ptrImageView->hqVersionBuilt(m_hqImage);
+        m_ptrImageView->hqTileBuilt(m_tile, m_hqImage);
     }
 }
 
@@ -39,14 +39,17 @@
 #include <QPoint>
 #include <QPointF>
 #include <QSizeF>
+#include <QRect>
 #include <QRectF>
 #include <QMarginsF>
 #include <Qt>
 #include <memory>
+#include <map>
 
 class QPainter;
 class BackgroundExecutor;
 class ImagePresentation;
+class ImagePyramid;
 class AcceleratableOperations;
 
 /**
@@ -82,7 +85,8 @@ public:
      *        The whole idea of having a downscaled version is
      *        to speed up real-time rendering of high-resolution
      *        images.  Note that the delayed high quality transform
-     *        operates on the original image, not the downscaled one.
+     *        operates on the original image (or its downscaled
+     *        by a power of two versions), not on this one.
      * \param presentation Specifies transformation from image
      *        pixel coordinates to virtual image coordinates, along
      *        with some other properties.
@@ -328,6 +332,25 @@ private:
     class TempFocalPointAdjuster;
     class TransformChangeWatcher;
 
+    /**
+     * A square of the high quality layer, either built or being built.
+     */
+    struct HqTile
+    {
+        QPixmap pixmap;
+        IntrusivePtr<HqTransformTask> ptrTask;
+    };
+
+    struct HqTileLess
+    {
+        bool operator()(QPoint const& lhs, QPoint const& rhs) const
+        {
+            return lhs.y() < rhs.y() || (lhs.y() == rhs.y() && lhs.x() < rhs.x());
+        }
+    };
+
+    typedef std::map<QPoint, HqTile, HqTileLess> HqTileMap;
+
     QRectF dynamicViewportRect() const;
 
     void transformChanged();
@@ -344,11 +367,21 @@ private:
 
     QPointF centeredWidgetFocalPoint() const;
 
-    bool validateHqPixmap() const;
+    QTransform hqTileTransform(QPoint* origin) const;
+
+    QRect visibleHqTiles(QPoint const& origin) const;
+
+    bool hqTilesComplete(QRect const& tiles) const;
+
+    void paintHqTiles(QPainter& painter, QPoint const& origin, QRect const& tiles);
 
     void scheduleHqVersionRebuild();
 
-    void hqVersionBuilt(QImage const& image);
+    void requestHqTiles();
+
+    void discardHqTiles();
+
+    void hqTileBuilt(QPoint const& tile, QImage const& image);
 
     void updateStatusTipAndCursor();
 
@@ -370,6 +403,12 @@ private:
      */
     QImage m_image;
 
+    /**
+     * m_image and its downscaled versions, which the high-quality
+     * version is built from.  Shared with background tasks.
+     */
+    std::shared_ptr<ImagePyramid> m_ptrPyramid;
+
     /**
      * This timer is used for delaying the construction of
      * a high quality image version.
@@ -383,38 +422,26 @@ private:
     QPixmap m_pixmap;
 
     /**
-     * The high quality, pre-transformed version of m_pixmap.
-     */
-    QPixmap m_hqPixmap;
-
-    /**
-     * The position, in widget coordinates, where m_hqPixmap is to be drawn.
+     * The high quality, pre-transformed version of m_pixmap, split into
+     * square tiles.  Only the visible tiles (and a few around them) are kept.
+     * Tile (i, j) covers the area of HQ_TILE_SIZE pixels squared at
+     * (i, j) * HQ_TILE_SIZE in tile coordinates, which are widget
+     * coordinates shifted by the origin returned by hqTileTransform().
      */
-    QPoint m_hqPixmapPos;
+    HqTileMap m_hqTiles;
 
     /**
-     * The transformation used to build m_hqPixmap.
-     * It's used to detect if m_hqPixmap needs to be rebuild.
+     * Transformation from m_image to tile coordinates that m_hqTiles were
+     * built for.  Panning by whole pixels doesn't change it, so the tiles
+     * already built remain valid while panning.
      */
     QTransform m_hqXform;
 
     /**
-     * Used to check if we need to extend the delay before building m_hqPixmap.
+     * Used to check if we need to extend the delay before rebuilding m_hqTiles.
      */
     QTransform m_potentialHqXform;
 
-    /**
-     * The ID (QImage::cacheKey()) of the image that was used
-     * to build m_hqPixmap.  It's used to detect if m_hqPixmap
-     * needs to be rebuilt.
-     */
-    qint64 m_hqSourceId;
-
-    /**
-     * The pending (if any) high quality transformation task.
-     */
-    IntrusivePtr<HqTransformTask> m_ptrHqTransformTask;
-
     /**
      * Transformation from m_pixmap coordinates to m_image coordinates.
      */
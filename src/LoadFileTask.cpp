@@ -28,9 +28,12 @@
 #include "ProjectPages.h"
 #include "PageInfo.h"
 #include "ImageLoader.h"
+#include "StageCache.h"
+#include "Trace.h"
 #include "imageproc/AffineImageTransform.h"
 #include "imageproc/AffineTransformedImage.h"
 #include "imageproc/GrayImage.h"
+#include "imageproc/GrayImagePyramid.h"
 #include "stages/fix_orientation/Task.h"
 #include <QCoreApplication>
 #include <QFile>
@@ -78,12 +81,33 @@ LoadFileTask::~LoadFileTask()
 {
 }
 
+void
+LoadFileTask::setPreloadedImage(
+    QImage const& image, CachingFactory<imageproc::GrayImage> const& gray_image_factory)
+{
+    m_preloadedImage = image;
+    m_preloadedGrayImageFactory = gray_image_factory;
+}
+
 FilterResultPtr
 LoadFileTask::operator()()
 {
     using namespace imageproc;
 
-    QImage image(ImageLoader::load(m_pageId.imageId()));
+    TraceSpan span("stage", "load");
+
+    QImage image(m_preloadedImage);
+    if (image.isNull())
+    {
+        ImageId const& image_id = m_pageId.imageId();
+        image = StageCache::instance().getOrCompute(
+                    QStringLiteral("original-1"), StageCache::sourceKey(image_id),
+                    StageCache::MEMORY_ONLY, [&image_id]()
+        {
+            return ImageLoader::load(image_id);
+        }
+                );
+    }
 
     try
     {
@@ -95,6 +119,7 @@ LoadFileTask::operator()()
         }
         else
         {
+            span.setImageSize(image.size());
             updateImageSizeIfChanged(image);
 
             // It's a good time to create a thumbnail if it's missing.
@@ -105,9 +130,17 @@ LoadFileTask::operator()()
             {
                 return GrayImage(image);
             });
+            if (m_preloadedGrayImageFactory && !m_preloadedImage.isNull())
+            {
+                gray_image_factory = *m_preloadedGrayImageFactory;
+            }
+
+            // Downscaled levels are built when the first stage asks for them
+            // and are then reused by the following ones.
+            GrayImagePyramid const gray_pyramid(image.size(), gray_image_factory);
 
             return m_ptrNextTask->process(
-                       *this, m_ptrAccelOps, image, gray_image_factory, transform
+                       *this, m_ptrAccelOps, image, gray_image_factory, gray_pyramid, transform
                    );
         }
     }
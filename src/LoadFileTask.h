@@ -25,13 +25,16 @@
 #include "IntrusivePtr.h"
 #include "PageId.h"
 #include "ImageMetadata.h"
+#include "CachingFactory.h"
+#include "imageproc/GrayImage.h"
 #include "acceleration/AcceleratableOperations.h"
+#include <QImage>
+#include <boost/optional.hpp>
 #include <memory>
 
 class ThumbnailPixmapCache;
 class PageInfo;
 class ProjectPages;
-class QImage;
 
 namespace fix_orientation
 {
@@ -50,6 +53,16 @@ public:
 
     virtual ~LoadFileTask();
 
+    /**
+     * \brief Makes the task use an already decoded image instead of loading it.
+     *
+     * This allows running several filter stages over a page while decoding
+     * the source file only once.  The gray image factory is shared with the
+     * caller, so the grayscale conversion is done at most once as well.
+     */
+    void setPreloadedImage(QImage const& image,
+                           CachingFactory<imageproc::GrayImage> const& gray_image_factory);
+
     virtual FilterResultPtr operator()();
 private:
     class ErrorResult;
@@ -62,6 +75,8 @@ private:
     ImageMetadata m_imageMetadata;
     IntrusivePtr<ProjectPages> const m_ptrPages;
     IntrusivePtr<fix_orientation::Task> const m_ptrNextTask;
+    QImage m_preloadedImage;
+    boost::optional<CachingFactory<imageproc::GrayImage>> m_preloadedGrayImageFactory;
 };
 
 #endif
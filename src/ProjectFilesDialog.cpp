@@ -20,6 +20,7 @@
 #include "NonCopyable.h"
 #include "ImageMetadata.h"
 #include "ImageMetadataLoader.h"
+#include "ImageMetadataScanner.h"
 #include "SmartFilenameOrdering.h"
 #include <QAbstractListModel>
 #include <QSortFilterProxyModel>
@@ -39,7 +40,7 @@
 #include <QColor>
 #include <QDebug>
 #include <vector>
-#include <deque>
+#include <limits>
 #include <algorithm>
 #include <utility>
 #include <iterator>
@@ -94,8 +95,6 @@ class ProjectFilesDialog::FileList : private QAbstractListModel
 {
     DECLARE_NON_COPYABLE(FileList)
 public:
-    enum LoadStatus { LOAD_OK, LOAD_FAILED, NO_MORE_FILES };
-
     FileList();
 
     virtual ~FileList();
@@ -134,9 +133,20 @@ public:
 
     void remove(QItemSelection const& selection);
 
-    void prepareForLoadingFiles();
-
-    LoadStatus loadNextFile();
+    /**
+     * \brief Returns the paths of all files, in the order they are to be loaded.
+     *
+     * Indexes into the returned vector are what applyLoadResults() expects
+     * to find in ImageMetadataScanner::Result::fileIdx.
+     */
+    std::vector<QString> prepareForLoadingFiles();
+
+    /**
+     * \brief Updates items from a batch of results.
+     *
+     * \return The number of files in the batch that failed to load.
+     */
+    int applyLoadResults(std::vector<ImageMetadataScanner::Result>& results);
 private:
     virtual int rowCount(QModelIndex const& parent) const;
 
@@ -145,7 +155,7 @@ private:
     virtual Qt::ItemFlags flags(QModelIndex const& index) const;
 
     std::vector<Item> m_items;
-    std::deque<int> m_itemsToLoad;
+    std::vector<int> m_itemsToLoad;
 };
 
 
@@ -588,7 +598,7 @@ ProjectFilesDialog::onOK()
 void
 ProjectFilesDialog::startLoadingMetadata()
 {
-    m_ptrInProjectFiles->prepareForLoadingFiles();
+    std::vector<QString> const file_paths(m_ptrInProjectFiles->prepareForLoadingFiles());
 
     progressBar->setMaximum(m_ptrInProjectFiles->count());
     inpDirLine->setEnabled(false);
@@ -603,8 +613,14 @@ ProjectFilesDialog::startLoadingMetadata()
     buttonBox->button(QDialogButtonBox::Ok)->setEnabled(false);
     offProjectList->clearSelection();
     inProjectList->clearSelection();
-    m_loadTimerId = startTimer(0);
     m_metadataLoadFailed = false;
+
+    m_ptrMetadataScanner.reset(new ImageMetadataScanner);
+    m_ptrMetadataScanner->start(file_paths);
+
+    // Results are picked up in batches, so that the event loop isn't
+    // flooded with per-file updates.
+    m_loadTimerId = startTimer(50);
 }
 
 void
@@ -616,17 +632,18 @@ ProjectFilesDialog::timerEvent(QTimerEvent* event)
         return;
     }
 
-    switch (m_ptrInProjectFiles->loadNextFile())
+    std::vector<ImageMetadataScanner::Result> results;
+    bool const more_to_come = m_ptrMetadataScanner->takeResults(results);
+
+    if (m_ptrInProjectFiles->applyLoadResults(results) > 0)
     {
-    case FileList::NO_MORE_FILES:
-        finishLoadingMetadata();
-        break;
-    case FileList::LOAD_FAILED:
         m_metadataLoadFailed = true;
-    // Fall through.
-    case FileList::LOAD_OK:
-        progressBar->setValue(progressBar->value() + 1);
-        break;
+    }
+    progressBar->setValue(progressBar->value() + results.size());
+
+    if (!more_to_come)
+    {
+        finishLoadingMetadata();
     }
 }
 
@@ -634,6 +651,7 @@ void
 ProjectFilesDialog::finishLoadingMetadata()
 {
     killTimer(m_loadTimerId);
+    m_ptrMetadataScanner.reset();
 
     inpDirLine->setEnabled(true);
     inpDirBrowseBtn->setEnabled(true);
@@ -755,10 +773,10 @@ ProjectFilesDialog::FileList::flags(QModelIndex const& index) const
     return m_items[index.row()].flags();
 }
 
-void
+std::vector<QString>
 ProjectFilesDialog::FileList::prepareForLoadingFiles()
 {
-    std::deque<int> item_indexes;
+    std::vector<int> item_indexes;
     int const num_items = m_items.size();
     for (int i = 0; i < num_items; ++i)
     {
@@ -774,46 +792,55 @@ ProjectFilesDialog::FileList::prepareForLoadingFiles()
     );
 
     m_itemsToLoad.swap(item_indexes);
-}
 
-ProjectFilesDialog::FileList::LoadStatus
-ProjectFilesDialog::FileList::loadNextFile()
-{
-    if (m_itemsToLoad.empty())
+    std::vector<QString> file_paths;
+    file_paths.reserve(m_itemsToLoad.size());
+    for (int const item_idx : m_itemsToLoad)
     {
-        return NO_MORE_FILES;
+        file_paths.push_back(m_items[item_idx].fileInfo().absoluteFilePath());
     }
 
-    int const item_idx = m_itemsToLoad.front();
-    Item& item = m_items[item_idx];
-    std::vector<ImageMetadata> per_page_metadata;
-    QString const file_path(item.fileInfo().absoluteFilePath());
-    ImageMetadataLoader::Status const st = ImageMetadataLoader::load(
-            file_path, [&] (ImageMetadata const& metadata)
+    return file_paths;
+}
+
+int
+ProjectFilesDialog::FileList::applyLoadResults(
+    std::vector<ImageMetadataScanner::Result>& results)
+{
+    if (results.empty())
     {
-        per_page_metadata.push_back(metadata);
+        return 0;
     }
-                                           );
 
-    LoadStatus status;
+    int num_failed = 0;
+    int first_row = std::numeric_limits<int>::max();
+    int last_row = std::numeric_limits<int>::min();
 
-    if (st == ImageMetadataLoader::LOADED)
-    {
-        status = LOAD_OK;
-        item.perPageMetadata().swap(per_page_metadata);
-        item.setStatus(Item::STATUS_LOAD_OK);
-    }
-    else
+    for (ImageMetadataScanner::Result& result : results)
     {
-        status = LOAD_FAILED;
-        item.setStatus(Item::STATUS_LOAD_FAILED);
+        int const item_idx = m_itemsToLoad[result.fileIdx];
+        Item& item = m_items[item_idx];
+
+        if (result.status == ImageMetadataLoader::LOADED)
+        {
+            item.perPageMetadata().swap(result.perPageMetadata);
+            item.setStatus(Item::STATUS_LOAD_OK);
+        }
+        else
+        {
+            ++num_failed;
+            item.setStatus(Item::STATUS_LOAD_FAILED);
+        }
+
+        first_row = std::min(first_row, item_idx);
+        last_row = std::max(last_row, item_idx);
     }
-    QModelIndex const idx(index(item_idx, 0));
-    emit dataChanged(idx, idx);
 
-    m_itemsToLoad.pop_front();
+    // A single notification per batch keeps the views responsive
+    // when thousands of files are being loaded.
+    emit dataChanged(index(first_row, 0), index(last_row, 0));
 
-    return status;
+    return num_failed;
 }
 
 
@@ -27,6 +27,8 @@
 #include <vector>
 #include <memory>
 
+class ImageMetadataScanner;
+
 class ProjectFilesDialog : public QDialog, private Ui::ProjectFilesDialog
 {
     Q_OBJECT
@@ -79,6 +81,7 @@ private:
     std::unique_ptr<SortedFileList> m_ptrOffProjectFilesSorted;
     std::unique_ptr<FileList> m_ptrInProjectFiles;
     std::unique_ptr<SortedFileList> m_ptrInProjectFilesSorted;
+    std::unique_ptr<ImageMetadataScanner> m_ptrMetadataScanner;
     int m_loadTimerId;
     bool m_metadataLoadFailed;
     bool m_autoOutDir;
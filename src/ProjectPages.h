@@ -80,6 +80,14 @@ public:
 
     PageSequence toPageSequence(PageView view) const;
 
+    /**
+     * \brief Returns the logical pages of a single image, as they would
+     *        appear in toPageSequence(PAGE_VIEW).
+     *
+     * An empty vector is returned if the image is not part of the project.
+     */
+    std::vector<PageInfo> logicalPagesOf(ImageId const& image_id) const;
+
     void listRelinkablePaths(VirtualFunction1<void, RelinkablePath const&>& sink) const;
 
     /**
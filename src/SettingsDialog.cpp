@@ -112,6 +112,10 @@ SettingsDialog::SettingsDialog(QWidget* parent)
     }
 #endif
 
+    ui.enableCpuAccelerationCb->setChecked(
+        settings.value("settings/enable_cpu_acceleration", false).toBool()
+    );
+
     saveOldSettings();
     setupStylesheetsCombo();
 }
@@ -139,6 +143,8 @@ SettingsDialog::accept()
         }
 #endif
 
+        settings.setValue("settings/enable_cpu_acceleration", ui.enableCpuAccelerationCb->isChecked());
+
         QString stylesheetFilePath = ui.stylesheetCombo->currentData().toString();
         if (stylesheetFilePath != m_oldStylesheetFilePath)
         {
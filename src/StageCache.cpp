@@ -0,0 +1,352 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "StageCache.h"
+#include "ImageId.h"
+#include "AtomicFileOverwriter.h"
+#include "Utils.h"
+#include "imageproc/AbstractImageTransform.h"
+#include "imageproc/AffineImageTransform.h"
+#include "imageproc/AffineTransformedImage.h"
+#include "acceleration/AcceleratableOperations.h"
+#include <QColor>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QDateTime>
+#include <QDataStream>
+#include <QVector>
+#include <QCryptographicHash>
+#include <QSettings>
+#include <QStandardPaths>
+#include <QMutexLocker>
+#include <QtGlobal>
+#include <utility>
+
+using namespace imageproc;
+
+namespace
+{
+
+quint32 const DISK_FORMAT_MAGIC = 0x53544331; // "STC1"
+
+qint64 imageBytes(QImage const& image)
+{
+    return qint64(image.bytesPerLine()) * image.height();
+}
+
+bool writeImage(QIODevice& device, QImage const& image)
+{
+    QDataStream strm(&device);
+    strm << DISK_FORMAT_MAGIC;
+    strm << qint32(image.width()) << qint32(image.height()) << qint32(image.format());
+    strm << qint32(image.dotsPerMeterX()) << qint32(image.dotsPerMeterY());
+    strm << image.colorTable();
+
+    int const bytes_per_line = (image.width() * image.depth() + 7) / 8;
+    for (int y = 0; y < image.height(); ++y)
+    {
+        char const* line = reinterpret_cast<char const*>(image.constScanLine(y));
+        if (strm.writeRawData(line, bytes_per_line) != bytes_per_line)
+        {
+            return false;
+        }
+    }
+
+    return strm.status() == QDataStream::Ok;
+}
+
+QImage readImage(QIODevice& device)
+{
+    QDataStream strm(&device);
+
+    quint32 magic = 0;
+    qint32 width = 0, height = 0, format = 0, dpm_x = 0, dpm_y = 0;
+    strm >> magic;
+    if (magic != DISK_FORMAT_MAGIC)
+    {
+        return QImage();
+    }
+    strm >> width >> height >> format >> dpm_x >> dpm_y;
+    if (strm.status() != QDataStream::Ok || width <= 0 || height <= 0 ||
+            format <= QImage::Format_Invalid || format >= QImage::NImageFormats)
+    {
+        return QImage();
+    }
+
+    QVector<QRgb> color_table;
+    strm >> color_table;
+
+    QImage image(width, height, QImage::Format(format));
+    if (image.isNull())
+    {
+        return QImage();
+    }
+    image.setDotsPerMeterX(dpm_x);
+    image.setDotsPerMeterY(dpm_y);
+    if (!color_table.isEmpty())
+    {
+        image.setColorTable(color_table);
+    }
+
+    int const bytes_per_line = (image.width() * image.depth() + 7) / 8;
+    for (int y = 0; y < height; ++y)
+    {
+        char* line = reinterpret_cast<char*>(image.scanLine(y));
+        if (strm.readRawData(line, bytes_per_line) != bytes_per_line)
+        {
+            return QImage();
+        }
+    }
+
+    return image;
+}
+
+} // anonymous namespace
+
+StageCache&
+StageCache::instance()
+{
+    static StageCache cache;
+    return cache;
+}
+
+StageCache::StageCache()
+    :   m_memoryBytes(0)
+{
+    QString const default_dir(
+        QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QStringLiteral("/stages")
+    );
+
+    QSettings settings;
+    m_maxMemoryBytes = settings.value("settings/stage_cache_memory_mb", 512).toLongLong() << 20;
+    m_diskDir = settings.value("settings/stage_cache_dir", default_dir).toString();
+    // The disk tier writes uncompressed page-sized images, so it's opt-in.
+    m_maxDiskBytes = settings.value("settings/stage_cache_disk_mb", 0).toLongLong() << 20;
+    if (m_diskDir.isEmpty())
+    {
+        m_maxDiskBytes = 0;
+    }
+}
+
+void
+StageCache::disableDiskTier()
+{
+    m_maxDiskBytes = 0;
+}
+
+QString
+StageCache::sourceKey(ImageId const& image_id)
+{
+    QFileInfo const file_info(image_id.filePath());
+    if (!file_info.exists())
+    {
+        return QString();
+    }
+
+    return QStringLiteral("%1#%2@%3:%4").arg(
+               file_info.absoluteFilePath(), QString::number(image_id.page()),
+               QString::number(file_info.size()),
+               QString::number(file_info.lastModified().toMSecsSinceEpoch())
+           );
+}
+
+QImage
+StageCache::get(QString const& artifact, QString const& key, Persistence const persistence)
+{
+    if (key.isEmpty())
+    {
+        return QImage();
+    }
+
+    QString const entry_id(entryId(artifact, key));
+    {
+        QMutexLocker const locker(&m_mutex);
+
+        auto const it(m_entries.find(entry_id));
+        if (it != m_entries.end())
+        {
+            m_lru.splice(m_lru.begin(), m_lru, it->second);
+            return it->second->second;
+        }
+    }
+
+    if (persistence != MEMORY_AND_DISK || m_maxDiskBytes <= 0)
+    {
+        return QImage();
+    }
+
+    QFile file(diskPath(entry_id));
+    if (!file.open(QIODevice::ReadWrite))
+    {
+        return QImage();
+    }
+
+    QImage const image(readImage(file));
+    if (image.isNull())
+    {
+        return QImage();
+    }
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+    // Entries are evicted from disk by modification time.
+    file.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+#endif
+    file.close();
+
+    QMutexLocker const locker(&m_mutex);
+    putInMemory(entry_id, image);
+
+    return image;
+}
+
+void
+StageCache::put(
+    QString const& artifact, QString const& key,
+    QImage const& image, Persistence const persistence)
+{
+    if (key.isEmpty() || image.isNull())
+    {
+        return;
+    }
+
+    QString const entry_id(entryId(artifact, key));
+
+    {
+        QMutexLocker const locker(&m_mutex);
+        putInMemory(entry_id, image);
+    }
+
+    if (persistence != MEMORY_AND_DISK || m_maxDiskBytes <= 0 || !QDir().mkpath(m_diskDir))
+    {
+        return;
+    }
+
+    AtomicFileOverwriter overwriter;
+    QIODevice* const device = overwriter.startWriting(diskPath(entry_id));
+    if (device && writeImage(*device, image))
+    {
+        overwriter.commit();
+        Utils::trimCacheDir(m_diskDir, m_maxDiskBytes);
+    }
+}
+
+QImage
+StageCache::getOrCompute(
+    QString const& artifact, QString const& key,
+    Persistence const persistence, std::function<QImage()> const& compute)
+{
+    QImage image(get(artifact, key, persistence));
+    if (image.isNull())
+    {
+        // Two threads may end up computing the same image,
+        // which is better than holding the lock while computing.
+        image = compute();
+        put(artifact, key, image, persistence);
+    }
+    return image;
+}
+
+CachingFactory<QImage>
+StageCache::factory(
+    QString const& artifact, QString const& key,
+    Persistence const persistence, std::function<QImage()> const& compute)
+{
+    return CachingFactory<QImage>(
+               [this, artifact, key, persistence, compute]()
+    {
+        return getOrCompute(artifact, key, persistence, compute);
+    }
+           );
+}
+
+AffineTransformedImage
+StageCache::toAffine(
+    ImageId const& image_id, QImage const& image,
+    AbstractImageTransform const& transform, QColor const& outside_color,
+    std::shared_ptr<AcceleratableOperations> const& accel_ops)
+{
+    if (transform.isAffine())
+    {
+        return transform.toAffine(image, outside_color, accel_ops);
+    }
+
+    QString const source_key(sourceKey(image_id));
+    QString const key(
+        source_key.isEmpty() ? QString() :
+        source_key + QChar('|') + transform.fingerprint() +
+        QChar('|') + QString::number(outside_color.rgba(), 16)
+    );
+
+    QImage const dewarped(
+        instance().getOrCompute(
+            QStringLiteral("dewarped-1"), key, MEMORY_AND_DISK, [&]()
+    {
+        return transform.toAffine(image, outside_color, accel_ops).origImage();
+    }
+        )
+    );
+
+    return AffineTransformedImage(dewarped, transform.toAffine());
+}
+
+QString
+StageCache::entryId(QString const& artifact, QString const& key)
+{
+    QByteArray const hash(
+        QCryptographicHash::hash(
+            (artifact + QChar('|') + key).toUtf8(), QCryptographicHash::Sha1
+        ).toHex()
+    );
+    return QString::fromLatin1(hash.data(), hash.size());
+}
+
+QString
+StageCache::diskPath(QString const& entry_id) const
+{
+    return m_diskDir + QChar('/') + entry_id + QStringLiteral(".img");
+}
+
+void
+StageCache::putInMemory(QString const& entry_id, QImage const& image)
+{
+    auto const it(m_entries.find(entry_id));
+    if (it != m_entries.end())
+    {
+        m_memoryBytes -= imageBytes(it->second->second);
+        m_lru.erase(it->second);
+        m_entries.erase(it);
+    }
+
+    qint64 const bytes = imageBytes(image);
+    if (bytes > m_maxMemoryBytes)
+    {
+        return;
+    }
+
+    m_lru.emplace_front(entry_id, image);
+    m_entries[entry_id] = m_lru.begin();
+    m_memoryBytes += bytes;
+
+    while (m_memoryBytes > m_maxMemoryBytes)
+    {
+        m_memoryBytes -= imageBytes(m_lru.back().second);
+        m_entries.erase(m_lru.back().first);
+        m_lru.pop_back();
+    }
+}
@@ -0,0 +1,151 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STAGE_CACHE_H_
+#define STAGE_CACHE_H_
+
+#include "NonCopyable.h"
+#include "CachingFactory.h"
+#include <QString>
+#include <QImage>
+#include <QMutex>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+
+class ImageId;
+class AcceleratableOperations;
+class QColor;
+
+namespace imageproc
+{
+class AbstractImageTransform;
+class AffineTransformedImage;
+}
+
+/**
+ * \brief A cache of intermediate images produced by processing stages.
+ *
+ * Re-processing a page in the GUI goes through the whole chain of stages,
+ * starting from decoding the original image. Stages that already have
+ * their parameters don't redo their analysis, but the images they produce
+ * along the way, like the decoded original or the dewarped image, would
+ * still be recomputed. This cache lets a stage publish such images and
+ * consume them on subsequent runs, so that changing an output setting
+ * only costs re-running the output stage itself.
+ *
+ * An artifact is identified by a name that includes its version, like
+ * "output/transformed-1", and by a key that captures everything the image
+ * depends on, typically a sourceKey() plus a transform fingerprint.
+ * Bumping the version invalidates old entries.
+ *
+ * Images are kept in memory, up to "settings/stage_cache_memory_mb",
+ * evicting the least recently used ones. Artifacts stored MEMORY_AND_DISK
+ * also go to "settings/stage_cache_dir", limited by
+ * "settings/stage_cache_disk_mb", and survive restarts. The disk limit
+ * defaults to zero, which keeps everything in memory. Artifacts are written
+ * uncompressed, as encoding a full size image would take about as long as
+ * producing it. The settings are read once, on first access.
+ *
+ * \note This class is thread-safe.
+ */
+class StageCache
+{
+    DECLARE_NON_COPYABLE(StageCache)
+public:
+    enum Persistence { MEMORY_ONLY, MEMORY_AND_DISK };
+
+    /** \brief Returns the process-wide instance. */
+    static StageCache& instance();
+
+    /**
+     * \brief Keeps MEMORY_AND_DISK artifacts in memory only.
+     *
+     * Has to be called before the cache is used by other threads.
+     */
+    void disableDiskTier();
+
+    /**
+     * \brief Identifies the current contents of an image file.
+     *
+     * Consists of the file path, the page number, the file size and the
+     * modification time. Returns an empty string if the file doesn't exist,
+     * which disables caching of the artifacts derived from it.
+     */
+    static QString sourceKey(ImageId const& image_id);
+
+    /**
+     * \brief Returns a cached image or a null one if it's not cached.
+     */
+    QImage get(QString const& artifact, QString const& key, Persistence persistence);
+
+    /**
+     * \brief Publishes an image. Null images are ignored.
+     */
+    void put(QString const& artifact, QString const& key,
+             QImage const& image, Persistence persistence);
+
+    /**
+     * \brief Returns a cached image, or computes and publishes it.
+     *
+     * If \p key is empty, \p compute is called and nothing gets cached.
+     */
+    QImage getOrCompute(QString const& artifact, QString const& key,
+                        Persistence persistence, std::function<QImage()> const& compute);
+
+    /**
+     * \brief Wraps getOrCompute() into a CachingFactory, so that the image
+     *        is neither looked up nor computed until it's needed.
+     */
+    CachingFactory<QImage> factory(
+        QString const& artifact, QString const& key,
+        Persistence persistence, std::function<QImage()> const& compute);
+
+    /**
+     * \brief A cached version of AbstractImageTransform::toAffine().
+     *
+     * Affine transforms don't produce a new image, so they are passed through.
+     * For others, the transformed image is cached as the "dewarped" artifact.
+     */
+    static imageproc::AffineTransformedImage toAffine(
+        ImageId const& image_id, QImage const& image,
+        imageproc::AbstractImageTransform const& transform, QColor const& outside_color,
+        std::shared_ptr<AcceleratableOperations> const& accel_ops);
+private:
+    typedef std::list<std::pair<QString, QImage>> LruList;
+
+    StageCache();
+
+    static QString entryId(QString const& artifact, QString const& key);
+
+    QString diskPath(QString const& entry_id) const;
+
+    /** Must be called with m_mutex locked. */
+    void putInMemory(QString const& entry_id, QImage const& image);
+
+    QMutex m_mutex;
+    LruList m_lru; /**< Most recently used first. */
+    std::map<QString, LruList::iterator> m_entries;
+    qint64 m_memoryBytes;
+    qint64 m_maxMemoryBytes;
+    QString m_diskDir;
+    qint64 m_maxDiskBytes;
+};
+
+#endif
@@ -102,6 +102,12 @@ ThumbnailBase::paint(QPainter* painter,
             m_ptrCompletionHandler.swap(handler);
         }
     }
+    else
+    {
+        // We are being painted, so we are visible.  Let our request
+        // overtake those of thumbnails that were scrolled out of view.
+        m_ptrThumbnailCache->prioritizeRequest(m_pageId, *m_ptrFullSizeImageTransform);
+    }
 
     QTransform const full_size_transformed_to_display(
         m_postTransform * painter->worldTransform()
@@ -30,6 +30,7 @@
 #include <QCoreApplication>
 #include <QCryptographicHash>
 #include <QThread>
+#include <QElapsedTimer>
 #include <QMutex>
 #include <QMutexLocker>
 #include <QFileInfo>
@@ -229,12 +230,13 @@ private:
 };
 
 
-class ThumbnailPixmapCache::Impl : public QThread
+class ThumbnailPixmapCache::Impl : public QObject
 {
 public:
     Impl(QString const& thumb_dir,
          std::shared_ptr<AcceleratableOperations> const& accel_ops,
-         QSize const& max_thumb_size, int max_cached_pixmaps, int expiration_threshold);
+         QSize const& max_thumb_size, int max_cached_pixmaps, int expiration_threshold,
+         int num_loader_threads);
 
     ~Impl();
 
@@ -246,15 +248,17 @@ public:
                                 AbstractImageTransform const& full_size_image_transform,
                                 boost::weak_ptr<CompletionHandler> const& completion_handler);
 
+    void prioritize(ThumbId const& thumb_id);
+
     void ensureThumbnailExists(
         ThumbId const& thumb_id, QImage const& full_size_image,
         AbstractImageTransform const& full_size_image_transform,
         bool force_recreate);
 
     void recreateThumbnail(PageId const& page_id, QImage const& image);
-protected:
-    virtual void run();
 
+    Stats stats() const;
+protected:
     virtual void customEvent(QEvent* e);
 private:
     class LoadResultEvent;
@@ -285,6 +289,25 @@ private:
         Impl& m_rOwner;
     };
 
+    /**
+     * All loader threads take their work from the same load queue,
+     * so the order of requests and their expiration work the same way
+     * regardless of the number of threads.
+     */
+    class LoaderThread : public QThread
+    {
+    public:
+        LoaderThread(Impl& owner);
+
+        /** Makes the thread look into the load queue again. */
+        void wakeUp();
+    protected:
+        virtual void run();
+    private:
+        Impl& m_rOwner;
+        BackgroundLoader m_backgroundLoader;
+    };
+
     void backgroundProcessing();
 
     static QString getThumbFilePath(
@@ -352,7 +375,7 @@ private:
      */
     std::shared_ptr<AcceleratableOperations> m_ptrAccelOps;
 
-    BackgroundLoader m_backgroundLoader;
+    std::vector<std::unique_ptr<LoaderThread>> m_loaderThreads;
     Container m_items;
     ItemsByKey& m_itemsByKey; /**< ThumbId => Item mapping */
 
@@ -401,7 +424,10 @@ private:
      */
     int m_totalLoadAttempts;
 
-    bool m_threadStarted;
+    /** Throughput counters, except for Stats::numLoaderThreads. */
+    Stats m_stats;
+
+    bool m_threadsStarted;
     bool m_shuttingDown;
 };
 
@@ -431,11 +457,13 @@ ThumbnailPixmapCache::ThumbnailPixmapCache(
     QString const& thumb_dir,
     std::shared_ptr<AcceleratableOperations> const& accel_ops,
     QSize const& max_thumb_size,
-    int const max_cached_pixmaps, int const expiration_threshold)
+    int const max_cached_pixmaps, int const expiration_threshold,
+    int const num_loader_threads)
     :	m_ptrImpl(
           new Impl(
               RelinkablePath::normalize(thumb_dir), accel_ops,
-              max_thumb_size, max_cached_pixmaps, expiration_threshold
+              max_thumb_size, max_cached_pixmaps, expiration_threshold,
+              num_loader_threads
           )
       )
 {
@@ -468,6 +496,13 @@ ThumbnailPixmapCache::loadRequest(PageId const& page_id,
            );
 }
 
+void
+ThumbnailPixmapCache::prioritizeRequest(
+    PageId const& page_id, AbstractImageTransform const& full_size_image_transform)
+{
+    m_ptrImpl->prioritize(ThumbId(page_id, full_size_image_transform.isAffine()));
+}
+
 void
 ThumbnailPixmapCache::ensureThumbnailExists(
     PageId const& page_id, QImage const& full_size_image,
@@ -492,15 +527,21 @@ ThumbnailPixmapCache::recreateThumbnail(
     );
 }
 
+ThumbnailPixmapCache::Stats
+ThumbnailPixmapCache::stats() const
+{
+    return m_ptrImpl->stats();
+}
+
 /*======================= ThumbnailPixmapCache::Impl ========================*/
 
 ThumbnailPixmapCache::Impl::Impl(
     QString const& thumb_dir,
     std::shared_ptr<AcceleratableOperations> const& accel_ops,
     QSize const& max_thumb_size,
-    int const max_cached_pixmaps, int const expiration_threshold)
+    int const max_cached_pixmaps, int const expiration_threshold,
+    int const num_loader_threads)
     :	m_ptrAccelOps(accel_ops),
-      m_backgroundLoader(*this),
       m_items(),
       m_itemsByKey(m_items.get<ItemsByKeyTag>()),
       m_loadQueue(m_items.get<LoadQueueTag>()),
@@ -513,16 +554,25 @@ ThumbnailPixmapCache::Impl::Impl(
       m_numQueuedItems(0),
       m_numLoadedItems(0),
       m_totalLoadAttempts(0),
-      m_threadStarted(false),
+      m_threadsStarted(false),
       m_shuttingDown(false)
 {
+    m_stats.numLoaderThreads = std::max(1, num_loader_threads);
+    m_stats.numLoaded = 0;
+    m_stats.numFailed = 0;
+    m_stats.numExpired = 0;
+    m_stats.loadMsec = 0;
+
     // Note that QDir::mkdir() will fail if the parent directory,
     // that is $OUT/cache doesn't exist. We want that behaviour,
     // as otherwise when loading a project from a different machine,
     // a whole bunch of bogus directories would be created.
     QDir().mkdir(m_thumbDir);
 
-    m_backgroundLoader.moveToThread(this);
+    for (int i = 0; i < m_stats.numLoaderThreads; ++i)
+    {
+        m_loaderThreads.emplace_back(new LoaderThread(*this));
+    }
 }
 
 ThumbnailPixmapCache::Impl::~Impl()
@@ -530,7 +580,7 @@ ThumbnailPixmapCache::Impl::~Impl()
     {
         QMutexLocker const locker(&m_mutex);
 
-        if (!m_threadStarted)
+        if (!m_threadsStarted)
         {
             return;
         }
@@ -538,8 +588,14 @@ ThumbnailPixmapCache::Impl::~Impl()
         m_shuttingDown = true;
     }
 
-    quit();
-    wait();
+    for (std::unique_ptr<LoaderThread> const& thread : m_loaderThreads)
+    {
+        thread->quit();
+    }
+    for (std::unique_ptr<LoaderThread> const& thread : m_loaderThreads)
+    {
+        thread->wait();
+    }
 }
 
 void
@@ -709,24 +765,51 @@ ThumbnailPixmapCache::Impl::request(ThumbId const& thumb_id,
 
     if (m_numQueuedItems++ == 0)
     {
-        if (m_threadStarted)
-        {
-            // Wake the background thread up.
-            QCoreApplication::postEvent(
-                &m_backgroundLoader, new QEvent(QEvent::User)
-            );
-        }
-        else
+        // Loader threads only go idle once the queue is empty,
+        // so that's the only time we need to wake them up.
+        for (std::unique_ptr<LoaderThread> const& thread : m_loaderThreads)
         {
-            // Start the background thread.
-            start();
-            m_threadStarted = true;
+            if (m_threadsStarted)
+            {
+                thread->wakeUp();
+            }
+            else
+            {
+                thread->start();
+            }
         }
+        m_threadsStarted = true;
     }
 
     return ThumbnailLoadResult::QUEUED;
 }
 
+void
+ThumbnailPixmapCache::Impl::prioritize(ThumbId const& thumb_id)
+{
+    assert(QCoreApplication::instance()->thread() == QThread::currentThread());
+
+    QMutexLocker const locker(&m_mutex);
+
+    ItemsByKey::iterator const k_it(m_itemsByKey.find(thumb_id));
+    if (k_it == m_itemsByKey.end() || k_it->status != Item::QUEUED)
+    {
+        // Note that we must not move IN_PROGRESS items, as all QUEUED
+        // items must precede any other items in the load queue.
+        return;
+    }
+
+    LoadQueue::iterator const lq_it(m_items.project<LoadQueueTag>(k_it));
+    m_loadQueue.relocate(m_loadQueue.begin(), lq_it);
+}
+
+ThumbnailPixmapCache::Stats
+ThumbnailPixmapCache::Impl::stats() const
+{
+    QMutexLocker const locker(&m_mutex);
+    return m_stats;
+}
+
 void
 ThumbnailPixmapCache::Impl::ensureThumbnailExists(
     ThumbId const& thumb_id, QImage const& full_size_image,
@@ -794,13 +877,6 @@ ThumbnailPixmapCache::Impl::ensureThumbnailExists(
     postLoadedResult(item.thisPtr, *thumb);
 }
 
-void
-ThumbnailPixmapCache::Impl::run()
-{
-    backgroundProcessing();
-    exec(); // Wait for further processing requests (via custom events).
-}
-
 void
 ThumbnailPixmapCache::Impl::customEvent(QEvent* e)
 {
@@ -864,6 +940,7 @@ ThumbnailPixmapCache::Impl::backgroundProcessing()
                     // ThumbnailLoadResult::REQUEST_EXPIRED
                     // documentation.
 
+                    ++m_stats.numExpired;
                     postRequestExpiredResult(item_weak_ptr);
                     continue;
                 }
@@ -879,12 +956,29 @@ ThumbnailPixmapCache::Impl::backgroundProcessing()
 
             assert(full_size_image_transform);
 
+            QElapsedTimer timer;
+            timer.start();
+
             boost::optional<AffineTransformedImage> const thumb(
                 loadSaveThumbnail(
                     thumb_id, *full_size_image_transform, accel_ops,
                     thumb_dir, max_thumb_size
                 )
             );
+
+            {
+                QMutexLocker const locker(&m_mutex);
+                if (thumb)
+                {
+                    ++m_stats.numLoaded;
+                }
+                else
+                {
+                    ++m_stats.numFailed;
+                }
+                m_stats.loadMsec += timer.elapsed();
+            }
+
             if (thumb)
             {
                 postLoadedResult(item_weak_ptr, *thumb);
@@ -1004,8 +1098,13 @@ ThumbnailPixmapCache::Impl::loadSaveThumbnail(ThumbId const& thumb_id,
         return AffineTransformedImage(thumb_image, thumb_transform);
     }
 
-    // Load full size image.
-    QImage full_size_image(ImageLoader::load(thumb_id.pageId.imageId()));
+    // Load full size image.  For affine transforms, the thumbnail is just
+    // a downscaled original, so a reduced resolution version is good enough.
+    QImage full_size_image(
+        full_size_image_transform.isAffine()
+        ? ImageLoader::loadScaled(thumb_id.pageId.imageId(), max_thumb_size)
+        : ImageLoader::load(thumb_id.pageId.imageId())
+    );
     if (full_size_image.isNull())
     {
         return boost::optional<AffineTransformedImage>();
@@ -1456,3 +1555,26 @@ ThumbnailPixmapCache::Impl::BackgroundLoader::customEvent(QEvent*)
 {
     m_rOwner.backgroundProcessing();
 }
+
+
+/*==================== ThumbnailPixmapCache::LoaderThread ===================*/
+
+ThumbnailPixmapCache::Impl::LoaderThread::LoaderThread(Impl& owner)
+    :	m_rOwner(owner),
+      m_backgroundLoader(owner)
+{
+    m_backgroundLoader.moveToThread(this);
+}
+
+void
+ThumbnailPixmapCache::Impl::LoaderThread::wakeUp()
+{
+    QCoreApplication::postEvent(&m_backgroundLoader, new QEvent(QEvent::User));
+}
+
+void
+ThumbnailPixmapCache::Impl::LoaderThread::run()
+{
+    m_rOwner.backgroundProcessing();
+    exec(); // Wait for further processing requests (via custom events).
+}
@@ -25,6 +25,7 @@
 #include "AbstractCommand.h"
 #include "acceleration/AcceleratableOperations.h"
 #include <boost/weak_ptr.hpp>
+#include <QtGlobal>
 #include <memory>
 
 class PageId;
@@ -45,6 +46,27 @@ class ThumbnailPixmapCache : public RefCountable
 public:
     typedef AbstractCommand1<void, ThumbnailLoadResult::Status> CompletionHandler;
 
+    /**
+     * \brief Counters of the work done by the loader threads.
+     *
+     * Sampling these periodically gives the thumbnail throughput.
+     */
+    struct Stats
+    {
+        int numLoaderThreads;
+
+        /** Thumbnails loaded from disk or generated from full size images. */
+        int numLoaded;
+
+        int numFailed;
+
+        /** \see ThumbnailLoadResult::REQUEST_EXPIRED */
+        int numExpired;
+
+        /** Time spent on loading, summed across the loader threads. */
+        qint64 loadMsec;
+    };
+
     /**
      * \brief Constructor.  To be called from the GUI thread only.
      *
@@ -62,11 +84,15 @@ public:
      *        expired.  \p expiration_threshold specifies the exact number
      *        of requests that cause older requests to expire.
      *
+     * \param num_loader_threads The number of background threads
+     *        servicing load requests.
+     *
      * \see ThumbnailLoadResult::REQUEST_EXPIRED
      */
     ThumbnailPixmapCache(QString const& thumb_dir,
                          std::shared_ptr<AcceleratableOperations> const& accel_ops,
-                         QSize const& max_size, int max_cached_pixmaps, int expiration_threshold);
+                         QSize const& max_size, int max_cached_pixmaps, int expiration_threshold,
+                         int num_loader_threads = 1);
 
     /**
      * \brief Destructor.  To be called from the GUI thread only.
@@ -107,6 +133,18 @@ public:
                                     imageproc::AbstractImageTransform const& full_size_image_transform,
                                     boost::weak_ptr<CompletionHandler> const& completion_handler);
 
+    /**
+     * \brief Move a pending load request to the front of the load queue.
+     *
+     * Meant to be called for thumbnails that are currently visible,
+     * so that they are loaded before the ones that were scrolled away.
+     * Does nothing if no such request is queued.
+     *
+     * \note This function is to be called from the GUI thread only.
+     */
+    void prioritizeRequest(PageId const& page_id,
+                           imageproc::AbstractImageTransform const& full_size_image_transform);
+
     /**
      * \brief If no thumbnail exists for this image, create it.
      *
@@ -141,6 +179,11 @@ public:
     void recreateThumbnail(
         PageId const& page_id, QImage const& full_size_image,
         imageproc::AbstractImageTransform const& full_size_image_transform);
+
+    /**
+     * \note This function may be called from any thread.
+     */
+    Stats stats() const;
 private:
     struct ThumbId;
     class Item;
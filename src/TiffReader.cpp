@@ -19,14 +19,20 @@
 #include "TiffReader.h"
 #include "ImageMetadata.h"
 #include "NonCopyable.h"
+#include "ParallelFor.h"
 #include <QtGlobal>
 #include <QSysInfo>
 #include <QIODevice>
+#include <QFile>
+#include <QString>
 #include <QImage>
 #include <QColor>
 #include <QSize>
 #include <QDebug>
 #include <algorithm>
+#include <vector>
+#include <atomic>
+#include <string.h>
 #include <tiff.h>
 #include <tiffio.h>
 #include <new>
@@ -123,6 +129,8 @@ struct TiffReader::TiffInfo
     uint16_t samples_per_pixel;
     uint16_t sample_format;
     uint16_t photometric;
+    uint16_t compression;
+    uint16_t planar_config;
     bool host_big_endian;
     bool file_big_endian;
 
@@ -139,10 +147,11 @@ TiffReader::TiffInfo::TiffInfo(TiffHandle const& tif, TiffHeader const& header)
       samples_per_pixel(1),
       sample_format(SAMPLEFORMAT_UINT),
       photometric(PHOTOMETRIC_MINISBLACK),
+      compression(COMPRESSION_NONE),
+      planar_config(PLANARCONFIG_CONTIG),
       host_big_endian(QSysInfo::ByteOrder == QSysInfo::BigEndian),
       file_big_endian(header.signature() == TiffHeader::TIFF_BIG_ENDIAN)
 {
-    uint16_t compression = 1;
     TIFFGetField(tif.handle(), TIFFTAG_COMPRESSION, &compression);
     switch (compression)
     {
@@ -159,6 +168,7 @@ TiffReader::TiffInfo::TiffInfo(TiffHandle const& tif, TiffHeader const& header)
     TIFFGetField(tif.handle(), TIFFTAG_SAMPLESPERPIXEL, &samples_per_pixel);
     TIFFGetField(tif.handle(), TIFFTAG_SAMPLEFORMAT, &sample_format);
     TIFFGetField(tif.handle(), TIFFTAG_PHOTOMETRIC, &photometric);
+    TIFFGetField(tif.handle(), TIFFTAG_PLANARCONFIG, &planar_config);
 }
 
 bool
@@ -181,6 +191,25 @@ TiffReader::TiffInfo::mapsToBinaryOrIndexed8() const
 }
 
 
+/**
+ * Describes how the current page is decoded by readNativeImage().
+ * Blocks are either strips or tiles, numbered the way libtiff does.
+ */
+struct TiffReader::NativeLayout
+{
+    SampleConversion conversion;
+    QImage::Format format;
+    int bits_per_sample;
+    bool tiled;
+    int block_width;
+    int block_height;
+    int blocks_across;
+    int num_blocks;
+    tsize_t block_size;
+    tsize_t row_size;
+};
+
+
 static tsize_t deviceRead(thandle_t context, tdata_t data, tsize_t size)
 {
     QIODevice* dev = (QIODevice*)context;
@@ -313,6 +342,149 @@ static void convertAbgrToArgb(uint32_t const* src, uint32_t* dst, int count)
     }
 }
 
+namespace
+{
+
+/**
+ * Downscales an image by an integer factor, averaging blocks of
+ * factor x factor pixels.  The source image is fed line by line,
+ * so it never has to be in memory as a whole.
+ */
+class LineDecimator
+{
+    DECLARE_NON_COPYABLE(LineDecimator)
+public:
+    /**
+     * \param format One of Format_Indexed8 (for grayscale images),
+     *        Format_RGB32 or Format_ARGB32.
+     */
+    LineDecimator(int src_width, int src_height, int factor, QImage::Format format);
+
+    /**
+     * \brief Takes the next line of the source image.
+     *
+     * For grayscale images, the gray level is taken from the blue channel.
+     */
+    void pushLine(uint32_t const* line);
+
+    QImage const& image() const
+    {
+        return m_image;
+    }
+private:
+    void flushBlockRow();
+
+    QImage m_image;
+    std::vector<uint32_t> m_sums;
+    int m_srcWidth;
+    int m_srcHeight;
+    int m_factor;
+    int m_srcY;
+    int m_linesInBlock;
+    int m_channels;
+};
+
+LineDecimator::LineDecimator(
+    int const src_width, int const src_height, int const factor, QImage::Format const format)
+    :	m_image(
+          (src_width + factor - 1) / factor,
+          (src_height + factor - 1) / factor, format
+      ),
+      m_srcWidth(src_width),
+      m_srcHeight(src_height),
+      m_factor(factor),
+      m_srcY(0),
+      m_linesInBlock(0),
+      m_channels(format == QImage::Format_Indexed8 ? 1 : 4)
+{
+    if (m_image.isNull())
+    {
+        throw std::bad_alloc();
+    }
+
+    if (format == QImage::Format_Indexed8)
+    {
+        QVector<QRgb> palette(256);
+        for (int i = 0; i < 256; ++i)
+        {
+            palette[i] = qRgb(i, i, i);
+        }
+        m_image.setColorTable(palette);
+    }
+
+    m_sums.resize(m_image.width() * m_channels, 0);
+}
+
+void
+LineDecimator::pushLine(uint32_t const* line)
+{
+    int const dst_width = m_image.width();
+    uint32_t* sum = &m_sums[0];
+    int x = 0;
+
+    for (int dst_x = 0; dst_x < dst_width; ++dst_x, sum += m_channels)
+    {
+        int const x_end = std::min(x + m_factor, m_srcWidth);
+        if (m_channels == 1)
+        {
+            for (; x < x_end; ++x)
+            {
+                sum[0] += line[x] & 0xFF;
+            }
+        }
+        else
+        {
+            for (; x < x_end; ++x)
+            {
+                uint32_t const pixel = line[x];
+                sum[0] += pixel >> 24;
+                sum[1] += (pixel >> 16) & 0xFF;
+                sum[2] += (pixel >> 8) & 0xFF;
+                sum[3] += pixel & 0xFF;
+            }
+        }
+    }
+
+    ++m_srcY;
+    ++m_linesInBlock;
+    if ((m_linesInBlock == m_factor) || (m_srcY == m_srcHeight))
+    {
+        flushBlockRow();
+    }
+}
+
+void
+LineDecimator::flushBlockRow()
+{
+    int const dst_width = m_image.width();
+    int const dst_y = (m_srcY - 1) / m_factor;
+    uint32_t const* sum = &m_sums[0];
+
+    for (int dst_x = 0; dst_x < dst_width; ++dst_x, sum += m_channels)
+    {
+        int const block_width = std::min(m_factor, m_srcWidth - dst_x * m_factor);
+        uint32_t const area = block_width * m_linesInBlock;
+        uint32_t const half = area >> 1;
+        if (m_channels == 1)
+        {
+            m_image.scanLine(dst_y)[dst_x] = static_cast<uchar>((sum[0] + half) / area);
+        }
+        else
+        {
+            uint32_t pixel = ((sum[0] + half) / area) << 24;
+            pixel |= ((sum[1] + half) / area) << 16;
+            pixel |= ((sum[2] + half) / area) << 8;
+            pixel |= (sum[3] + half) / area;
+            ((uint32_t*)m_image.scanLine(dst_y))[dst_x] = pixel;
+        }
+    }
+
+    std::fill(m_sums.begin(), m_sums.end(), 0);
+    m_linesInBlock = 0;
+}
+
+} // anonymous namespace
+
 QImage
 TiffReader::readImage(QIODevice& device, int const page_num)
 {
@@ -351,63 +523,629 @@ TiffReader::readImage(QIODevice& device, int const page_num)
 
     TiffInfo const info(tif, header);
 
-    QImage image;
+    return readCurrentDirectory(tif, info);
+}
 
-    if (info.mapsToBinaryOrIndexed8())
+QImage
+TiffReader::readCurrentDirectory(TiffHandle const& tif, TiffInfo const& info)
+{
+    NativeLayout layout;
+    if (getNativeLayout(tif, info, layout))
     {
         // Common case optimization.
-        image = extractBinaryOrIndexed8Image(tif, info);
+        return readNativeImage(tif, info, layout);
+    }
+
+    // General case.
+    QImage image(
+        info.width, info.height,
+        info.samples_per_pixel == 3
+        ? QImage::Format_RGB32 : QImage::Format_ARGB32
+    );
+    if (image.isNull())
+    {
+        throw std::bad_alloc();
+    }
+
+    // For ABGR -> ARGB conversion.
+    TiffBuffer<uint32_t> tmp_buffer;
+    uint32_t const* src_line = 0;
+
+    if (image.bytesPerLine() == 4 * info.width)
+    {
+        // We can avoid creating a temporary buffer in this case.
+        if (!TIFFReadRGBAImageOriented(tif.handle(), info.width, info.height,
+                                       (uint32_t*)image.bits(), ORIENTATION_TOPLEFT, 0))
+        {
+            return QImage();
+        }
+        src_line = (uint32_t const*)image.bits();
     }
     else
     {
-        // General case.
-        image = QImage(
-                    info.width, info.height,
-                    info.samples_per_pixel == 3
-                    ? QImage::Format_RGB32 : QImage::Format_ARGB32
-                );
-        if (image.isNull())
+        TiffBuffer<uint32_t>(info.width * info.height).swap(tmp_buffer);
+        if (!TIFFReadRGBAImageOriented(tif.handle(), info.width, info.height,
+                                       tmp_buffer.data(), ORIENTATION_TOPLEFT, 0))
         {
-            throw std::bad_alloc();
+            return QImage();
         }
+        src_line = tmp_buffer.data();
+    }
 
-        // For ABGR -> ARGB conversion.
-        TiffBuffer<uint32_t> tmp_buffer;
-        uint32_t const* src_line = 0;
+    uint32_t* dst_line = (uint32_t*)image.bits();
+    assert(image.bytesPerLine() % 4 == 0);
+    int const dst_stride = image.bytesPerLine() / 4;
+    for (int y = 0; y < info.height; ++y)
+    {
+        convertAbgrToArgb(src_line, dst_line, info.width);
+        src_line += info.width;
+        dst_line += dst_stride;
+    }
+
+    return image;
+}
 
-        if (image.bytesPerLine() == 4 * info.width)
+bool
+TiffReader::getNativeLayout(
+    TiffHandle const& tif, TiffInfo const& info, NativeLayout& layout)
+{
+    if (info.sample_format != SAMPLEFORMAT_UINT)
+    {
+        return false;
+    }
+    if (info.samples_per_pixel > 1 && info.planar_config != PLANARCONFIG_CONTIG)
+    {
+        return false;
+    }
+
+    layout.bits_per_sample = info.bits_per_sample;
+
+    if (info.mapsToBinaryOrIndexed8())
+    {
+        if (info.bits_per_sample == 1)
         {
-            // We can avoid creating a temporary buffer in this case.
-            if (!TIFFReadRGBAImageOriented(tif.handle(), info.width, info.height,
-                                           (uint32_t*)image.bits(), ORIENTATION_TOPLEFT, 0))
+            // Because we specify B option when opening, we can
+            // always use Format_Mono, and not Format_MonoLSB.
+            layout.conversion = COPY_BITS;
+            layout.format = QImage::Format_Mono;
+        }
+        else
+        {
+            layout.conversion = info.bits_per_sample == 8 ? COPY_BYTES : UNPACK_INDICES;
+            layout.format = QImage::Format_Indexed8;
+        }
+    }
+    else if (info.samples_per_pixel == 1 && info.bits_per_sample == 16
+             && (info.photometric == PHOTOMETRIC_MINISBLACK
+                 || info.photometric == PHOTOMETRIC_MINISWHITE))
+    {
+        layout.conversion = GRAY16;
+        layout.format = QImage::Format_Indexed8;
+    }
+    else if (info.photometric == PHOTOMETRIC_RGB
+             && (info.bits_per_sample == 8 || info.bits_per_sample == 16))
+    {
+        bool const is16 = info.bits_per_sample == 16;
+        if (info.samples_per_pixel == 3)
+        {
+            layout.conversion = is16 ? RGB16 : RGB8;
+            layout.format = QImage::Format_RGB32;
+        }
+        else if (info.samples_per_pixel == 4)
+        {
+            // Associated (premultiplied) alpha is left to the general case.
+            uint16_t num_extra = 0;
+            uint16_t* extra_types = 0;
+            TIFFGetFieldDefaulted(
+                tif.handle(), TIFFTAG_EXTRASAMPLES, &num_extra, &extra_types
+            );
+            if (num_extra != 1 || extra_types[0] != EXTRASAMPLE_UNASSALPHA)
             {
-                return QImage();
+                return false;
             }
-            src_line = (uint32_t const*)image.bits();
+            layout.conversion = is16 ? RGBA16 : RGBA8;
+            layout.format = QImage::Format_ARGB32;
         }
         else
         {
-            TiffBuffer<uint32_t>(info.width * info.height).swap(tmp_buffer);
-            if (!TIFFReadRGBAImageOriented(tif.handle(), info.width, info.height,
-                                           tmp_buffer.data(), ORIENTATION_TOPLEFT, 0))
+            return false;
+        }
+    }
+    else
+    {
+        return false;
+    }
+
+    if (layout.conversion != COPY_BITS && layout.conversion != COPY_BYTES
+            && layout.conversion != UNPACK_INDICES)
+    {
+        // These used to go through TIFFReadRGBAImageOriented(), which
+        // honours the orientation tag.  The general case still does.
+        uint16_t orientation = ORIENTATION_TOPLEFT;
+        TIFFGetFieldDefaulted(tif.handle(), TIFFTAG_ORIENTATION, &orientation);
+        if (orientation != ORIENTATION_TOPLEFT)
+        {
+            return false;
+        }
+    }
+
+    layout.tiled = TIFFIsTiled(tif.handle()) != 0;
+    if (layout.tiled)
+    {
+        uint32_t tile_width = 0, tile_length = 0;
+        TIFFGetField(tif.handle(), TIFFTAG_TILEWIDTH, &tile_width);
+        TIFFGetField(tif.handle(), TIFFTAG_TILELENGTH, &tile_length);
+        if (!tile_width || !tile_length || (tile_width % 8))
+        {
+            return false;
+        }
+        layout.block_width = tile_width;
+        layout.block_height = tile_length;
+        layout.blocks_across = (info.width + tile_width - 1) / tile_width;
+        layout.num_blocks = TIFFNumberOfTiles(tif.handle());
+        layout.block_size = TIFFTileSize(tif.handle());
+        layout.row_size = TIFFTileRowSize(tif.handle());
+    }
+    else
+    {
+        uint32_t rows_per_strip = 0;
+        TIFFGetFieldDefaulted(tif.handle(), TIFFTAG_ROWSPERSTRIP, &rows_per_strip);
+        layout.block_width = info.width;
+        layout.block_height = std::max<uint32_t>(
+            1, std::min<uint32_t>(rows_per_strip, info.height)
+        );
+        layout.blocks_across = 1;
+        layout.num_blocks = TIFFNumberOfStrips(tif.handle());
+        layout.block_size = TIFFStripSize(tif.handle());
+        layout.row_size = TIFFScanlineSize(tif.handle());
+    }
+
+    return layout.block_size > 0 && layout.row_size > 0;
+}
+
+QImage
+TiffReader::readNativeImage(
+    TiffHandle const& tif, TiffInfo const& info, NativeLayout const& layout)
+{
+    QImage image(info.width, info.height, layout.format);
+    if (image.isNull())
+    {
+        throw std::bad_alloc();
+    }
+
+    if (layout.format != QImage::Format_RGB32 && layout.format != QImage::Format_ARGB32)
+    {
+        // GRAY16 samples are reduced to 8 bits before going through the palette.
+        TiffInfo palette_info(info);
+        palette_info.bits_per_sample = std::min<uint16_t>(info.bits_per_sample, 8);
+
+        QVector<QRgb> colors;
+        if (!readColorTable(tif, palette_info, colors))
+        {
+            return QImage();
+        }
+        image.setColorTable(colors);
+    }
+
+    // Taken once, as scanLine() and friends aren't safe to call concurrently.
+    uint8_t* const image_data = image.bits();
+    int const image_stride = image.bytesPerLine();
+
+    QFile* const file = qobject_cast<QFile*>(
+                            static_cast<QIODevice*>(TIFFClientdata(tif.handle()))
+                        );
+    if (!file || info.compression == COMPRESSION_NONE || layout.num_blocks < 2)
+    {
+        // Nothing to gain from parallel decoding, or no way to do it.
+        if (!decodeBlocks(tif, layout, 0, layout.num_blocks, image_data, image_stride))
+        {
+            return QImage();
+        }
+        return image;
+    }
+
+    // A libtiff handle can't be used by more than one thread at a time,
+    // so each chunk of blocks gets a handle of its own.
+    QString const file_path(file->fileName());
+    toff_t const dir_offset = TIFFCurrentDirOffset(tif.handle());
+    std::atomic<bool> reopen_failed(false);
+    std::atomic<bool> decode_failed(false);
+
+    parallelFor(0, layout.num_blocks, [&](int begin, int end)
+    {
+        QFile local_file(file_path);
+        if (local_file.open(QIODevice::ReadOnly))
+        {
+            TiffHandle local_tif(
+                TIFFClientOpen(
+                    "file", "rBm", &local_file, &deviceRead, &deviceWrite,
+                    &deviceSeek, &deviceClose, &deviceSize,
+                    &deviceMap, &deviceUnmap
+                )
+            );
+            if (local_tif.handle() && TIFFSetSubDirectory(local_tif.handle(), dir_offset))
             {
+                if (!decodeBlocks(local_tif, layout, begin, end, image_data, image_stride))
+                {
+                    decode_failed.store(true);
+                }
+                return;
+            }
+        }
+        reopen_failed.store(true);
+    });
+
+    if (decode_failed.load())
+    {
+        return QImage();
+    }
+
+    if (reopen_failed.load()
+            && !decodeBlocks(tif, layout, 0, layout.num_blocks, image_data, image_stride))
+    {
+        return QImage();
+    }
+
+    return image;
+}
+
+bool
+TiffReader::decodeBlocks(
+    TiffHandle const& tif, NativeLayout const& layout,
+    int const first_block, int const last_block,
+    uint8_t* const image_data, int const image_stride)
+{
+    TIFF* const handle = tif.handle();
+    uint32_t width = 0, height = 0;
+    TIFFGetField(handle, TIFFTAG_IMAGEWIDTH, &width);
+    TIFFGetField(handle, TIFFTAG_IMAGELENGTH, &height);
+
+    TiffBuffer<uint8_t> buf(layout.block_size);
+
+    for (int block = first_block; block < last_block; ++block)
+    {
+        int const x0 = (block % layout.blocks_across) * layout.block_width;
+        int const y0 = (block / layout.blocks_across) * layout.block_height;
+        if (x0 >= (int)width || y0 >= (int)height)
+        {
+            continue;
+        }
+
+        tsize_t const decoded = layout.tiled
+                                ? TIFFReadEncodedTile(handle, block, buf.data(), layout.block_size)
+                                : TIFFReadEncodedStrip(handle, block, buf.data(), layout.block_size);
+        if (decoded < 0)
+        {
+            // Like TIFFReadRGBAImageOriented() used to, fail the whole image
+            // rather than show a partially decoded one.
+            return false;
+        }
+
+        int const rows = std::min<int>(layout.block_height, height - y0);
+        int const count = std::min<int>(layout.block_width, width - x0);
+        uint8_t const* src = buf.data();
+        uint8_t* dst_line = image_data + y0 * image_stride;
+        for (int i = 0; i < rows; ++i, src += layout.row_size, dst_line += image_stride)
+        {
+            convertSamples(layout, src, dst_line, x0, count);
+        }
+    }
+
+    return true;
+}
+
+static inline uint32_t sample16To8(uint16_t const sample)
+{
+    return (sample * 255u + 32767u) / 65535u;
+}
+
+void
+TiffReader::convertSamples(
+    NativeLayout const& layout, uint8_t const* src,
+    uint8_t* dst_line, int const x0, int const count)
+{
+    switch (layout.conversion)
+    {
+    case COPY_BITS:
+        // Tile widths are multiples of 8, so x0 is byte-aligned.
+        memcpy(dst_line + x0 / 8, src, (count + 7) / 8);
+        break;
+    case COPY_BYTES:
+        memcpy(dst_line + x0, src, count);
+        break;
+    case UNPACK_INDICES:
+        unpackLine(src, dst_line + x0, count, layout.bits_per_sample);
+        break;
+    case GRAY16:
+    {
+        uint16_t const* src16 = (uint16_t const*)src;
+        uint8_t* dst = dst_line + x0;
+        for (int i = 0; i < count; ++i)
+        {
+            dst[i] = static_cast<uint8_t>(sample16To8(src16[i]));
+        }
+        break;
+    }
+    case RGB8:
+    {
+        uint32_t* dst = (uint32_t*)dst_line + x0;
+        for (int i = 0; i < count; ++i, src += 3)
+        {
+            dst[i] = 0xFF000000 | (src[0] << 16) | (src[1] << 8) | src[2];
+        }
+        break;
+    }
+    case RGB16:
+    {
+        uint16_t const* src16 = (uint16_t const*)src;
+        uint32_t* dst = (uint32_t*)dst_line + x0;
+        for (int i = 0; i < count; ++i, src16 += 3)
+        {
+            dst[i] = 0xFF000000 | (sample16To8(src16[0]) << 16)
+                     | (sample16To8(src16[1]) << 8) | sample16To8(src16[2]);
+        }
+        break;
+    }
+    case RGBA8:
+    {
+        uint32_t* dst = (uint32_t*)dst_line + x0;
+        for (int i = 0; i < count; ++i, src += 4)
+        {
+            dst[i] = (uint32_t(src[3]) << 24) | (src[0] << 16) | (src[1] << 8) | src[2];
+        }
+        break;
+    }
+    case RGBA16:
+    {
+        uint16_t const* src16 = (uint16_t const*)src;
+        uint32_t* dst = (uint32_t*)dst_line + x0;
+        for (int i = 0; i < count; ++i, src16 += 4)
+        {
+            dst[i] = (sample16To8(src16[3]) << 24) | (sample16To8(src16[0]) << 16)
+                     | (sample16To8(src16[1]) << 8) | sample16To8(src16[2]);
+        }
+        break;
+    }
+    }
+}
+
+QImage
+TiffReader::readScaledImage(QIODevice& device, int const page_num, QSize const& hint)
+{
+    if (!device.isReadable())
+    {
+        return QImage();
+    }
+    if (device.isSequential())
+    {
+        // libtiff needs to be able to seek.
+        return QImage();
+    }
+
+    TiffHeader header(readHeader(device));
+    if (!checkHeader(header))
+    {
+        return QImage();
+    }
+
+    TiffHandle tif(
+        TIFFClientOpen(
+            "file", "rBm", &device, &deviceRead, &deviceWrite,
+            &deviceSeek, &deviceClose, &deviceSize,
+            &deviceMap, &deviceUnmap
+        )
+    );
+    if (!tif.handle())
+    {
+        return QImage();
+    }
+
+    if (!TIFFSetDirectory(tif.handle(), page_num))
+    {
+        return QImage();
+    }
+
+    QSize const target_size(
+        currentPageMetadata(tif).size().scaled(hint, Qt::KeepAspectRatio)
+    );
+    if (target_size.isEmpty())
+    {
+        TiffInfo const info(tif, header);
+        return readCurrentDirectory(tif, info);
+    }
+
+    if (!selectReducedImage(tif, page_num, target_size))
+    {
+        return QImage();
+    }
+
+    TiffInfo const info(tif, header);
+    int const factor = std::min(
+        info.width / target_size.width(), info.height / target_size.height()
+    );
+
+    return readCurrentDirectoryScaled(tif, info, factor);
+}
+
+bool
+TiffReader::selectReducedImage(
+    TiffHandle const& tif, int const page_num, QSize const& min_size)
+{
+    uint16_t num_subifds = 0;
+    toff_t* subifds = 0;
+    if (!TIFFGetField(tif.handle(), TIFFTAG_SUBIFD, &num_subifds, &subifds) || !num_subifds)
+    {
+        return true;
+    }
+
+    // The array belongs to the current directory, which we are about to leave.
+    std::vector<toff_t> const offsets(subifds, subifds + num_subifds);
+
+    toff_t best_offset = 0;
+    uint32_t best_width = 0;
+    TIFFGetField(tif.handle(), TIFFTAG_IMAGEWIDTH, &best_width);
+
+    for (size_t i = 0; i < offsets.size(); ++i)
+    {
+        if (!TIFFSetSubDirectory(tif.handle(), offsets[i]))
+        {
+            continue;
+        }
+
+        uint32_t subfile_type = 0;
+        uint32_t width = 0, height = 0;
+        TIFFGetField(tif.handle(), TIFFTAG_SUBFILETYPE, &subfile_type);
+        TIFFGetField(tif.handle(), TIFFTAG_IMAGEWIDTH, &width);
+        TIFFGetField(tif.handle(), TIFFTAG_IMAGELENGTH, &height);
+        if ((subfile_type & FILETYPE_REDUCEDIMAGE) && (width < best_width)
+                && ((int)width >= min_size.width()) && ((int)height >= min_size.height()))
+        {
+            best_offset = offsets[i];
+            best_width = width;
+        }
+    }
+
+    if (best_offset)
+    {
+        return TIFFSetSubDirectory(tif.handle(), best_offset) != 0;
+    }
+    else
+    {
+        return TIFFSetDirectory(tif.handle(), page_num) != 0;
+    }
+}
+
+QImage
+TiffReader::readCurrentDirectoryScaled(
+    TiffHandle const& tif, TiffInfo const& info, int const factor)
+{
+    if (factor <= 1)
+    {
+        return readCurrentDirectory(tif, info);
+    }
+
+    if (info.mapsToBinaryOrIndexed8() && !TIFFIsTiled(tif.handle()))
+    {
+        // Common case optimization.
+        QVector<QRgb> colors;
+        if (!readColorTable(tif, info, colors))
+        {
+            return QImage();
+        }
+
+        bool all_gray = true;
+        for (int i = 0; i < colors.size(); ++i)
+        {
+            QRgb const color = colors[i];
+            all_gray = all_gray && (qRed(color) == qGreen(color))
+                       && (qGreen(color) == qBlue(color));
+        }
+
+        LineDecimator decimator(
+            info.width, info.height, factor,
+            all_gray ? QImage::Format_Indexed8 : QImage::Format_RGB32
+        );
+
+        TiffBuffer<uint8_t> buf(TIFFScanlineSize(tif.handle()));
+        std::vector<uint8_t> indices(info.width);
+        std::vector<uint32_t> line(info.width);
+        for (int y = 0; y < info.height; ++y)
+        {
+            if (TIFFReadScanline(tif.handle(), buf.data(), y) < 0)
+            {
+                // Better no thumbnail than a garbage one.
                 return QImage();
             }
-            src_line = tmp_buffer.data();
+
+            uint8_t const* src = buf.data();
+            if (info.bits_per_sample != 8)
+            {
+                unpackLine(src, &indices[0], info.width, info.bits_per_sample);
+                src = &indices[0];
+            }
+            for (int x = 0; x < info.width; ++x)
+            {
+                line[x] = colors[src[x]];
+            }
+            decimator.pushLine(&line[0]);
         }
 
-        uint32_t* dst_line = (uint32_t*)image.bits();
-        assert(image.bytesPerLine() % 4 == 0);
-        int const dst_stride = image.bytesPerLine() / 4;
+        return decimator.image();
+    }
+    else if (info.mapsToBinaryOrIndexed8())
+    {
+        // Tiled pages can't be read line by line.
+        QImage const full_image(readCurrentDirectory(tif, info));
+        if (full_image.isNull())
+        {
+            return QImage();
+        }
+
+        QImage const rgb_image(full_image.convertToFormat(QImage::Format_RGB32));
+        LineDecimator decimator(
+            info.width, info.height, factor,
+            full_image.allGray() ? QImage::Format_Indexed8 : QImage::Format_RGB32
+        );
         for (int y = 0; y < info.height; ++y)
         {
-            convertAbgrToArgb(src_line, dst_line, info.width);
-            src_line += info.width;
-            dst_line += dst_stride;
+            decimator.pushLine((uint32_t const*)rgb_image.scanLine(y));
         }
+
+        return decimator.image();
     }
 
-    return image;
+    // General case.
+    char emsg[1024] = "";
+    TIFFRGBAImage img;
+    if (!TIFFRGBAImageOK(tif.handle(), emsg)
+            || !TIFFRGBAImageBegin(&img, tif.handle(), 0, emsg))
+    {
+        return QImage();
+    }
+    img.req_orientation = ORIENTATION_TOPLEFT;
+
+    // Read whole strips or tile rows at once, as libtiff would otherwise
+    // decode the ones that span chunk boundaries twice.
+    uint32_t block_rows = 0;
+    if (TIFFIsTiled(tif.handle()))
+    {
+        TIFFGetField(tif.handle(), TIFFTAG_TILELENGTH, &block_rows);
+    }
+    else
+    {
+        TIFFGetFieldDefaulted(tif.handle(), TIFFTAG_ROWSPERSTRIP, &block_rows);
+    }
+    block_rows = std::max<uint32_t>(1, std::min<uint32_t>(block_rows, info.height));
+    int const chunk_rows = std::min<int>(
+        info.height, block_rows * std::max<uint32_t>(1, 64 / block_rows)
+    );
+
+    LineDecimator decimator(
+        info.width, info.height, factor,
+        info.samples_per_pixel == 3
+        ? QImage::Format_RGB32 : QImage::Format_ARGB32
+    );
+
+    TiffBuffer<uint32_t> chunk(info.width * chunk_rows);
+    std::vector<uint32_t> line(info.width);
+    bool ok = true;
+    for (int y = 0; ok && y < info.height; y += chunk_rows)
+    {
+        int const rows = std::min(chunk_rows, info.height - y);
+        img.row_offset = y;
+        img.col_offset = 0;
+        ok = TIFFRGBAImageGet(&img, chunk.data(), info.width, rows) != 0;
+
+        uint32_t const* src_line = chunk.data();
+        for (int i = 0; ok && i < rows; ++i, src_line += info.width)
+        {
+            convertAbgrToArgb(src_line, &line[0], info.width);
+            decimator.pushLine(&line[0]);
+        }
+    }
+    TIFFRGBAImageEnd(&img);
+
+    return ok ? decimator.image() : QImage();
 }
 
 TiffReader::TiffHeader
@@ -461,26 +1199,12 @@ TiffReader::currentPageMetadata(TiffHandle const& tif)
     return ImageMetadata(QSize(width, height));
 }
 
-QImage
-TiffReader::extractBinaryOrIndexed8Image(
-    TiffHandle const& tif, TiffInfo const& info)
+bool
+TiffReader::readColorTable(
+    TiffHandle const& tif, TiffInfo const& info, QVector<QRgb>& colors)
 {
-    QImage::Format format = QImage::Format_Indexed8;
-    if (info.bits_per_sample == 1)
-    {
-        // Because we specify B option when opening, we can
-        // always use Format_Mono, and not Format_MonoLSB.
-        format = QImage::Format_Mono;
-    }
-
-    QImage image(info.width, info.height, format);
-    if (image.isNull())
-    {
-        throw std::bad_alloc();
-    }
-
     int const num_colors = 1 << info.bits_per_sample;
-    image.setColorCount(num_colors);
+    colors.resize(num_colors);
 
     if (info.photometric == PHOTOMETRIC_PALETTE)
     {
@@ -490,7 +1214,7 @@ TiffReader::extractBinaryOrIndexed8Image(
         TIFFGetField(tif.handle(), TIFFTAG_COLORMAP, &pr, &pg, &pb);
         if (!pr || !pg || !pb)
         {
-            return QImage();
+            return false;
         }
         if (info.host_big_endian != info.file_big_endian)
         {
@@ -505,7 +1229,7 @@ TiffReader::extractBinaryOrIndexed8Image(
             uint32_t const g = (uint32_t)(pg[i] * f + 0.5);
             uint32_t const b = (uint32_t)(pb[i] * f + 0.5);
             uint32_t const a = 0xFF000000;
-            image.setColor(i, a | (r << 16) | (g << 8) | b);
+            colors[i] = a | (r << 16) | (g << 8) | b;
         }
     }
     else if (info.photometric == PHOTOMETRIC_MINISBLACK)
@@ -514,7 +1238,7 @@ TiffReader::extractBinaryOrIndexed8Image(
         for (int i = 0; i < num_colors; ++i)
         {
             int const gray = (int)(i * f + 0.5);
-            image.setColor(i, qRgb(gray, gray, gray));
+            colors[i] = qRgb(gray, gray, gray);
         }
     }
     else if (info.photometric == PHOTOMETRIC_MINISWHITE)
@@ -524,68 +1248,35 @@ TiffReader::extractBinaryOrIndexed8Image(
         for (int i = 0; i < num_colors; ++i, --c)
         {
             int const gray = (int)(c * f + 0.5);
-            image.setColor(i, qRgb(gray, gray, gray));
+            colors[i] = qRgb(gray, gray, gray);
         }
     }
     else
     {
-        return QImage();
-    }
-
-    if (info.bits_per_sample == 1 || info.bits_per_sample == 8)
-    {
-        readLines(tif, image);
-    }
-    else
-    {
-        readAndUnpackLines(tif, info, image);
+        return false;
     }
 
-    return image;
-}
-
-void
-TiffReader::readLines(TiffHandle const& tif, QImage& image)
-{
-    int const height = image.height();
-    for (int y = 0; y < height; ++y)
-    {
-        TIFFReadScanline(tif.handle(), image.scanLine(y), y);
-    }
+    return true;
 }
 
 void
-TiffReader::readAndUnpackLines(
-    TiffHandle const& tif, TiffInfo const& info, QImage& image)
+TiffReader::unpackLine(
+    uint8_t const* src, uint8_t* dst, int const width, int const bits_per_sample)
 {
-    TiffBuffer<uint8_t> buf(TIFFScanlineSize(tif.handle()));
-
-    int const width = image.width();
-    int const height = image.height();
-    int const bits_per_sample = info.bits_per_sample;
     unsigned const dst_mask = (1 << bits_per_sample) - 1;
+    unsigned accum = 0;
+    int bits_in_accum = 0;
 
-    for (int y = 0; y < height; ++y)
+    for (int i = width; i > 0; --i, ++dst)
     {
-        TIFFReadScanline(tif.handle(), buf.data(), y);
-
-        unsigned accum = 0;
-        int bits_in_accum = 0;
-
-        uint8_t const* src = buf.data();
-        uint8_t* dst = (uint8_t*)image.scanLine(y);
-
-        for (int i = width; i > 0; --i, ++dst)
+        while (bits_in_accum < bits_per_sample)
         {
-            while (bits_in_accum < bits_per_sample)
-            {
-                accum <<= 8;
-                accum |= *src;
-                bits_in_accum += 8;
-                ++src;
-            }
-            bits_in_accum -= bits_per_sample;
-            *dst = static_cast<uint8_t>((accum >> bits_in_accum) & dst_mask);
+            accum <<= 8;
+            accum |= *src;
+            bits_in_accum += 8;
+            ++src;
         }
+        bits_in_accum -= bits_per_sample;
+        *dst = static_cast<uint8_t>((accum >> bits_in_accum) & dst_mask);
     }
 }
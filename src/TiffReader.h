@@ -21,9 +21,13 @@
 
 #include "ImageMetadataLoader.h"
 #include "VirtualFunction.h"
+#include <QVector>
+#include <QRgb>
+#include <stdint.h>
 
 class QIODevice;
 class QImage;
+class QSize;
 class ImageMetadata;
 
 class TiffReader
@@ -45,25 +49,88 @@ public:
      * \return The resulting image, or a null image in case of failure.
      */
     static QImage readImage(QIODevice& device, int page_num = 0);
+
+    /**
+     * \brief Reads a reduced resolution version of the image.
+     *
+     * If the page comes with reduced resolution versions of itself (SubIFDs),
+     * the smallest one that is large enough is used.  Otherwise, the page
+     * is decoded line by line and blocks of pixels are averaged on the fly,
+     * without ever holding the full resolution image in memory.
+     *
+     * \param device The device to read from.  This device must be
+     *        opened for reading and must be seekable.
+     * \param page_num A zero-based page number within a multi-page
+     *        TIFF file.
+     * \param hint The size the image is going to be scaled to fit into,
+     *        preserving the aspect ratio.  The result is no smaller than
+     *        necessary for that.
+     * \return The resulting image, or a null image in case of failure.
+     */
+    static QImage readScaledImage(QIODevice& device, int page_num, QSize const& hint);
 private:
     class TiffHeader;
     class TiffHandle;
     struct TiffInfo;
+    struct NativeLayout;
     template<typename T> class TiffBuffer;
 
+    /**
+     * How decoded samples map to pixels of the resulting QImage.
+     */
+    enum SampleConversion
+    {
+        COPY_BITS,       /**< Bilevel -> Format_Mono */
+        COPY_BYTES,      /**< 8-bit gray or palette -> Format_Indexed8 */
+        UNPACK_INDICES,  /**< 2 or 4-bit gray or palette -> Format_Indexed8 */
+        GRAY16,          /**< 16-bit gray -> Format_Indexed8 */
+        RGB8,            /**< 8-bit RGB -> Format_RGB32 */
+        RGB16,           /**< 16-bit RGB -> Format_RGB32 */
+        RGBA8,           /**< 8-bit RGB + unassociated alpha -> Format_ARGB32 */
+        RGBA16           /**< 16-bit RGB + unassociated alpha -> Format_ARGB32 */
+    };
+
+    static QImage readCurrentDirectory(TiffHandle const& tif, TiffInfo const& info);
+
+    static bool getNativeLayout(
+        TiffHandle const& tif, TiffInfo const& info, NativeLayout& layout);
+
+    static QImage readNativeImage(
+        TiffHandle const& tif, TiffInfo const& info, NativeLayout const& layout);
+
+    /**
+     * \return false if a strip or tile couldn't be decoded.
+     */
+    static bool decodeBlocks(
+        TiffHandle const& tif, NativeLayout const& layout,
+        int first_block, int last_block, uint8_t* image_data, int image_stride);
+
+    static void convertSamples(
+        NativeLayout const& layout, uint8_t const* src,
+        uint8_t* dst_line, int x0, int count);
+
+    static QImage readCurrentDirectoryScaled(
+        TiffHandle const& tif, TiffInfo const& info, int factor);
+
+    /**
+     * Switches to the smallest reduced resolution version of the current page
+     * that is no smaller than \p min_size, if the page provides any.
+     * Returns false if neither that nor the page itself could be selected.
+     */
+    static bool selectReducedImage(
+        TiffHandle const& tif, int page_num, QSize const& min_size);
+
     static TiffHeader readHeader(QIODevice& device);
 
     static bool checkHeader(TiffHeader const& header);
 
     static ImageMetadata currentPageMetadata(TiffHandle const& tif);
 
-    static QImage extractBinaryOrIndexed8Image(
-        TiffHandle const& tif, TiffInfo const& info);
-
-    static void readLines(TiffHandle const& tif, QImage& image);
+    static bool readColorTable(
+        TiffHandle const& tif, TiffInfo const& info, QVector<QRgb>& colors);
 
-    static void readAndUnpackLines(
-        TiffHandle const& tif, TiffInfo const& info, QImage& image);
+    static void unpackLine(
+        uint8_t const* src, uint8_t* dst, int width, int bits_per_sample);
 };
 
 #endif
@@ -18,8 +18,12 @@
 
 #include "TiffWriter.h"
 #include "imageproc/Constants.h"
+#include "ParallelFor.h"
 #include <QtGlobal>
 #include <QFile>
+#include <QBuffer>
+#include <QByteArray>
+#include <QThreadPool>
 #include <QIODevice>
 #include <QImage>
 #include <QColor>
@@ -27,6 +31,7 @@
 #include <QSize>
 #include <QDebug>
 #include <vector>
+#include <algorithm>
 #include <tiff.h>
 #include <tiffio.h>
 #include <string.h>
@@ -155,214 +160,408 @@ static void deviceUnmap(thandle_t, tdata_t, toff_t)
     // Not implemented.
 }
 
-bool
-TiffWriter::writeImage(QString const& file_path, QImage const& image)
+namespace
 {
-    if (image.isNull())
-    {
-        return false;
-    }
 
-    QFile file(file_path);
-    if (!file.open(QFile::WriteOnly))
-    {
-        return false;
-    }
+/**
+ * Strips are about this size before compression, unless
+ * Options::rowsPerStrip says otherwise.
+ */
+int const DEFAULT_STRIP_BYTES = 256 * 1024;
 
-    if (!writeImage(file, image))
+QImage::Format toWritableFormat(QImage::Format const format)
+{
+    switch (format)
     {
-        file.remove();
-        return false;
+    case QImage::Format_Mono:
+    case QImage::Format_MonoLSB:
+    case QImage::Format_Indexed8:
+        return format;
+    default:
+        ;
     }
 
-    return true;
+    return QImage(1, 1, format).hasAlphaChannel() ? QImage::Format_ARGB32 : QImage::Format_RGB32;
 }
 
-bool
-TiffWriter::writeImage(QIODevice& device, QImage const& image)
+TIFF* openDevice(QIODevice& device)
 {
-    if (image.isNull())
-    {
-        return false;
-    }
     if (!device.isWritable())
     {
-        return false;
+        return nullptr;
     }
     if (device.isSequential())
     {
         // libtiff needs to be able to seek.
-        return false;
+        return nullptr;
     }
 
-    TiffHandle tif(
-        TIFFClientOpen(
-            // Libtiff seems to be buggy with L or H flags,
-            // so we use B.
-            "file", "wBm", &device, &deviceRead, &deviceWrite,
-            &deviceSeek, &deviceClose, &deviceSize,
-            &deviceMap, &deviceUnmap
-        )
-    );
-    if (!tif.handle())
+    return TIFFClientOpen(
+               // Libtiff seems to be buggy with L or H flags,
+               // so we use B.
+               "file", "wBm", &device, &deviceRead, &deviceWrite,
+               &deviceSeek, &deviceClose, &deviceSize,
+               &deviceMap, &deviceUnmap
+           );
+}
+
+/**
+ * Same as QImage::isGrayscale() for indexed images: only a palette
+ * mapping each index to the same gray level lets us write the indices
+ * as they are.  Any other palette, even if all of its colours are gray,
+ * has to be written as such.
+ */
+bool isGrayscale(QVector<QRgb> const& color_table)
+{
+    for (int i = 0; i < color_table.size(); ++i)
     {
-        return false;
+        if (color_table[i] != qRgb(i, i, i))
+        {
+            return false;
+        }
     }
+    return true;
+}
 
-    TIFFSetField(tif.handle(), TIFFTAG_IMAGEWIDTH, uint32_t(image.width()));
-    TIFFSetField(tif.handle(), TIFFTAG_IMAGELENGTH, uint32_t(image.height()));
-    TIFFSetField(tif.handle(), TIFFTAG_SAMPLEFORMAT, SAMPLEFORMAT_UINT);
-    TIFFSetField(tif.handle(), TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
-    TIFFSetField(tif.handle(), TIFFTAG_XRESOLUTION, TIFF_DEFAULT_DPI);
-    TIFFSetField(tif.handle(), TIFFTAG_YRESOLUTION, TIFF_DEFAULT_DPI);
+} // anonymous namespace
 
-    switch (image.format())
-    {
-    case QImage::Format_Mono:
-    case QImage::Format_MonoLSB:
-    case QImage::Format_Indexed8:
-        return writeBitonalOrIndexed8Image(tif, image);
-    default:
-        ;
-    }
+class TiffWriter::StripWriter::Impl
+{
+public:
+    Impl(QIODevice& device, QSize const& size, QImage::Format format,
+         QVector<QRgb> const& color_table, Options const& options);
 
-    if (image.hasAlphaChannel())
+    bool isOk() const
     {
-        return writeARGB32Image(
-                   tif, image.convertToFormat(QImage::Format_ARGB32)
-               );
+        return !m_failed;
     }
-    else
+
+    bool writeLines(QImage const& lines);
+
+    bool finish();
+private:
+    void setupFields(QVector<QRgb> const& color_table, Options const& options);
+
+    void setFields(TIFF* tif, int height, bool scratch) const;
+
+    void packLine(uint8_t const* src, uint8_t* dst) const;
+
+    void flushStrips();
+
+    QByteArray encodeStrip(uint8_t* data, int rows) const;
+
+    TiffHandle m_tif;
+    QSize m_size;
+    QImage::Format m_format;
+    uint16_t m_compression;
+    uint16_t m_photometric;
+    uint16_t m_bitsPerSample;
+    uint16_t m_samplesPerPixel;
+    bool m_predictor;
+    int m_quality;
+    std::vector<uint16_t> m_colorMap;
+    int m_scanlineBytes;
+    int m_rowsPerStrip;
+    int m_stripsPerBatch;
+    std::vector<uint8_t> m_pendingRows;
+    int m_numPendingRows;
+    int m_rowsWritten;
+    int m_nextStrip;
+    bool m_failed;
+};
+
+TiffWriter::StripWriter::Impl::Impl(
+    QIODevice& device, QSize const& size, QImage::Format const format,
+    QVector<QRgb> const& color_table, Options const& options)
+    :   m_tif(isCodecSupported(options.codec) ? openDevice(device) : nullptr),
+        m_size(size),
+        m_format(toWritableFormat(format)),
+        m_compression(COMPRESSION_NONE),
+        m_photometric(PHOTOMETRIC_RGB),
+        m_bitsPerSample(8),
+        m_samplesPerPixel(3),
+        m_predictor(false),
+        m_quality(options.quality),
+        m_scanlineBytes(0),
+        m_rowsPerStrip(0),
+        m_stripsPerBatch(std::max(1, QThreadPool::globalInstance()->maxThreadCount())),
+        m_numPendingRows(0),
+        m_rowsWritten(0),
+        m_nextStrip(0),
+        m_failed(true)
+{
+    if (size.isEmpty() || !m_tif.handle())
     {
-        return writeRGB32Image(
-                   tif, image.convertToFormat(QImage::Format_RGB32)
-               );
+        return;
     }
+
+    setupFields(color_table, options);
+    setFields(m_tif.handle(), m_size.height(), false);
+
+    m_pendingRows.resize(size_t(m_scanlineBytes) * m_rowsPerStrip * m_stripsPerBatch);
+    m_failed = false;
 }
 
-bool
-TiffWriter::writeBitonalOrIndexed8Image(
-    TiffHandle const& tif, QImage const& image)
+void
+TiffWriter::StripWriter::Impl::setupFields(
+    QVector<QRgb> const& color_table, Options const& options)
 {
-    TIFFSetField(tif.handle(), TIFFTAG_SAMPLESPERPIXEL, uint16_t(1));
+    bool const bitonal = (m_format == QImage::Format_Mono || m_format == QImage::Format_MonoLSB);
+    bool const gray = (m_format == QImage::Format_Indexed8 && isGrayscale(color_table));
 
-    uint16_t compression = COMPRESSION_LZW;
-    uint16_t bits_per_sample = 8;
-    uint16_t photometric = PHOTOMETRIC_PALETTE;
-    if (image.isGrayscale())
+    Codec codec = options.codec;
+    if ((codec == CODEC_G4 && !bitonal) ||
+            (codec == CODEC_JPEG && !gray && m_format != QImage::Format_RGB32))
     {
-        photometric = PHOTOMETRIC_MINISBLACK;
+        codec = CODEC_DEFAULT;
     }
 
-    switch (image.format())
+    switch (codec)
     {
-    case QImage::Format_Mono:
-    case QImage::Format_MonoLSB:
+    case CODEC_DEFAULT:
         // Don't use CCITTFAX4 compression, as Photoshop
         // has problems with it.
-        compression = COMPRESSION_CCITTFAX4;
-        bits_per_sample = 1;
-        if (image.colorCount() < 2)
+        m_compression = bitonal ? COMPRESSION_CCITTFAX4 : COMPRESSION_LZW;
+        break;
+    case CODEC_NONE:
+        m_compression = COMPRESSION_NONE;
+        break;
+    case CODEC_LZW:
+        m_compression = COMPRESSION_LZW;
+        break;
+    case CODEC_DEFLATE:
+        m_compression = COMPRESSION_ADOBE_DEFLATE;
+        break;
+    case CODEC_ZSTD:
+#ifdef COMPRESSION_ZSTD
+        m_compression = COMPRESSION_ZSTD;
+#endif
+        break;
+    case CODEC_JPEG:
+        m_compression = COMPRESSION_JPEG;
+        break;
+    case CODEC_G4:
+        m_compression = COMPRESSION_CCITTFAX4;
+        break;
+    }
+
+    if (bitonal)
+    {
+        m_bitsPerSample = 1;
+        m_samplesPerPixel = 1;
+        m_scanlineBytes = (m_size.width() + 7) / 8;
+        m_photometric = PHOTOMETRIC_PALETTE;
+        if (color_table.size() < 2)
         {
-            photometric = PHOTOMETRIC_MINISWHITE;
+            m_photometric = PHOTOMETRIC_MINISWHITE;
         }
         else
         {
             // Some programs don't understand
             // palettized binary images, so don't
             // use a palette for black and white images.
-            uint32_t const c0 = image.color(0);
-            uint32_t const c1 = image.color(1);
+            uint32_t const c0 = color_table[0];
+            uint32_t const c1 = color_table[1];
             if (c0 == 0xffffffff && c1 == 0xff000000)
             {
-                photometric = PHOTOMETRIC_MINISWHITE;
+                m_photometric = PHOTOMETRIC_MINISWHITE;
             }
             else if (c0 == 0xff000000 && c1 == 0xffffffff)
             {
-                photometric = PHOTOMETRIC_MINISBLACK;
+                m_photometric = PHOTOMETRIC_MINISBLACK;
             }
         }
-        break;
-    default:
-        ;
+    }
+    else if (m_format == QImage::Format_Indexed8)
+    {
+        m_bitsPerSample = 8;
+        m_samplesPerPixel = 1;
+        m_scanlineBytes = m_size.width();
+        m_photometric = gray ? PHOTOMETRIC_MINISBLACK : PHOTOMETRIC_PALETTE;
+    }
+    else
+    {
+        m_bitsPerSample = 8;
+        m_samplesPerPixel = (m_format == QImage::Format_ARGB32) ? 4 : 3;
+        m_scanlineBytes = m_size.width() * m_samplesPerPixel;
+        m_photometric = PHOTOMETRIC_RGB;
     }
 
-    TIFFSetField(tif.handle(), TIFFTAG_COMPRESSION, compression);
-    TIFFSetField(tif.handle(), TIFFTAG_BITSPERSAMPLE, bits_per_sample);
-    TIFFSetField(tif.handle(), TIFFTAG_PHOTOMETRIC, photometric);
+    m_predictor = options.predictor && m_bitsPerSample == 8 &&
+                  m_compression != COMPRESSION_NONE && m_compression != COMPRESSION_JPEG;
 
-    if (photometric == PHOTOMETRIC_PALETTE)
+    if (m_photometric == PHOTOMETRIC_PALETTE)
     {
-        int const num_colors = 1 << bits_per_sample;
-        QVector<QRgb> color_table(image.colorTable());
-        if (color_table.size() > num_colors)
-        {
-            color_table.resize(num_colors);
-        }
-        std::vector<uint16_t> pr(num_colors, 0);
-        std::vector<uint16_t> pg(num_colors, 0);
-        std::vector<uint16_t> pb(num_colors, 0);
-        for (int i = 0; i < color_table.size(); ++i)
+        int const num_colors = 1 << m_bitsPerSample;
+        m_colorMap.resize(num_colors * 3, 0);
+        for (int i = 0; i < std::min<int>(num_colors, color_table.size()); ++i)
         {
             QRgb const rgb = color_table[i];
-            pr[i] = (0xFFFF * qRed(rgb) + 128) / 255;
-            pg[i] = (0xFFFF * qGreen(rgb) + 128) / 255;
-            pb[i] = (0xFFFF * qBlue(rgb) + 128) / 255;
+            m_colorMap[i] = (0xFFFF * qRed(rgb) + 128) / 255;
+            m_colorMap[num_colors + i] = (0xFFFF * qGreen(rgb) + 128) / 255;
+            m_colorMap[num_colors * 2 + i] = (0xFFFF * qBlue(rgb) + 128) / 255;
         }
-        TIFFSetField(tif.handle(), TIFFTAG_COLORMAP, &pr[0], &pg[0], &pb[0]);
     }
 
-    if (image.format() == QImage::Format_Indexed8)
+    m_rowsPerStrip = options.rowsPerStrip;
+    if (m_rowsPerStrip <= 0)
+    {
+        m_rowsPerStrip = std::max(1, DEFAULT_STRIP_BYTES / m_scanlineBytes);
+    }
+    if (m_compression == COMPRESSION_JPEG)
+    {
+        // JPEG needs whole MCUs in a strip.
+        m_rowsPerStrip = (m_rowsPerStrip + 15) / 16 * 16;
+    }
+    m_rowsPerStrip = std::min(m_rowsPerStrip, m_size.height());
+}
+
+void
+TiffWriter::StripWriter::Impl::setFields(TIFF* const tif, int const height, bool const scratch) const
+{
+    TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, uint32_t(m_size.width()));
+    TIFFSetField(tif, TIFFTAG_IMAGELENGTH, uint32_t(height));
+    TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, uint32_t(m_rowsPerStrip));
+    TIFFSetField(tif, TIFFTAG_SAMPLEFORMAT, SAMPLEFORMAT_UINT);
+    TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+    TIFFSetField(tif, TIFFTAG_XRESOLUTION, TIFF_DEFAULT_DPI);
+    TIFFSetField(tif, TIFFTAG_YRESOLUTION, TIFF_DEFAULT_DPI);
+    TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, m_samplesPerPixel);
+    TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, m_bitsPerSample);
+    TIFFSetField(tif, TIFFTAG_COMPRESSION, m_compression);
+
+    if (scratch && m_photometric == PHOTOMETRIC_PALETTE)
     {
-        return write8bitLines(tif, image);
+        // Scratch files are only used for encoding strips, which doesn't
+        // depend on the palette, so we spare ourselves setting one.
+        TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
     }
     else
     {
-        if (image.format() == QImage::Format_MonoLSB)
+        TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, m_photometric);
+    }
+
+    if (!scratch && m_photometric == PHOTOMETRIC_PALETTE)
+    {
+        size_t const num_colors = m_colorMap.size() / 3;
+        TIFFSetField(
+            tif, TIFFTAG_COLORMAP, &m_colorMap[0],
+            &m_colorMap[num_colors], &m_colorMap[num_colors * 2]
+        );
+    }
+
+    if (m_predictor)
+    {
+        TIFFSetField(tif, TIFFTAG_PREDICTOR, PREDICTOR_HORIZONTAL);
+    }
+
+    switch (m_compression)
+    {
+    case COMPRESSION_JPEG:
+        // Every strip carries its own tables, so that strips
+        // encoded separately may be put together as they are.
+        TIFFSetField(tif, TIFFTAG_JPEGTABLESMODE, 0);
+        if (m_quality > 0)
         {
-            return writeBinaryLinesReversed(tif, image);
+            TIFFSetField(tif, TIFFTAG_JPEGQUALITY, std::min(m_quality, 100));
         }
-        else
+        break;
+    case COMPRESSION_ADOBE_DEFLATE:
+        if (m_quality > 0)
+        {
+            TIFFSetField(tif, TIFFTAG_ZIPQUALITY, std::min(m_quality, 9));
+        }
+        break;
+#ifdef COMPRESSION_ZSTD
+    case COMPRESSION_ZSTD:
+        if (m_quality > 0)
         {
-            return writeBinaryLinesAsIs(tif, image);
+            TIFFSetField(tif, TIFFTAG_ZSTD_LEVEL, std::min(m_quality, 22));
         }
+        break;
+#endif
+    default:
+        ;
     }
 }
 
-bool
-TiffWriter::writeRGB32Image(
-    TiffHandle const& tif, QImage const& image)
+void
+TiffWriter::StripWriter::Impl::packLine(uint8_t const* src, uint8_t* dst) const
 {
-    assert(image.format() == QImage::Format_RGB32);
+    int const width = m_size.width();
 
-    TIFFSetField(tif.handle(), TIFFTAG_SAMPLESPERPIXEL, uint16_t(3));
-    TIFFSetField(tif.handle(), TIFFTAG_COMPRESSION, COMPRESSION_LZW);
-    TIFFSetField(tif.handle(), TIFFTAG_BITSPERSAMPLE, uint16_t(8));
-    TIFFSetField(tif.handle(), TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
-
-    int const width = image.width();
-    int const height = image.height();
-
-    std::vector<uint8_t> tmp_line(width * 3);
-
-    // Libtiff expects "RR GG BB" sequences regardless of CPU byte order.
-
-    for (int y = 0; y < height; ++y)
+    switch (m_format)
     {
-        uint32_t const* p_src = (uint32_t const*)image.scanLine(y);
-        uint8_t* p_dst = &tmp_line[0];
+    case QImage::Format_MonoLSB:
+        for (int i = 0; i < m_scanlineBytes; ++i)
+        {
+            dst[i] = m_reverseBitsLUT[src[i]];
+        }
+        break;
+    case QImage::Format_Mono:
+    case QImage::Format_Indexed8:
+        memcpy(dst, src, m_scanlineBytes);
+        break;
+    case QImage::Format_ARGB32:
+        // Libtiff expects "RR GG BB AA" sequences regardless of CPU byte order.
         for (int x = 0; x < width; ++x)
         {
-            uint32_t const ARGB = *p_src;
-            p_dst[0] = static_cast<uint8_t>(ARGB >> 16);
-            p_dst[1] = static_cast<uint8_t>(ARGB >> 8);
-            p_dst[2] = static_cast<uint8_t>(ARGB);
-            ++p_src;
-            p_dst += 3;
+            uint32_t const ARGB = reinterpret_cast<uint32_t const*>(src)[x];
+            dst[0] = static_cast<uint8_t>(ARGB >> 16);
+            dst[1] = static_cast<uint8_t>(ARGB >> 8);
+            dst[2] = static_cast<uint8_t>(ARGB);
+            dst[3] = static_cast<uint8_t>(ARGB >> 24);
+            dst += 4;
         }
-        if (TIFFWriteScanline(tif.handle(), &tmp_line[0], y) == -1)
+        break;
+    default:
+        // Libtiff expects "RR GG BB" sequences regardless of CPU byte order.
+        for (int x = 0; x < width; ++x)
         {
-            return false;
+            uint32_t const ARGB = reinterpret_cast<uint32_t const*>(src)[x];
+            dst[0] = static_cast<uint8_t>(ARGB >> 16);
+            dst[1] = static_cast<uint8_t>(ARGB >> 8);
+            dst[2] = static_cast<uint8_t>(ARGB);
+            dst += 3;
+        }
+        break;
+    }
+}
+
+bool
+TiffWriter::StripWriter::Impl::writeLines(QImage const& lines)
+{
+    if (m_failed)
+    {
+        return false;
+    }
+    if (lines.width() != m_size.width() || m_rowsWritten + lines.height() > m_size.height())
+    {
+        m_failed = true;
+        return false;
+    }
+
+    QImage const converted(
+        lines.format() == m_format ? lines : lines.convertToFormat(m_format)
+    );
+    int const rows_per_batch = m_rowsPerStrip * m_stripsPerBatch;
+
+    for (int y = 0; y < converted.height(); ++y)
+    {
+        packLine(
+            converted.constScanLine(y),
+            &m_pendingRows[size_t(m_numPendingRows) * m_scanlineBytes]
+        );
+        ++m_numPendingRows;
+        ++m_rowsWritten;
+
+        if (m_numPendingRows == rows_per_batch)
+        {
+            flushStrips();
+            if (m_failed)
+            {
+                return false;
+            }
         }
     }
 
@@ -370,118 +569,235 @@ TiffWriter::writeRGB32Image(
 }
 
 bool
-TiffWriter::writeARGB32Image(
-    TiffHandle const& tif, QImage const& image)
+TiffWriter::StripWriter::Impl::finish()
 {
-    assert(image.format() == QImage::Format_ARGB32);
-
-    TIFFSetField(tif.handle(), TIFFTAG_SAMPLESPERPIXEL, uint16_t(4));
-    TIFFSetField(tif.handle(), TIFFTAG_COMPRESSION, COMPRESSION_LZW);
-    TIFFSetField(tif.handle(), TIFFTAG_BITSPERSAMPLE, uint16_t(8));
-    TIFFSetField(tif.handle(), TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
+    if (m_failed || m_rowsWritten != m_size.height())
+    {
+        m_failed = true;
+        return false;
+    }
 
-    int const width = image.width();
-    int const height = image.height();
+    flushStrips();
+    if (!m_failed && !TIFFFlush(m_tif.handle()))
+    {
+        m_failed = true;
+    }
 
-    std::vector<uint8_t> tmp_line(width * 4);
+    return !m_failed;
+}
 
-    // Libtiff expects "RR GG BB AA" sequences regardless of CPU byte order.
+void
+TiffWriter::StripWriter::Impl::flushStrips()
+{
+    int const num_strips = (m_numPendingRows + m_rowsPerStrip - 1) / m_rowsPerStrip;
+    size_t const strip_bytes = size_t(m_scanlineBytes) * m_rowsPerStrip;
+    auto strip_rows = [this](int const strip_idx)
+    {
+        return std::min(m_rowsPerStrip, m_numPendingRows - strip_idx * m_rowsPerStrip);
+    };
 
-    for (int y = 0; y < height; ++y)
+    if (num_strips == 1)
     {
-        uint32_t const* p_src = (uint32_t const*)image.scanLine(y);
-        uint8_t* p_dst = &tmp_line[0];
-        for (int x = 0; x < width; ++x)
+        // Nothing to parallelize.
+        tsize_t const size = tsize_t(strip_rows(0)) * m_scanlineBytes;
+        if (TIFFWriteEncodedStrip(m_tif.handle(), m_nextStrip, &m_pendingRows[0], size) == -1)
         {
-            uint32_t const ARGB = *p_src;
-            p_dst[0] = static_cast<uint8_t>(ARGB >> 16);
-            p_dst[1] = static_cast<uint8_t>(ARGB >> 8);
-            p_dst[2] = static_cast<uint8_t>(ARGB);
-            p_dst[3] = static_cast<uint8_t>(ARGB >> 24);
-            ++p_src;
-            p_dst += 4;
+            m_failed = true;
         }
-        if (TIFFWriteScanline(tif.handle(), &tmp_line[0], y) == -1)
+    }
+    else if (num_strips > 1)
+    {
+        // Each strip is encoded by libtiff into a separate in-memory file,
+        // from where we take the compressed data as it is.
+        std::vector<QByteArray> encoded(num_strips);
+        parallelFor(0, num_strips, [&](int const begin, int const end)
         {
-            return false;
+            for (int i = begin; i < end; ++i)
+            {
+                encoded[i] = encodeStrip(&m_pendingRows[i * strip_bytes], strip_rows(i));
+            }
+        });
+
+        for (int i = 0; i < num_strips && !m_failed; ++i)
+        {
+            if (encoded[i].isEmpty() ||
+                    TIFFWriteRawStrip(
+                        m_tif.handle(), m_nextStrip + i,
+                        encoded[i].data(), encoded[i].size()) == -1)
+            {
+                m_failed = true;
+            }
         }
     }
 
-    return true;
+    m_nextStrip += num_strips;
+    m_numPendingRows = 0;
 }
 
-bool
-TiffWriter::write8bitLines(
-    TiffHandle const& tif, QImage const& image)
+QByteArray
+TiffWriter::StripWriter::Impl::encodeStrip(uint8_t* const data, int const rows) const
 {
-    int const width = image.width();
-    int const height = image.height();
+    QBuffer buffer;
+    buffer.open(QIODevice::ReadWrite);
 
-    // TIFFWriteScanline() can actually modify the data you pass it,
-    // so we have to use a temporary buffer even when no coversion
-    // is required.
-    std::vector<uint8_t> tmp_line(width, 0);
+    TiffHandle tif(
+        TIFFClientOpen(
+            "strip", "wBm", &buffer, &deviceRead, &deviceWrite,
+            &deviceSeek, &deviceClose, &deviceSize,
+            &deviceMap, &deviceUnmap
+        )
+    );
+    if (!tif.handle())
+    {
+        return QByteArray();
+    }
 
-    for (int y = 0; y < height; ++y)
+    setFields(tif.handle(), rows, true);
+
+    if (TIFFWriteEncodedStrip(tif.handle(), 0, data, tsize_t(rows) * m_scanlineBytes) == -1)
     {
-        uint8_t const* src_line = image.scanLine(y);
-        memcpy(&tmp_line[0], src_line, tmp_line.size());
-        if (TIFFWriteScanline(tif.handle(), &tmp_line[0], y) == -1)
-        {
-            return false;
-        }
+        return QByteArray();
     }
 
-    return true;
+    // The strip is already written at this point. The directory
+    // that gets written when the file is closed is of no interest.
+    toff_t* offsets = nullptr;
+    toff_t* byte_counts = nullptr;
+    if (!TIFFGetField(tif.handle(), TIFFTAG_STRIPOFFSETS, &offsets) ||
+            !TIFFGetField(tif.handle(), TIFFTAG_STRIPBYTECOUNTS, &byte_counts))
+    {
+        return QByteArray();
+    }
+
+    return buffer.data().mid(int(offsets[0]), int(byte_counts[0]));
+}
+
+
+TiffWriter::StripWriter::StripWriter(
+    QIODevice& device, QSize const& size, QImage::Format const format,
+    QVector<QRgb> const& color_table, Options const& options)
+    :   m_ptrImpl(new Impl(device, size, format, color_table, options))
+{
+}
+
+TiffWriter::StripWriter::~StripWriter()
+{
+}
+
+bool
+TiffWriter::StripWriter::isOk() const
+{
+    return m_ptrImpl->isOk();
+}
+
+bool
+TiffWriter::StripWriter::writeLines(QImage const& lines)
+{
+    return m_ptrImpl->writeLines(lines);
 }
 
 bool
-TiffWriter::writeBinaryLinesAsIs(
-    TiffHandle const& tif, QImage const& image)
+TiffWriter::StripWriter::finish()
 {
-    int const width = image.width();
-    int const height = image.height();
+    return m_ptrImpl->finish();
+}
 
-    // TIFFWriteScanline() can actually modify the data you pass it,
-    // so we have to use a temporary buffer even when no coversion
-    // is required.
-    int const bpl = (width + 7) / 8;
-    std::vector<uint8_t> tmp_line(bpl, 0);
 
-    for (int y = 0; y < height; ++y)
+bool
+TiffWriter::writeImage(
+    QString const& file_path, QImage const& image, Options const& options)
+{
+    if (image.isNull())
     {
-        uint8_t const* src_line = image.scanLine(y);
-        memcpy(&tmp_line[0], src_line, bpl);
-        if (TIFFWriteScanline(tif.handle(), &tmp_line[0], y) == -1)
-        {
-            return false;
-        }
+        return false;
+    }
+
+    QFile file(file_path);
+    if (!file.open(QFile::WriteOnly))
+    {
+        return false;
+    }
+
+    if (!writeImage(file, image, options))
+    {
+        file.remove();
+        return false;
     }
 
     return true;
 }
 
 bool
-TiffWriter::writeBinaryLinesReversed(
-    TiffHandle const& tif, QImage const& image)
+TiffWriter::writeImage(
+    QIODevice& device, QImage const& image, Options const& options)
 {
-    int const width = image.width();
-    int const height = image.height();
+    if (image.isNull())
+    {
+        return false;
+    }
 
-    int const bpl = (width + 7) / 8;
-    std::vector<uint8_t> tmp_line(bpl, 0);
+    StripWriter writer(device, image.size(), image.format(), image.colorTable(), options);
+    return writer.writeLines(image) && writer.finish();
+}
 
-    for (int y = 0; y < height; ++y)
+bool
+TiffWriter::isCodecSupported(Codec const codec)
+{
+    switch (codec)
     {
-        uint8_t const* src_line = image.scanLine(y);
-        for (int i = 0; i < bpl; ++i)
-        {
-            tmp_line[i] = m_reverseBitsLUT[src_line[i]];
-        }
-        if (TIFFWriteScanline(tif.handle(), &tmp_line[0], y) == -1)
-        {
-            return false;
-        }
+    case CODEC_DEFAULT:
+    case CODEC_NONE:
+        return true;
+    case CODEC_LZW:
+        return TIFFIsCODECConfigured(COMPRESSION_LZW);
+    case CODEC_DEFLATE:
+        return TIFFIsCODECConfigured(COMPRESSION_ADOBE_DEFLATE);
+    case CODEC_ZSTD:
+#ifdef COMPRESSION_ZSTD
+        return TIFFIsCODECConfigured(COMPRESSION_ZSTD);
+#else
+        return false;
+#endif
+    case CODEC_JPEG:
+        return TIFFIsCODECConfigured(COMPRESSION_JPEG);
+    case CODEC_G4:
+        return TIFFIsCODECConfigured(COMPRESSION_CCITTFAX4);
+    }
+
+    return false;
+}
+
+bool
+TiffWriter::parseCodec(QString const& name, Codec& codec)
+{
+    QString const lower(name.toLower());
+    if (lower == "none")
+    {
+        codec = CODEC_NONE;
+    }
+    else if (lower == "lzw")
+    {
+        codec = CODEC_LZW;
+    }
+    else if (lower == "deflate")
+    {
+        codec = CODEC_DEFLATE;
+    }
+    else if (lower == "zstd")
+    {
+        codec = CODEC_ZSTD;
+    }
+    else if (lower == "jpeg")
+    {
+        codec = CODEC_JPEG;
+    }
+    else if (lower == "g4")
+    {
+        codec = CODEC_G4;
+    }
+    else
+    {
+        return false;
     }
 
     return true;
@@ -19,25 +19,121 @@
 #ifndef TIFFWRITER_H_
 #define TIFFWRITER_H_
 
+#include "NonCopyable.h"
+#include <QImage>
+#include <QVector>
+#include <QSize>
+#include <QtGlobal>
+#include <memory>
 #include <stdint.h>
 #include <stddef.h>
 
 class QIODevice;
 class QString;
-class QImage;
 class Dpm;
 
 class TiffWriter
 {
 public:
+    enum Codec
+    {
+        /** CCITT Group 4 for bitonal images, LZW for the rest. */
+        CODEC_DEFAULT,
+        CODEC_NONE,
+        CODEC_LZW,
+        CODEC_DEFLATE,
+        CODEC_ZSTD,
+        /** Only for grayscale and RGB images. Others use CODEC_DEFAULT. */
+        CODEC_JPEG,
+        /** Only for bitonal images. Others use CODEC_DEFAULT. */
+        CODEC_G4
+    };
+
+    struct Options
+    {
+        Codec codec;
+
+        /**
+         * Whether to apply horizontal differencing before compressing.
+         * Only affects LZW, Deflate and ZSTD on 8-bit samples.
+         */
+        bool predictor;
+
+        /**
+         * The number of rows in a strip. Zero stands for strips of about
+         * 256 KB before compression. Strips are compressed in parallel.
+         */
+        int rowsPerStrip;
+
+        /**
+         * JPEG quality (1 - 100) or Deflate (1 - 9) and ZSTD (1 - 22)
+         * compression level. Zero stands for the codec's default.
+         */
+        int quality;
+
+        Options() : codec(CODEC_DEFAULT), predictor(false), rowsPerStrip(0), quality(0) {}
+    };
+
+    /**
+     * \brief Writes an image incrementally, a number of lines at a time.
+     *
+     * Lines are accumulated into strips, which are compressed in batches,
+     * in parallel, and then written in order. Once all lines are written,
+     * finish() has to be called to complete the file.
+     */
+    class StripWriter
+    {
+        DECLARE_NON_COPYABLE(StripWriter)
+    public:
+        /**
+         * \param device The device to write to. It must be opened for writing,
+         *        be seekable and outlive the writer, which closes it when destroyed.
+         * \param size The dimensions of the whole image.
+         * \param format The format of the image. Lines passed to writeLines()
+         *        are converted to it if necessary.
+         * \param color_table The color table for indexed and bitonal images.
+         * \param options Compression options.
+         */
+        StripWriter(QIODevice& device, QSize const& size, QImage::Format format,
+                    QVector<QRgb> const& color_table, Options const& options = Options());
+
+        ~StripWriter();
+
+        /**
+         * \brief Returns false if something went wrong, in which case
+         *        the output is to be discarded.
+         */
+        bool isOk() const;
+
+        /**
+         * \brief Appends lines to the image.
+         *
+         * The width of \p lines has to match the width of the image.
+         */
+        bool writeLines(QImage const& lines);
+
+        /**
+         * \brief Writes the remaining strips and the TIFF directory.
+         *
+         * Fails if fewer lines than the image height were written.
+         */
+        bool finish();
+    private:
+        class Impl;
+
+        std::unique_ptr<Impl> m_ptrImpl;
+    };
+
     /**
      * \brief Writes a QImage in TIFF format to a file.
      *
      * \param file_path The full path to the file.
      * \param image The image to write.  Writing a null image will fail.
+     * \param options Compression options.
      * \return True on success, false on failure.
      */
-    static bool writeImage(QString const& file_path, QImage const& image);
+    static bool writeImage(QString const& file_path, QImage const& image,
+                           Options const& options = Options());
 
     /**
      * \brief Writes a QImage in TIFF format to an IO device.
@@ -45,29 +141,25 @@ public:
      * \param device The device to write to.  This device must be
      *        opened for writing and seekable.
      * \param image The image to write.  Writing a null image will fail.
+     * \param options Compression options.
      * \return True on success, false on failure.
      */
-    static bool writeImage(QIODevice& device, QImage const& image);
-private:
-    class TiffHandle;
-
-    static bool writeBitonalOrIndexed8Image(
-        TiffHandle const& tif, QImage const& image);
-
-    static bool writeRGB32Image(
-        TiffHandle const& tif, QImage const& image);
+    static bool writeImage(QIODevice& device, QImage const& image,
+                           Options const& options = Options());
 
-    static bool writeARGB32Image(
-        TiffHandle const& tif, QImage const& image);
-
-    static bool write8bitLines(
-        TiffHandle const& tif, QImage const& image);
-
-    static bool writeBinaryLinesAsIs(
-        TiffHandle const& tif, QImage const& image);
+    /**
+     * \brief Checks whether libtiff was built with support for a codec.
+     */
+    static bool isCodecSupported(Codec codec);
 
-    static bool writeBinaryLinesReversed(
-        TiffHandle const& tif, QImage const& image);
+    /**
+     * \brief Parses "none", "lzw", "deflate", "zstd", "jpeg" or "g4".
+     *
+     * \return True on success, false if \p name is not a codec name.
+     */
+    static bool parseCodec(QString const& name, Codec& codec);
+private:
+    class TiffHandle;
 
     static uint8_t const m_reverseBitsLUT[256];
 };
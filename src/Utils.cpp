@@ -21,7 +21,15 @@
 #include <QByteArray>
 #include <QFile>
 #include <QDir>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QStringList>
+#include <QSettings>
+#include <QThread>
 #include <QtGlobal>
+#include <algorithm>
+#include <vector>
+#include <map>
 
 #ifdef Q_OS_WIN
 #include <windows.h>
@@ -45,6 +53,67 @@ Utils::overwritingRename(QString const& from, QString const& to)
 #endif
 }
 
+void
+Utils::trimCacheDir(QString const& dir, qint64 const max_bytes)
+{
+    struct Entry
+    {
+        qint64 bytes;
+        QDateTime lastUsed;
+        QStringList files;
+    };
+
+    std::map<QString, Entry> entries;
+    qint64 total_bytes = 0;
+
+    QFileInfoList const files(QDir(dir).entryInfoList(QDir::Files));
+    for (QFileInfo const& file : files)
+    {
+        // This also groups temporary files with the entries they belong to.
+        QString const key(file.fileName().section(QChar('.'), 0, 0));
+        Entry& entry = entries[key];
+        entry.bytes += file.size();
+        entry.files.push_back(file.absoluteFilePath());
+        if (entry.lastUsed.isNull() || entry.lastUsed < file.lastModified())
+        {
+            entry.lastUsed = file.lastModified();
+        }
+        total_bytes += file.size();
+    }
+
+    if (total_bytes <= max_bytes)
+    {
+        return;
+    }
+
+    std::vector<Entry const*> lru;
+    for (auto const& kv : entries)
+    {
+        lru.push_back(&kv.second);
+    }
+    std::sort(
+        lru.begin(), lru.end(),
+        [](Entry const* lhs, Entry const* rhs)
+    {
+        return lhs->lastUsed < rhs->lastUsed;
+    }
+    );
+
+    qint64 const target_bytes = max_bytes - max_bytes / 10;
+    for (Entry const* entry : lru)
+    {
+        if (total_bytes <= target_bytes)
+        {
+            break;
+        }
+        for (QString const& file_path : entry->files)
+        {
+            QFile::remove(file_path);
+        }
+        total_bytes -= entry->bytes;
+    }
+}
+
 QString
 Utils::richTextForLink(
     QString const& label, QString const& target)
@@ -82,8 +151,25 @@ Utils::createThumbnailCache(QString const& output_dir,
     QSize const max_pixmap_size(200, 200);
     QString const thumbs_cache_path(outputDirToThumbDir(output_dir));
 
+    int max_threads = 1;
+    if (sizeof(void*) > 4)
+    {
+        // Same address space considerations as for batch processing.
+        max_threads = QThread::idealThreadCount();
+    }
+
+    // Loading is partly I/O bound, and each thread may hold a full size
+    // image in memory, so we don't go beyond a few threads by default.
+    QSettings settings;
+    int num_threads = settings.value(
+        "settings/thumbnail_loader_threads", std::min(max_threads, 4)
+    ).toInt();
+    num_threads = qBound(1, num_threads, max_threads);
+
     return IntrusivePtr<ThumbnailPixmapCache>(
-               new ThumbnailPixmapCache(thumbs_cache_path, accel_ops, max_pixmap_size, 40, 5)
+               new ThumbnailPixmapCache(
+                   thumbs_cache_path, accel_ops, max_pixmap_size, 40, 5, num_threads
+               )
            );
 }
 
@@ -51,6 +51,17 @@ public:
      */
     static bool overwritingRename(QString const& from, QString const& to);
 
+    /**
+     * \brief Evicts least recently used entries from a cache directory.
+     *
+     * An entry is the group of files sharing the part of the name before
+     * the first dot, and it's as recent as the most recently modified
+     * of them. If the directory takes more than \p max_bytes, entries
+     * are removed until it takes no more than 90% of that, so that
+     * a cache growing one entry at a time isn't trimmed on every insertion.
+     */
+    static void trimCacheDir(QString const& dir, qint64 max_bytes);
+
     /**
      * \brief A high precision, locale independent number to string conversion.
      *
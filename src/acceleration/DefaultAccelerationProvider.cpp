@@ -19,6 +19,8 @@
 #include "DefaultAccelerationProvider.h"
 #include "NonAcceleratedOperations.h"
 #include "AccelerationPlugin.h"
+#include "TracingOperations.h"
+#include "Trace.h"
 #include <QCoreApplication>
 #include <QPluginLoader>
 #include <QSettings>
@@ -38,61 +40,75 @@ DefaultAccelerationProvider::processUpdatedConfiguration()
 {
     QSettings settings;
 
+    // Plugins we stop using will be kept in memory till unload() is called
+    // on QPluginLoader. That happens automatically by static destruction
+    // process, though we do that explicitly in main().
+    m_pPlugin = nullptr;
+
 #ifdef ENABLE_OPENCL
     if (settings.value("settings/enable_opencl", false).toBool())
     {
-        QPluginLoader loader("opencl_plugin");
-        if (loader.load())
-        {
-            m_pPlugin = qobject_cast<AccelerationPlugin*>(loader.instance());
-        }
-        else
-        {
-            qDebug() << "OpenCL plugin failed to load: " << loader.errorString();
-        }
+        m_pPlugin = loadPlugin("opencl_plugin");
     }
-    else
+#endif
+
+    if (!m_pPlugin && settings.value("settings/enable_cpu_acceleration", false).toBool())
     {
-        m_pPlugin = nullptr;
-        // It will be kept in memory till unload() is called on QPluginLoader.
-        // That happens automatically by static destruction process, though we
-        // do that explicitly in main().
+        m_pPlugin = loadPlugin("cpu_plugin");
     }
-#endif
 }
 
 void
 DefaultAccelerationProvider::releaseResources()
 {
-#ifdef ENABLE_OPENCL
     // We could have just called unload() on QPluginLoader, but
     // unfortunately Qt's reference counting on plugins prevents
     // that from working.
-    AccelerationPlugin* opencl_plugin = m_pPlugin;
-    if (!opencl_plugin)
-    {
-        QPluginLoader loader("opencl_plugin");
-        if (loader.isLoaded())
-        {
-            opencl_plugin = qobject_cast<AccelerationPlugin*>(loader.instance());
-        }
-    }
-    if (opencl_plugin)
-    {
-        opencl_plugin->releaseResources();
-    }
+#ifdef ENABLE_OPENCL
+    releasePluginResources("opencl_plugin");
 #endif
+    releasePluginResources("cpu_plugin");
 }
 
 std::shared_ptr<AcceleratableOperations>
 DefaultAccelerationProvider::getOperations()
 {
+    std::shared_ptr<AcceleratableOperations> ops = m_ptrNonAcceleratedOperations;
     if (m_pPlugin)
     {
-        return m_pPlugin->getOperations(m_ptrNonAcceleratedOperations);
+        ops = m_pPlugin->getOperations(m_ptrNonAcceleratedOperations);
     }
-    else
+
+    if (Trace::isEnabled())
+    {
+        ops = std::make_shared<TracingOperations>(ops);
+    }
+
+    return ops;
+}
+
+AccelerationPlugin*
+DefaultAccelerationProvider::loadPlugin(char const* name)
+{
+    QPluginLoader loader(name);
+    if (!loader.load())
+    {
+        qDebug() << name << "failed to load: " << loader.errorString();
+        return nullptr;
+    }
+
+    return qobject_cast<AccelerationPlugin*>(loader.instance());
+}
+
+void
+DefaultAccelerationProvider::releasePluginResources(char const* name)
+{
+    QPluginLoader loader(name);
+    if (loader.isLoaded())
     {
-        return m_ptrNonAcceleratedOperations;
+        if (AccelerationPlugin* plugin = qobject_cast<AccelerationPlugin*>(loader.instance()))
+        {
+            plugin->releaseResources();
+        }
     }
 }
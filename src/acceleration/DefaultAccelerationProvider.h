@@ -27,7 +27,7 @@
 class AccelerationPlugin;
 
 /**
- * @brief Provides access to accelerated (think OpenCL) operations.
+ * @brief Provides access to accelerated (think OpenCL or multithreaded) operations.
  *
  * @note This class is not thread-safe.
  */
@@ -44,7 +44,8 @@ public:
      * @brief Re-checks configuration and loads plug-ins if necessary.
      *
      * This method should be called after changing the value of "settings/enable_opencl"
-     * key in QSettings. This method is called from this class' constructor.
+     * or "settings/enable_cpu_acceleration" keys in QSettings. OpenCL takes precedence
+     * when both are enabled. This method is called from this class' constructor.
      */
     void processUpdatedConfiguration();
 
@@ -62,9 +63,15 @@ public:
 
     /**
      * @brief Delegates to a plugin, if one is loaded or returns a non-accelerated version.
+     *
+     * When tracing is enabled, the operations are wrapped into TracingOperations.
      */
     std::shared_ptr<AcceleratableOperations> getOperations();
 private:
+    static AccelerationPlugin* loadPlugin(char const* name);
+
+    static void releasePluginResources(char const* name);
+
     AccelerationPlugin* m_pPlugin;
     std::shared_ptr<AcceleratableOperations> m_ptrNonAcceleratedOperations;
 };
@@ -0,0 +1,105 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "TracingOperations.h"
+#include "Trace.h"
+
+using namespace imageproc;
+
+TracingOperations::TracingOperations(
+    std::shared_ptr<AcceleratableOperations> const& delegate)
+    :	m_ptrDelegate(delegate)
+{
+}
+
+Grid<float>
+TracingOperations::gaussBlur(
+    Grid<float> const& src, float h_sigma, float v_sigma) const
+{
+    TraceSpan const span("accel", "gaussBlur", QSize(src.width(), src.height()));
+    return m_ptrDelegate->gaussBlur(src, h_sigma, v_sigma);
+}
+
+Grid<float>
+TracingOperations::anisotropicGaussBlur(
+    Grid<float> const& src, float dir_x, float dir_y,
+    float dir_sigma, float ortho_dir_sigma) const
+{
+    TraceSpan const span("accel", "anisotropicGaussBlur", QSize(src.width(), src.height()));
+    return m_ptrDelegate->anisotropicGaussBlur(src, dir_x, dir_y, dir_sigma, ortho_dir_sigma);
+}
+
+std::pair<Grid<float>, Grid<uint8_t>>
+                                   TracingOperations::textFilterBank(
+                                       Grid<float> const& src, std::vector<Vec2f> const& directions,
+                                       std::vector<Vec2f> const& sigmas, float shoulder_length) const
+{
+    TraceSpan const span("accel", "textFilterBank", QSize(src.width(), src.height()));
+    return m_ptrDelegate->textFilterBank(src, directions, sigmas, shoulder_length);
+}
+
+QImage
+TracingOperations::dewarp(
+    QImage const& src, QSize const& dst_size,
+    dewarping::CylindricalSurfaceDewarper const& distortion_model,
+    QRectF const& model_domain, QColor const& background_color,
+    float min_density, float max_density,
+    QSizeF const& min_mapping_area) const
+{
+    TraceSpan const span("accel", "dewarp", dst_size);
+    return m_ptrDelegate->dewarp(
+               src, dst_size, distortion_model, model_domain, background_color,
+               min_density, max_density, min_mapping_area
+           );
+}
+
+QImage
+TracingOperations::affineTransform(
+    QImage const& src, QTransform const& xform,
+    QRect const& dst_rect, imageproc::OutsidePixels const& outside_pixels,
+    QSizeF const& min_mapping_area) const
+{
+    TraceSpan const span("accel", "affineTransform", dst_rect.size());
+    return m_ptrDelegate->affineTransform(src, xform, dst_rect, outside_pixels, min_mapping_area);
+}
+
+GrayImage
+TracingOperations::renderPolynomialSurface(
+    PolynomialSurface const& surface, int width, int height)
+{
+    TraceSpan const span("accel", "renderPolynomialSurface", QSize(width, height));
+    return m_ptrDelegate->renderPolynomialSurface(surface, width, height);
+}
+
+GrayImage
+TracingOperations::savGolFilter(
+    imageproc::GrayImage const& src, QSize const& window_size,
+    int hor_degree, int vert_degree)
+{
+    TraceSpan const span("accel", "savGolFilter", src.size());
+    return m_ptrDelegate->savGolFilter(src, window_size, hor_degree, vert_degree);
+}
+
+void
+TracingOperations::hitMissReplaceInPlace(
+    imageproc::BinaryImage& img, imageproc::BWColor const img_surroundings,
+    std::vector<Grid<char>> const& patterns)
+{
+    TraceSpan const span("accel", "hitMissReplaceInPlace", img.size());
+    m_ptrDelegate->hitMissReplaceInPlace(img, img_surroundings, patterns);
+}
@@ -0,0 +1,300 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "CpuAcceleratedOperations.h"
+#include "ParallelFor.h"
+#include "imageproc/GaussBlur.h"
+#include "imageproc/AffineTransform.h"
+#include "imageproc/SavGolFilter.h"
+#include "dewarping/RasterDewarper.h"
+#include <QThreadPool>
+#include <QPoint>
+#include <QPointF>
+#include <QRect>
+#include <algorithm>
+#include <limits>
+#include <cstddef>
+
+using namespace imageproc;
+
+namespace cpu
+{
+
+namespace
+{
+
+/**
+ * Evaluates a single text filter on row y of its blurred image and folds
+ * the response into the running maximum. A shoulder pixel falling outside
+ * of the image is substituted by the origin pixel, as NonAcceleratedOperations
+ * does. Instead of testing every pixel, the row is split into spans where
+ * both shoulders are either inside or outside, which leaves a branch-free
+ * inner loop the compiler is able to vectorize.
+ */
+void combineTextFilterRow(
+    Grid<float> const& blurred, int const y, QPoint const shoulder,
+    uint8_t const dir_idx, float* const accum_line, uint8_t* const direction_line)
+{
+    int const width = blurred.width();
+    int const height = blurred.height();
+    int const stride = blurred.stride();
+    int const sx = shoulder.x();
+    int const sy = shoulder.y();
+
+    float const* const origin_line = blurred.data() + y * stride;
+    bool const row1_inside = (y + sy >= 0 && y + sy < height);
+    bool const row2_inside = (y - sy >= 0 && y - sy < height);
+
+    // pt1 = (x + sx, y + sy) is inside for x in [x1_begin, x1_end).
+    int const x1_begin = std::max(0, -sx);
+    int const x1_end = std::min(width, width - sx);
+    // pt2 = (x - sx, y - sy) is inside for x in [x2_begin, x2_end).
+    int const x2_begin = std::max(0, sx);
+    int const x2_end = std::min(width, width + sx);
+
+    int breaks[] = { 0, x1_begin, x1_end, x2_begin, x2_end, width };
+    for (int& b : breaks)
+    {
+        b = std::min(std::max(b, 0), width);
+    }
+    std::sort(std::begin(breaks), std::end(breaks));
+
+    for (int i = 1; i < int(sizeof(breaks) / sizeof(breaks[0])); ++i)
+    {
+        int const span_begin = breaks[i - 1];
+        int const span_end = breaks[i];
+        if (span_begin == span_end)
+        {
+            continue;
+        }
+
+        bool const pt1_inside = (row1_inside && span_begin >= x1_begin && span_end <= x1_end);
+        bool const pt2_inside = (row2_inside && span_begin >= x2_begin && span_end <= x2_end);
+
+        // Either a shoulder line shifted so that index x maps to the shoulder
+        // pixel, or the origin line itself if the shoulder is outside.
+        float const* const line1 = pt1_inside ? origin_line + sy * stride + sx : origin_line;
+        float const* const line2 = pt2_inside ? origin_line - sy * stride - sx : origin_line;
+
+        for (int x = span_begin; x < span_end; ++x)
+        {
+            float const origin_px = origin_line[x];
+            float const response = 0.5f * (line1[x] + line2[x]) - origin_px;
+            bool const better = response > accum_line[x];
+            accum_line[x] = better ? response : accum_line[x];
+            direction_line[x] = better ? dir_idx : direction_line[x];
+        }
+    }
+}
+
+} // anonymous namespace
+
+CpuAcceleratedOperations::CpuAcceleratedOperations(
+    std::shared_ptr<AcceleratableOperations> const& fallback)
+    :	m_ptrFallback(fallback)
+{
+}
+
+CpuAcceleratedOperations::~CpuAcceleratedOperations()
+{
+}
+
+Grid<float>
+CpuAcceleratedOperations::gaussBlur(
+    Grid<float> const& src, float h_sigma, float v_sigma) const
+{
+    if (src.width() == 0 || src.height() == 0 || h_sigma < 0.0f || v_sigma < 0.0f ||
+            (h_sigma < 1e-2f && v_sigma < 1e-2f))
+    {
+        // Let the fallback handle the degenerate cases.
+        return m_ptrFallback->gaussBlur(src, h_sigma, v_sigma);
+    }
+
+    QSize const size(src.width(), src.height());
+    Grid<float> intermediate_image(src.width(), src.height(), /*padding=*/0);
+    Grid<float> dst(src.width(), src.height());
+
+    // Columns are independent in the vertical pass and rows are independent
+    // in the horizontal one, so splitting them into bands doesn't change the result.
+    parallelFor(0, size.width(), [&](int const x_begin, int const x_end)
+    {
+        gauss_blur_impl::verticalPass(
+            size, v_sigma, x_begin, x_end, src.data(), src.stride(),
+            [](float val) { return val; }, intermediate_image
+        );
+    });
+
+    parallelFor(0, size.height(), [&](int const y_begin, int const y_end)
+    {
+        gauss_blur_impl::horizontalPass(
+            size, h_sigma, y_begin, y_end, intermediate_image, dst.data(), dst.stride(),
+            [](float& dst, float src) { dst = src; }
+        );
+    });
+
+    return dst;
+}
+
+Grid<float>
+CpuAcceleratedOperations::anisotropicGaussBlur(
+    Grid<float> const& src, float dir_x, float dir_y,
+    float dir_sigma, float ortho_dir_sigma) const
+{
+    // The skewed pass writes to positions shifted relative to the ones it
+    // reads from and so has to visit them in order.
+    return m_ptrFallback->anisotropicGaussBlur(src, dir_x, dir_y, dir_sigma, ortho_dir_sigma);
+}
+
+std::pair<Grid<float>, Grid<uint8_t>>
+                                   CpuAcceleratedOperations::textFilterBank(
+                                       Grid<float> const& src, std::vector<Vec2f> const& directions,
+                                       std::vector<Vec2f> const& sigmas, float shoulder_length) const
+{
+    Grid<float> accum(src.width(), src.height());
+    accum.initInterior(-std::numeric_limits<float>::max());
+
+    Grid<uint8_t> direction_map(src.width(), src.height());
+    direction_map.initInterior(0);
+
+    struct Filter
+    {
+        Vec2f sigma;
+        size_t dirIdx;
+        QPoint shoulder;
+    };
+
+    // Same order as in NonAcceleratedOperations. As ties are resolved
+    // in favour of the earlier filter, combining has to follow this order.
+    std::vector<Filter> filters;
+    for (Vec2f const& s : sigmas)
+    {
+        for (size_t dir_idx = 0; dir_idx < directions.size(); ++dir_idx)
+        {
+            Vec2f const& dir = directions[dir_idx];
+            QPointF shoulder_f(dir[1], -dir[0]);
+            shoulder_f *= s[1] * shoulder_length;
+            filters.push_back(Filter{s, dir_idx, shoulder_f.toPoint()});
+        }
+    }
+
+    // Blurring a single filter is sequential, so we blur as many filters
+    // in parallel as there are threads, then combine them a band of rows
+    // at a time. Having more filters in flight would just cost memory.
+    size_t const batch_size = std::min<size_t>(
+        std::max(1, QThreadPool::globalInstance()->maxThreadCount()), filters.size()
+    );
+
+    // One blurred image per filter in a batch, reused across batches.
+    std::vector<Grid<float>> blurred(batch_size);
+    for (Grid<float>& grid : blurred)
+    {
+        grid = Grid<float>(src.width(), src.height(), /*padding=*/0);
+    }
+
+    for (size_t batch_begin = 0; batch_begin < filters.size(); batch_begin += batch_size)
+    {
+        size_t const batch_end = std::min(batch_begin + batch_size, filters.size());
+
+        parallelFor(int(batch_begin), int(batch_end), [&](int const begin, int const end)
+        {
+            for (int i = begin; i < end; ++i)
+            {
+                Filter const& filter = filters[i];
+                Vec2f const& dir = directions[filter.dirIdx];
+                Grid<float>& dst = blurred[i - batch_begin];
+                anisotropicGaussBlurGeneric(
+                    QSize(src.width(), src.height()), dir[0], dir[1], filter.sigma[0], filter.sigma[1],
+                    src.data(), src.stride(), [](float val) { return val; },
+                    dst.data(), dst.stride(), [](float& dst, float src) { dst = src; }
+                );
+            }
+        });
+
+        parallelFor(0, src.height(), [&](int const y_begin, int const y_end)
+        {
+            for (int y = y_begin; y < y_end; ++y)
+            {
+                float* accum_line = accum.data() + y * accum.stride();
+                uint8_t* direction_line = direction_map.data() + y * direction_map.stride();
+
+                for (size_t i = batch_begin; i < batch_end; ++i)
+                {
+                    Filter const& filter = filters[i];
+                    combineTextFilterRow(
+                        blurred[i - batch_begin], y, filter.shoulder,
+                        uint8_t(filter.dirIdx), accum_line, direction_line
+                    );
+                }
+            }
+        });
+    }
+
+    return std::make_pair(std::move(accum), std::move(direction_map));
+}
+
+QImage
+CpuAcceleratedOperations::dewarp(
+    QImage const& src, QSize const& dst_size,
+    dewarping::CylindricalSurfaceDewarper const& distortion_model,
+    QRectF const& model_domain, QColor const& background_color,
+    float min_density, float max_density,
+    QSizeF const& min_mapping_area) const
+{
+    return dewarping::RasterDewarper::dewarp(
+               src, dst_size, distortion_model, model_domain, background_color,
+               min_density, max_density, min_mapping_area, &parallelFor
+           );
+}
+
+QImage
+CpuAcceleratedOperations::affineTransform(
+    QImage const& src, QTransform const& xform,
+    QRect const& dst_rect, imageproc::OutsidePixels const& outside_pixels,
+    QSizeF const& min_mapping_area) const
+{
+    return imageproc::affineTransform(
+               src, xform, dst_rect, outside_pixels, min_mapping_area, &parallelFor
+           );
+}
+
+GrayImage
+CpuAcceleratedOperations::renderPolynomialSurface(
+    PolynomialSurface const& surface, int width, int height)
+{
+    return surface.render(QSize(width, height), &parallelFor);
+}
+
+GrayImage
+CpuAcceleratedOperations::savGolFilter(
+    imageproc::GrayImage const& src, QSize const& window_size,
+    int hor_degree, int vert_degree)
+{
+    return imageproc::savGolFilter(src, window_size, hor_degree, vert_degree, &parallelFor);
+}
+
+void
+CpuAcceleratedOperations::hitMissReplaceInPlace(
+    imageproc::BinaryImage& img, imageproc::BWColor const img_surroundings,
+    std::vector<Grid<char>> const& patterns)
+{
+    // Each pattern is applied to the output of the previous one, and the
+    // replacements of a single pattern affect the matches that follow.
+    m_ptrFallback->hitMissReplaceInPlace(img, img_surroundings, patterns);
+}
+
+} // namespace cpu
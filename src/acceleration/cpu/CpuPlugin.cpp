@@ -0,0 +1,71 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "CpuPlugin.h"
+#include "CpuAcceleratedOperations.h"
+
+namespace cpu
+{
+
+static char const DEVICE_NAME[] = "CPU";
+
+CpuPlugin::CpuPlugin()
+{
+}
+
+CpuPlugin::~CpuPlugin()
+{
+}
+
+std::vector<std::string>
+CpuPlugin::devices() const
+{
+    return std::vector<std::string>(1, DEVICE_NAME);
+}
+
+void
+CpuPlugin::selectDevice(std::string const&)
+{
+    // There is only one device.
+}
+
+std::string
+CpuPlugin::selectedDevice() const
+{
+    return DEVICE_NAME;
+}
+
+std::shared_ptr<AcceleratableOperations>
+CpuPlugin::getOperations(
+    std::shared_ptr<AcceleratableOperations> const& fallback)
+{
+    if (!m_ptrCachedOps)
+    {
+        m_ptrCachedOps = std::make_shared<CpuAcceleratedOperations>(fallback);
+    }
+
+    return m_ptrCachedOps;
+}
+
+void
+CpuPlugin::releaseResources()
+{
+    m_ptrCachedOps.reset();
+}
+
+} // namespace cpu
@@ -0,0 +1,295 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "CpuAcceleratedOperations.h"
+#include "NonAcceleratedOperations.h"
+#include "Grid.h"
+#include "VecNT.h"
+#include "PerformanceTimer.h"
+#include "imageproc/GrayImage.h"
+#include "imageproc/AffineTransform.h"
+#include "imageproc/PolynomialSurface.h"
+#include "dewarping/CylindricalSurfaceDewarper.h"
+#include <QImage>
+#include <QSize>
+#include <QSizeF>
+#include <QRect>
+#include <QRectF>
+#include <QPointF>
+#include <QColor>
+#include <QTransform>
+#include <Qt>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int_distribution.hpp>
+#include <boost/random/uniform_real_distribution.hpp>
+#include <boost/test/unit_test.hpp>
+#include <memory>
+#include <vector>
+#include <cmath>
+#include <cstdint>
+
+using namespace imageproc;
+using namespace dewarping;
+
+namespace cpu
+{
+
+namespace tests
+{
+
+class OperationsFixture
+{
+public:
+    OperationsFixture()
+        : m_ptrReference(std::make_shared<NonAcceleratedOperations>())
+        , m_operations(m_ptrReference)
+    {
+    }
+protected:
+    std::shared_ptr<NonAcceleratedOperations> m_ptrReference;
+    CpuAcceleratedOperations m_operations;
+};
+
+static Grid<float> randomGrid(int width, int height)
+{
+    boost::random::mt19937 rng;
+    boost::random::uniform_real_distribution<float> dist(0.f, 1.f);
+
+    Grid<float> grid(width, height);
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            grid(x, y) = dist(rng);
+        }
+    }
+
+    return grid;
+}
+
+static QImage randomImage(int width, int height, QImage::Format format)
+{
+    boost::random::mt19937 rng;
+    boost::random::uniform_int_distribution<> dist(0, 255);
+
+    QImage image(width, height, format);
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            image.setPixel(x, y, qRgba(dist(rng), dist(rng), dist(rng), dist(rng)));
+        }
+    }
+
+    return image;
+}
+
+static GrayImage randomGrayImage(int width, int height)
+{
+    boost::random::mt19937 rng;
+    boost::random::uniform_int_distribution<> dist(0, 255);
+
+    GrayImage image(QSize(width, height));
+    uint8_t* line = image.data();
+    for (int y = 0; y < height; ++y, line += image.stride())
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            line[x] = static_cast<uint8_t>(dist(rng));
+        }
+    }
+
+    return image;
+}
+
+template<typename T>
+static bool identical(Grid<T> const& lhs, Grid<T> const& rhs)
+{
+    if (lhs.width() != rhs.width() || lhs.height() != rhs.height())
+    {
+        return false;
+    }
+
+    for (int y = 0; y < lhs.height(); ++y)
+    {
+        for (int x = 0; x < lhs.width(); ++x)
+        {
+            if (lhs(x, y) != rhs(x, y))
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+BOOST_FIXTURE_TEST_SUITE(CpuAcceleratedOperationsTestSuite, OperationsFixture);
+
+#define LOG_PERFORMANCE 0
+
+BOOST_AUTO_TEST_CASE(test_gauss_blur)
+{
+    Grid<float> const input(randomGrid(1001, 999));
+
+#if LOG_PERFORMANCE
+    PerformanceTimer ptimer1;
+#endif
+    Grid<float> const control(m_ptrReference->gaussBlur(input, 15.f, 7.f));
+#if LOG_PERFORMANCE
+    ptimer1.print("[gaussBlur] Non-accelerated version:");
+    PerformanceTimer ptimer2;
+#endif
+    Grid<float> const output(m_operations.gaussBlur(input, 15.f, 7.f));
+#if LOG_PERFORMANCE
+    ptimer2.print("[gaussBlur] Multithreaded version:");
+#endif
+
+    BOOST_CHECK(identical(output, control));
+}
+
+BOOST_AUTO_TEST_CASE(test_text_filter_bank)
+{
+    Grid<float> const input(randomGrid(301, 199));
+
+    std::vector<Vec2f> directions;
+    for (int i = 0; i < 7; ++i)
+    {
+        float const angle = i * 0.3f;
+        directions.push_back(Vec2f(std::cos(angle), std::sin(angle)));
+    }
+    std::vector<Vec2f> const sigmas {Vec2f(8.f, 2.f), Vec2f(12.f, 3.f)};
+
+#if LOG_PERFORMANCE
+    PerformanceTimer ptimer1;
+#endif
+    auto const control = m_ptrReference->textFilterBank(input, directions, sigmas, 2.f);
+#if LOG_PERFORMANCE
+    ptimer1.print("[textFilterBank] Non-accelerated version:");
+    PerformanceTimer ptimer2;
+#endif
+    auto const output = m_operations.textFilterBank(input, directions, sigmas, 2.f);
+#if LOG_PERFORMANCE
+    ptimer2.print("[textFilterBank] Multithreaded version:");
+#endif
+
+    BOOST_CHECK(identical(output.first, control.first));
+    BOOST_CHECK(identical(output.second, control.second));
+}
+
+BOOST_AUTO_TEST_CASE(test_dewarp)
+{
+    QSize const output_size(900, 1100);
+    QRectF const model_domain(QPointF(0, 0), output_size);
+    CylindricalSurfaceDewarper const distortion_model(
+        std::vector<QPointF> {QPointF(200, -50), QPointF(1050, 200)},
+        std::vector<QPointF> {QPointF(-50, 800), QPointF(800, 1050)},
+        1.5,
+        1.5,
+        1.5
+    );
+
+    for (QImage::Format format : {QImage::Format_ARGB32, QImage::Format_RGB32})
+    {
+        QImage const input(randomImage(1000, 1000, format));
+
+        QImage const control = m_ptrReference->dewarp(
+                                   input, output_size, distortion_model, model_domain,
+                                   Qt::transparent, 1e1f, 1e5f, QSizeF(0.7, 0.7)
+                               );
+        QImage const output = m_operations.dewarp(
+                                  input, output_size, distortion_model, model_domain,
+                                  Qt::transparent, 1e1f, 1e5f, QSizeF(0.7, 0.7)
+                              );
+
+        BOOST_CHECK(output == control);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_affine_transform)
+{
+    QImage const input(randomImage(1000, 800, QImage::Format_RGB32));
+
+    QTransform xform;
+    xform.rotate(17);
+    xform.scale(0.7, 0.8);
+    QRect const dst_rect(xform.mapRect(QRectF(input.rect())).toAlignedRect().adjusted(-5, -5, 5, 5));
+    OutsidePixels const outside_pixels(OutsidePixels::assumeColor(Qt::white));
+
+    QImage const control = m_ptrReference->affineTransform(
+                               input, xform, dst_rect, outside_pixels, QSizeF(0.9, 0.9)
+                           );
+    QImage const output = m_operations.affineTransform(
+                              input, xform, dst_rect, outside_pixels, QSizeF(0.9, 0.9)
+                          );
+
+    BOOST_CHECK(output == control);
+}
+
+BOOST_AUTO_TEST_CASE(test_affine_transform_shared_gray)
+{
+    // An all-gray Indexed8 image goes through the GrayImage path, where
+    // the GrayImage shares its data with the source image.  Keeping
+    // another copy alive makes sure nothing tries to detach it while
+    // the worker threads are reading it.
+    QImage const input(randomGrayImage(1000, 800).toQImage());
+    QImage const shared_copy(input);
+    BOOST_REQUIRE(input.format() == QImage::Format_Indexed8);
+
+    QTransform xform;
+    xform.rotate(-11);
+    xform.scale(0.6, 0.6);
+    QRect const dst_rect(xform.mapRect(QRectF(input.rect())).toAlignedRect());
+    OutsidePixels const outside_pixels(OutsidePixels::assumeColor(Qt::white));
+
+    QImage const control = m_ptrReference->affineTransform(
+                               input, xform, dst_rect, outside_pixels, QSizeF(0.9, 0.9)
+                           );
+    QImage const output = m_operations.affineTransform(
+                              input, xform, dst_rect, outside_pixels, QSizeF(0.9, 0.9)
+                          );
+
+    BOOST_CHECK(output == control);
+    BOOST_CHECK(input.constBits() == shared_copy.constBits());
+}
+
+BOOST_AUTO_TEST_CASE(test_render_polynomial_surface)
+{
+    PolynomialSurface const surface(3, 4, randomGrayImage(60, 50));
+
+    GrayImage const control(m_ptrReference->renderPolynomialSurface(surface, 1003, 997));
+    GrayImage const output(m_operations.renderPolynomialSurface(surface, 1003, 997));
+
+    BOOST_CHECK(output == control);
+}
+
+BOOST_AUTO_TEST_CASE(test_sav_gol_filter)
+{
+    GrayImage const input(randomGrayImage(1003, 997));
+
+    GrayImage const control(m_ptrReference->savGolFilter(input, QSize(7, 5), 4, 3));
+    GrayImage const output(m_operations.savGolFilter(input, QSize(7, 5), 4, 3));
+
+    BOOST_CHECK(output == control);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace tests
+
+} // namespace cpu
@@ -0,0 +1,116 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Benchmark.h"
+#include "Inputs.h"
+#include "NoCancelStatus.h"
+#include "CachingFactory.h"
+#include "acceleration/NonAcceleratedOperations.h"
+#include "stages/deskew/SkewEstimator.h"
+#include "imageproc/AffineImageTransform.h"
+#include "imageproc/GrayImage.h"
+#include "imageproc/GrayImagePyramid.h"
+#include "imageproc/SkewFinder.h"
+#include <sstream>
+#include <stdexcept>
+#include <memory>
+#include <math.h>
+
+using namespace imageproc;
+
+namespace benchmarks
+{
+
+namespace
+{
+
+/** Skews the page is rotated by before estimating it, in degrees. */
+double const TEST_ANGLES[] = { -4.6, -1.3, 0.0, 0.7, 3.2 };
+
+/** The angle the timed runs are done at. */
+double const MEASURED_ANGLE = 0.7;
+
+Skew estimateSkew(double const angle, deskew::SkewEstimator::Mode const mode)
+{
+    GrayImage const& input = Inputs::grayPage();
+
+    // A fresh pyramid, so that building its levels is part of the work.
+    GrayImagePyramid const pyramid(
+        input.size(), CachingFactory<GrayImage>([&input]()
+    {
+        return input;
+    })
+    );
+
+    AffineImageTransform xform(input.size());
+    xform.rotate(angle);
+
+    std::shared_ptr<AcceleratableOperations> const accel_ops(
+        std::make_shared<NonAcceleratedOperations>()
+    );
+    NoCancelStatus const status;
+    return deskew::SkewEstimator::estimateSkew(status, accel_ops, pyramid, xform, mode);
+}
+
+/**
+ * Throws if the two modes disagree on any of the test angles by more
+ * than SkewFinder's accuracy allows for.
+ */
+void checkSameAngles()
+{
+    double const tolerance = 2.0 * SkewFinder::DEFAULT_ACCURACY + 1e-6;
+
+    for (double const angle : TEST_ANGLES)
+    {
+        Skew const full(estimateSkew(angle, deskew::SkewEstimator::FULL_RESOLUTION));
+        Skew const c2f(estimateSkew(angle, deskew::SkewEstimator::COARSE_TO_FINE));
+        if (fabs(full.angle() - c2f.angle()) > tolerance ||
+                (full.confidence() >= Skew::GOOD_CONFIDENCE) !=
+                (c2f.confidence() >= Skew::GOOD_CONFIDENCE))
+        {
+            std::ostringstream msg;
+            msg << "at " << angle << " degrees, full resolution found " << full.angle()
+                << " (confidence " << full.confidence() << "), coarse to fine found "
+                << c2f.angle() << " (confidence " << c2f.confidence() << ")";
+            throw std::runtime_error(msg.str());
+        }
+    }
+}
+
+void measureSkew(State& state, deskew::SkewEstimator::Mode const mode)
+{
+    state.measure(Inputs::pixels(Inputs::grayPage().size()), [mode]()
+    {
+        estimateSkew(MEASURED_ANGLE, mode);
+    });
+}
+
+} // anonymous namespace
+
+BENCHMARK_CASE(bench_skew_full_resolution, "deskew/SkewEstimator/full_resolution")
+{
+    measureSkew(state, deskew::SkewEstimator::FULL_RESOLUTION);
+}
+
+BENCHMARK_CASE(bench_skew_coarse_to_fine, "deskew/SkewEstimator/coarse_to_fine")
+{
+    checkSameAngles();
+    measureSkew(state, deskew::SkewEstimator::COARSE_TO_FINE);
+}
+
+} // namespace benchmarks
@@ -0,0 +1,83 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Benchmark.h"
+#include "Inputs.h"
+#include "ParallelFor.h"
+#include "dewarping/RasterDewarper.h"
+#include "dewarping/CylindricalSurfaceDewarper.h"
+#include <QImage>
+#include <QSize>
+#include <QSizeF>
+#include <QRectF>
+#include <QPointF>
+#include <QColor>
+#include <vector>
+
+using namespace dewarping;
+
+namespace benchmarks
+{
+
+namespace
+{
+
+/**
+ * A page bent like one side of an open book, dewarped into
+ * an image of the same size.
+ */
+void measureDewarp(State& state, RangeExecutor const& executor)
+{
+    QImage const& input = Inputs::colorPage();
+    double const w = input.width();
+    double const h = input.height();
+
+    std::vector<QPointF> const top_curve = {
+        QPointF(0.05 * w, 0.08 * h), QPointF(0.5 * w, 0.03 * h), QPointF(0.95 * w, 0.07 * h)
+    };
+    std::vector<QPointF> const bottom_curve = {
+        QPointF(0.05 * w, 0.92 * h), QPointF(0.5 * w, 0.97 * h), QPointF(0.95 * w, 0.93 * h)
+    };
+    CylindricalSurfaceDewarper const distortion_model(top_curve, bottom_curve, 2.0, 0.5, 2.0);
+
+    QSize const dst_size(input.size());
+    QRectF const model_domain(QPointF(0, 0), dst_size);
+    state.measure(Inputs::pixels(dst_size), [&]()
+    {
+        QImage const output(
+            RasterDewarper::dewarp(
+                input, dst_size, distortion_model, model_domain, Qt::white,
+                1e1f, 1e5f, QSizeF(0.9, 0.9), executor
+            )
+        );
+    });
+}
+
+} // anonymous namespace
+
+BENCHMARK_CASE(bench_dewarp, "dewarping/RasterDewarper::dewarp")
+{
+    measureDewarp(state, &serialFor);
+}
+
+BENCHMARK_CASE(bench_dewarp_parallel, "dewarping/RasterDewarper::dewarp/parallel")
+{
+    measureDewarp(state, &parallelFor);
+}
+
+} // namespace benchmarks
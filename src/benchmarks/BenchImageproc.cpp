@@ -0,0 +1,301 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Benchmark.h"
+#include "Inputs.h"
+#include "imageproc/Binarize.h"
+#include "imageproc/BinaryImage.h"
+#include "imageproc/GrayImage.h"
+#include "imageproc/GaussBlur.h"
+#include "imageproc/ConnectivityMap.h"
+#include "imageproc/Connectivity.h"
+#include "imageproc/SEDM.h"
+#include "imageproc/SeedFill.h"
+#include "imageproc/Morphology.h"
+#include "imageproc/AffineTransform.h"
+#include "imageproc/Scale.h"
+#include "ParallelFor.h"
+#include <QImage>
+#include <QTransform>
+#include <QSize>
+#include <QRect>
+#include <QRectF>
+#include <QSizeF>
+#include <QColor>
+
+using namespace imageproc;
+
+namespace benchmarks
+{
+
+namespace
+{
+
+template<typename Binarizer>
+void measureBinarization(State& state, Binarizer binarize)
+{
+    GrayImage const& input = Inputs::grayPage();
+    state.measure(Inputs::pixels(input.size()), [&]()
+    {
+        BinaryImage const output(binarize(input));
+    });
+}
+
+} // anonymous namespace
+
+BENCHMARK_CASE(bench_binarize_otsu, "imageproc/binarizeOtsu")
+{
+    QImage const& input = Inputs::colorPage();
+    state.measure(Inputs::pixels(input.size()), [&]()
+    {
+        BinaryImage const output(binarizeOtsu(input));
+    });
+}
+
+BENCHMARK_CASE(bench_binarize_mokji, "imageproc/binarizeMokji")
+{
+    QImage const input(Inputs::grayPage().toQImage());
+    state.measure(Inputs::pixels(input.size()), [&]()
+    {
+        BinaryImage const output(binarizeMokji(input));
+    });
+}
+
+BENCHMARK_CASE(bench_binarize_niblack, "imageproc/binarizeNiblack")
+{
+    measureBinarization(state, [](GrayImage const& src)
+    {
+        return binarizeNiblack(src);
+    });
+}
+
+BENCHMARK_CASE(bench_binarize_gatos, "imageproc/binarizeGatos")
+{
+    measureBinarization(state, [](GrayImage const& src)
+    {
+        return binarizeGatos(src);
+    });
+}
+
+BENCHMARK_CASE(bench_binarize_sauvola, "imageproc/binarizeSauvola")
+{
+    measureBinarization(state, [](GrayImage const& src)
+    {
+        return binarizeSauvola(src);
+    });
+}
+
+BENCHMARK_CASE(bench_binarize_wolf, "imageproc/binarizeWolf")
+{
+    measureBinarization(state, [](GrayImage const& src)
+    {
+        return binarizeWolf(src);
+    });
+}
+
+BENCHMARK_CASE(bench_binarize_bradley, "imageproc/binarizeBradley")
+{
+    measureBinarization(state, [](GrayImage const& src)
+    {
+        return binarizeBradley(src);
+    });
+}
+
+BENCHMARK_CASE(bench_binarize_edgediv, "imageproc/binarizeEdgeDiv")
+{
+    measureBinarization(state, [](GrayImage const& src)
+    {
+        return binarizeEdgeDiv(src);
+    });
+}
+
+BENCHMARK_CASE(bench_binarize_robust, "imageproc/binarizeRobust")
+{
+    measureBinarization(state, [](GrayImage const& src)
+    {
+        return binarizeRobust(src);
+    });
+}
+
+BENCHMARK_CASE(bench_binarize_grain, "imageproc/binarizeGrain")
+{
+    measureBinarization(state, [](GrayImage const& src)
+    {
+        return binarizeGrain(src);
+    });
+}
+
+BENCHMARK_CASE(bench_binarize_mscale, "imageproc/binarizeMScale")
+{
+    measureBinarization(state, [](GrayImage const& src)
+    {
+        return binarizeMScale(src);
+    });
+}
+
+BENCHMARK_CASE(bench_gauss_blur, "imageproc/gaussBlur")
+{
+    GrayImage const& input = Inputs::grayPage();
+    state.measure(Inputs::pixels(input.size()), [&]()
+    {
+        GrayImage const output(gaussBlur(input, 10.0f, 10.0f));
+    });
+}
+
+BENCHMARK_CASE(bench_connectivity_map, "imageproc/ConnectivityMap")
+{
+    BinaryImage const& input = Inputs::binaryPage();
+    state.measure(Inputs::pixels(input.size()), [&]()
+    {
+        ConnectivityMap const cmap(input, CONN8);
+    });
+}
+
+BENCHMARK_CASE(bench_sedm, "imageproc/SEDM")
+{
+    BinaryImage const& input = Inputs::binaryPage();
+    state.measure(Inputs::pixels(input.size()), [&]()
+    {
+        SEDM const sedm(input, SEDM::DIST_TO_BLACK, SEDM::DIST_TO_ALL_BORDERS);
+    });
+}
+
+BENCHMARK_CASE(bench_seed_fill, "imageproc/seedFill")
+{
+    BinaryImage const& mask = Inputs::binaryPage();
+    BinaryImage const seed(erodeBrick(mask, Brick(QSize(5, 5))));
+    state.measure(Inputs::pixels(mask.size()), [&]()
+    {
+        BinaryImage const output(seedFill(seed, mask, CONN8));
+    });
+}
+
+BENCHMARK_CASE(bench_seed_fill_gray, "imageproc/seedFillGrayInPlace")
+{
+    GrayImage const& mask = Inputs::grayPage();
+
+    // Darkness spreading inwards from the borders, as far as the mask allows.
+    GrayImage border_seed(mask.size());
+    border_seed.fill(0xff);
+    QRect const inner(mask.rect().adjusted(1, 1, -1, -1));
+    for (int y = 0; y < mask.height(); ++y)
+    {
+        for (int x = 0; x < mask.width(); ++x)
+        {
+            if (!inner.contains(x, y))
+            {
+                border_seed.data()[y * border_seed.stride() + x] = 0;
+            }
+        }
+    }
+
+    state.measure(Inputs::pixels(mask.size()), [&]()
+    {
+        GrayImage seed(border_seed);
+        seedFillGrayInPlace(seed, mask, CONN8);
+    });
+}
+
+BENCHMARK_CASE(bench_dilate_brick, "imageproc/dilateBrick")
+{
+    BinaryImage const& input = Inputs::binaryPage();
+    state.measure(Inputs::pixels(input.size()), [&]()
+    {
+        BinaryImage const output(dilateBrick(input, Brick(QSize(15, 15))));
+    });
+}
+
+BENCHMARK_CASE(bench_erode_brick, "imageproc/erodeBrick")
+{
+    BinaryImage const& input = Inputs::binaryPage();
+    state.measure(Inputs::pixels(input.size()), [&]()
+    {
+        BinaryImage const output(erodeBrick(input, Brick(QSize(15, 15))));
+    });
+}
+
+BENCHMARK_CASE(bench_open_brick, "imageproc/openBrick")
+{
+    BinaryImage const& input = Inputs::binaryPage();
+    state.measure(Inputs::pixels(input.size()), [&]()
+    {
+        BinaryImage const output(openBrick(input, QSize(9, 9)));
+    });
+}
+
+BENCHMARK_CASE(bench_close_brick, "imageproc/closeBrick")
+{
+    BinaryImage const& input = Inputs::binaryPage();
+    state.measure(Inputs::pixels(input.size()), [&]()
+    {
+        BinaryImage const output(closeBrick(input, QSize(9, 9)));
+    });
+}
+
+BENCHMARK_CASE(bench_dilate_gray, "imageproc/dilateGray")
+{
+    GrayImage const& input = Inputs::grayPage();
+    state.measure(Inputs::pixels(input.size()), [&]()
+    {
+        GrayImage const output(dilateGray(input, Brick(QSize(15, 15))));
+    });
+}
+
+namespace
+{
+
+void measureAffineTransform(State& state, RangeExecutor const& executor)
+{
+    QImage const& input = Inputs::colorPage();
+    QTransform xform;
+    xform.rotate(3.5);
+    QRect const dst_rect(xform.mapRect(QRectF(input.rect())).toRect());
+    state.measure(Inputs::pixels(dst_rect.size()), [&]()
+    {
+        QImage const output(
+            affineTransform(
+                input, xform, dst_rect,
+                OutsidePixels::assumeColor(Qt::white), QSizeF(0.9, 0.9), executor
+            )
+        );
+    });
+}
+
+} // anonymous namespace
+
+BENCHMARK_CASE(bench_affine_transform, "imageproc/affineTransform")
+{
+    measureAffineTransform(state, &serialFor);
+}
+
+BENCHMARK_CASE(bench_affine_transform_parallel, "imageproc/affineTransform/parallel")
+{
+    measureAffineTransform(state, &parallelFor);
+}
+
+BENCHMARK_CASE(bench_scale_to_gray, "imageproc/scaleToGray")
+{
+    GrayImage const& input = Inputs::grayPage();
+    QSize const dst_size(input.size() * 0.3);
+    state.measure(Inputs::pixels(input.size()), [&]()
+    {
+        GrayImage const output(scaleToGray(input, dst_size));
+    });
+}
+
+} // namespace benchmarks
@@ -0,0 +1,111 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Benchmark.h"
+#include "Inputs.h"
+#include "Despeckle.h"
+#include "NoCancelStatus.h"
+#include "CachingFactory.h"
+#include "ZoneSet.h"
+#include "acceleration/NonAcceleratedOperations.h"
+#include "stages/output/OutputGenerator.h"
+#include "stages/output/Params.h"
+#include "stages/output/ColorParams.h"
+#include "imageproc/AffineImageTransform.h"
+#include "imageproc/BinaryImage.h"
+#include "imageproc/GrayImage.h"
+#include <QImage>
+#include <QRectF>
+#include <memory>
+
+using namespace imageproc;
+
+namespace benchmarks
+{
+
+namespace
+{
+
+void measureOutput(State& state, output::ColorParams::ColorMode const mode)
+{
+    QImage const& input = Inputs::colorPage();
+    GrayImage const& gray_input = Inputs::grayPage();
+    CachingFactory<GrayImage> const gray_input_factory([&gray_input]()
+    {
+        return gray_input;
+    });
+
+    std::shared_ptr<AbstractImageTransform const> const transform(
+        std::make_shared<AffineImageTransform>(input.size())
+    );
+    QRectF const outer_rect(input.rect());
+    QRectF const content_rect(outer_rect.adjusted(
+                                  outer_rect.width() * 0.08, outer_rect.height() * 0.08,
+                                  -outer_rect.width() * 0.08, -outer_rect.height() * 0.08
+                              ));
+
+    output::ColorParams color_params;
+    color_params.setColorMode(mode);
+    output::Params params;
+    params.setColorParams(color_params);
+
+    std::shared_ptr<AcceleratableOperations> const accel_ops(
+        std::make_shared<NonAcceleratedOperations>()
+    );
+    NoCancelStatus const status;
+    ZoneSet const no_zones;
+
+    state.measure(Inputs::pixels(input.size()), [&]()
+    {
+        output::OutputGenerator generator(transform, content_rect, outer_rect, params);
+        QImage const output(
+            generator.process(
+                status, accel_ops, input, gray_input_factory, no_zones, no_zones
+            )
+        );
+    });
+}
+
+} // anonymous namespace
+
+BENCHMARK_CASE(bench_despeckle, "output/Despeckle")
+{
+    BinaryImage const& input = Inputs::binaryPage();
+    NoCancelStatus const status;
+    state.measure(Inputs::pixels(input.size()), [&]()
+    {
+        BinaryImage const output(Despeckle::despeckle(input, 2.5, status));
+    });
+}
+
+BENCHMARK_CASE(bench_output_bw, "output/OutputGenerator::process/black_and_white")
+{
+    measureOutput(state, output::ColorParams::BLACK_AND_WHITE);
+}
+
+BENCHMARK_CASE(bench_output_color, "output/OutputGenerator::process/color_grayscale")
+{
+    measureOutput(state, output::ColorParams::COLOR_GRAYSCALE);
+}
+
+BENCHMARK_CASE(bench_output_mixed, "output/OutputGenerator::process/mixed")
+{
+    measureOutput(state, output::ColorParams::MIXED);
+}
+
+} // namespace benchmarks
@@ -0,0 +1,116 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Benchmark.h"
+#include "Inputs.h"
+#include "TiffReader.h"
+#include "TiffWriter.h"
+#include <QImage>
+#include <QBuffer>
+#include <QByteArray>
+#include <QIODevice>
+#include <stdexcept>
+
+namespace benchmarks
+{
+
+namespace
+{
+
+QByteArray encode(QImage const& image, TiffWriter::Codec const codec)
+{
+    TiffWriter::Options options;
+    options.codec = codec;
+
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::ReadWrite);
+    if (!TiffWriter::writeImage(buffer, image, options))
+    {
+        throw std::runtime_error("Writing a TIFF failed");
+    }
+    return data;
+}
+
+void measureWrite(State& state, QImage const& image, TiffWriter::Codec const codec)
+{
+    if (!TiffWriter::isCodecSupported(codec))
+    {
+        return;
+    }
+
+    state.measure(Inputs::pixels(image.size()), [&]()
+    {
+        encode(image, codec);
+    });
+}
+
+void measureRead(State& state, QImage const& image, TiffWriter::Codec const codec)
+{
+    if (!TiffWriter::isCodecSupported(codec))
+    {
+        return;
+    }
+
+    QByteArray data(encode(image, codec));
+    state.measure(Inputs::pixels(image.size()), [&]()
+    {
+        QBuffer buffer(&data);
+        buffer.open(QIODevice::ReadOnly);
+        QImage const decoded(TiffReader::readImage(buffer));
+    });
+}
+
+} // anonymous namespace
+
+BENCHMARK_CASE(bench_tiff_write_color_lzw, "io/TiffWriter/color/lzw")
+{
+    measureWrite(state, Inputs::colorPage(), TiffWriter::CODEC_LZW);
+}
+
+BENCHMARK_CASE(bench_tiff_write_color_deflate, "io/TiffWriter/color/deflate")
+{
+    measureWrite(state, Inputs::colorPage(), TiffWriter::CODEC_DEFLATE);
+}
+
+BENCHMARK_CASE(bench_tiff_write_gray_lzw, "io/TiffWriter/gray/lzw")
+{
+    measureWrite(state, Inputs::grayPage().toQImage(), TiffWriter::CODEC_LZW);
+}
+
+BENCHMARK_CASE(bench_tiff_write_bw_g4, "io/TiffWriter/bw/g4")
+{
+    measureWrite(state, Inputs::binaryPage().toQImage(), TiffWriter::CODEC_G4);
+}
+
+BENCHMARK_CASE(bench_tiff_read_color_lzw, "io/TiffReader/color/lzw")
+{
+    measureRead(state, Inputs::colorPage(), TiffWriter::CODEC_LZW);
+}
+
+BENCHMARK_CASE(bench_tiff_read_gray_lzw, "io/TiffReader/gray/lzw")
+{
+    measureRead(state, Inputs::grayPage().toQImage(), TiffWriter::CODEC_LZW);
+}
+
+BENCHMARK_CASE(bench_tiff_read_bw_g4, "io/TiffReader/bw/g4")
+{
+    measureRead(state, Inputs::binaryPage().toQImage(), TiffWriter::CODEC_G4);
+}
+
+} // namespace benchmarks
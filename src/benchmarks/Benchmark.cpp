@@ -0,0 +1,133 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Benchmark.h"
+#include <chrono>
+#include <algorithm>
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#elif defined(__linux__)
+#include <fstream>
+#include <sstream>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace benchmarks
+{
+
+State::State(double const min_seconds, int const min_runs)
+    :	m_minSeconds(min_seconds),
+      m_minRuns(std::max(1, min_runs)),
+      m_pixels(0),
+      m_runs(0),
+      m_nsPerRun(0)
+{
+}
+
+void
+State::measure(qint64 const pixels, std::function<void()> const& body)
+{
+    using clock = std::chrono::steady_clock;
+
+    // Warms up caches and lets lazily initialized data get initialized.
+    body();
+
+    std::vector<double> times;
+    clock::time_point const start = clock::now();
+    for (;;)
+    {
+        clock::time_point const run_start = clock::now();
+        body();
+        clock::time_point const run_end = clock::now();
+        times.push_back(std::chrono::duration<double, std::nano>(run_end - run_start).count());
+
+        double const elapsed = std::chrono::duration<double>(run_end - start).count();
+        if (int(times.size()) >= m_minRuns && elapsed >= m_minSeconds)
+        {
+            break;
+        }
+    }
+
+    std::vector<double>::iterator const median = times.begin() + times.size() / 2;
+    std::nth_element(times.begin(), median, times.end());
+
+    m_pixels = pixels;
+    m_runs = int(times.size());
+    m_nsPerRun = *median;
+}
+
+
+std::vector<Benchmark>&
+Registry::benchmarks()
+{
+    static std::vector<Benchmark> benchmarks;
+    return benchmarks;
+}
+
+
+void
+PeakRss::reset()
+{
+#if defined(__linux__)
+    // Writing 5 to clear_refs resets VmHWM to the current RSS (Linux 4.0+).
+    std::ofstream clear_refs("/proc/self/clear_refs");
+    clear_refs << "5";
+#endif
+}
+
+qint64
+PeakRss::get()
+{
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    {
+        return qint64(counters.PeakWorkingSetSize);
+    }
+    return 0;
+#elif defined(__linux__)
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line))
+    {
+        if (line.compare(0, 6, "VmHWM:") == 0)
+        {
+            std::istringstream strm(line.substr(6));
+            qint64 kb = 0;
+            strm >> kb;
+            return kb * 1024;
+        }
+    }
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+    {
+        return 0;
+    }
+#ifdef __APPLE__
+    return qint64(usage.ru_maxrss); // Bytes on macOS.
+#else
+    return qint64(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+} // namespace benchmarks
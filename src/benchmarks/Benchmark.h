@@ -0,0 +1,159 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BENCHMARKS_BENCHMARK_H_
+#define BENCHMARKS_BENCHMARK_H_
+
+#include "NonCopyable.h"
+#include <QtGlobal>
+#include <functional>
+#include <vector>
+#include <string>
+
+namespace benchmarks
+{
+
+/**
+ * \brief The outcome of a single benchmark.
+ */
+struct Result
+{
+    std::string name;
+
+    /** The number of pixels processed by a single run. */
+    qint64 pixels;
+
+    /** The number of timed runs. */
+    int runs;
+
+    /** The median time of a run. */
+    double nsPerRun;
+
+    /**
+     * The peak resident set size of the process while the benchmark,
+     * including its setup, was running. Where the peak can't be reset,
+     * that's the peak since the process was started.
+     */
+    qint64 peakRssBytes;
+
+    double nsPerPixel() const { return pixels > 0 ? nsPerRun / pixels : nsPerRun; }
+
+    Result() : pixels(0), runs(0), nsPerRun(0), peakRssBytes(0) {}
+};
+
+
+/**
+ * \brief Passed to a benchmark to time its workload.
+ */
+class State
+{
+    DECLARE_NON_COPYABLE(State)
+public:
+    State(double min_seconds, int min_runs);
+
+    /**
+     * \brief Runs \p body repeatedly and records the median time of a run.
+     *
+     * The first run is not timed. After that, the body is run at least
+     * min_runs times and until min_seconds have passed.
+     *
+     * \param pixels The number of pixels a single run processes,
+     *        used to normalize the time.
+     * \param body The workload to time.
+     */
+    void measure(qint64 pixels, std::function<void()> const& body);
+
+    bool measured() const { return m_runs > 0; }
+
+    qint64 pixels() const { return m_pixels; }
+
+    int runs() const { return m_runs; }
+
+    double nsPerRun() const { return m_nsPerRun; }
+private:
+    double m_minSeconds;
+    int m_minRuns;
+    qint64 m_pixels;
+    int m_runs;
+    double m_nsPerRun;
+};
+
+
+struct Benchmark
+{
+    char const* name;
+    void (*function)(State& state);
+};
+
+
+/**
+ * \brief Holds the benchmarks registered with BENCHMARK_CASE.
+ */
+class Registry
+{
+public:
+    static std::vector<Benchmark>& benchmarks();
+
+    class Registrar
+    {
+    public:
+        Registrar(char const* name, void (*function)(State& state))
+        {
+            Benchmark const benchmark = { name, function };
+            benchmarks().push_back(benchmark);
+        }
+    };
+};
+
+
+/**
+ * \brief Peak RSS tracking.
+ */
+class PeakRss
+{
+public:
+    /**
+     * \brief Resets the peak to the current RSS, if the OS allows that.
+     */
+    static void reset();
+
+    static qint64 get();
+};
+
+} // namespace benchmarks
+
+/**
+ * \brief Defines and registers a benchmark, similar to BOOST_AUTO_TEST_CASE.
+ *
+ * \code
+ * BENCHMARK_CASE(bench_gauss_blur, "imageproc/gaussBlur")
+ * {
+ *     GrayImage const input(...);
+ *     state.measure(input.width() * input.height(), [&]()
+ *     {
+ *         gaussBlur(input, 10, 10);
+ *     });
+ * }
+ * \endcode
+ */
+#define BENCHMARK_CASE(id, name) \
+    static void id(::benchmarks::State& state); \
+    static ::benchmarks::Registry::Registrar const id##_registrar(name, &id); \
+    static void id(::benchmarks::State& state)
+
+#endif
@@ -0,0 +1,195 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Inputs.h"
+#include "imageproc/BinaryThreshold.h"
+#include <QRect>
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
+
+using namespace imageproc;
+
+namespace benchmarks
+{
+
+namespace
+{
+
+QSize g_pageSize(2480, 3508);
+QImage g_colorPage;
+GrayImage g_grayPage;
+BinaryImage g_binaryPage;
+
+int clampToByte(int const val)
+{
+    return std::min(255, std::max(0, val));
+}
+
+void fillRect(QImage& image, QRect const& rect, QRgb const color)
+{
+    QRect const r(rect.intersected(image.rect()));
+    for (int y = r.top(); y <= r.bottom(); ++y)
+    {
+        uint32_t* const line = reinterpret_cast<uint32_t*>(image.scanLine(y));
+        std::fill(line + r.left(), line + r.right() + 1, color);
+    }
+}
+
+/**
+ * Paper with uneven illumination and noise, lines of glyph-sized
+ * blocks of text, a color picture and scattered speckles.
+ */
+QImage makeSyntheticPage(QSize const& size)
+{
+    std::mt19937 rng(12345);
+    int const width = size.width();
+    int const height = size.height();
+
+    QImage page(size, QImage::Format_RGB32);
+
+    std::uniform_int_distribution<int> noise(-6, 6);
+    double const cx = 0.4 * width;
+    double const cy = 0.45 * height;
+    double const r2 = double(width) * width + double(height) * height;
+    for (int y = 0; y < height; ++y)
+    {
+        uint32_t* const line = reinterpret_cast<uint32_t*>(page.scanLine(y));
+        for (int x = 0; x < width; ++x)
+        {
+            double const d2 = (x - cx) * (x - cx) + (y - cy) * (y - cy);
+            double const light = 1.0 - 0.3 * d2 / r2;
+            int const n = noise(rng);
+            line[x] = qRgb(
+                          clampToByte(int(235 * light) + n),
+                          clampToByte(int(230 * light) + n),
+                          clampToByte(int(215 * light) + n)
+                      );
+        }
+    }
+
+    int const line_height = std::max(4, height / 60);
+    int const glyph_height = std::max(2, line_height * 6 / 10);
+    int const glyph_width = std::max(1, glyph_height * 2 / 3);
+    QRect const text_area(width / 10, height / 10, width * 8 / 10, height * 8 / 10);
+    QRect const picture_area(width / 2, height / 8, width * 4 / 10, height / 5);
+    std::uniform_int_distribution<int> glyph_width_dist(glyph_width / 2, glyph_width);
+    std::uniform_int_distribution<int> word_length_dist(2, 9);
+    std::uniform_int_distribution<int> ink_dist(20, 60);
+
+    for (int y = text_area.top(); y + glyph_height <= text_area.bottom(); y += line_height)
+    {
+        int x = text_area.left();
+        while (x < text_area.right())
+        {
+            int const word_length = word_length_dist(rng);
+            for (int i = 0; i < word_length && x < text_area.right(); ++i)
+            {
+                QRect const glyph(x, y, glyph_width_dist(rng), glyph_height);
+                if (!glyph.intersects(picture_area))
+                {
+                    int const ink = ink_dist(rng);
+                    fillRect(page, glyph, qRgb(ink, ink, ink + 5));
+                }
+                x += glyph.width() + std::max(1, glyph_width / 4);
+            }
+            x += glyph_width;
+        }
+    }
+
+    for (int y = picture_area.top(); y <= picture_area.bottom(); ++y)
+    {
+        uint32_t* const line = reinterpret_cast<uint32_t*>(page.scanLine(y));
+        double const fy = double(y - picture_area.top()) / picture_area.height();
+        for (int x = picture_area.left(); x <= picture_area.right(); ++x)
+        {
+            double const fx = double(x - picture_area.left()) / picture_area.width();
+            double const wave = 0.5 + 0.5 * std::sin(fx * 12.0 + fy * 7.0);
+            line[x] = qRgb(
+                          clampToByte(int(60 + 180 * fx)),
+                          clampToByte(int(40 + 160 * wave)),
+                          clampToByte(int(200 - 150 * fy))
+                      );
+        }
+    }
+
+    std::uniform_int_distribution<int> x_dist(0, width - 1);
+    std::uniform_int_distribution<int> y_dist(0, height - 1);
+    std::uniform_int_distribution<int> speckle_size(1, 3);
+    int const num_speckles = int(qint64(width) * height / 4000);
+    for (int i = 0; i < num_speckles; ++i)
+    {
+        int const s = speckle_size(rng);
+        fillRect(page, QRect(x_dist(rng), y_dist(rng), s, s), qRgb(30, 30, 30));
+    }
+
+    return page;
+}
+
+} // anonymous namespace
+
+void
+Inputs::setPageSize(QSize const& size)
+{
+    g_pageSize = size;
+    g_colorPage = QImage();
+    g_grayPage = GrayImage();
+    g_binaryPage = BinaryImage();
+}
+
+void
+Inputs::setSamplePage(QImage const& image)
+{
+    g_colorPage = image.convertToFormat(QImage::Format_RGB32);
+    g_pageSize = g_colorPage.size();
+    g_grayPage = GrayImage();
+    g_binaryPage = BinaryImage();
+}
+
+QImage const&
+Inputs::colorPage()
+{
+    if (g_colorPage.isNull())
+    {
+        g_colorPage = makeSyntheticPage(g_pageSize);
+    }
+    return g_colorPage;
+}
+
+GrayImage const&
+Inputs::grayPage()
+{
+    if (g_grayPage.isNull())
+    {
+        g_grayPage = GrayImage(colorPage());
+    }
+    return g_grayPage;
+}
+
+BinaryImage const&
+Inputs::binaryPage()
+{
+    if (g_binaryPage.isNull())
+    {
+        g_binaryPage = BinaryImage(colorPage(), BinaryThreshold(128));
+    }
+    return g_binaryPage;
+}
+
+} // namespace benchmarks
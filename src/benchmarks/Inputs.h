@@ -0,0 +1,73 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BENCHMARKS_INPUTS_H_
+#define BENCHMARKS_INPUTS_H_
+
+#include "imageproc/GrayImage.h"
+#include "imageproc/BinaryImage.h"
+#include <QImage>
+#include <QSize>
+
+namespace benchmarks
+{
+
+/**
+ * \brief The page images benchmarks operate on.
+ *
+ * By default, that's a synthetic page generated from a fixed seed,
+ * so results are reproducible across runs and machines. A sample page
+ * may be provided instead, to measure on real content.
+ *
+ * \note Not thread-safe. Images are generated on first access and kept
+ *       for the rest of the run.
+ */
+class Inputs
+{
+public:
+    /**
+     * \brief Sets the size of the synthetic page. Defaults to A4 at 300 DPI.
+     */
+    static void setPageSize(QSize const& size);
+
+    /**
+     * \brief Replaces the synthetic page with the given one.
+     */
+    static void setSamplePage(QImage const& image);
+
+    /**
+     * \brief The page in QImage::Format_RGB32.
+     */
+    static QImage const& colorPage();
+
+    static imageproc::GrayImage const& grayPage();
+
+    /**
+     * \brief The page thresholded at the middle gray level.
+     */
+    static imageproc::BinaryImage const& binaryPage();
+
+    static qint64 pixels(QSize const& size)
+    {
+        return qint64(size.width()) * size.height();
+    }
+};
+
+} // namespace benchmarks
+
+#endif
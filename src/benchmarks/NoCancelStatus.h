@@ -0,0 +1,45 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BENCHMARKS_NO_CANCEL_STATUS_H_
+#define BENCHMARKS_NO_CANCEL_STATUS_H_
+
+#include "TaskStatus.h"
+
+namespace benchmarks
+{
+
+/**
+ * \brief A TaskStatus for workloads that are never cancelled.
+ */
+class NoCancelStatus : public TaskStatus
+{
+public:
+    virtual void cancel() {}
+
+    virtual bool isCancelled() const
+    {
+        return false;
+    }
+
+    virtual void throwIfCancelled() const {}
+};
+
+} // namespace benchmarks
+
+#endif
@@ -0,0 +1,426 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Benchmark.h"
+#include "Inputs.h"
+#include "TiffReader.h"
+#include <QCoreApplication>
+#include <QStringList>
+#include <QString>
+#include <QFile>
+#include <QImage>
+#include <QImageReader>
+#include <QSize>
+#include <QMap>
+#include <QRegularExpression>
+#include <QThreadPool>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <set>
+#include <string>
+#include <exception>
+#include <stdlib.h>
+
+using namespace benchmarks;
+
+namespace
+{
+
+struct Options
+{
+    QString filter;
+    QString jsonFile;
+    QString baselineFile;
+    QString sampleFile;
+    QSize pageSize;
+    double minSeconds;
+    int minRuns;
+    int threads;
+    double tolerance;
+    double rssTolerance;
+    bool list;
+
+    Options()
+        : minSeconds(1.0), minRuns(3), threads(0),
+          tolerance(0.10), rssTolerance(0.20), list(false) {}
+};
+
+void printHelp()
+{
+    std::cout << "\n";
+    std::cout << "Usage: perf_benchmarks [options]" << "\n";
+    std::cout << "\n";
+    std::cout << "Options:" << "\n";
+    std::cout << "\t--list\t\t\t\t-- list benchmarks and exit" << "\n";
+    std::cout << "\t--filter=<regex>\t\t-- only run benchmarks whose names match" << "\n";
+    std::cout << "\t--sample=<image>\t\t-- use this page instead of a synthetic one" << "\n";
+    std::cout << "\t--page-size=<width>x<height>\t-- synthetic page size; default: 2480x3508" << "\n";
+    std::cout << "\t--min-time=<seconds>\t\t-- minimum time per benchmark; default: 1" << "\n";
+    std::cout << "\t--min-runs=<n>\t\t\t-- minimum timed runs per benchmark; default: 3" << "\n";
+    std::cout << "\t--threads=<n>\t\t\t-- thread pool size; default: one per CPU core" << "\n";
+    std::cout << "\t--json=<file>\t\t\t-- write results to a JSON file" << "\n";
+    std::cout << "\t--baseline=<file>\t\t-- compare against results written by --json;" << "\n";
+    std::cout << "\t\t\t\t\t   exit with status 2 on a regression" << "\n";
+    std::cout << "\t\t\t\t\t   or a benchmark missing from this run" << "\n";
+    std::cout << "\t--tolerance=<percent>\t\t-- allowed ns/pixel increase; default: 10" << "\n";
+    std::cout << "\t--rss-tolerance=<percent>\t-- allowed peak RSS increase; default: 20" << "\n";
+    std::cout << "\n";
+}
+
+void fail(QString const& message)
+{
+    std::cerr << message.toLocal8Bit().constData() << std::endl;
+    exit(1);
+}
+
+Options parseOptions(QStringList const& args)
+{
+    Options options;
+    QRegularExpression const rx("^--([^=]+)(?:=(.*))?$");
+    for (int i = 1; i < args.size(); ++i)
+    {
+        QRegularExpressionMatch const match(rx.match(args[i]));
+        if (!match.hasMatch())
+        {
+            fail("Unexpected argument: " + args[i]);
+        }
+
+        QString const key(match.captured(1));
+        QString const value(match.captured(2));
+        bool ok = true;
+        if (key == "help")
+        {
+            printHelp();
+            exit(0);
+        }
+        else if (key == "list")
+        {
+            options.list = true;
+        }
+        else if (key == "filter")
+        {
+            options.filter = value;
+        }
+        else if (key == "sample")
+        {
+            options.sampleFile = value;
+        }
+        else if (key == "page-size")
+        {
+            QStringList const dims(value.split('x'));
+            ok = dims.size() == 2;
+            if (ok)
+            {
+                bool ok_w = false, ok_h = false;
+                options.pageSize = QSize(dims[0].toInt(&ok_w), dims[1].toInt(&ok_h));
+                ok = ok_w && ok_h && !options.pageSize.isEmpty();
+            }
+        }
+        else if (key == "min-time")
+        {
+            options.minSeconds = value.toDouble(&ok);
+        }
+        else if (key == "min-runs")
+        {
+            options.minRuns = value.toInt(&ok);
+        }
+        else if (key == "threads")
+        {
+            options.threads = value.toInt(&ok);
+        }
+        else if (key == "json")
+        {
+            options.jsonFile = value;
+        }
+        else if (key == "baseline")
+        {
+            options.baselineFile = value;
+        }
+        else if (key == "tolerance")
+        {
+            options.tolerance = value.toDouble(&ok) / 100.0;
+        }
+        else if (key == "rss-tolerance")
+        {
+            options.rssTolerance = value.toDouble(&ok) / 100.0;
+        }
+        else
+        {
+            fail("Unknown option: --" + key);
+        }
+
+        if (!ok)
+        {
+            fail("Invalid value for --" + key + ": " + value);
+        }
+    }
+    return options;
+}
+
+QImage loadSample(QString const& file_path)
+{
+    QFile file(file_path);
+    if (file.open(QIODevice::ReadOnly) && TiffReader::canRead(file))
+    {
+        return TiffReader::readImage(file);
+    }
+    return QImageReader(file_path).read();
+}
+
+QJsonObject toJson(Result const& result)
+{
+    QJsonObject obj;
+    obj["name"] = QString::fromStdString(result.name);
+    obj["pixels"] = double(result.pixels);
+    obj["runs"] = result.runs;
+    obj["ns_per_run"] = result.nsPerRun;
+    obj["ns_per_pixel"] = result.nsPerPixel();
+    obj["peak_rss_bytes"] = double(result.peakRssBytes);
+    return obj;
+}
+
+bool writeJson(QString const& file_path, std::vector<Result> const& results)
+{
+    QJsonArray array;
+    for (Result const& result : results)
+    {
+        array.append(toJson(result));
+    }
+    QJsonObject root;
+    root["benchmarks"] = array;
+
+    QFile file(file_path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        return false;
+    }
+    QByteArray const data(QJsonDocument(root).toJson());
+    return file.write(data) == data.size();
+}
+
+/**
+ * Compares results against a baseline and reports the differences.
+ * Benchmarks missing from the baseline are skipped. Baseline entries
+ * selected by the filter but missing from the results count as regressions,
+ * unless they are in \p not_run, which the caller has already reported.
+ *
+ * \return The number of regressions beyond the tolerances.
+ */
+int compareWithBaseline(
+    std::vector<Result> const& results, std::set<std::string> const& not_run,
+    QString const& baseline_file, QRegularExpression const& filter, Options const& options)
+{
+    QFile file(baseline_file);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        fail("Can't open the baseline file: " + baseline_file);
+    }
+    QJsonDocument const doc(QJsonDocument::fromJson(file.readAll()));
+    if (!doc.isObject())
+    {
+        fail("Invalid baseline file: " + baseline_file);
+    }
+
+    QMap<QString, QJsonObject> baseline;
+    for (QJsonValue const& value : doc.object().value("benchmarks").toArray())
+    {
+        QJsonObject const obj(value.toObject());
+        baseline.insert(obj.value("name").toString(), obj);
+    }
+
+    std::cout << std::setprecision(1);
+    std::cout << "\nComparison with " << baseline_file.toLocal8Bit().constData() << ":\n";
+    int regressions = 0;
+    for (Result const& result : results)
+    {
+        QString const name(QString::fromStdString(result.name));
+        if (!baseline.contains(name))
+        {
+            continue;
+        }
+
+        QJsonObject const& base = baseline[name];
+        double const base_ns = base.value("ns_per_pixel").toDouble();
+        double const base_rss = base.value("peak_rss_bytes").toDouble();
+        double const time_ratio = base_ns > 0 ? result.nsPerPixel() / base_ns : 1.0;
+        double const rss_ratio = base_rss > 0 ? result.peakRssBytes / base_rss : 1.0;
+        bool const slower = time_ratio > 1.0 + options.tolerance;
+        bool const bigger = rss_ratio > 1.0 + options.rssTolerance;
+
+        std::cout << std::left << std::setw(52) << result.name << std::right
+                  << std::showpos << std::setw(9) << (time_ratio - 1.0) * 100.0 << "% time"
+                  << std::setw(9) << (rss_ratio - 1.0) * 100.0 << "% rss" << std::noshowpos;
+        if (slower || bigger)
+        {
+            std::cout << "  REGRESSION";
+            ++regressions;
+        }
+        std::cout << "\n";
+    }
+
+    std::set<std::string> measured;
+    for (Result const& result : results)
+    {
+        measured.insert(result.name);
+    }
+    for (QString const& name : baseline.keys())
+    {
+        std::string const std_name(name.toStdString());
+        if (!filter.match(name).hasMatch() || measured.count(std_name) || not_run.count(std_name))
+        {
+            continue;
+        }
+        std::cout << std::left << std::setw(52) << std_name << std::right
+                  << "  MISSING\n";
+        ++regressions;
+    }
+    return regressions;
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+    QCoreApplication app(argc, argv);
+    Options const options(parseOptions(app.arguments()));
+
+    QRegularExpression const filter(options.filter);
+    if (!filter.isValid())
+    {
+        fail("Invalid filter: " + options.filter);
+    }
+
+    std::vector<Benchmark> benchmarks;
+    for (Benchmark const& benchmark : Registry::benchmarks())
+    {
+        if (filter.match(QString::fromLatin1(benchmark.name)).hasMatch())
+        {
+            benchmarks.push_back(benchmark);
+        }
+    }
+
+    if (options.list)
+    {
+        for (Benchmark const& benchmark : benchmarks)
+        {
+            std::cout << benchmark.name << "\n";
+        }
+        return 0;
+    }
+
+    if (options.threads > 0)
+    {
+        QThreadPool::globalInstance()->setMaxThreadCount(options.threads);
+    }
+    if (!options.pageSize.isEmpty())
+    {
+        Inputs::setPageSize(options.pageSize);
+    }
+    if (!options.sampleFile.isEmpty())
+    {
+        QImage const sample(loadSample(options.sampleFile));
+        if (sample.isNull())
+        {
+            fail("Can't load the sample page: " + options.sampleFile);
+        }
+        Inputs::setSamplePage(sample);
+    }
+
+    // Generated upfront, so that peak RSS of whichever benchmark
+    // happens to be the first to use them isn't inflated.
+    QSize const page_size(Inputs::colorPage().size());
+    Inputs::grayPage();
+    Inputs::binaryPage();
+
+    std::cout << "Page: " << page_size.width() << "x" << page_size.height()
+              << ", threads: " << QThreadPool::globalInstance()->maxThreadCount() << "\n\n";
+    std::cout << std::left << std::setw(52) << "benchmark" << std::right
+              << std::setw(12) << "ns/pixel" << std::setw(12) << "ms/run"
+              << std::setw(8) << "runs" << std::setw(14) << "peak RSS MB" << "\n";
+    std::cout << std::fixed << std::setprecision(3);
+
+    std::vector<Result> results;
+    std::set<std::string> not_run;
+    int failures = 0;
+    for (Benchmark const& benchmark : benchmarks)
+    {
+        State state(options.minSeconds, options.minRuns);
+        PeakRss::reset();
+        try
+        {
+            benchmark.function(state);
+        }
+        catch (std::exception const& e)
+        {
+            std::cerr << benchmark.name << " failed: " << e.what() << std::endl;
+            not_run.insert(benchmark.name);
+            ++failures;
+            continue;
+        }
+
+        if (!state.measured())
+        {
+            // Unsupported in this build, like a TIFF codec libtiff lacks.
+            not_run.insert(benchmark.name);
+            continue;
+        }
+
+        Result result;
+        result.name = benchmark.name;
+        result.pixels = state.pixels();
+        result.runs = state.runs();
+        result.nsPerRun = state.nsPerRun();
+        result.peakRssBytes = PeakRss::get();
+        results.push_back(result);
+
+        std::cout << std::left << std::setw(52) << result.name << std::right
+                  << std::setw(12) << result.nsPerPixel()
+                  << std::setw(12) << result.nsPerRun * 1e-6
+                  << std::setw(8) << result.runs
+                  << std::setw(14) << result.peakRssBytes / (1024.0 * 1024.0) << "\n";
+        std::cout.flush();
+    }
+
+    if (!options.jsonFile.isEmpty() && !writeJson(options.jsonFile, results))
+    {
+        fail("Can't write " + options.jsonFile);
+    }
+
+    int regressions = 0;
+    if (!options.baselineFile.isEmpty())
+    {
+        regressions = compareWithBaseline(
+                          results, not_run, options.baselineFile, filter, options
+                      );
+        if (regressions > 0)
+        {
+            std::cout << "\n" << regressions << " regression(s) beyond tolerance.\n";
+        }
+    }
+
+    if (failures > 0)
+    {
+        std::cerr << failures << " benchmark(s) failed." << std::endl;
+        return 1;
+    }
+    return regressions > 0 ? 2 : 0;
+}
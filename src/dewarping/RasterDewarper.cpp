@@ -361,7 +361,7 @@ void areaMapGeneratrix(
 }
 
 template<typename ColorMixer, typename PixelType>
-void dewarpGeneric(
+void dewarpColumns(
     PixelType const* const src_data,
     QSize const src_size,
     int const src_stride,
@@ -373,9 +373,10 @@ void dewarpGeneric(
     PixelType const bg_color,
     float const min_density,
     float const max_density,
-    QSizeF const& min_mapping_area)
+    QSizeF const& min_mapping_area,
+    int const dst_x_begin,
+    int const dst_x_end)
 {
-    int const dst_width = dst_size.width();
     int const dst_height = dst_size.height();
 
     CylindricalSurfaceDewarper::State state;
@@ -394,7 +395,7 @@ void dewarpGeneric(
     std::vector<Vec2f> next_grid_column(dst_height + 1);
     std::pair<int, int> prev_dst_y_range(0, dst_height - 1); // Inclusive.
 
-    for (int dst_x = 0; dst_x <= dst_width; ++dst_x)
+    for (int dst_x = dst_x_begin; dst_x <= dst_x_end; ++dst_x)
     {
         double const model_x = (dst_x - model_domain_left) * model_x_scale;
         CylindricalSurfaceDewarper::Generatrix const generatrix(
@@ -466,7 +467,7 @@ void dewarpGeneric(
         // The case with dst_y_first > dst_y_first is not a problem, as long as both
         // are within [0, dst_height)
 
-        if (dst_x != 0)
+        if (dst_x != dst_x_begin)
         {
             areaMapGeneratrix<ColorMixer, PixelType>(
                 src_data,
@@ -490,6 +491,35 @@ void dewarpGeneric(
     }
 }
 
+template<typename ColorMixer, typename PixelType>
+void dewarpGeneric(
+    PixelType const* const src_data,
+    QSize const src_size,
+    int const src_stride,
+    PixelType* const dst_data,
+    QSize const dst_size,
+    int const dst_stride,
+    CylindricalSurfaceDewarper const& distortion_model,
+    QRectF const& model_domain,
+    PixelType const bg_color,
+    float const min_density,
+    float const max_density,
+    QSizeF const& min_mapping_area,
+    RangeExecutor const& executor)
+{
+    // Each destination column is produced from a pair of adjacent grid columns.
+    // A band of destination columns [begin, end) therefore needs grid columns
+    // [begin, end], with the first one being only computed, not area-mapped.
+    executor(0, dst_size.width(), [&](int const dst_x_begin, int const dst_x_end)
+    {
+        dewarpColumns<ColorMixer, PixelType>(
+            src_data, src_size, src_stride, dst_data, dst_size, dst_stride,
+            distortion_model, model_domain, bg_color, min_density, max_density,
+            min_mapping_area, dst_x_begin, dst_x_end
+        );
+    });
+}
+
 typedef uint32_t MixingWeight;
 typedef float ArgbMixingWeight;
 /* We can't use uint32_t for ArgbMixingWeight because additional scaling
@@ -506,7 +536,8 @@ QImage dewarpGrayscale(
     QColor const& bg_color,
     float const min_density,
     float const max_density,
-    QSizeF const& min_mapping_area)
+    QSizeF const& min_mapping_area,
+    RangeExecutor const& executor)
 {
     GrayImage dst(dst_size);
     uint8_t const bg_sample = qGray(bg_color.rgb());
@@ -523,7 +554,8 @@ QImage dewarpGrayscale(
         bg_sample,
         min_density,
         max_density,
-        min_mapping_area
+        min_mapping_area,
+        executor
     );
     return dst.toQImage();
 }
@@ -536,7 +568,8 @@ QImage dewarpRgb(
     QColor const& bg_color,
     float const min_density,
     float const max_density,
-    QSizeF const& min_mapping_area)
+    QSizeF const& min_mapping_area,
+    RangeExecutor const& executor)
 {
     QImage dst(dst_size, QImage::Format_RGB32);
     badAllocIfNull(dst);
@@ -554,7 +587,8 @@ QImage dewarpRgb(
         bg_color.rgb(),
         min_density,
         max_density,
-        min_mapping_area
+        min_mapping_area,
+        executor
     );
     return dst;
 }
@@ -567,7 +601,8 @@ QImage dewarpArgb(
     QColor const& bg_color,
     float const min_density,
     float const max_density,
-    QSizeF const& min_mapping_area)
+    QSizeF const& min_mapping_area,
+    RangeExecutor const& executor)
 {
     QImage dst(dst_size, QImage::Format_ARGB32);
     badAllocIfNull(dst);
@@ -585,7 +620,8 @@ QImage dewarpArgb(
         bg_color.rgba(),
         min_density,
         max_density,
-        min_mapping_area
+        min_mapping_area,
+        executor
     );
     return dst;
 }
@@ -601,7 +637,8 @@ RasterDewarper::dewarp(
     QColor const& bg_color,
     float const min_density,
     float const max_density,
-    QSizeF const& min_mapping_area)
+    QSizeF const& min_mapping_area,
+    RangeExecutor const& executor)
 {
     if (model_domain.isEmpty())
     {
@@ -630,7 +667,8 @@ RasterDewarper::dewarp(
                        bg_color,
                        min_density,
                        max_density,
-                       min_mapping_area
+                       min_mapping_area,
+                       executor
                    );
         }
     // fall through
@@ -645,7 +683,8 @@ RasterDewarper::dewarp(
                        bg_color,
                        min_density,
                        max_density,
-                       min_mapping_area
+                       min_mapping_area,
+                       executor
                    );
         }
         else
@@ -658,7 +697,8 @@ RasterDewarper::dewarp(
                        bg_color,
                        min_density,
                        max_density,
-                       min_mapping_area
+                       min_mapping_area,
+                       executor
                    );
         }
     }
@@ -20,6 +20,7 @@
 #define DEWARPING_RASTER_DEWARPER_H_
 
 #include "dewarping_config.h"
+#include "ParallelFor.h"
 #include <QSizeF>
 
 class QImage;
@@ -59,6 +60,8 @@ public:
      * @param min_mapping_area Defines the minimum rectangle in the source image
      *        that maps to a destination pixel.  This can be used to control
      *        smoothing.
+     * @param executor Processes bands of destination columns. Passing parallelFor
+     *        splits the work across threads without affecting the result.
      * @return The dewarped image.
      */
     static QImage dewarp(
@@ -66,7 +69,8 @@ public:
         CylindricalSurfaceDewarper const& distortion_model,
         QRectF const& model_domain, QColor const& background_color,
         float min_density, float max_density,
-        QSizeF const& min_mapping_area = QSizeF(0.9, 0.9));
+        QSizeF const& min_mapping_area = QSizeF(0.9, 0.9),
+        RangeExecutor const& executor = &serialFor);
 };
 
 } // namespace dewarping
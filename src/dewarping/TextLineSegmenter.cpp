@@ -408,7 +408,8 @@ TextLineSegmenter::initialSegmentation(
     int const width = image.width();
     int const height = image.height();
 
-    ConnectivityMap cmap(peaks, CONN4);
+    std::vector<ConnectivityMap::ComponentStats> stats;
+    ConnectivityMap cmap(peaks, CONN4, &stats);
 
     struct Region
     {
@@ -483,24 +484,19 @@ TextLineSegmenter::initialSegmentation(
 
     std::priority_queue<Pos> queue;
 
-    rasterOpGenericXY(
-        [&regions, &blurred, &queue](uint32_t& label, int x, int y)
+    // Seed each region from the first pixel of its connected component.
+    for (uint32_t label = 1; label <= cmap.maxLabel(); ++label)
     {
-        if (label)
-        {
-            Region& region = regions[label - 1];
-            if (region.empty())
-            {
-                region.extendWith(x, y);
-                float const quality = blurred(x, y);
-                queue.push({x, y, 1, label, quality});
-                queue.push({x, y, -1, label, quality});
-            }
-            label = 0;
-        }
-    },
-    cmap
-    );
+        QPoint const seed(stats[label].seed);
+        regions[label - 1].extendWith(seed.x(), seed.y());
+        float const quality = blurred(seed.x(), seed.y());
+        queue.push({seed.x(), seed.y(), 1, label, quality});
+        queue.push({seed.x(), seed.y(), -1, label, quality});
+    }
+    std::vector<ConnectivityMap::ComponentStats>().swap(stats);
+
+    // Clear the map.
+    std::fill(cmap.paddedData(), cmap.paddedData() + cmap.stride() * (height + 2), 0);
 
     status.throwIfCancelled();
 
@@ -0,0 +1,172 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ParallelFor.h"
+#include <QThreadPool>
+#include <QRunnable>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWaitCondition>
+#include <atomic>
+#include <memory>
+#include <exception>
+#include <algorithm>
+
+namespace
+{
+
+/**
+ * Shared between the calling thread and the helpers it submits to the pool.
+ * A helper may only start running after all chunks have been processed,
+ * which is why this object is reference-counted rather than living on
+ * the caller's stack.
+ */
+class ParallelForState
+{
+public:
+    ParallelForState(int begin, int end, int chunk_size,
+                     std::function<void(int, int)> const& body)
+        : m_end(end)
+        , m_chunkSize(chunk_size)
+        , m_numChunks((end - begin + chunk_size - 1) / chunk_size)
+        , m_nextChunkStart(begin)
+        , m_failed(false)
+        , m_numChunksDone(0)
+        , m_rBody(body)
+    {
+    }
+
+    /**
+     * Processes chunks until none are left. m_rBody is only accessed while
+     * a chunk is in progress, and the caller doesn't return before all
+     * chunks are done, so the reference can't dangle.
+     */
+    void processChunks()
+    {
+        for (;;)
+        {
+            int const first = m_nextChunkStart.fetch_add(m_chunkSize);
+            if (first >= m_end)
+            {
+                break;
+            }
+
+            if (!m_failed.load())
+            {
+                try
+                {
+                    m_rBody(first, std::min(first + m_chunkSize, m_end));
+                }
+                catch (...)
+                {
+                    QMutexLocker const locker(&m_mutex);
+                    if (!m_ptrError)
+                    {
+                        m_ptrError = std::current_exception();
+                    }
+                    m_failed.store(true);
+                }
+            }
+
+            QMutexLocker const locker(&m_mutex);
+            if (++m_numChunksDone == m_numChunks)
+            {
+                m_allDone.wakeAll();
+            }
+        }
+    }
+
+    void waitForAllChunks()
+    {
+        QMutexLocker const locker(&m_mutex);
+        while (m_numChunksDone != m_numChunks)
+        {
+            m_allDone.wait(&m_mutex);
+        }
+
+        if (m_ptrError)
+        {
+            std::rethrow_exception(m_ptrError);
+        }
+    }
+private:
+    int const m_end;
+    int const m_chunkSize;
+    int const m_numChunks;
+    std::atomic<int> m_nextChunkStart;
+    std::atomic<bool> m_failed;
+    QMutex m_mutex;
+    QWaitCondition m_allDone;
+    int m_numChunksDone;
+    std::exception_ptr m_ptrError;
+    std::function<void(int, int)> const& m_rBody;
+};
+
+class Helper : public QRunnable
+{
+public:
+    Helper(std::shared_ptr<ParallelForState> const& state) : m_ptrState(state) {}
+
+    virtual void run()
+    {
+        m_ptrState->processChunks();
+    }
+private:
+    std::shared_ptr<ParallelForState> m_ptrState;
+};
+
+} // anonymous namespace
+
+void serialFor(int const begin, int const end, std::function<void(int, int)> const& body)
+{
+    if (begin < end)
+    {
+        body(begin, end);
+    }
+}
+
+void parallelFor(int const begin, int const end, std::function<void(int, int)> const& body)
+{
+    if (begin >= end)
+    {
+        return;
+    }
+
+    QThreadPool* const pool = QThreadPool::globalInstance();
+    int const num_threads = std::max(1, pool->maxThreadCount());
+    int const range = end - begin;
+
+    // A few chunks per thread let faster threads take over the work of slower ones.
+    int const chunk_size = std::max(1, range / (num_threads * 4));
+    int const num_chunks = (range + chunk_size - 1) / chunk_size;
+    int const num_helpers = std::min(num_threads, num_chunks) - 1;
+    if (num_helpers <= 0)
+    {
+        body(begin, end);
+        return;
+    }
+
+    auto const state = std::make_shared<ParallelForState>(begin, end, chunk_size, body);
+    for (int i = 0; i < num_helpers; ++i)
+    {
+        pool->start(new Helper(state));
+    }
+
+    state->processChunks();
+    state->waitForAllChunks();
+}
@@ -0,0 +1,55 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PARALLEL_FOR_H_
+#define PARALLEL_FOR_H_
+
+#include "foundation_config.h"
+#include <functional>
+
+/**
+ * \brief A way of running body(first, last) over disjoint sub-ranges
+ *        covering [begin, end).
+ *
+ * Code that can process its rows or columns independently may take one
+ * of these, letting the caller decide between serialFor() and parallelFor().
+ */
+typedef std::function<void(int begin, int end, std::function<void(int, int)> const& body)> RangeExecutor;
+
+/**
+ * \brief Calls body(begin, end) once, unless the range is empty.
+ */
+FOUNDATION_EXPORT void serialFor(
+    int begin, int end, std::function<void(int, int)> const& body);
+
+/**
+ * \brief Splits [begin, end) into chunks and processes them concurrently
+ *        on QThreadPool::globalInstance().
+ *
+ * Chunks are handed out one at a time to whichever thread asks for the next
+ * one, so a thread that finishes early picks up the work of a slower one.
+ * The calling thread processes chunks as well, which makes nested calls
+ * safe even when the pool has no idle threads.
+ *
+ * If body throws, chunks not yet started are skipped and the first exception
+ * is rethrown from this function once all running chunks complete.
+ */
+FOUNDATION_EXPORT void parallelFor(
+    int begin, int end, std::function<void(int, int)> const& body);
+
+#endif
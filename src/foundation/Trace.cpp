@@ -0,0 +1,382 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Trace.h"
+#include <QFile>
+#include <QByteArray>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QHash>
+#include <QPair>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <ostream>
+#include <iomanip>
+#include <cstring>
+#include <cstdio>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+namespace
+{
+
+struct Event
+{
+    char const* category;
+    char const* name;
+    int64_t startUsec;
+    int64_t durationUsec;
+    int64_t selfUsec;
+    int64_t cpuUsec;
+    int64_t selfCpuUsec;
+    int64_t heapDeltaBytes;
+    int width;
+    int height;
+    int threadId;
+};
+
+/**
+ * Spans beyond this number are counted but not recorded, so that
+ * a forgotten --trace on a huge batch doesn't exhaust memory.
+ */
+size_t const MAX_EVENTS = size_t(1) << 20;
+
+std::atomic<bool> g_enabled(false);
+std::atomic<int> g_nextThreadId(1);
+
+/** The innermost active span on the current thread. */
+thread_local TraceSpan* t_pInnermostSpan = nullptr;
+
+QMutex g_mutex;
+std::vector<Event> g_events;
+size_t g_droppedEvents = 0;
+
+int64_t wallUsec()
+{
+    using clock = std::chrono::steady_clock;
+    static clock::time_point const epoch = clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - epoch).count();
+}
+
+int64_t threadCpuUsec()
+{
+#if defined(_WIN32)
+    FILETIME creation, exit, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user))
+    {
+        return 0;
+    }
+    auto const to100ns = [](FILETIME const& ft)
+    {
+        return (int64_t(ft.dwHighDateTime) << 32) | int64_t(ft.dwLowDateTime);
+    };
+    return (to100ns(kernel) + to100ns(user)) / 10;
+#elif defined(CLOCK_THREAD_CPUTIME_ID)
+    timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0)
+    {
+        return 0;
+    }
+    return int64_t(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+#else
+    return 0;
+#endif
+}
+
+/**
+ * Bytes currently allocated from the heap by the whole process, or 0
+ * where the C library doesn't tell. The difference of two readings is
+ * used as an estimate of what a span allocated. That includes the
+ * allocations of any concurrently running spans, and frees within the
+ * span offset the allocations.
+ */
+int64_t heapBytesInUse()
+{
+#if defined(__GLIBC__)
+#if __GLIBC_PREREQ(2, 33)
+    struct mallinfo2 const info = mallinfo2();
+    return int64_t(info.uordblks) + int64_t(info.hblkhd);
+#else
+    return 0;
+#endif
+#else
+    return 0;
+#endif
+}
+
+int currentThreadId()
+{
+    thread_local int const id = g_nextThreadId.fetch_add(1, std::memory_order_relaxed);
+    return id;
+}
+
+void appendJsonString(QByteArray& out, char const* str)
+{
+    out += '"';
+    for (; *str; ++str)
+    {
+        char const ch = *str;
+        if (ch == '"' || ch == '\\')
+        {
+            out += '\\';
+            out += ch;
+        }
+        else if (static_cast<unsigned char>(ch) < 0x20)
+        {
+            char buf[8];
+            std::snprintf(buf, sizeof(buf), "\\u%04x", unsigned(ch));
+            out += buf;
+        }
+        else
+        {
+            out += ch;
+        }
+    }
+    out += '"';
+}
+
+} // anonymous namespace
+
+void
+Trace::setEnabled(bool const enabled)
+{
+    if (enabled)
+    {
+        wallUsec(); // Fixes the epoch.
+    }
+    g_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool
+Trace::isEnabled()
+{
+    return g_enabled.load(std::memory_order_relaxed);
+}
+
+void
+Trace::clear()
+{
+    QMutexLocker const locker(&g_mutex);
+    g_events.clear();
+    g_droppedEvents = 0;
+}
+
+bool
+Trace::writeChromeTrace(QString const& file_path)
+{
+    std::vector<Event> events;
+    {
+        QMutexLocker const locker(&g_mutex);
+        events = g_events;
+    }
+
+    QByteArray json;
+    json.reserve(int(std::min<size_t>(events.size() * 200 + 64, 1u << 30)));
+    json += "{\"traceEvents\":[\n";
+    for (size_t i = 0; i < events.size(); ++i)
+    {
+        Event const& ev = events[i];
+        json += "{\"name\":";
+        appendJsonString(json, ev.name);
+        json += ",\"cat\":";
+        appendJsonString(json, ev.category);
+        json += ",\"ph\":\"X\",\"ts\":" + QByteArray::number(qlonglong(ev.startUsec));
+        json += ",\"dur\":" + QByteArray::number(qlonglong(ev.durationUsec));
+        json += ",\"pid\":1,\"tid\":" + QByteArray::number(ev.threadId);
+        json += ",\"args\":{\"cpu_us\":" + QByteArray::number(qlonglong(ev.cpuUsec));
+        json += ",\"self_us\":" + QByteArray::number(qlonglong(ev.selfUsec));
+        json += ",\"self_cpu_us\":" + QByteArray::number(qlonglong(ev.selfCpuUsec));
+        json += ",\"heap_delta_bytes\":" + QByteArray::number(qlonglong(ev.heapDeltaBytes));
+        json += ",\"width\":" + QByteArray::number(ev.width);
+        json += ",\"height\":" + QByteArray::number(ev.height);
+        json += "}}";
+        json += (i + 1 < events.size()) ? ",\n" : "\n";
+    }
+    json += "],\"displayTimeUnit\":\"ms\"}\n";
+
+    QFile file(file_path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        return false;
+    }
+    return file.write(json) == json.size();
+}
+
+void
+Trace::printSummary(std::ostream& out)
+{
+    struct Totals
+    {
+        char const* category;
+        char const* name;
+        int64_t count;
+        int64_t wallUsec;
+        int64_t selfUsec;
+        int64_t selfCpuUsec;
+        double megapixels;
+    };
+
+    std::vector<Totals> totals;
+    size_t dropped;
+    {
+        QMutexLocker const locker(&g_mutex);
+        dropped = g_droppedEvents;
+
+        // Names are literals, but the same literal may have
+        // different addresses in different translation units.
+        QHash<QPair<QByteArray, QByteArray>, size_t> index;
+        for (Event const& ev : g_events)
+        {
+            QPair<QByteArray, QByteArray> const key(
+                QByteArray::fromRawData(ev.category, int(std::strlen(ev.category))),
+                QByteArray::fromRawData(ev.name, int(std::strlen(ev.name)))
+            );
+            auto it = index.find(key);
+            if (it == index.end())
+            {
+                it = index.insert(key, totals.size());
+                totals.push_back(Totals{ev.category, ev.name, 0, 0, 0, 0, 0.0});
+            }
+            Totals& t = totals[it.value()];
+            ++t.count;
+            t.wallUsec += ev.durationUsec;
+            t.selfUsec += ev.selfUsec;
+            t.selfCpuUsec += ev.selfCpuUsec;
+            t.megapixels += double(ev.width) * double(ev.height) * 1e-6;
+        }
+    }
+
+    std::stable_sort(totals.begin(), totals.end(), [](Totals const& lhs, Totals const& rhs)
+    {
+        if (std::strcmp(lhs.category, rhs.category) != 0)
+        {
+            return std::strcmp(lhs.category, rhs.category) < 0;
+        }
+        return lhs.selfUsec > rhs.selfUsec;
+    });
+
+    std::ios::fmtflags const flags = out.flags();
+    std::streamsize const precision = out.precision();
+    out << std::fixed << std::setprecision(1);
+
+    out << std::left << std::setw(10) << "category" << std::setw(36) << "name"
+        << std::right << std::setw(8) << "count"
+        << std::setw(12) << "total ms" << std::setw(12) << "self ms"
+        << std::setw(13) << "self cpu ms" << std::setw(12) << "mean ms"
+        << std::setw(10) << "Mpx" << "\n";
+    for (Totals const& t : totals)
+    {
+        out << std::left << std::setw(10) << t.category << std::setw(36) << t.name
+            << std::right << std::setw(8) << t.count
+            << std::setw(12) << t.wallUsec * 1e-3 << std::setw(12) << t.selfUsec * 1e-3
+            << std::setw(13) << t.selfCpuUsec * 1e-3 << std::setw(12) << t.selfUsec * 1e-3 / t.count
+            << std::setw(10) << t.megapixels << "\n";
+    }
+    if (dropped)
+    {
+        out << dropped << " spans were not recorded as the limit of "
+            << MAX_EVENTS << " was reached.\n";
+    }
+
+    out.flags(flags);
+    out.precision(precision);
+}
+
+
+TraceSpan::TraceSpan(char const* category, char const* name)
+    :	m_pCategory(category),
+      m_pName(name),
+      m_pParent(nullptr),
+      m_active(false)
+{
+    start();
+}
+
+TraceSpan::TraceSpan(char const* category, char const* name, QSize const& image_size)
+    :	m_pCategory(category),
+      m_pName(name),
+      m_pParent(nullptr),
+      m_imageSize(image_size),
+      m_active(false)
+{
+    start();
+}
+
+void
+TraceSpan::start()
+{
+    if (!Trace::isEnabled())
+    {
+        return;
+    }
+
+    m_active = true;
+    m_pParent = t_pInnermostSpan;
+    t_pInnermostSpan = this;
+    m_nestedUsec = 0;
+    m_nestedCpuUsec = 0;
+    m_startHeapBytes = heapBytesInUse();
+    m_startCpuUsec = threadCpuUsec();
+    m_startUsec = wallUsec();
+}
+
+TraceSpan::~TraceSpan()
+{
+    if (!m_active)
+    {
+        return;
+    }
+
+    int64_t const end_usec = wallUsec();
+    int64_t const end_cpu_usec = threadCpuUsec();
+    int64_t const end_heap_bytes = heapBytesInUse();
+    int64_t const duration_usec = end_usec - m_startUsec;
+    int64_t const cpu_usec = end_cpu_usec - m_startCpuUsec;
+
+    t_pInnermostSpan = m_pParent;
+    if (m_pParent && std::strcmp(m_pParent->m_pCategory, m_pCategory) == 0)
+    {
+        m_pParent->m_nestedUsec += duration_usec;
+        m_pParent->m_nestedCpuUsec += cpu_usec;
+    }
+
+    Event const ev = {
+        m_pCategory, m_pName, m_startUsec, duration_usec, duration_usec - m_nestedUsec,
+        cpu_usec, cpu_usec - m_nestedCpuUsec, end_heap_bytes - m_startHeapBytes,
+        std::max(0, m_imageSize.width()), std::max(0, m_imageSize.height()),
+        currentThreadId()
+    };
+
+    QMutexLocker const locker(&g_mutex);
+    if (g_events.size() < MAX_EVENTS)
+    {
+        g_events.push_back(ev);
+    }
+    else
+    {
+        ++g_droppedEvents;
+    }
+}
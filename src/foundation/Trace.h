@@ -0,0 +1,113 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include "foundation_config.h"
+#include "NonCopyable.h"
+#include <QString>
+#include <QSize>
+#include <iosfwd>
+#include <cstdint>
+
+/**
+ * \brief Collects timed spans of work for profiling.
+ *
+ * Tracing is off by default, in which case a TraceSpan costs a single
+ * atomic load. Once enabled, every finished span is recorded together with
+ * its wall time, the CPU time of the thread it ran on, the growth of the
+ * heap while it was open, and the dimensions of the image it worked on.
+ * The collected spans may be written out in the Chrome trace event format
+ * (loadable by chrome://tracing or Perfetto) or summarized per name.
+ *
+ * \note All methods are thread-safe.
+ */
+class FOUNDATION_EXPORT Trace
+{
+public:
+    static void setEnabled(bool enabled);
+
+    static bool isEnabled();
+
+    /**
+     * \brief Writes the recorded spans as a Chrome trace JSON document.
+     *
+     * \return true on success, false if the file couldn't be written.
+     */
+    static bool writeChromeTrace(QString const& file_path);
+
+    /**
+     * \brief Prints the times of spans grouped by category and name,
+     *        in order of decreasing self time.
+     *
+     * The self time of a span excludes the time spent in spans of the same
+     * category nested within it on the same thread. As stage tasks invoke
+     * the next stage's task, that's what makes per-stage times add up.
+     */
+    static void printSummary(std::ostream& out);
+
+    /**
+     * \brief Discards the spans recorded so far.
+     */
+    static void clear();
+};
+
+
+/**
+ * \brief Records the time between its construction and destruction
+ *        as a trace span.
+ *
+ * \code
+ * TraceSpan const span("stage", "deskew", image.size());
+ * \endcode
+ *
+ * Both category and name must be string literals or otherwise outlive
+ * the trace, as only the pointers are stored.
+ */
+class FOUNDATION_EXPORT TraceSpan
+{
+    DECLARE_NON_COPYABLE(TraceSpan)
+public:
+    TraceSpan(char const* category, char const* name);
+
+    TraceSpan(char const* category, char const* name, QSize const& image_size);
+
+    ~TraceSpan();
+
+    /**
+     * \brief Sets the image size reported for this span, for cases when
+     *        it's not known at the point of construction.
+     */
+    void setImageSize(QSize const& image_size) { m_imageSize = image_size; }
+private:
+    void start();
+
+    char const* m_pCategory;
+    char const* m_pName;
+    TraceSpan* m_pParent;
+    QSize m_imageSize;
+    int64_t m_startUsec;
+    int64_t m_startCpuUsec;
+    int64_t m_startHeapBytes;
+    int64_t m_nestedUsec;
+    int64_t m_nestedCpuUsec;
+    bool m_active;
+};
+
+#endif
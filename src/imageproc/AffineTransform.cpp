@@ -85,14 +85,13 @@ static void affineTransformGeneric(
     StorageUnit const* const src_data, int const src_stride, QSize const src_size,
     StorageUnit* const dst_data, int const dst_stride, QTransform const& xform,
     QRect const& dst_rect, StorageUnit const outside_color, int const outside_flags,
-    QSizeF const& min_mapping_area)
+    QSizeF const& min_mapping_area, int const dy_begin, int const dy_end)
 {
     int const sw = src_size.width();
     int const sh = src_size.height();
     int const dw = dst_rect.width();
-    int const dh = dst_rect.height();
 
-    StorageUnit* dst_line = dst_data;
+    StorageUnit* dst_line = dst_data + dy_begin * dst_stride;
 
     QTransform inv_xform;
     inv_xform.translate(dst_rect.x(), dst_rect.y());
@@ -106,7 +105,7 @@ static void affineTransformGeneric(
     int const src32_unit_w = std::max<int>(1, qRound(src32_unit_size.width()));
     int const src32_unit_h = std::max<int>(1, qRound(src32_unit_size.height()));
 
-    for (int dy = 0; dy < dh; ++dy, dst_line += dst_stride)
+    for (int dy = dy_begin; dy < dy_end; ++dy, dst_line += dst_stride)
     {
         double const f_dy_center = dy + 0.5;
         double const f_sx32_base = f_dy_center * inv_xform.m21() + inv_xform.dx();
@@ -356,7 +355,7 @@ static void affineTransformGeneric(
 QImage affineTransform(
     QImage const& src, QTransform const& xform,
     QRect const& dst_rect, OutsidePixels const outside_pixels,
-    QSizeF const& min_mapping_area)
+    QSizeF const& min_mapping_area, RangeExecutor const& executor)
 {
     if (src.isNull() || dst_rect.isEmpty())
     {
@@ -387,16 +386,25 @@ QImage affineTransform(
     case QImage::Format_MonoLSB:
         if (src.allGray() && is_opaque_gray(outside_pixels.rgba()))
         {
-            GrayImage gray_src(src);
+            GrayImage const gray_src(src);
             GrayImage gray_dst(dst_rect.size());
 
+            // gray_src may share its data with src, and so may be shared with
+            // other threads.  Non-const accessors would try to detach it from
+            // every worker at once, so we take the pointers here.
+            uint8_t const* const src_data = gray_src.data();
+            uint8_t* const dst_data = gray_dst.data();
+
             typedef uint32_t AccumType;
-            affineTransformGeneric<uint8_t, GrayColorMixer<AccumType>>(
-                        gray_src.data(), gray_src.stride(), src.size(),
-                        gray_dst.data(), gray_dst.stride(), xform, dst_rect,
-                        outside_pixels.grayLevel(), outside_pixels.flags(),
-                        min_mapping_area
-                    );
+            executor(0, dst_rect.height(), [&](int dy_begin, int dy_end)
+            {
+                affineTransformGeneric<uint8_t, GrayColorMixer<AccumType>>(
+                    src_data, gray_src.stride(), src.size(),
+                    dst_data, gray_dst.stride(), xform, dst_rect,
+                    outside_pixels.grayLevel(), outside_pixels.flags(),
+                    min_mapping_area, dy_begin, dy_end
+                );
+            });
 
             return gray_dst;
         }
@@ -410,12 +418,19 @@ QImage affineTransform(
             QImage dst(dst_rect.size(), QImage::Format_RGB32);
             badAllocIfNull(dst);
 
+            uint32_t const* const src_data = (uint32_t const*)src_rgb32.bits();
+            uint32_t* const dst_data = (uint32_t*)dst.bits();
+
             typedef uint32_t AccumType;
-            affineTransformGeneric<uint32_t, RgbColorMixer<AccumType>>(
-                        (uint32_t const*)src_rgb32.bits(), src_rgb32.bytesPerLine() / 4, src_rgb32.size(),
-                        (uint32_t*)dst.bits(), dst.bytesPerLine() / 4, xform, dst_rect,
-                        outside_pixels.rgb(), outside_pixels.flags(), min_mapping_area
-                    );
+            executor(0, dst_rect.height(), [&](int dy_begin, int dy_end)
+            {
+                affineTransformGeneric<uint32_t, RgbColorMixer<AccumType>>(
+                    src_data, src_rgb32.bytesPerLine() / 4, src_rgb32.size(),
+                    dst_data, dst.bytesPerLine() / 4, xform, dst_rect,
+                    outside_pixels.rgb(), outside_pixels.flags(), min_mapping_area,
+                    dy_begin, dy_end
+                );
+            });
             return dst;
         }
         else
@@ -431,13 +446,19 @@ QImage affineTransform(
              * (think thumbnail creation). We could have used uint64_t, but float provides
              * better performance, at least on my machine.
              */
+            uint32_t const* const src_data = (uint32_t const*)src_argb32.bits();
+            uint32_t* const dst_data = (uint32_t*)dst.bits();
+
             typedef float AccumType;
-            affineTransformGeneric<uint32_t, ArgbColorMixer<AccumType>>(
-                        (uint32_t const*)src_argb32.bits(),
-                        src_argb32.bytesPerLine() / 4, src_argb32.size(),
-                        (uint32_t*)dst.bits(), dst.bytesPerLine() / 4, xform, dst_rect,
-                        outside_pixels.rgba(), outside_pixels.flags(), min_mapping_area
-                    );
+            executor(0, dst_rect.height(), [&](int dy_begin, int dy_end)
+            {
+                affineTransformGeneric<uint32_t, ArgbColorMixer<AccumType>>(
+                    src_data, src_argb32.bytesPerLine() / 4, src_argb32.size(),
+                    dst_data, dst.bytesPerLine() / 4, xform, dst_rect,
+                    outside_pixels.rgba(), outside_pixels.flags(), min_mapping_area,
+                    dy_begin, dy_end
+                );
+            });
             return dst;
         }
     }
@@ -446,7 +467,7 @@ QImage affineTransform(
 GrayImage affineTransformToGray(
     QImage const& src, QTransform const& xform,
     QRect const& dst_rect, OutsidePixels const outside_pixels,
-    QSizeF const& min_mapping_area)
+    QSizeF const& min_mapping_area, RangeExecutor const& executor)
 {
     if (src.isNull() || dst_rect.isEmpty())
     {
@@ -466,13 +487,19 @@ GrayImage affineTransformToGray(
     GrayImage const gray_src(src);
     GrayImage dst(dst_rect.size());
 
+    uint8_t const* const src_data = gray_src.data();
+    uint8_t* const dst_data = dst.data();
+
     typedef unsigned AccumType;
-    affineTransformGeneric<uint8_t, GrayColorMixer<AccumType>>(
-                gray_src.data(), gray_src.stride(), gray_src.size(),
-                dst.data(), dst.stride(), xform, dst_rect,
-                outside_pixels.grayLevel(), outside_pixels.flags(),
-                min_mapping_area
-            );
+    executor(0, dst_rect.height(), [&](int dy_begin, int dy_end)
+    {
+        affineTransformGeneric<uint8_t, GrayColorMixer<AccumType>>(
+            src_data, gray_src.stride(), gray_src.size(),
+            dst_data, dst.stride(), xform, dst_rect,
+            outside_pixels.grayLevel(), outside_pixels.flags(),
+            min_mapping_area, dy_begin, dy_end
+        );
+    });
 
     return dst;
 }
@@ -20,6 +20,7 @@
 #define IMAGEPROC_TRANSFORM_H_
 
 #include "imageproc_config.h"
+#include "ParallelFor.h"
 #include <QSizeF>
 #include <QColor>
 #include <stdint.h>
@@ -112,6 +113,8 @@ private:
  * \param min_mapping_area Defines the minimum rectangle in the source image
  *        that maps to a destination pixel.  This can be used to control
  *        smoothing.
+ * \param executor Processes bands of destination rows. Passing parallelFor
+ *        splits the work across threads without affecting the result.
  * \return The transformed image.  It's format may differ from the
  *         source image format, for example Format_Indexed8 may
  *         be transformed to Format_RGB32, if the source image
@@ -120,7 +123,8 @@ private:
 IMAGEPROC_EXPORT QImage affineTransform(
     QImage const& src, QTransform const& xform,
     QRect const& dst_rect, OutsidePixels outside_pixels,
-    QSizeF const& min_mapping_area = QSizeF(0.9, 0.9));
+    QSizeF const& min_mapping_area = QSizeF(0.9, 0.9),
+    RangeExecutor const& executor = &serialFor);
 
 /**
  * \brief Apply an affine transformation to the image.
@@ -131,7 +135,8 @@ IMAGEPROC_EXPORT QImage affineTransform(
 IMAGEPROC_EXPORT GrayImage affineTransformToGray(
     QImage const& src, QTransform const& xform,
     QRect const& dst_rect, OutsidePixels outside_pixels,
-    QSizeF const& min_mapping_area = QSizeF(0.9, 0.9));
+    QSizeF const& min_mapping_area = QSizeF(0.9, 0.9),
+    RangeExecutor const& executor = &serialFor);
 
 } // namespace imageproc
 
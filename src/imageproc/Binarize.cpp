@@ -31,6 +31,7 @@
 #include "BinaryThreshold.h"
 #include "Grayscale.h"
 #include "GrayImage.h"
+#include "LocalStats.h"
 #include "RasterOpGeneric.h"
 #include "GaussBlur.h"
 
@@ -415,12 +416,23 @@ BinaryImage binarizeNiblack(
     unsigned char const bound_lower,
     unsigned char const bound_upper)
 {
+    return binarizeNiblack(LocalStats(src, radius), k, delta, bound_lower, bound_upper);
+}
+
+BinaryImage binarizeNiblack(
+    LocalStats const& stats,
+    float const k,
+    int const delta,
+    unsigned char const bound_lower,
+    unsigned char const bound_upper)
+{
+    GrayImage const& src = stats.source();
     if (src.isNull())
     {
         return BinaryImage();
     }
 
-    GrayImage threshold_map(grayNiblackMap(src, radius, k, delta));
+    GrayImage threshold_map(grayNiblackMap(stats, k, delta));
     BinaryImage bw_img(binarizeFromMap(src, threshold_map, 0, bound_lower, bound_upper));
 
     return bw_img;
@@ -570,12 +582,23 @@ BinaryImage binarizeSauvola(
     unsigned char const bound_lower,
     unsigned char const bound_upper)
 {
+    return binarizeSauvola(LocalStats(src, radius), k, delta, bound_lower, bound_upper);
+}
+
+BinaryImage binarizeSauvola(
+    LocalStats const& stats,
+    float const k,
+    int const delta,
+    unsigned char const bound_lower,
+    unsigned char const bound_upper)
+{
+    GrayImage const& src = stats.source();
     if (src.isNull())
     {
         return BinaryImage();
     }
 
-    GrayImage threshold_map(graySauvolaMap(src, radius, k, delta));
+    GrayImage threshold_map(graySauvolaMap(stats, k, delta));
     BinaryImage bw_img(binarizeFromMap(src, threshold_map, 0, bound_lower, bound_upper));
 
     return bw_img;
@@ -595,12 +618,23 @@ BinaryImage binarizeWolf(
     unsigned char const bound_lower,
     unsigned char const bound_upper)
 {
+    return binarizeWolf(LocalStats(src, radius), k, delta, bound_lower, bound_upper);
+}
+
+BinaryImage binarizeWolf(
+    LocalStats const& stats,
+    float const k,
+    int const delta,
+    unsigned char const bound_lower,
+    unsigned char const bound_upper)
+{
+    GrayImage const& src = stats.source();
     if (src.isNull())
     {
         return BinaryImage();
     }
 
-    GrayImage threshold_map(grayWolfMap(src, radius, k, delta));
+    GrayImage threshold_map(grayWolfMap(stats, k, delta));
     BinaryImage bw_img(binarizeFromMap(src, threshold_map, 0, bound_lower, bound_upper));
 
     return bw_img;
@@ -625,12 +659,23 @@ BinaryImage binarizeWindow(
     unsigned char const bound_lower,
     unsigned char const bound_upper)
 {
+    return binarizeWindow(LocalStats(src, radius), k, delta, bound_lower, bound_upper);
+}
+
+BinaryImage binarizeWindow(
+    LocalStats const& stats,
+    float const k,
+    int const delta,
+    unsigned char const bound_lower,
+    unsigned char const bound_upper)
+{
+    GrayImage const& src = stats.source();
     if (src.isNull())
     {
         return BinaryImage();
     }
 
-    GrayImage threshold_map(grayWindowMap(src, radius, k, delta));
+    GrayImage threshold_map(grayWindowMap(stats, k, delta));
     BinaryImage bw_img(binarizeFromMap(src, threshold_map, 0, bound_lower, bound_upper));
 
     return bw_img;
@@ -647,12 +692,23 @@ BinaryImage binarizeBradley(
     unsigned char const bound_lower,
     unsigned char const bound_upper)
 {
+    return binarizeBradley(LocalStats(src, radius, LocalStats::MEAN), k, delta, bound_lower, bound_upper);
+}
+
+BinaryImage binarizeBradley(
+    LocalStats const& stats,
+    float const k,
+    int const delta,
+    unsigned char const bound_lower,
+    unsigned char const bound_upper)
+{
+    GrayImage const& src = stats.source();
     if (src.isNull())
     {
         return BinaryImage();
     }
 
-    GrayImage threshold_map(grayBradleyMap(src, radius, k));
+    GrayImage threshold_map(grayBradleyMap(stats, k));
     BinaryImage bw_img(binarizeFromMap(src, threshold_map, delta, bound_lower, bound_upper));
 
     return bw_img;
@@ -671,12 +727,23 @@ BinaryImage binarizeNick(
     unsigned char const bound_lower,
     unsigned char const bound_upper)
 {
+    return binarizeNick(LocalStats(src, radius), k, delta, bound_lower, bound_upper);
+}
+
+BinaryImage binarizeNick(
+    LocalStats const& stats,
+    float const k,
+    int const delta,
+    unsigned char const bound_lower,
+    unsigned char const bound_upper)
+{
+    GrayImage const& src = stats.source();
     if (src.isNull())
     {
         return BinaryImage();
     }
 
-    GrayImage threshold_map(grayNickMap(src, radius, k, delta));
+    GrayImage threshold_map(grayNickMap(stats, k, delta));
     BinaryImage bw_img(binarizeFromMap(src, threshold_map, 0, bound_lower, bound_upper));
 
     return bw_img;
@@ -773,12 +840,23 @@ BinaryImage binarizeSingh(
     unsigned char const bound_lower,
     unsigned char const bound_upper)
 {
+    return binarizeSingh(LocalStats(src, radius, LocalStats::MEAN), k, delta, bound_lower, bound_upper);
+}
+
+BinaryImage binarizeSingh(
+    LocalStats const& stats,
+    float const k,
+    int const delta,
+    unsigned char const bound_lower,
+    unsigned char const bound_upper)
+{
+    GrayImage const& src = stats.source();
     if (src.isNull())
     {
         return BinaryImage();
     }
 
-    GrayImage threshold_map(graySinghMap(src, radius, k, delta));
+    GrayImage threshold_map(graySinghMap(stats, k, delta));
     BinaryImage bw_img(binarizeFromMap(src, threshold_map, 0, bound_lower, bound_upper));
 
     return bw_img;
@@ -796,12 +874,23 @@ BinaryImage binarizeFox(
     unsigned char const bound_lower,
     unsigned char const bound_upper)
 {
+    return binarizeFox(LocalStats(src, radius, LocalStats::MEAN), k, delta, bound_lower, bound_upper);
+}
+
+BinaryImage binarizeFox(
+    LocalStats const& stats,
+    float const k,
+    int const delta,
+    unsigned char const bound_lower,
+    unsigned char const bound_upper)
+{
+    GrayImage const& src = stats.source();
     if (src.isNull())
     {
         return BinaryImage();
     }
 
-    GrayImage threshold_map(grayFoxMap(src, radius, k, delta));
+    GrayImage threshold_map(grayFoxMap(stats, k, delta));
     BinaryImage bw_img(binarizeFromMap(src, threshold_map, 0, bound_lower, bound_upper));
 
     return bw_img;
@@ -821,12 +910,23 @@ BinaryImage binarizeWAN(
     unsigned char const bound_lower,
     unsigned char const bound_upper)
 {
+    return binarizeWAN(LocalStats(src, radius), k, delta, bound_lower, bound_upper);
+}
+
+BinaryImage binarizeWAN(
+    LocalStats const& stats,
+    float const k,
+    int const delta,
+    unsigned char const bound_lower,
+    unsigned char const bound_upper)
+{
+    GrayImage const& src = stats.source();
     if (src.isNull())
     {
         return BinaryImage();
     }
 
-    GrayImage threshold_map(grayWANMap(src, radius, k, delta));
+    GrayImage threshold_map(grayWANMap(stats, k, delta));
     BinaryImage bw_img(binarizeFromMap(src, threshold_map, 0, bound_lower, bound_upper));
 
     return bw_img;
@@ -29,6 +29,7 @@ namespace imageproc
 
 class BinaryImage;
 class GrayImage;
+class LocalStats;
 
 /**
  * \brief Image binarization using Otsu's global thresholding method.
@@ -127,6 +128,12 @@ IMAGEPROC_EXPORT BinaryImage binarizeNiblack(
     int delta = 0,
     unsigned char lower_bound = 0,
     unsigned char upper_bound = 255);
+IMAGEPROC_EXPORT BinaryImage binarizeNiblack(
+    LocalStats const& stats,
+    float k = 0.20f,
+    int delta = 0,
+    unsigned char lower_bound = 0,
+    unsigned char upper_bound = 255);
 
 /**
  * \brief Image binarization using Gatos' local thresholding method.
@@ -163,6 +170,12 @@ IMAGEPROC_EXPORT BinaryImage binarizeSauvola(
     int delta = 0,
     unsigned char lower_bound = 0,
     unsigned char upper_bound = 255);
+IMAGEPROC_EXPORT BinaryImage binarizeSauvola(
+    LocalStats const& stats,
+    float k = 0.30f,
+    int delta = 0,
+    unsigned char lower_bound = 0,
+    unsigned char upper_bound = 255);
 
 /**
  * \brief Image binarization using Wolf's local thresholding method.
@@ -181,6 +194,12 @@ IMAGEPROC_EXPORT BinaryImage binarizeWolf(
     int delta = 0,
     unsigned char lower_bound = 0,
     unsigned char upper_bound = 255);
+IMAGEPROC_EXPORT BinaryImage binarizeWolf(
+    LocalStats const& stats,
+    float k = 0.30f,
+    int delta = 0,
+    unsigned char lower_bound = 0,
+    unsigned char upper_bound = 255);
 
 /**
  * \brief Image binarization using Dynamic Window based thresholding method.
@@ -197,6 +216,12 @@ IMAGEPROC_EXPORT BinaryImage binarizeWindow(
     int delta = 0,
     unsigned char lower_bound = 0,
     unsigned char upper_bound = 255);
+IMAGEPROC_EXPORT BinaryImage binarizeWindow(
+    LocalStats const& stats,
+    float k = 1.0f,
+    int delta = 0,
+    unsigned char lower_bound = 0,
+    unsigned char upper_bound = 255);
 
 /**
  * \brief Image binarization using Bradley's adaptive thresholding method.
@@ -211,6 +236,12 @@ IMAGEPROC_EXPORT BinaryImage binarizeBradley(
     int delta = 0,
     unsigned char lower_bound = 0,
     unsigned char upper_bound = 255);
+IMAGEPROC_EXPORT BinaryImage binarizeBradley(
+    LocalStats const& stats,
+    float k = 0.20f,
+    int delta = 0,
+    unsigned char lower_bound = 0,
+    unsigned char upper_bound = 255);
 
 /**
   * \brief Image binarization using N.I.C.K.'s local thresholding method.
@@ -225,6 +256,12 @@ IMAGEPROC_EXPORT BinaryImage binarizeNick(
     int delta = 0,
     unsigned char lower_bound = 0,
     unsigned char upper_bound = 255);
+IMAGEPROC_EXPORT BinaryImage binarizeNick(
+    LocalStats const& stats,
+    float k = 0.10f,
+    int delta = 0,
+    unsigned char lower_bound = 0,
+    unsigned char upper_bound = 255);
 
 /**
  * \brief Image binarization using Grad local/global thresholding method.
@@ -257,6 +294,12 @@ IMAGEPROC_EXPORT BinaryImage binarizeSingh(
     int delta = 0,
     unsigned char lower_bound = 0,
     unsigned char upper_bound = 255);
+IMAGEPROC_EXPORT BinaryImage binarizeSingh(
+    LocalStats const& stats,
+    float k = 0.30f,
+    int delta = 0,
+    unsigned char lower_bound = 0,
+    unsigned char upper_bound = 255);
 
 /**
  * \brief Image binarization using Fox adaptive thresholding method.
@@ -270,6 +313,12 @@ IMAGEPROC_EXPORT BinaryImage binarizeFox(
     int delta = 0,
     unsigned char lower_bound = 0,
     unsigned char upper_bound = 255);
+IMAGEPROC_EXPORT BinaryImage binarizeFox(
+    LocalStats const& stats,
+    float k = 0.30f,
+    int delta = 0,
+    unsigned char lower_bound = 0,
+    unsigned char upper_bound = 255);
 /**
  * \brief Image binarization using WAN's local thresholding method.
  *
@@ -284,6 +333,12 @@ IMAGEPROC_EXPORT BinaryImage binarizeWAN(
     int delta = 0,
     unsigned char lower_bound = 0,
     unsigned char upper_bound = 255);
+IMAGEPROC_EXPORT BinaryImage binarizeWAN(
+    LocalStats const& stats,
+    float k = 0.30f,
+    int delta = 0,
+    unsigned char lower_bound = 0,
+    unsigned char upper_bound = 255);
 
 /**
  * \brief Image binarization using EdgeDiv (EdgePlus & BlurDiv) local/global thresholding method.
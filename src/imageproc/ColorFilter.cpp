@@ -35,6 +35,7 @@
 #include "BinaryImage.h"
 #include "Binarize.h"
 #include "ColorFilter.h"
+#include "Trace.h"
 
 namespace imageproc
 {
@@ -1526,6 +1527,79 @@ void paletteYCbCrtoRGB(
     }
 }
 
+namespace
+{
+
+/**
+ * hsvKMeansInPlace() clusters a histogram of colours rather than
+ * individual pixels. Each colour component is quantized to this many
+ * bits, and foreground and background pixels go to separate bins.
+ */
+int const KMEANS_BITS = 5;
+
+int const KMEANS_LEVELS = 1 << KMEANS_BITS;
+
+/** The number of bins for either foreground or background pixels. */
+int const KMEANS_BINS = KMEANS_LEVELS * KMEANS_LEVELS * KMEANS_LEVELS;
+
+/**
+ * A non-empty histogram bin, represented by the mean colour of its pixels.
+ */
+struct ColorBin
+{
+    float h, s, v;
+    uint32_t len;
+    bool fg;
+    int index;
+    int cluster;
+};
+
+inline int colorBinIndex(QRgb const hsv, bool const fg)
+{
+    int const shift = 8 - KMEANS_BITS;
+    int const idx = ((qRed(hsv) >> shift) * KMEANS_LEVELS + (qGreen(hsv) >> shift))
+                    * KMEANS_LEVELS + (qBlue(hsv) >> shift);
+    return fg ? (idx + KMEANS_BINS) : idx;
+}
+
+/**
+ * Foreground bins go to the nearest of clusters [1, fgcount], background
+ * ones to the nearest of [fgcount + 1, ncount]. Clusters 0 and ncount + 1
+ * take the bins of a kind that has no clusters of its own.
+ */
+int nearestCluster(
+    ColorBin const& bin, double const* mean_h, double const* mean_s, double const* mean_v,
+    int const fgcount, int const ncount)
+{
+    int first = fgcount + 1;
+    int last = ncount;
+    if (bin.fg)
+    {
+        first = 1;
+        last = fgcount;
+    }
+    if (first > last)
+    {
+        return bin.fg ? 0 : (ncount + 1);
+    }
+
+    float dist_min = -1.0f;
+    int indx_min = first;
+    for (int k = first; k <= last; k++)
+    {
+        float const dist = pixelDistance(bin.h, bin.s, bin.v, mean_h[k], mean_s[k], mean_v[k]);
+        if ((dist_min < 0.0f) || (dist < dist_min))
+        {
+            indx_min = k;
+            dist_min = dist;
+        }
+    }
+
+    return indx_min;
+}
+
+} // anonymous namespace
+
 double hsvKMeansInPlace(
     QImage& dst,
     QImage const& image,
@@ -1540,6 +1614,8 @@ double hsvKMeansInPlace(
     bool const find_black,
     bool const find_white)
 {
+    TraceSpan const span("output", "hsvKMeansInPlace", dst.size());
+
     double mse = 0.0;
     if (dst.isNull() || image.isNull() || mask.isNull())
     {
@@ -1609,7 +1685,7 @@ double hsvKMeansInPlace(
         }
 
         /* len clusters*/
-        uint32_t mean_len[256] = {0};
+        double mean_len[256] = {0.0};
         /* defaults clusters*/
         double mean_h0[256] = {0.0};
         double mean_s0[256] = {0.0};
@@ -1621,20 +1697,51 @@ double hsvKMeansInPlace(
         /* sort clusters*/
         float dist_c[256] = {0.0f}, dist_c_max = 0.0f;
         bool dist_bg[256] = {false};
-        /* reinit clusters*/
-        unsigned int mean_y[256] = {0};
-        unsigned int mean_x[256] = {0};
 
         uint32_t const msb = uint32_t(1) << 31;
 
-        GrayImage clusters(image);
-        if (clusters.isNull())
+        /* histogram of zone pixels */
+        std::vector<ColorBin> bins;
         {
-            return mse;
-        }
+            std::vector<uint32_t> bin_len(KMEANS_BINS * 2, 0);
+            std::vector<uint64_t> bin_sum(KMEANS_BINS * 2 * 3, 0);
+
+            for (unsigned int y = 0; y < h; y++)
+            {
+                QRgb const* rowh = (QRgb const*)hsv_img.constScanLine(y);
+                for (unsigned int x = 0; x < w; x++)
+                {
+                    if (mask_zones_line[x >> 5] & (msb >> (x & 31)))
+                    {
+                        bool const fg = (mask_line[x >> 5] & (msb >> (x & 31))) != 0;
+                        int const idx = colorBinIndex(rowh[x], fg);
+                        bin_len[idx]++;
+                        bin_sum[idx * 3] += qRed(rowh[x]);
+                        bin_sum[idx * 3 + 1] += qGreen(rowh[x]);
+                        bin_sum[idx * 3 + 2] += qBlue(rowh[x]);
+                    }
+                }
+                mask_line += mask_stride;
+                mask_zones_line += mask_zones_stride;
+            }
 
-        unsigned char* clusters_line = clusters.data();
-        int const clusters_stride = clusters.stride();
+            for (int idx = 0; idx < KMEANS_BINS * 2; idx++)
+            {
+                if (bin_len[idx] > 0)
+                {
+                    double const bin_lr = 1.0 / bin_len[idx];
+                    ColorBin bin;
+                    bin.h = (float) (bin_sum[idx * 3] * bin_lr);
+                    bin.s = (float) (bin_sum[idx * 3 + 1] * bin_lr);
+                    bin.v = (float) (bin_sum[idx * 3 + 2] * bin_lr);
+                    bin.len = bin_len[idx];
+                    bin.fg = (idx >= KMEANS_BINS);
+                    bin.index = idx;
+                    bin.cluster = 0;
+                    bins.push_back(bin);
+                }
+            }
+        }
 
         /* init clusters */
         paletteHSVcylinderGenerate(mean_h0, mean_s0, mean_v0, ncount, start_value);
@@ -1642,31 +1749,19 @@ double hsvKMeansInPlace(
         /* find and sort clusters */
         for (int i = 1; i <= ncount; i++)
         {
-            mask_zones_line = mask_zones.data();
             float dist_min = -1.0f;
-            for (unsigned int y = 0; y < h; y++)
+            for (ColorBin const& bin : bins)
             {
-                QRgb *rowh = (QRgb*)hsv_img.constScanLine(y);
-                for (unsigned int x = 0; x < w; x++)
+                float const dist = pixelDistance(bin.h, bin.s, bin.v, mean_h0[i], mean_s0[i], mean_v0[i]);
+                if ((dist_min < 0.0f) || (dist < dist_min))
                 {
-                    if (mask_zones_line[x >> 5] & (msb >> (x & 31)))
-                    {
-                        float const hsv_h = qRed(rowh[x]);
-                        float const hsv_s = qGreen(rowh[x]);
-                        float const hsv_v = qBlue(rowh[x]);
-                        float const dist = pixelDistance(hsv_h, hsv_s, hsv_v, mean_h0[i], mean_s0[i], mean_v0[i]);
-                        if ((dist_min < 0.0f) || (dist < dist_min))
-                        {
-                            mean_h[i] = hsv_h;
-                            mean_s[i] = hsv_s;
-                            mean_v[i] = hsv_v;
-                            dist_c[i] = dist;
-                            dist_min = dist;
-                            dist_bg[i] = (mask_line[x >> 5] & (msb >> (x & 31))) ? false : true;
-                        }
-                    }
+                    mean_h[i] = bin.h;
+                    mean_s[i] = bin.s;
+                    mean_v[i] = bin.v;
+                    dist_c[i] = dist;
+                    dist_min = dist;
+                    dist_bg[i] = !bin.fg;
                 }
-                mask_zones_line += mask_zones_stride;
             }
             dist_c_max = (dist_c_max < dist_c[i]) ? dist_c[i] : dist_c_max;
             mean_h0[i] = mean_h[i];
@@ -1712,36 +1807,21 @@ double hsvKMeansInPlace(
         /* reinit clusters (separate fg and bg) */
         for (int i = 1; i <= ncount; i++)
         {
-            mask_line = mask.data();
-            mask_zones_line = mask_zones.data();
+            bool const fg = (i <= fgcount);
             float dist_min = -1.0f;
-            for (unsigned int y = 0; y < h; y++)
+            for (ColorBin const& bin : bins)
             {
-                QRgb *rowh = (QRgb*)hsv_img.constScanLine(y);
-                for (unsigned int x = 0; x < w; x++)
+                if (bin.fg == fg)
                 {
-                    if (mask_zones_line[x >> 5] & (msb >> (x & 31)))
+                    float const dist = pixelDistance(bin.h, bin.s, bin.v, mean_h0[i], mean_s0[i], mean_v0[i]);
+                    if ((dist_min < 0.0f) || (dist < dist_min))
                     {
-                        if ((i > fgcount) ^ (mask_line[x >> 5] & (msb >> (x & 31))))
-                        {
-                            float const hsv_h = qRed(rowh[x]);
-                            float const hsv_s = qGreen(rowh[x]);
-                            float const hsv_v = qBlue(rowh[x]);
-                            float const dist = pixelDistance(hsv_h, hsv_s, hsv_v, mean_h0[i], mean_s0[i], mean_v0[i]);
-                            if ((dist_min < 0.0f) || (dist < dist_min))
-                            {
-                                mean_h[i] = hsv_h;
-                                mean_s[i] = hsv_s;
-                                mean_v[i] = hsv_v;
-                                mean_y[i] = y;
-                                mean_x[i] = x;
-                                dist_min = dist;
-                            }
-                        }
+                        mean_h[i] = bin.h;
+                        mean_s[i] = bin.s;
+                        mean_v[i] = bin.v;
+                        dist_min = dist;
                     }
                 }
-                mask_line += mask_stride;
-                mask_zones_line += mask_zones_stride;
             }
             mean_h0[i] = mean_h[i];
             mean_s0[i] = mean_s[i];
@@ -1749,62 +1829,12 @@ double hsvKMeansInPlace(
         }
 
         /* init clusters map */
-        mask_line = mask.data();
-        for (unsigned int y = 0; y < h; y++)
+        for (ColorBin& bin : bins)
         {
-            QRgb *rowh = (QRgb*)hsv_img.constScanLine(y);
-            for (unsigned int x = 0; x < w; x++)
-            {
-                float const hsv_h = qRed(rowh[x]);
-                float const hsv_s = qGreen(rowh[x]);
-                float const hsv_v = qBlue(rowh[x]);
-                float dist_min = -1.0f;
-                int indx_min = 0;
-                if (mask_line[x >> 5] & (msb >> (x & 31)))
-                {
-                    if (fgcount > 0)
-                    {
-                        for (int k = 1; k <= fgcount; k++)
-                        {
-                            float const dist = pixelDistance(hsv_h, hsv_s, hsv_v, mean_h[k], mean_s[k], mean_v[k]);
-                            if ((dist_min < 0.0f) || (dist < dist_min))
-                            {
-                                indx_min = k;
-                                dist_min = dist;
-                            }
-                        }
-                    }
-                    else
-                    {
-                        indx_min = 0;
-                    }
-                }
-                else
-                {
-                    if (bgcount > 0)
-                    {
-                        for (int k = (fgcount + 1); k <= ncount; k++)
-                        {
-                            float const dist = pixelDistance(hsv_h, hsv_s, hsv_v, mean_h[k], mean_s[k], mean_v[k]);
-                            if ((dist_min < 0.0f) || (dist < dist_min))
-                            {
-                                indx_min = k;
-                                dist_min = dist;
-                            }
-                        }
-                    }
-                    else
-                    {
-                        indx_min = ncount + 1;
-                    }
-                }
-                clusters_line[x] = indx_min;
-            }
-            mask_line += mask_stride;
-            clusters_line += clusters_stride;
+            bin.cluster = nearestCluster(bin, mean_h, mean_s, mean_v, fgcount, ncount);
         }
 
-        /* iteration clusters map */
+        /* iteration clusters map (weighted by bin populations) */
         for (unsigned int itr = 0; itr < 50; itr++)
         {
             for (int i = 0; i < sfull; i++)
@@ -1812,118 +1842,47 @@ double hsvKMeansInPlace(
                 mean_h[i] = 0.0;
                 mean_s[i] = 0.0;
                 mean_v[i] = 0.0;
-                mean_len[i] = 0;
+                mean_len[i] = 0.0;
             }
 
-            mask_zones_line = mask_zones.data();
-            clusters_line = clusters.data();
-            for (unsigned int y = 0; y < h; y++)
+            for (ColorBin const& bin : bins)
             {
-                QRgb *rowh = (QRgb*)hsv_img.constScanLine(y);
-                for (unsigned int x = 0; x < w; x++)
-                {
-                    if (mask_zones_line[x >> 5] & (msb >> (x & 31)))
-                    {
-                        int const cluster = clusters_line[x];
-                        float const hsv_h = qRed(rowh[x]);
-                        float const hsv_s = qGreen(rowh[x]);
-                        float const hsv_v = qBlue(rowh[x]);
-                        mean_h[cluster] += hsv_h;
-                        mean_s[cluster] += hsv_s;
-                        mean_v[cluster] += hsv_v;
-                        mean_len[cluster]++;
-                    }
-                }
-                mask_zones_line += mask_zones_stride;
-                clusters_line += clusters_stride;
+                int const cluster = bin.cluster;
+                mean_h[cluster] += (double) bin.h * bin.len;
+                mean_s[cluster] += (double) bin.s * bin.len;
+                mean_v[cluster] += (double) bin.v * bin.len;
+                mean_len[cluster] += bin.len;
             }
-            clusters_line = clusters.data();
+
             uint32_t changes = 0;
             for (int i = 0; i < sfull; i++)
             {
-                if (mean_len[i] > 0)
+                if (mean_len[i] > 0.0)
                 {
-                    float const mean_lr = 1.0f / (float) mean_len[i];
+                    double const mean_lr = 1.0 / mean_len[i];
                     mean_h[i] *= mean_lr;
                     mean_s[i] *= mean_lr;
                     mean_v[i] *= mean_lr;
                 }
                 else
                 {
+                    /* re-seed an empty cluster: its initial mean is the colour
+                       of its seed bin, which then goes back to it, unless
+                       another cluster has the very same mean */
                     mean_h[i] = mean_h0[i];
                     mean_s[i] = mean_s0[i];
                     mean_v[i] = mean_v0[i];
-
-                    unsigned int y0 = mean_y[i];
-                    unsigned int x0 = mean_x[i];
-                    uint32_t indx = y0 * clusters_stride + x0;
-                    int const cluster = clusters_line[indx];
-                    mean_len[cluster]--;
-                    clusters_line[indx] = i;
-                    mean_len[i] = 1;
-                    changes++;
                 }
             }
 
-            mask_line = mask.data();
-            clusters_line = clusters.data();
-            for (unsigned int y = 0; y < h; y++)
+            for (ColorBin& bin : bins)
             {
-                QRgb *rowh = (QRgb*)hsv_img.constScanLine(y);
-                for (unsigned int x = 0; x < w; x++)
+                int const cluster = nearestCluster(bin, mean_h, mean_s, mean_v, fgcount, ncount);
+                if (cluster != bin.cluster)
                 {
-                    float const hsv_h = qRed(rowh[x]);
-                    float const hsv_s = qGreen(rowh[x]);
-                    float const hsv_v = qBlue(rowh[x]);
-                    float dist_min = -1.0f;
-                    int indx_min = 0;
-                    if (mask_line[x >> 5] & (msb >> (x & 31)))
-                    {
-                        if (fgcount > 0)
-                        {
-                            for (int k = 1; k <= fgcount; k++)
-                            {
-                                float const dist = pixelDistance(hsv_h, hsv_s, hsv_v, mean_h[k], mean_s[k], mean_v[k]);
-                                if ((dist_min < 0.0f) || (dist < dist_min))
-                                {
-                                    indx_min = k;
-                                    dist_min = dist;
-                                }
-                            }
-                        }
-                        else
-                        {
-                            indx_min = 0;
-                        }
-                    }
-                    else
-                    {
-                        if (bgcount > 0)
-                        {
-                            for (int k = (fgcount + 1); k <= ncount; k++)
-                            {
-                                float const dist = pixelDistance(hsv_h, hsv_s, hsv_v, mean_h[k], mean_s[k], mean_v[k]);
-                                if ((dist_min < 0.0f) || (dist < dist_min))
-                                {
-                                    indx_min = k;
-                                    dist_min = dist;
-                                }
-                            }
-                        }
-                        else
-                        {
-                            indx_min = ncount + 1;
-                        }
-                    }
-                    if (indx_min != clusters_line[x])
-                    {
-                        clusters_line[x] = indx_min;
-                        changes++;
-                    }
-
+                    bin.cluster = cluster;
+                    changes++;
                 }
-                mask_line += mask_stride;
-                clusters_line += clusters_stride;
             }
 
             if (changes == 0)
@@ -2049,12 +2008,22 @@ double hsvKMeansInPlace(
         mean_v[ncount + 1] = 255.0;
 
         /* Replace pixels and metrics */
+        std::vector<uint8_t> bin_clusters(KMEANS_BINS * 2, 0);
+        for (ColorBin const& bin : bins)
+        {
+            bin_clusters[bin.index] = (uint8_t) bin.cluster;
+        }
+
+        QImage const image_rgb(image.convertToFormat(QImage::Format_RGB32));
+        QImage const dst_rgb(dst.convertToFormat(QImage::Format_RGB32));
         uint32_t cntkm = 0;
+        mask_line = mask.data();
         mask_zones_line = mask_zones.data();
-        clusters_line = clusters.data();
         for (unsigned int y = 0; y < h; y++)
         {
-            QRgb *rowh = (QRgb*)hsv_img.constScanLine(y);
+            QRgb* rowh = (QRgb*)hsv_img.scanLine(y);
+            QRgb const* rowi = (QRgb const*)image_rgb.constScanLine(y);
+            QRgb const* rowd = (QRgb const*)dst_rgb.constScanLine(y);
             double msel = 0.0;
             for (unsigned int x = 0; x < w; x++)
             {
@@ -2062,11 +2031,11 @@ double hsvKMeansInPlace(
                 if (mask_zones_line[x >> 5] & (msb >> (x & 31)))
                 {
                     int r0, g0, b0, dr, dg, db;
-                    QRgb const origin = image.pixel(x, y);
-                    r0 = qRed(origin);
-                    g0 = qGreen(origin);
-                    b0 = qBlue(origin);
-                    int const cluster = clusters_line[x];
+                    r0 = qRed(rowi[x]);
+                    g0 = qGreen(rowi[x]);
+                    b0 = qBlue(rowi[x]);
+                    bool const fg = (mask_line[x >> 5] & (msb >> (x & 31))) != 0;
+                    int const cluster = bin_clusters[colorBinIndex(rowh[x], fg)];
                     r = mean_h[cluster];
                     g = mean_s[cluster];
                     b = mean_v[cluster];
@@ -2079,16 +2048,15 @@ double hsvKMeansInPlace(
                 }
                 else
                 {
-                    QRgb const pixel = dst.pixel(x, y);
-                    r = qRed(pixel);
-                    g = qGreen(pixel);
-                    b = qBlue(pixel);
+                    r = qRed(rowd[x]);
+                    g = qGreen(rowd[x]);
+                    b = qBlue(rowd[x]);
                 }
                 rowh[x] = qRgb(r, g, b);
             }
             mse += msel;
+            mask_line += mask_stride;
             mask_zones_line += mask_zones_stride;
-            clusters_line += clusters_stride;
         }
         mse = (cntkm > 0) ? (sqrt(mse / cntkm / 3.0) / 255.0) : 0.0;
 
@@ -20,6 +20,7 @@
 #include "BinaryImage.h"
 #include "InfluenceMap.h"
 #include "ColorForId.h"
+#include "BitOps.h"
 #include <boost/foreach.hpp>
 #include <QImage>
 #include <QColor>
@@ -34,6 +35,132 @@ namespace imageproc
 uint32_t const ConnectivityMap::BACKGROUND = ~uint32_t(0);
 uint32_t const ConnectivityMap::UNTAGGED_FG = BACKGROUND - 1;
 
+namespace
+{
+
+/**
+ * The number of rows in a band labelled independently of other bands.
+ */
+int const BAND_HEIGHT = 64;
+
+/**
+ * A horizontal run of black pixels, spanning [xbegin, xend).
+ */
+struct Run
+{
+    int xbegin;
+    int xend;
+};
+
+struct Band
+{
+    std::vector<Run> runs;
+
+    /**
+     * rowRuns[i] is the index of the first run on the i-th row of the band.
+     * The last element is the total number of runs.
+     */
+    std::vector<uint32_t> rowRuns;
+};
+
+/**
+ * Returns the position of the first bit at or after \p x that is set
+ * in \p line, with \p invert applied to each word, or \p width if
+ * there is no such bit.
+ */
+int findBit(uint32_t const* line, int const width, int const x, uint32_t const invert)
+{
+    if (x >= width)
+    {
+        // With width being a multiple of 32, line[x >> 5] would be
+        // past the end of the line, or past the end of the image.
+        return width;
+    }
+
+    int const last_word = (width - 1) >> 5;
+    int word_idx = x >> 5;
+    uint32_t word = (line[word_idx] ^ invert) & (~uint32_t(0) >> (x & 31));
+    for (;;)
+    {
+        if (word)
+        {
+            return std::min(width, (word_idx << 5) + countMostSignificantZeroes(word));
+        }
+        if (++word_idx > last_word)
+        {
+            return width;
+        }
+        word = line[word_idx] ^ invert;
+    }
+}
+
+void extractRuns(uint32_t const* line, int const width, std::vector<Run>& runs)
+{
+    int x = 0;
+    while ((x = findBit(line, width, x, 0)) < width)
+    {
+        Run run;
+        run.xbegin = x;
+        run.xend = x = findBit(line, width, x, ~uint32_t(0));
+        runs.push_back(run);
+    }
+}
+
+/**
+ * Union-find lookup with path halving.  Because unite() always makes
+ * the lower index the root, parents[i] <= i holds for every node.
+ */
+uint32_t findRoot(uint32_t* const parents, uint32_t node)
+{
+    while (parents[node] != node)
+    {
+        parents[node] = parents[parents[node]];
+        node = parents[node];
+    }
+    return node;
+}
+
+void unite(uint32_t* const parents, uint32_t const node1, uint32_t const node2)
+{
+    uint32_t const root1 = findRoot(parents, node1);
+    uint32_t const root2 = findRoot(parents, node2);
+    if (root1 < root2)
+    {
+        parents[root2] = root1;
+    }
+    else if (root2 < root1)
+    {
+        parents[root1] = root2;
+    }
+}
+
+/**
+ * Unites runs on a row with the touching runs on the row above.
+ *
+ * \param slack 0 for 4-connectivity, 1 for 8-connectivity.
+ */
+void uniteRows(
+    Run const* const runs, uint32_t* const parents,
+    uint32_t const prev_begin, uint32_t const prev_end,
+    uint32_t const cur_begin, uint32_t const cur_end, int const slack)
+{
+    uint32_t prev = prev_begin;
+    for (uint32_t cur = cur_begin; cur < cur_end; ++cur)
+    {
+        Run const& run = runs[cur];
+        while (prev < prev_end && runs[prev].xend + slack <= run.xbegin)
+        {
+            ++prev;
+        }
+        for (uint32_t i = prev; i < prev_end && runs[i].xbegin < run.xend + slack; ++i)
+        {
+            unite(parents, i, cur);
+        }
+    }
+}
+
+} // anonymous namespace
+
 ConnectivityMap::ConnectivityMap()
     : m_pData(0),
       m_size(),
@@ -62,12 +189,19 @@ ConnectivityMap::ConnectivityMap(QSize const& size)
 }
 
 ConnectivityMap::ConnectivityMap(
-    BinaryImage const& image, Connectivity const conn)
+    BinaryImage const& image, Connectivity const conn,
+    std::vector<ComponentStats>* const stats,
+    RangeExecutor const& executor)
     : m_pData(0),
       m_size(image.size()),
       m_stride(0),
       m_maxLabel(0)
 {
+    if (stats)
+    {
+        stats->assign(1, ComponentStats());
+    }
+
     if (m_size.isEmpty())
     {
         return;
@@ -76,31 +210,11 @@ ConnectivityMap::ConnectivityMap(
     int const width = m_size.width();
     int const height = m_size.height();
 
-    m_data.resize((width + 2) * (height + 2), BACKGROUND);
+    m_data.resize((width + 2) * (height + 2), 0);
     m_stride = width + 2;
     m_pData = &m_data[0] + 1 + m_stride;
 
-    uint32_t* dst = m_pData;
-    int const dst_stride = m_stride;
-
-    uint32_t const* src = image.data();
-    int const src_stride = image.wordsPerLine();
-
-    uint32_t const msb = uint32_t(1) << 31;
-    for (int y = 0; y < height; ++y)
-    {
-        for (int x = 0; x < width; ++x)
-        {
-            if (src[x >> 5] & (msb >> (x & 31)))
-            {
-                dst[x] = UNTAGGED_FG;
-            }
-        }
-        src += src_stride;
-        dst += dst_stride;
-    }
-
-    assignIds(conn);
+    labelRuns(image, conn, stats, executor);
 }
 
 ConnectivityMap::ConnectivityMap(ConnectivityMap const& other)
@@ -279,6 +393,158 @@ ConnectivityMap::copyFromInfluenceMap(InfluenceMap const& imap)
     }
 }
 
+void
+ConnectivityMap::labelRuns(
+    BinaryImage const& image, Connectivity const conn,
+    std::vector<ComponentStats>* const stats,
+    RangeExecutor const& executor)
+{
+    int const width = m_size.width();
+    int const height = m_size.height();
+    int const slack = conn == CONN8 ? 1 : 0;
+    int const num_bands = (height + BAND_HEIGHT - 1) / BAND_HEIGHT;
+
+    uint32_t const* const src_data = image.data();
+    int const src_stride = image.wordsPerLine();
+
+    // Extract runs of black pixels, band by band.
+    std::vector<Band> bands(num_bands);
+    executor(0, num_bands, [&](int const first_band, int const last_band)
+    {
+        for (int b = first_band; b < last_band; ++b)
+        {
+            Band& band = bands[b];
+            int const y0 = b * BAND_HEIGHT;
+            int const y1 = std::min(height, y0 + BAND_HEIGHT);
+            band.rowRuns.reserve(y1 - y0 + 1);
+            uint32_t const* src_line = src_data + y0 * src_stride;
+            for (int y = y0; y < y1; ++y, src_line += src_stride)
+            {
+                band.rowRuns.push_back(band.runs.size());
+                extractRuns(src_line, width, band.runs);
+            }
+            band.rowRuns.push_back(band.runs.size());
+        }
+    });
+
+    // Runs of all bands are concatenated in raster order.
+    std::vector<uint32_t> band_offsets(num_bands + 1, 0);
+    for (int b = 0; b < num_bands; ++b)
+    {
+        band_offsets[b + 1] = band_offsets[b] + bands[b].runs.size();
+    }
+    uint32_t const num_runs = band_offsets[num_bands];
+    if (num_runs == 0)
+    {
+        return;
+    }
+
+    std::vector<Run> runs(num_runs);
+    std::vector<uint32_t> row_runs(height + 1);
+    std::vector<uint32_t> parents(num_runs);
+    row_runs[height] = num_runs;
+
+    // Label each band on its own.  Bands only touch their own
+    // ranges of runs and parents, so they don't interfere.
+    executor(0, num_bands, [&](int const first_band, int const last_band)
+    {
+        for (int b = first_band; b < last_band; ++b)
+        {
+            Band& band = bands[b];
+            uint32_t const offset = band_offsets[b];
+            std::copy(band.runs.begin(), band.runs.end(), runs.begin() + offset);
+
+            int const y0 = b * BAND_HEIGHT;
+            int const rows = band.rowRuns.size() - 1;
+            for (int i = 0; i < rows; ++i)
+            {
+                row_runs[y0 + i] = offset + band.rowRuns[i];
+            }
+            for (uint32_t i = offset; i < band_offsets[b + 1]; ++i)
+            {
+                parents[i] = i;
+            }
+            for (int i = 1; i < rows; ++i)
+            {
+                uniteRows(
+                    &runs[0], &parents[0],
+                    offset + band.rowRuns[i - 1], offset + band.rowRuns[i],
+                    offset + band.rowRuns[i], offset + band.rowRuns[i + 1], slack
+                );
+            }
+
+            std::vector<Run>().swap(band.runs);
+        }
+    });
+
+    // Merge components across band boundaries.
+    for (int b = 1; b < num_bands; ++b)
+    {
+        int const y = b * BAND_HEIGHT;
+        uniteRows(
+            &runs[0], &parents[0],
+            row_runs[y - 1], row_runs[y], row_runs[y], row_runs[y + 1], slack
+        );
+    }
+
+    // Replace parents with labels.  The root of each set is its first run
+    // in raster order, so labels come out in raster order of the first pixel.
+    // Every node below the current one already holds its final label,
+    // which makes it fine to read parents[parent] even for non-root parents.
+    uint32_t next_label = 1;
+    for (uint32_t i = 0; i < num_runs; ++i)
+    {
+        uint32_t const parent = parents[i];
+        parents[i] = (parent == i) ? next_label++ : parents[parent];
+    }
+    m_maxLabel = next_label - 1;
+
+    // Paint the runs.
+    executor(0, height, [&](int const first_row, int const last_row)
+    {
+        uint32_t* line = m_pData + first_row * m_stride;
+        for (int y = first_row; y < last_row; ++y, line += m_stride)
+        {
+            for (uint32_t i = row_runs[y]; i < row_runs[y + 1]; ++i)
+            {
+                std::fill(line + runs[i].xbegin, line + runs[i].xend, parents[i]);
+            }
+        }
+    });
+
+    if (!stats)
+    {
+        return;
+    }
+
+    stats->assign(m_maxLabel + 1, ComponentStats());
+    for (int y = 0; y < height; ++y)
+    {
+        for (uint32_t i = row_runs[y]; i < row_runs[y + 1]; ++i)
+        {
+            Run const& run = runs[i];
+            ComponentStats& cs = (*stats)[parents[i]];
+            int const len = run.xend - run.xbegin;
+            if (cs.pixCount == 0)
+            {
+                cs.seed = QPoint(run.xbegin, y);
+                cs.left = run.xbegin;
+                cs.right = run.xend - 1;
+                cs.top = y;
+            }
+            else
+            {
+                cs.left = std::min(cs.left, run.xbegin);
+                cs.right = std::max(cs.right, run.xend - 1);
+            }
+            cs.bottom = y;
+            cs.pixCount += len;
+            cs.xSum += 0.5 * double(run.xbegin + run.xend - 1) * len;
+            cs.ySum += double(y) * len;
+        }
+    }
+}
+
 void
 ConnectivityMap::assignIds(Connectivity const conn)
 {
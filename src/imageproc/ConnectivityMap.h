@@ -23,7 +23,11 @@
 #include "Connectivity.h"
 #include "FastQueue.h"
 #include "GridAccessor.h"
+#include "ParallelFor.h"
 #include <QSize>
+#include <QPoint>
+#include <QPointF>
+#include <QRect>
 #include <QColor>
 #include <Qt>
 #include <vector>
@@ -50,6 +54,55 @@ class InfluenceMap;
 class IMAGEPROC_EXPORT ConnectivityMap
 {
 public:
+    /**
+     * \brief Pixel count, bounding box and centroid of a labelled component.
+     */
+    struct ComponentStats
+    {
+        /**
+         * \brief The first pixel of the component in raster order.
+         */
+        QPoint seed;
+
+        // All are inclusive.
+        int left;
+        int top;
+        int right;
+        int bottom;
+
+        uint32_t pixCount;
+
+        /**
+         * \brief Sums of x and y coordinates of the component's pixels.
+         */
+        double xSum;
+        double ySum;
+
+        ComponentStats()
+            : left(0), top(0), right(-1), bottom(-1),
+              pixCount(0), xSum(0), ySum(0) {}
+
+        int width() const
+        {
+            return right - left + 1;
+        }
+
+        int height() const
+        {
+            return bottom - top + 1;
+        }
+
+        QRect rect() const
+        {
+            return QRect(QPoint(left, top), QPoint(right, bottom));
+        }
+
+        QPointF centroid() const
+        {
+            return pixCount ? QPointF(xSum / pixCount, ySum / pixCount) : QPointF();
+        }
+    };
+
     /**
      * \brief Constructs a null connectivity map.
      *
@@ -66,8 +119,25 @@ public:
 
     /**
      * \brief Labels components in a binary image.
+     *
+     * Runs of black pixels are extracted directly from the packed
+     * image words and joined with a union-find structure.  Bands of rows
+     * are labelled independently, after which the runs meeting at band
+     * boundaries are merged.  Labels are assigned in raster order of each
+     * component's first pixel, which is what the other constructors do
+     * as well.
+     *
+     * \param image The image to label.
+     * \param conn Pixel connectivity.
+     * \param stats If provided, will be resized to maxLabel() + 1 and
+     *        filled with statistics of each component, indexed by label.
+     *        Element zero is left default-constructed.  Computing them
+     *        here is cheaper than scanning the map afterwards.
+     * \param executor Used to process bands of rows.
      */
-    ConnectivityMap(BinaryImage const& image, Connectivity conn);
+    ConnectivityMap(BinaryImage const& image, Connectivity conn,
+                    std::vector<ComponentStats>* stats = 0,
+                    RangeExecutor const& executor = &parallelFor);
 
     /**
      * \brief Same as the version working with BinaryImage
@@ -225,6 +295,10 @@ public:
 private:
     void copyFromInfluenceMap(InfluenceMap const& imap);
 
+    void labelRuns(BinaryImage const& image, Connectivity conn,
+                   std::vector<ComponentStats>* stats,
+                   RangeExecutor const& executor);
+
     void assignIds(Connectivity conn);
 
     uint32_t initialTagging();
@@ -209,108 +209,242 @@ void IMAGEPROC_EXPORT calcBackwardPassInitialConditions(
 
 void IMAGEPROC_EXPORT initPaddingLayers(Grid<float>& intermediate_image);
 
-} // namespace gauss_blur_impl
+/**
+ * The number of columns (rows) the vertical (horizontal) pass processes
+ * together.  The recursion state of those is interleaved, turning the inner
+ * loops into independent lane-wise operations the compiler can vectorize.
+ * Every lane goes through exactly the same arithmetic as a lone column (row)
+ * would, so the results don't depend on how the image is split into blocks.
+ */
+enum { PASS_BLOCK_SIZE = 8 };
 
-template<typename SrcIt, typename DstIt, typename FloatReader, typename FloatWriter>
-void gaussBlurGeneric(QSize const size, float const h_sigma, float const v_sigma,
-                      SrcIt const input, int const input_stride, FloatReader const float_reader,
-                      DstIt const output, int const output_stride, FloatWriter const float_writer)
+/**
+ * \brief The vertical pass of gaussBlurGeneric(), restricted to a range of columns.
+ *
+ * Columns are processed independently of each other, so disjoint column ranges
+ * may be processed concurrently.  The results are identical to processing all
+ * columns at once.
+ *
+ * \param intermediate_image Receives the vertically blurred columns. Must have
+ *        the dimensions specified by \p size.
+ */
+template<typename SrcIt, typename FloatReader>
+void verticalPass(QSize const size, float const v_sigma, int const x_begin, int const x_end,
+                  SrcIt const input, int const input_stride, FloatReader const float_reader,
+                  Grid<float>& intermediate_image)
 {
-    using namespace gauss_blur_impl;
+    int const B = PASS_BLOCK_SIZE;
+    int const height = size.height();
+    int const intermediate_stride = intermediate_image.stride();
 
-    if (size.isEmpty())
-    {
-        return;
-    }
+    boost::scoped_array<float> const w(new float[(3 + height + 3) * B]);
 
-    if (h_sigma < 0.0f || v_sigma < 0.0f)
+    FilterParams const p(v_sigma);
+    float const A = p.A;
+    float const a1 = p.a1;
+    float const a2 = p.a2;
+    float const a3 = p.a3;
+    float const B2 = p.B * p.B;
+
+    int x = x_begin;
+    for (; x + B <= x_end; x += B)
     {
-        throw std::invalid_argument("gaussBlur: stddev can't be negative");
+        // Forward pass.
+        SrcIt inp_line = input + x;
+        float* p_w = &w[3 * B];
+        for (int i = 0; i < B; ++i)
+        {
+            p_w[i - B] = p_w[i - 2 * B] = p_w[i - 3 * B] = float_reader(inp_line[i]) * A;
+        }
+
+        for (int y = 0; y < height; ++y)
+        {
+            for (int i = 0; i < B; ++i)
+            {
+                float const pixel = float_reader(inp_line[i]);
+                p_w[i] = pixel + a1 * p_w[i - B] + a2 * p_w[i - 2 * B] + a3 * p_w[i - 3 * B];
+            }
+            inp_line += input_stride;
+            p_w += B;
+        }
+
+        // Backward pass.
+        for (int i = 0; i < B; ++i)
+        {
+            p_w[i] = p_w[i + B] = p_w[i + 2 * B] = p_w[i - B] * A;
+        }
+        float* p_int = intermediate_image.data() + x + height * intermediate_stride;
+        for (int y = height - 1; y >= 0; --y)
+        {
+            p_w -= B;
+            p_int -= intermediate_stride;
+            for (int i = 0; i < B; ++i)
+            {
+                p_w[i] = p_w[i] + a1 * p_w[i + B] + a2 * p_w[i + 2 * B] + a3 * p_w[i + 3 * B];
+                p_int[i] = p_w[i] * B2; // Re-scale by B^2.
+            }
+        }
     }
-    else if (h_sigma < 1e-2f && v_sigma < 1e-2f)
+
+    for (; x < x_end; ++x)
     {
-        return;
+        // Forward pass.
+        SrcIt inp_it = input + x;
+        float pixel = float_reader(*inp_it);
+        float* p_w = &w[3];
+        p_w[-1] = p_w[-2] = p_w[-3] = pixel * A;
+
+        for (int y = 0; y < height; ++y)
+        {
+            pixel = float_reader(*inp_it);
+            *p_w = pixel + a1 * p_w[-1] + a2 * p_w[-2] + a3 * p_w[-3];
+            inp_it += input_stride;
+            ++p_w;
+        }
+
+        // Backward pass.
+        //calcBackwardPassInitialConditions(p, p_w, pixel);
+        p_w[0] = p_w[1] = p_w[2] = p_w[-1] * A;
+        float* p_int = intermediate_image.data() + x + height * intermediate_stride;
+        for (int y = height - 1; y >= 0; --y)
+        {
+            --p_w;
+            p_int -= intermediate_stride;
+            *p_w = *p_w + a1 * p_w[1] + a2 * p_w[2] + a3 * p_w[3];
+            *p_int = *p_w * B2; // Re-scale by B^2.
+        }
     }
+}
 
+/**
+ * \brief The horizontal pass of gaussBlurGeneric(), restricted to a range of rows.
+ *
+ * Rows are processed independently of each other, so disjoint row ranges
+ * may be processed concurrently, provided the vertical pass has completed.
+ */
+template<typename DstIt, typename FloatWriter>
+void horizontalPass(QSize const size, float const h_sigma, int const y_begin, int const y_end,
+                    Grid<float> const& intermediate_image,
+                    DstIt const output, int const output_stride, FloatWriter const float_writer)
+{
+    int const B = PASS_BLOCK_SIZE;
     int const width = size.width();
-    int const height = size.height();
-    int const width_height_max = width > height ? width : height;
-
-    boost::scoped_array<float> const w(new float[3 + width_height_max + 3]);
-    Grid<float> intermediate_image(width, height, /*padding=*/0);
     int const intermediate_stride = intermediate_image.stride();
 
+    boost::scoped_array<float> const w(new float[(3 + width + 3) * B]);
+
+    FilterParams const p(h_sigma);
+    float const A = p.A;
+    float const a1 = p.a1;
+    float const a2 = p.a2;
+    float const a3 = p.a3;
+    float const B2 = p.B * p.B;
+
+    int y = y_begin;
+    for (; y + B <= y_end; y += B)
     {
-        // Vertical pass.
-        gauss_blur_impl::FilterParams const p(v_sigma);
-        float const B2 = p.B * p.B;
+        // Forward pass.
+        float const* intermediate_line = intermediate_image.data() + y * intermediate_stride;
+        float* p_w = &w[3 * B];
+        for (int i = 0; i < B; ++i)
+        {
+            p_w[i - B] = p_w[i - 2 * B] = p_w[i - 3 * B] =
+                    intermediate_line[i * intermediate_stride] * A;
+        }
 
         for (int x = 0; x < width; ++x)
         {
-            // Forward pass.
-            SrcIt inp_it = input + x;
-            float pixel = float_reader(*inp_it);
-            float* p_w = &w[3];
-            p_w[-1] = p_w[-2] = p_w[-3] = pixel * p.A;
-
-            for (int y = 0; y < height; ++y)
+            for (int i = 0; i < B; ++i)
             {
-                pixel = float_reader(*inp_it);
-                *p_w = pixel + p.a1 * p_w[-1] + p.a2 * p_w[-2] + p.a3 * p_w[-3];
-                inp_it += input_stride;
-                ++p_w;
+                float const pixel = intermediate_line[i * intermediate_stride + x];
+                p_w[i] = pixel + a1 * p_w[i - B] + a2 * p_w[i - 2 * B] + a3 * p_w[i - 3 * B];
             }
+            p_w += B;
+        }
 
-            // Backward pass.
-            //calcBackwardPassInitialConditions(p, p_w, pixel);
-            p_w[0] = p_w[1] = p_w[2] = p_w[-1] * p.A;
-            float* p_int = intermediate_image.data() + x + height * intermediate_stride;
-            for (int y = height - 1; y >= 0; --y)
+        // Backward pass.
+        for (int i = 0; i < B; ++i)
+        {
+            p_w[i] = p_w[i + B] = p_w[i + 2 * B] = p_w[i - B] * A;
+        }
+        DstIt const output_line(output + y * output_stride);
+        for (int x = width - 1; x >= 0; --x)
+        {
+            p_w -= B;
+            for (int i = 0; i < B; ++i)
             {
-                --p_w;
-                p_int -= intermediate_stride;
-                *p_w = *p_w + p.a1 * p_w[1] + p.a2 * p_w[2] + p.a3 * p_w[3];
-                *p_int = *p_w * B2; // Re-scale by B^2.
+                p_w[i] = p_w[i] + a1 * p_w[i + B] + a2 * p_w[i + 2 * B] + a3 * p_w[i + 3 * B];
+                float_writer(output_line[i * output_stride + x], p_w[i] * B2); // Re-scale by B^2.
             }
         }
     }
 
+    float const* intermediate_line = intermediate_image.data() + y * intermediate_stride;
+    DstIt output_line(output + y * output_stride);
+
+    for (; y < y_end; ++y)
     {
-        // Horizontal pass.
-        gauss_blur_impl::FilterParams const p(h_sigma);
-        float const B2 = p.B * p.B;
-        float* intermediate_line = intermediate_image.data();
-        DstIt output_line(output);
+        // Forward pass.
+        float const* p_int = intermediate_line;
+        float* p_w = &w[3];
+        p_w[-1] = p_w[-2] = p_w[-3] = intermediate_line[0] * A;
+        for (int x = 0; x < width; ++x)
+        {
+            *p_w = *p_int + a1 * p_w[-1] + a2 * p_w[-2] + a3 * p_w[-3];
+            ++p_int;
+            ++p_w;
+        }
 
-        for (int y = 0; y < height; ++y)
+        // Backward pass.
+        //calcBackwardPassInitialConditions(p, p_w, p_int[-1]);
+        p_w[0] = p_w[1] = p_w[2] = p_w[-1] * A;
+        DstIt out_it = output_line + (width - 1);
+        for (int x = width - 1; x >= 0; --x)
         {
-            // Forward pass.
-            float* p_int = intermediate_line;
-            float* p_w = &w[3];
-            p_w[-1] = p_w[-2] = p_w[-3] = intermediate_line[0] * p.A;
-            for (int x = 0; x < width; ++x)
-            {
-                *p_w = *p_int + p.a1 * p_w[-1] + p.a2 * p_w[-2] + p.a3 * p_w[-3];
-                ++p_int;
-                ++p_w;
-            }
+            --p_w;
+            *p_w = *p_w + a1 * p_w[1] + a2 * p_w[2] + a3 * p_w[3];
+            float_writer(*out_it, *p_w * B2); // Re-scale by B^2.
+            --out_it;
+        }
 
-            // Backward pass.
-            //calcBackwardPassInitialConditions(p, p_w, p_int[-1]);
-            p_w[0] = p_w[1] = p_w[2] = p_w[-1] * p.A;
-            DstIt out_it = output_line + (width - 1);
-            for (int x = width - 1; x >= 0; --x)
-            {
-                --p_w;
-                *p_w = *p_w + p.a1 * p_w[1] + p.a2 * p_w[2] + p.a3 * p_w[3];
-                float_writer(*out_it, *p_w * B2); // Re-scale by B^2.
-                --out_it;
-            }
+        intermediate_line += intermediate_stride;
+        output_line += output_stride;
+    }
+}
 
-            intermediate_line += intermediate_stride;
-            output_line += output_stride;
-        }
+} // namespace gauss_blur_impl
+
+template<typename SrcIt, typename DstIt, typename FloatReader, typename FloatWriter>
+void gaussBlurGeneric(QSize const size, float const h_sigma, float const v_sigma,
+                      SrcIt const input, int const input_stride, FloatReader const float_reader,
+                      DstIt const output, int const output_stride, FloatWriter const float_writer)
+{
+    using namespace gauss_blur_impl;
+
+    if (size.isEmpty())
+    {
+        return;
+    }
+
+    if (h_sigma < 0.0f || v_sigma < 0.0f)
+    {
+        throw std::invalid_argument("gaussBlur: stddev can't be negative");
     }
+    else if (h_sigma < 1e-2f && v_sigma < 1e-2f)
+    {
+        return;
+    }
+
+    Grid<float> intermediate_image(size.width(), size.height(), /*padding=*/0);
+
+    verticalPass(
+        size, v_sigma, 0, size.width(),
+        input, input_stride, float_reader, intermediate_image
+    );
+    horizontalPass(
+        size, h_sigma, 0, size.height(),
+        intermediate_image, output, output_stride, float_writer
+    );
 }
 
 template<typename SrcIt, typename DstIt, typename FloatReader, typename FloatWriter>
@@ -0,0 +1,285 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "GrayFilterChain.h"
+#include "GrayImage.h"
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSize>
+#include <algorithm>
+#include <string.h>
+
+namespace imageproc
+{
+
+namespace
+{
+
+/**
+ * The width and height of tiles local steps run on, excluding the halo.
+ * Together with the temporary images filters allocate, a tile should fit
+ * into L2 cache.
+ */
+int const TILE_SIZE = 256;
+
+} // anonymous namespace
+
+void
+GrayFilterChain::addTable(unsigned char const* table)
+{
+    Step step(TABLE);
+    step.table.assign(table, table + 256);
+    m_steps.push_back(step);
+}
+
+void
+GrayFilterChain::addHistogramTable(TableBuilder const& builder)
+{
+    Step step(HISTOGRAM_TABLE);
+    step.builder = builder;
+    m_steps.push_back(step);
+}
+
+void
+GrayFilterChain::addLocal(int const radius, Filter const& filter)
+{
+    Step step(LOCAL);
+    step.radius = std::max(radius, 0);
+    step.filter = filter;
+    m_steps.push_back(step);
+}
+
+void
+GrayFilterChain::addGlobal(Filter const& filter)
+{
+    Step step(GLOBAL);
+    step.filter = filter;
+    m_steps.push_back(step);
+}
+
+void
+GrayFilterChain::apply(GrayImage& image, RangeExecutor const& executor) const
+{
+    StepIter it(m_steps.begin());
+    StepIter const end(m_steps.end());
+
+    while (it != end && !image.isNull())
+    {
+        bool const is_table = (it->kind == TABLE || it->kind == HISTOGRAM_TABLE);
+        StepIter run_end(it);
+        ++run_end;
+
+        if (is_table)
+        {
+            while (run_end != end && (run_end->kind == TABLE || run_end->kind == HISTOGRAM_TABLE))
+            {
+                ++run_end;
+            }
+            applyTables(image, it, run_end, executor);
+        }
+        else if (it->kind == LOCAL)
+        {
+            while (run_end != end && run_end->kind == LOCAL)
+            {
+                ++run_end;
+            }
+            applyLocal(image, it, run_end, executor);
+        }
+        else
+        {
+            it->filter(image);
+        }
+
+        it = run_end;
+    }
+}
+
+void
+GrayFilterChain::applyTables(
+    GrayImage& image, StepIter const begin, StepIter const end,
+    RangeExecutor const& executor)
+{
+    int const w = image.width();
+    int const h = image.height();
+    int const stride = image.stride();
+
+    bool needs_histogram = false;
+    for (StepIter it(begin); it != end; ++it)
+    {
+        needs_histogram |= (it->kind == HISTOGRAM_TABLE);
+    }
+
+    uint64_t histogram[256] = {0};
+    if (needs_histogram)
+    {
+        unsigned char const* const data = image.data();
+        QMutex mutex;
+        executor(0, h, [&](int const y_begin, int const y_end)
+        {
+            uint64_t band_histogram[256] = {0};
+            unsigned char const* line = data + y_begin * stride;
+            for (int y = y_begin; y < y_end; y++)
+            {
+                for (int x = 0; x < w; x++)
+                {
+                    band_histogram[line[x]]++;
+                }
+                line += stride;
+            }
+
+            QMutexLocker const locker(&mutex);
+            for (int i = 0; i < 256; i++)
+            {
+                histogram[i] += band_histogram[i];
+            }
+        });
+    }
+
+    unsigned char composed[256];
+    for (int i = 0; i < 256; i++)
+    {
+        composed[i] = (unsigned char) i;
+    }
+
+    for (StepIter it(begin); it != end; ++it)
+    {
+        unsigned char table[256];
+        if (it->kind == TABLE)
+        {
+            std::copy(it->table.begin(), it->table.end(), table);
+        }
+        else
+        {
+            // The histogram of what the previous steps would have produced.
+            uint64_t step_histogram[256] = {0};
+            for (int i = 0; i < 256; i++)
+            {
+                step_histogram[composed[i]] += histogram[i];
+            }
+            it->builder(table, step_histogram);
+        }
+
+        for (int i = 0; i < 256; i++)
+        {
+            composed[i] = table[composed[i]];
+        }
+    }
+
+    bool is_identity = true;
+    for (int i = 0; i < 256; i++)
+    {
+        is_identity &= (composed[i] == i);
+    }
+    if (is_identity)
+    {
+        return;
+    }
+
+    unsigned char* const data = image.data();
+    executor(0, h, [&](int const y_begin, int const y_end)
+    {
+        unsigned char* line = data + y_begin * stride;
+        for (int y = y_begin; y < y_end; y++)
+        {
+            for (int x = 0; x < w; x++)
+            {
+                line[x] = composed[line[x]];
+            }
+            line += stride;
+        }
+    });
+}
+
+void
+GrayFilterChain::applyLocal(
+    GrayImage& image, StepIter const begin, StepIter const end,
+    RangeExecutor const& executor)
+{
+    int const w = image.width();
+    int const h = image.height();
+
+    int halo = 0;
+    for (StepIter it(begin); it != end; ++it)
+    {
+        halo += it->radius;
+    }
+
+    // Keep the halo from dominating the work done on a tile.
+    int const tile_size = std::max(TILE_SIZE, 4 * halo);
+    if (tile_size >= w && tile_size >= h)
+    {
+        for (StepIter it(begin); it != end; ++it)
+        {
+            it->filter(image);
+        }
+        return;
+    }
+
+    int const tiles_x = (w + tile_size - 1) / tile_size;
+    int const tiles_y = (h + tile_size - 1) / tile_size;
+
+    GrayImage const src(image);
+    GrayImage dst(image.size());
+    unsigned char const* const src_data = src.data();
+    int const src_stride = src.stride();
+    unsigned char* const dst_data = dst.data();
+    int const dst_stride = dst.stride();
+
+    executor(0, tiles_x * tiles_y, [&](int const tile_begin, int const tile_end)
+    {
+        for (int t = tile_begin; t < tile_end; t++)
+        {
+            int const x0 = (t % tiles_x) * tile_size;
+            int const y0 = (t / tiles_x) * tile_size;
+            int const x1 = std::min(w, x0 + tile_size);
+            int const y1 = std::min(h, y0 + tile_size);
+            int const ext_x0 = std::max(0, x0 - halo);
+            int const ext_y0 = std::max(0, y0 - halo);
+            int const ext_x1 = std::min(w, x1 + halo);
+            int const ext_y1 = std::min(h, y1 + halo);
+
+            GrayImage tile(QSize(ext_x1 - ext_x0, ext_y1 - ext_y0));
+            int const tile_stride = tile.stride();
+            for (int y = ext_y0; y < ext_y1; y++)
+            {
+                memcpy(
+                    tile.data() + (y - ext_y0) * tile_stride,
+                    src_data + y * src_stride + ext_x0, ext_x1 - ext_x0
+                );
+            }
+
+            for (StepIter it(begin); it != end; ++it)
+            {
+                it->filter(tile);
+            }
+
+            unsigned char const* const tile_data = tile.data();
+            for (int y = y0; y < y1; y++)
+            {
+                memcpy(
+                    dst_data + y * dst_stride + x0,
+                    tile_data + (y - ext_y0) * tile_stride + (x0 - ext_x0), x1 - x0
+                );
+            }
+        }
+    });
+
+    image = dst;
+}
+
+} // namespace imageproc
@@ -0,0 +1,128 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef IMAGEPROC_GRAYFILTERCHAIN_H_
+#define IMAGEPROC_GRAYFILTERCHAIN_H_
+
+#include "imageproc_config.h"
+#include "ParallelFor.h"
+#include <functional>
+#include <vector>
+#include <stdint.h>
+
+namespace imageproc
+{
+
+class GrayImage;
+
+/**
+ * \brief A sequence of grayscale filters, executed with as few passes
+ *        over the image as their data dependencies allow.
+ *
+ * Each step declares how its output pixels depend on its input:
+ * \li Table steps map every pixel through a 256 entry lookup table, which
+ *     may be built from the histogram of the step's input.  Consecutive
+ *     table steps are fused into a single table.  The histograms of the
+ *     intermediate images are derived from that of the first one, so
+ *     the whole run costs at most two passes over the image.
+ * \li Local steps only look at pixels within a given radius of the one
+ *     being computed.  Consecutive local steps are run together on tiles
+ *     small enough to stay in cache, in parallel.  Each tile is extended
+ *     by the sum of their radii, and only its inner part is kept.
+ * \li Global steps are run on the whole image.
+ *
+ * The result is identical to that of running the steps one after another
+ * on the whole image.
+ */
+class IMAGEPROC_EXPORT GrayFilterChain
+{
+public:
+    /**
+     * Fills the 256 entry table, given the 256 bin histogram of the image
+     * it is going to be applied to.
+     */
+    typedef std::function<void(unsigned char* table, uint64_t const* histogram)> TableBuilder;
+
+    typedef std::function<void(GrayImage& image)> Filter;
+
+    /**
+     * \brief Adds a step mapping pixel values through a fixed table.
+     */
+    void addTable(unsigned char const* table);
+
+    /**
+     * \brief Adds a step mapping pixel values through a table depending
+     *        on the histogram of its input.
+     */
+    void addHistogramTable(TableBuilder const& builder);
+
+    /**
+     * \brief Adds a step whose output pixels only depend on the input pixels
+     *        no further than \p radius away in either direction.
+     *
+     * The filter will be given tiles of the image.  Besides the radius,
+     * its result must only depend on where the image edges are, not on
+     * the size of the image.
+     */
+    void addLocal(int radius, Filter const& filter);
+
+    /**
+     * \brief Adds a step that has to see the whole image.
+     */
+    void addGlobal(Filter const& filter);
+
+    bool isEmpty() const
+    {
+        return m_steps.empty();
+    }
+
+    /**
+     * \brief Runs all the steps on \p image, in the order they were added.
+     *
+     * \param image The image to process in place.
+     * \param executor Used to process tiles and bands of rows.
+     */
+    void apply(GrayImage& image, RangeExecutor const& executor = &parallelFor) const;
+private:
+    enum Kind { TABLE, HISTOGRAM_TABLE, LOCAL, GLOBAL };
+
+    struct Step
+    {
+        Kind kind;
+        int radius;
+        std::vector<unsigned char> table;
+        TableBuilder builder;
+        Filter filter;
+
+        Step(Kind k) : kind(k), radius(0) {}
+    };
+
+    typedef std::vector<Step>::const_iterator StepIter;
+
+    static void applyTables(GrayImage& image, StepIter begin, StepIter end,
+                            RangeExecutor const& executor);
+
+    static void applyLocal(GrayImage& image, StepIter begin, StepIter end,
+                           RangeExecutor const& executor);
+
+    std::vector<Step> m_steps;
+};
+
+} // namespace imageproc
+
+#endif
@@ -18,7 +18,11 @@
 
 #include <new>
 #include <stdexcept>
+#include <vector>
+#include <algorithm>
+#include <limits.h>
 #include "GrayImage.h"
+#include "LocalStats.h"
 #include "Grayscale.h"
 
 namespace imageproc
@@ -63,65 +67,7 @@ GrayImage grayMapMean(
     GrayImage const& src,
     int const radius)
 {
-    if (src.isNull())
-    {
-        return GrayImage();
-    }
-    GrayImage gray = GrayImage(src);
-    if (gray.isNull())
-    {
-        return GrayImage();
-    }
-
-    if (radius > 0)
-    {
-        int const w = src.width();
-        int const h = src.height();
-        unsigned char const* src_line = src.data();
-        int const src_stride = src.stride();
-        unsigned char* gray_line = gray.data();
-        int const gray_stride = gray.stride();
-
-        IntegralImage<uint32_t> integral_image(w, h);
-
-        for (int y = 0; y < h; y++)
-        {
-            integral_image.beginRow();
-            for (int x = 0; x < w; x++)
-            {
-                uint32_t const pixel = src_line[x];
-                integral_image.push(pixel);
-            }
-            src_line += src_stride;
-        }
-
-        for (int y = 0; y < h; y++)
-        {
-            int const top = ((y - radius) < 0) ? 0 : (y - radius);
-            int const bottom = ((y + radius + 1) < h) ? (y + radius + 1) : h;
-
-            for (int x = 0; x < w; x++)
-            {
-                int const left = ((x - radius) < 0) ? 0 : (x - radius);
-                int const right = ((x + radius) < w) ? (x + radius) : w;
-                int const area = (bottom - top) * (right - left);
-                assert(area > 0);  // because windowSize > 0 and w > 0 and h > 0
-
-                QRect const rect(left, top, right - left, bottom - top);
-                double const window_sum = integral_image.sum(rect);
-
-                double const r_area = 1.0 / area;
-                double mean = window_sum * r_area;
-
-                mean += 0.5;
-                mean = (mean < 0.0) ? 0.0 : ((mean < 255.0) ? mean : 255.0);
-                gray_line[x] = (unsigned char) mean;
-            }
-            gray_line += gray_stride;
-        }
-    }
-
-    return gray;
+    return LocalStats(src, radius, LocalStats::MEAN).mean();
 }  // grayMapMean
 
 /*
@@ -131,156 +77,14 @@ GrayImage grayMapDeviation(
     GrayImage const& src,
     int const radius)
 {
-    if (src.isNull())
-    {
-        return GrayImage();
-    }
-    GrayImage gray = GrayImage(src);
-    if (gray.isNull())
-    {
-        return GrayImage();
-    }
-
-    if (radius > 0)
-    {
-        int const w = src.width();
-        int const h = src.height();
-        unsigned char const* src_line = src.data();
-        int const src_stride = src.stride();
-        unsigned char* gray_line = gray.data();
-        int const gray_stride = gray.stride();
-
-        IntegralImage<uint32_t> integral_image(w, h);
-        IntegralImage<uint64_t> integral_sqimage(w, h);
-
-        uint32_t gray_min = 255;
-
-        for (int y = 0; y < h; y++)
-        {
-            integral_image.beginRow();
-            integral_sqimage.beginRow();
-            for (int x = 0; x < w; x++)
-            {
-                uint32_t const pixel = src_line[x];
-                integral_image.push(pixel);
-                integral_sqimage.push(pixel * pixel);
-                gray_min = std::min(gray_min, pixel);
-            }
-            src_line += src_stride;
-        }
-
-        for (int y = 0; y < h; y++)
-        {
-            int const top = ((y - radius) < 0) ? 0 : (y - radius);
-            int const bottom = ((y + radius + 1) < h) ? (y + radius + 1) : h;
-
-            for (int x = 0; x < w; x++)
-            {
-                int const left = ((x - radius) < 0) ? 0 : (x - radius);
-                int const right = ((x + radius + 1) < w) ? (x + radius + 1) : w;
-                int const area = (bottom - top) * (right - left);
-                assert(area > 0); // because window_size > 0 and w > 0 and h > 0
-
-                QRect const rect(left, top, right - left, bottom - top);
-                double const window_sum = integral_image.sum(rect);
-                double const window_sqsum = integral_sqimage.sum(rect);
-
-                double const r_area = 1.0 / area;
-                double const mean = window_sum * r_area;
-                double const sqmean = window_sqsum * r_area;
-
-                double const variance = sqmean - mean * mean;
-                double deviation = sqrt(fabs(variance));
-
-                deviation += 0.5;
-                deviation = (deviation < 0.0) ? 0.0 : ((deviation < 255.0) ? deviation : 255.0);
-                gray_line[x] = (unsigned char) deviation;
-            }
-            gray_line += gray_stride;
-        }
-    }
-
-    return gray;
+    return LocalStats(src, radius, LocalStats::DEVIATION).deviation();
 } // grayMapDeviation
 
 GrayImage grayMapMax(
     GrayImage const& src,
     int const radius)
 {
-    if (src.isNull())
-    {
-        return GrayImage();
-    }
-    GrayImage gray = GrayImage(src);
-    if (gray.isNull())
-    {
-        return GrayImage();
-    }
-
-    if (radius > 0)
-    {
-        GrayImage gmax = GrayImage(src);
-        if (gmax.isNull())
-        {
-            return gray;
-        }
-        int const w = src.width();
-        int const h = src.height();
-        unsigned char* gray_line = gray.data();
-        int const gray_stride = gray.stride();
-        unsigned char* gmax_line = gmax.data();
-
-        for (int y = 0; y < h; y++)
-        {
-            for (int x = 0; x < w; x++)
-            {
-                int const left = ((x - radius) < 0) ? 0 : (x - radius);
-                int const right = ((x + radius + 1) < w) ? (x + radius + 1) : w;
-
-                unsigned char const origin = gray_line[x];
-                unsigned char immax = origin;
-                for (int xf = left; xf < right; xf++)
-                {
-                    unsigned char imf = gray_line[xf];
-                    if (imf > immax)
-                    {
-                        immax = imf;
-                    }
-                }
-                gmax_line[x] = immax;
-            }
-            gray_line += gray_stride;
-            gmax_line += gray_stride;
-        }
-
-        gmax_line = gmax.data();
-        gray_line = gray.data();
-        for (int y = 0; y < h; y++)
-        {
-            int const top = ((y - radius) < 0) ? 0 : (y - radius);
-            int const bottom = ((y + radius + 1) < h) ? (y + radius + 1) : h;
-
-            for (int x = 0; x < w; x++)
-            {
-                unsigned char const origin = gray_line[x];
-                unsigned char immax = origin;
-                unsigned long int idx = top * gray_stride + x;
-                for (int yf = top; yf < bottom; yf++)
-                {
-                    unsigned char immaxf = gmax_line[idx];
-                    if (immaxf > immax)
-                    {
-                        immax = immaxf;
-                    }
-                    idx += gray_stride;
-                }
-                gray_line[x] = immax;
-            }
-            gray_line += gray_stride;
-        }
-    }
-
-    return gray;
+    return LocalStats(src, radius, 0).windowMax();
 }  // grayMapMax
 
 GrayImage grayMapContrast(
@@ -299,86 +103,30 @@ GrayImage grayMapContrast(
 
     if (radius > 0)
     {
-        GrayImage gmax = GrayImage(src);
-        if (gmax.isNull())
-        {
-            return gray;
-        }
-        GrayImage gmin = GrayImage(src);
-        if (gmin.isNull())
+        LocalStats const stats(src, radius, 0);
+        gray = stats.windowMax();
+        GrayImage const gmin = stats.windowMin();
+        if (gray.isNull() || gmin.isNull())
         {
-            return gray;
+            return GrayImage(src);
         }
         int const w = src.width();
         int const h = src.height();
         unsigned char* gray_line = gray.data();
         int const gray_stride = gray.stride();
-        unsigned char* gmax_line = gmax.data();
-        unsigned char* gmin_line = gmin.data();
+        unsigned char const* gmin_line = gmin.data();
+        int const gmin_stride = gmin.stride();
 
         for (int y = 0; y < h; y++)
         {
             for (int x = 0; x < w; x++)
             {
-                int const left = ((x - radius) < 0) ? 0 : (x - radius);
-                int const right = ((x + radius + 1) < w) ? (x + radius + 1) : w;
-
-                unsigned char const origin = gray_line[x];
-                unsigned char immin = origin;
-                unsigned char immax = origin;
-                for (int xf = left; xf < right; xf++)
-                {
-                    unsigned char imf = gray_line[xf];
-                    if (imf > immax)
-                    {
-                        immax = imf;
-                    }
-                    if (imf < immin)
-                    {
-                        immin = imf;
-                    }
-                }
-                gmax_line[x] = immax;
-                gmin_line[x] = immin;
-            }
-            gray_line += gray_stride;
-            gmax_line += gray_stride;
-            gmin_line += gray_stride;
-        }
-
-        gmax_line = gmax.data();
-        gmin_line = gmin.data();
-        gray_line = gray.data();
-        for (int y = 0; y < h; y++)
-        {
-            int const top = ((y - radius) < 0) ? 0 : (y - radius);
-            int const bottom = ((y + radius + 1) < h) ? (y + radius + 1) : h;
-
-            for (int x = 0; x < w; x++)
-            {
-                unsigned char const origin = gray_line[x];
-                unsigned char immin = origin;
-                unsigned char immax = origin;
-                unsigned long int idx = top * gray_stride + x;
-                for (int yf = top; yf < bottom; yf++)
-                {
-                    unsigned char immaxf = gmax_line[idx];
-                    unsigned char imminf = gmin_line[idx];
-                    if (immaxf > immax)
-                    {
-                        immax = immaxf;
-                    }
-                    if (imminf < immin)
-                    {
-                        immin = imminf;
-                    }
-                    idx += gray_stride;
-                }
-                unsigned char threshold = (immax - immin);
+                unsigned char threshold = (gray_line[x] - gmin_line[x]);
 
                 gray_line[x] = threshold;
             }
             gray_line += gray_stride;
+            gmin_line += gmin_stride;
         }
     }
 
@@ -603,11 +351,21 @@ GrayImage grayNiblackMap(
     float const k,
     int const delta)
 {
+    return grayNiblackMap(LocalStats(src, radius), k, delta);
+}
+
+GrayImage grayNiblackMap(
+    LocalStats const& stats,
+    float const k,
+    int const delta)
+{
+    GrayImage const& src = stats.source();
+    int const radius = stats.radius();
     if (src.isNull())
     {
         return GrayImage();
     }
-    GrayImage gmean = grayMapMean(src, radius);
+    GrayImage gmean = stats.mean();
     if (gmean.isNull())
     {
         return GrayImage(src);
@@ -615,7 +373,7 @@ GrayImage grayNiblackMap(
 
     if (radius > 0)
     {
-        GrayImage gdeviation = grayMapDeviation(src, radius);
+        GrayImage const& gdeviation = stats.deviation();
         if (gdeviation.isNull())
         {
             return gmean;
@@ -625,7 +383,7 @@ GrayImage grayNiblackMap(
         int const h = src.height();
         unsigned char* gmean_line = gmean.data();
         int const gmean_stride = gmean.stride();
-        unsigned char* gdeviation_line = gdeviation.data();
+        unsigned char const* gdeviation_line = gdeviation.data();
         int const gdeviation_stride = gdeviation.stride();
 
         for (int y = 0; y < h; y++)
@@ -754,11 +512,21 @@ GrayImage graySauvolaMap(
     float const k,
     int const delta)
 {
+    return graySauvolaMap(LocalStats(src, radius), k, delta);
+}
+
+GrayImage graySauvolaMap(
+    LocalStats const& stats,
+    float const k,
+    int const delta)
+{
+    GrayImage const& src = stats.source();
+    int const radius = stats.radius();
     if (src.isNull())
     {
         return GrayImage();
     }
-    GrayImage gmean = grayMapMean(src, radius);
+    GrayImage gmean = stats.mean();
     if (gmean.isNull())
     {
         return GrayImage(src);
@@ -766,7 +534,7 @@ GrayImage graySauvolaMap(
 
     if (radius > 0)
     {
-        GrayImage gdeviation = grayMapDeviation(src, radius);
+        GrayImage const& gdeviation = stats.deviation();
         if (gdeviation.isNull())
         {
             return gmean;
@@ -776,7 +544,7 @@ GrayImage graySauvolaMap(
         int const h = src.height();
         unsigned char* gmean_line = gmean.data();
         int const gmean_stride = gmean.stride();
-        unsigned char* gdeviation_line = gdeviation.data();
+        unsigned char const* gdeviation_line = gdeviation.data();
         int const gdeviation_stride = gdeviation.stride();
 
         for (int y = 0; y < h; y++)
@@ -813,11 +581,21 @@ GrayImage grayWolfMap(
     float const k,
     int const delta)
 {
+    return grayWolfMap(LocalStats(src, radius), k, delta);
+}
+
+GrayImage grayWolfMap(
+    LocalStats const& stats,
+    float const k,
+    int const delta)
+{
+    GrayImage const& src = stats.source();
+    int const radius = stats.radius();
     if (src.isNull())
     {
         return GrayImage();
     }
-    GrayImage gmean = grayMapMean(src, radius);
+    GrayImage gmean = stats.mean();
     if (gmean.isNull())
     {
         return GrayImage(src);
@@ -825,7 +603,7 @@ GrayImage grayWolfMap(
 
     if (radius > 0)
     {
-        GrayImage gdeviation = grayMapDeviation(src, radius);
+        GrayImage const& gdeviation = stats.deviation();
         if (gdeviation.isNull())
         {
             return gmean;
@@ -833,32 +611,14 @@ GrayImage grayWolfMap(
 
         int const w = src.width();
         int const h = src.height();
-        unsigned char const* src_line = src.data();
-        int const src_stride = src.stride();
         unsigned char* gmean_line = gmean.data();
         int const gmean_stride = gmean.stride();
-        unsigned char* gdeviation_line = gdeviation.data();
+        unsigned char const* gdeviation_line = gdeviation.data();
         int const gdeviation_stride = gdeviation.stride();
 
-        float gray_min = 255.0f;
-        float deviation_max = 0.0f;
+        float const gray_min = (float) stats.grayMin();
+        float const deviation_max = (float) stats.deviationMax();
 
-        for (int y = 0; y < h; y++)
-        {
-            for (int x = 0; x < w; x++)
-            {
-                float const origin = src_line[x];
-                float const deviation = gdeviation_line[x];
-
-                deviation_max = (deviation_max < deviation) ? deviation : deviation_max;
-                gray_min = (gray_min < origin) ? gray_min : origin;
-            }
-            src_line += src_stride;
-            gdeviation_line += gdeviation_stride;
-        }
-
-        gmean_line = gmean.data();
-        gdeviation_line = gdeviation.data();
         for (int y = 0; y < h; y++)
         {
             for (int x = 0; x < w; x++)
@@ -900,11 +660,21 @@ GrayImage grayWindowMap(
     float const k,
     int const delta)
 {
+    return grayWindowMap(LocalStats(src, radius), k, delta);
+}
+
+GrayImage grayWindowMap(
+    LocalStats const& stats,
+    float const k,
+    int const delta)
+{
+    GrayImage const& src = stats.source();
+    int const radius = stats.radius();
     if (src.isNull())
     {
         return GrayImage();
     }
-    GrayImage gmean = grayMapMean(src, radius);
+    GrayImage gmean = stats.mean();
     if (gmean.isNull())
     {
         return GrayImage(src);
@@ -912,7 +682,7 @@ GrayImage grayWindowMap(
 
     if (radius > 0)
     {
-        GrayImage gdeviation = grayMapDeviation(src, radius);
+        GrayImage const& gdeviation = stats.deviation();
         if (gdeviation.isNull())
         {
             return gmean;
@@ -920,36 +690,19 @@ GrayImage grayWindowMap(
 
         int const w = src.width();
         int const h = src.height();
-        unsigned char const* src_line = src.data();
-        int const src_stride = src.stride();
         unsigned char* gmean_line = gmean.data();
         int const gmean_stride = gmean.stride();
-        unsigned char* gdeviation_line = gdeviation.data();
+        unsigned char const* gdeviation_line = gdeviation.data();
         int const gdeviation_stride = gdeviation.stride();
 
-        uint64_t mean_full = 0;
-        float deviation_min = 256.0f, deviation_max = 0.0f, deviation_delta;
-
-        for (int y = 0; y < h; y++)
-        {
-            for (int x = 0; x < w; x++)
-            {
-                uint64_t const origin = src_line[x];
-                float const deviation = gdeviation_line[x];
-                deviation_min = (deviation_min < deviation) ? deviation_min : deviation;
-                deviation_max = (deviation_max < deviation) ? deviation : deviation_max;
-                mean_full += origin;
-            }
-            src_line += src_stride;
-            gdeviation_line += gdeviation_stride;
-        }
+        uint64_t mean_full = stats.graySum();
         mean_full /= h;
         mean_full += (w >> 1);
         mean_full /= w;
-        deviation_delta = deviation_max - deviation_min;
+        float const deviation_min = (float) stats.deviationMin();
+        float const deviation_max = (float) stats.deviationMax();
+        float const deviation_delta = deviation_max - deviation_min;
 
-        gmean_line = gmean.data();
-        gdeviation_line = gdeviation.data();
         for (int y = 0; y < h; y++)
         {
             for (int x = 0; x < w; x++)
@@ -982,11 +735,20 @@ GrayImage grayBradleyMap(
     int const radius,
     float const k)
 {
+    return grayBradleyMap(LocalStats(src, radius, LocalStats::MEAN), k);
+}
+
+GrayImage grayBradleyMap(
+    LocalStats const& stats,
+    float const k)
+{
+    GrayImage const& src = stats.source();
+    int const radius = stats.radius();
     if (src.isNull())
     {
         return GrayImage();
     }
-    GrayImage gmean = grayMapMean(src, radius);
+    GrayImage gmean = stats.mean();
     if (gmean.isNull())
     {
         return GrayImage(src);
@@ -1028,11 +790,21 @@ GrayImage grayNickMap(
     float const k,
     int const delta)
 {
+    return grayNickMap(LocalStats(src, radius), k, delta);
+}
+
+GrayImage grayNickMap(
+    LocalStats const& stats,
+    float const k,
+    int const delta)
+{
+    GrayImage const& src = stats.source();
+    int const radius = stats.radius();
     if (src.isNull())
     {
         return GrayImage();
     }
-    GrayImage gmean = grayMapMean(src, radius);
+    GrayImage gmean = stats.mean();
     if (gmean.isNull())
     {
         return GrayImage(src);
@@ -1041,7 +813,7 @@ GrayImage grayNickMap(
     if (radius > 0)
     {
         float cnick = (50.0f - delta) * 0.01f;
-        GrayImage gdeviation = grayMapDeviation(src, radius);
+        GrayImage const& gdeviation = stats.deviation();
         if (gdeviation.isNull())
         {
             return gmean;
@@ -1051,7 +823,7 @@ GrayImage grayNickMap(
         int const h = src.height();
         unsigned char* gmean_line = gmean.data();
         int const gmean_stride = gmean.stride();
-        unsigned char* gdeviation_line = gdeviation.data();
+        unsigned char const* gdeviation_line = gdeviation.data();
         int const gdeviation_stride = gdeviation.stride();
 
         for (int y = 0; y < h; y++)
@@ -1150,11 +922,21 @@ GrayImage graySinghMap(
     float const k,
     int const delta)
 {
+    return graySinghMap(LocalStats(src, radius, LocalStats::MEAN), k, delta);
+}
+
+GrayImage graySinghMap(
+    LocalStats const& stats,
+    float const k,
+    int const delta)
+{
+    GrayImage const& src = stats.source();
+    int const radius = stats.radius();
     if (src.isNull())
     {
         return GrayImage();
     }
-    GrayImage gmean = grayMapMean(src, radius);
+    GrayImage gmean = stats.mean();
     if (gmean.isNull())
     {
         return GrayImage(src);
@@ -1203,11 +985,21 @@ GrayImage grayFoxMap(
     float const k,
     int const delta)
 {
+    return grayFoxMap(LocalStats(src, radius, LocalStats::MEAN), k, delta);
+}
+
+GrayImage grayFoxMap(
+    LocalStats const& stats,
+    float const k,
+    int const delta)
+{
+    GrayImage const& src = stats.source();
+    int const radius = stats.radius();
     if (src.isNull())
     {
         return GrayImage();
     }
-    GrayImage gmean = grayMapMean(src, radius);
+    GrayImage gmean = stats.mean();
     if (gmean.isNull())
     {
         return GrayImage(src);
@@ -1222,7 +1014,7 @@ GrayImage grayFoxMap(
         unsigned char* gmean_line = gmean.data();
         int const gmean_stride = gmean.stride();
 
-        float gray_min = 255.0f;
+        float const gray_min = (float) stats.grayMin();
         float frac_max = 0.0f;
 
         for (int y = 0; y < h; y++)
@@ -1237,7 +1029,6 @@ GrayImage grayFoxMap(
                 float const frac_abs = (frac < 0) ? -frac : frac;
 
                 frac_max = (frac_max < frac_abs) ? frac_abs : frac_max;
-                gray_min = (gray_min < origin) ? gray_min : origin;
             }
             src_line += src_stride;
             gmean_line += gmean_stride;
@@ -1282,11 +1073,21 @@ GrayImage grayWANMap(
     float const k,
     int const delta)
 {
+    return grayWANMap(LocalStats(src, radius), k, delta);
+}
+
+GrayImage grayWANMap(
+    LocalStats const& stats,
+    float const k,
+    int const delta)
+{
+    GrayImage const& src = stats.source();
+    int const radius = stats.radius();
     if (src.isNull())
     {
         return GrayImage();
     }
-    GrayImage gmean = grayMapMean(src, radius);
+    GrayImage gmean = stats.mean();
     if (gmean.isNull())
     {
         return GrayImage(src);
@@ -1294,12 +1095,12 @@ GrayImage grayWANMap(
 
     if (radius > 0)
     {
-        GrayImage gdeviation = grayMapDeviation(src, radius);
+        GrayImage const& gdeviation = stats.deviation();
         if (gdeviation.isNull())
         {
             return gmean;
         }
-        GrayImage gmax = grayMapMax(src, radius);
+        GrayImage const gmax = stats.windowMax();
         if (gmax.isNull())
         {
             return gmean;
@@ -1309,9 +1110,9 @@ GrayImage grayWANMap(
         int const h = src.height();
         unsigned char* gmean_line = gmean.data();
         int const gmean_stride = gmean.stride();
-        unsigned char* gdeviation_line = gdeviation.data();
+        unsigned char const* gdeviation_line = gdeviation.data();
         int const gdeviation_stride = gdeviation.stride();
-        unsigned char* gmax_line = gmax.data();
+        unsigned char const* gmax_line = gmax.data();
         int const gmax_stride = gmax.stride();
 
         for (int y = 0; y < h; y++)
@@ -1735,44 +1536,24 @@ void grayCurveFilterInPlace(
 
     if (coef != 0.0f)
     {
-        int icoef = (int) (coef * 256.0f + 0.5f);
         unsigned int const w = src.width();
         unsigned int const h = src.height();
         unsigned char* src_line = src.data();
         int const src_stride = src.stride();
         unsigned char pix_replace[256];
+        uint64_t histogram[256] = {0};
 
-        uint64_t thres = 0;
         for (unsigned int y = 0; y < h; y++)
         {
             for (unsigned int x = 0; x < w; x++)
             {
                 unsigned char const val = src_line[x];
-                thres += val;
+                histogram[val]++;
             }
             src_line += src_stride;
         }
 
-        thres <<= 8; /* no round */
-        thres /= h;
-        thres /= w;
-
-        for (unsigned int j = 0; j < 256; j++)
-        {
-            int64_t val = (j << 8);
-            int64_t delta = (val - thres);
-            int64_t dsqr = delta * delta;
-            int64_t ddiv = (delta < 0) ? -thres : (65280 - thres);
-            dsqr = (ddiv == 0) ? 0 : dsqr / ddiv;
-            delta -= dsqr;
-            delta *= icoef;
-            delta += 128;
-            delta >>= 8;
-            val += delta;
-            val += 128;
-            val >>= 8;
-            pix_replace[j] = (unsigned char) val;
-        }
+        grayCurveFilterTable(pix_replace, histogram, coef);
 
         src_line = src.data();
         for (unsigned int y = 0; y < h; y++)
@@ -1787,6 +1568,40 @@ void grayCurveFilterInPlace(
     }
 }
 
+void grayCurveFilterTable(
+    unsigned char* table, uint64_t const* histogram, float const coef)
+{
+    int icoef = (int) (coef * 256.0f + 0.5f);
+
+    uint64_t thres = 0;
+    uint64_t count = 0;
+    for (unsigned int j = 0; j < 256; j++)
+    {
+        thres += histogram[j] * j;
+        count += histogram[j];
+    }
+
+    thres <<= 8; /* no round */
+    thres = (count == 0) ? 0 : (thres / count);
+
+    for (unsigned int j = 0; j < 256; j++)
+    {
+        int64_t val = (j << 8);
+        int64_t delta = (val - thres);
+        int64_t dsqr = delta * delta;
+        int64_t ddiv = (delta < 0) ? -thres : (65280 - thres);
+        dsqr = (ddiv == 0) ? 0 : dsqr / ddiv;
+        delta -= dsqr;
+        delta *= icoef;
+        delta += 128;
+        delta >>= 8;
+        val += delta;
+        val += 128;
+        val >>= 8;
+        table[j] = (unsigned char) val;
+    }
+}
+
 GrayImage graySqrFilter(
     GrayImage& src, float const coef)
 {
@@ -1805,26 +1620,13 @@ void graySqrFilterInPlace(
 
     if (coef != 0.0f)
     {
-        int icoef = (int) (coef * 256.0f + 0.5f);
         unsigned int const w = src.width();
         unsigned int const h = src.height();
         unsigned char* src_line = src.data();
         int const src_stride = src.stride();
         unsigned char pix_replace[256];
 
-        for (unsigned int j = 0; j < 256; j++)
-        {
-            unsigned int val = j;
-            val++;
-            val *= val;
-            val += 255;
-            val >>= 8;
-            val--;
-            val = icoef * val + (256 - icoef) * j;
-            val += 128;
-            val >>= 8;
-            pix_replace[j] = (unsigned char) val;
-        }
+        graySqrFilterTable(pix_replace, coef);
 
         for (unsigned int y = 0; y < h; y++)
         {
@@ -1838,6 +1640,26 @@ void graySqrFilterInPlace(
     }
 }
 
+void graySqrFilterTable(
+    unsigned char* table, float const coef)
+{
+    int icoef = (int) (coef * 256.0f + 0.5f);
+
+    for (unsigned int j = 0; j < 256; j++)
+    {
+        unsigned int val = j;
+        val++;
+        val *= val;
+        val += 255;
+        val >>= 8;
+        val--;
+        val = icoef * val + (256 - icoef) * j;
+        val += 128;
+        val >>= 8;
+        table[j] = (unsigned char) val;
+    }
+}
+
 GrayImage grayGravure(
     GrayImage const& src,
     int const radius,
@@ -2085,7 +1907,7 @@ void grayWienerInPlace(
             return;
         }
 
-        unsigned char* gdeviation_line = gdeviation.data();
+        unsigned char const* gdeviation_line = gdeviation.data();
         int const gdeviation_stride = gdeviation.stride();
 
         for (int y = 0; y < h; y++)
@@ -2150,12 +1972,7 @@ void grayKnnDenoiserInPlace(
 
         for (int y = 0; y < h; y++)
         {
-            integral_image.beginRow();
-            for (int x = 0; x < w; x++)
-            {
-                uint32_t const pixel = src_line[x];
-                integral_image.push(pixel);
-            }
+            integral_image.pushRow(src_line);
             src_line += src_stride;
         }
 
@@ -2306,102 +2123,227 @@ void grayEMDenoiserInPlace(
     }
 } // grayEMDenoiser
 
-GrayImage grayMedian(
-    GrayImage const& src,
-    int const radius,
-    float const coef)
+/**
+ * Median filters rows [y_begin, y_end) of src, in constant time per pixel
+ * regardless of the radius.  This follows S. Perreault and P. Hebert,
+ * "Median Filtering in Constant Time": a histogram is kept for each column
+ * of the (2 * radius + 1) rows window and slid down by one row at a time.
+ * Kernel histograms are then assembled from column histograms while sliding
+ * to the right.  A coarse 16-bin kernel histogram locates the median's
+ * bucket, and only that bucket of the fine 256-bin kernel histogram is
+ * brought up to date.  The image is processed in vertical strips narrow
+ * enough for their column histograms to stay in cache.  Pixels outside
+ * of the image replicate the nearest edge pixels.
+ *
+ * KernelCount must be able to hold (2 * radius + 1)^2.  16-bit counters
+ * let the compiler process all 16 bins of a bucket in a vector register.
+ */
+template<typename KernelCount>
+static void grayMedianBand(
+    GrayImage const& src, uint8_t* const dst_data, int const dst_stride,
+    int const radius, float const coef,
+    int const y_begin, int const y_end)
 {
-    GrayImage dst(src);
-    grayMedianInPlace(dst, radius, coef);
-    return dst;
-} // grayMedian
+    int const w = src.width();
+    int const h = src.height();
+    uint8_t const* const src_data = src.data();
+    int const src_stride = src.stride();
+    int const rsize = radius + 1 + radius;
+    uint32_t const fsizemed = (uint32_t(rsize) * uint32_t(rsize) + 1) / 2;
+    int const strip_width = 256;
 
-void grayMedianInPlace(
-    GrayImage& src,
-    int const radius,
-    float const coef)
-{
-    if (src.isNull())
+    // Column histograms, fine and coarse.  The window height is limited
+    // by the 16-bit counters.
+    size_t const max_columns = size_t(std::min(w, strip_width + 2 * radius));
+    std::vector<uint16_t> col_fine(max_columns * 256);
+    std::vector<uint16_t> col_coarse(max_columns * 16);
+
+    auto const clampY = [h](int const y)
     {
-        return;
-    }
+        return (y < 0) ? 0 : ((y < h) ? y : (h - 1));
+    };
 
-    if ((radius > 0) && (coef != 0.0f))
+    for (int strip_begin = 0; strip_begin < w; strip_begin += strip_width)
     {
-        unsigned int const histsize = 256;
-        unsigned int median = histsize / 2;
-        int const w = src.width();
-        int const h = src.height();
-        unsigned char* src_line = src.data();
-        unsigned int const src_stride = src.stride();
-        uint64_t const rsize = radius + 1 + radius;
-        uint64_t const fsize = rsize * rsize;
-        uint64_t sum = 0, histogram[histsize] = {0};
-        uint64_t const fsizemed = (fsize + 1) / 2;
+        int const strip_end = std::min(w, strip_begin + strip_width);
+        // Columns whose histograms are needed for this strip.
+        int const col_begin = std::max(0, strip_begin - radius);
+        int const col_end = std::min(w, strip_end + radius);
 
-        GrayImage gmean = GrayImage(src);
-        if (gmean.isNull())
+        // Maps an image column to its histogram index, replicating edge columns.
+        auto const colIdx = [w, col_begin](int const x)
         {
-            return;
+            return ((x < 0) ? 0 : ((x < w) ? x : (w - 1))) - col_begin;
+        };
+        auto const updateColumns = [&](int const y, int const delta)
+        {
+            uint8_t const* line = src_data + clampY(y) * src_stride;
+            for (int x = col_begin; x < col_end; ++x)
+            {
+                unsigned const val = line[x];
+                col_fine[(x - col_begin) * 256 + val] += delta;
+                col_coarse[(x - col_begin) * 16 + (val >> 4)] += delta;
+            }
+        };
+
+        std::fill(col_fine.begin(), col_fine.end(), 0);
+        std::fill(col_coarse.begin(), col_coarse.end(), 0);
+        for (int yf = y_begin - radius; yf <= y_begin + radius; ++yf)
+        {
+            updateColumns(yf, 1);
         }
-        unsigned char* gmean_line = gmean.data();
-        unsigned int const gmean_stride = gmean.stride();
 
-        for (int y = 0; y < h; y++)
+        uint8_t const* src_line = src_data + y_begin * src_stride;
+        uint8_t* dst_line = dst_data + y_begin * dst_stride;
+        for (int y = y_begin; y < y_end; ++y)
         {
-            for (int x = 0; x < w; x++)
+            if (y != y_begin)
             {
-                float const origin = src_line[x];
-                if (x == 0)
+                updateColumns(y - radius - 1, -1);
+                updateColumns(y + radius, 1);
+            }
+
+            KernelCount coarse[16] = {0};
+            KernelCount fine[256];
+            // The kernel position each fine bucket reflects.
+            int fine_x[16];
+            for (int b = 0; b < 16; ++b)
+            {
+                fine_x[b] = INT_MIN / 2;
+            }
+
+            for (int xf = strip_begin - radius; xf <= strip_begin + radius; ++xf)
+            {
+                uint16_t const* col = &col_coarse[colIdx(xf) * 16];
+                for (int b = 0; b < 16; ++b)
+                {
+                    coarse[b] += col[b];
+                }
+            }
+
+            for (int x = strip_begin; x < strip_end; ++x)
+            {
+                if (x != strip_begin)
+                {
+                    uint16_t const* col_out = &col_coarse[colIdx(x - radius - 1) * 16];
+                    uint16_t const* col_in = &col_coarse[colIdx(x + radius) * 16];
+                    for (int b = 0; b < 16; ++b)
+                    {
+                        coarse[b] += KernelCount(col_in[b] - col_out[b]);
+                    }
+                }
+
+                // Locate the bucket containing the median.
+                uint32_t sum = 0;
+                int b = 0;
+                while (sum + coarse[b] < fsizemed)
+                {
+                    sum += coarse[b];
+                    ++b;
+                }
+
+                // Bring the fine histogram of that bucket up to date.
+                KernelCount* fine_bucket = fine + b * 16;
+                if (x - fine_x[b] > rsize)
                 {
-                    for (unsigned int k = 0; k < histsize; k++)
+                    for (int i = 0; i < 16; ++i)
                     {
-                        histogram[k] = 0;
+                        fine_bucket[i] = 0;
                     }
-                    for (int yf = (y - radius); yf < (y + radius + 1); yf++)
+                    for (int xf = x - radius; xf <= x + radius; ++xf)
                     {
-                        int const yfs = (yf < 0) ? 0 : ((yf < h) ? yf : (h - 1));
-                        unsigned char* f_line = src.data();
-                        f_line += (yfs * src_stride);
-                        for  (int xf = (x - radius); xf < (x + radius + 1); xf++)
+                        uint16_t const* col = &col_fine[colIdx(xf) * 256 + b * 16];
+                        for (int i = 0; i < 16; ++i)
                         {
-                            int const xfs = (xf < 0) ? 0 : ((xf < w) ? xf : (w - 1));
-                            histogram[f_line[xfs]]++;
+                            fine_bucket[i] += col[i];
                         }
                     }
                 }
                 else
                 {
-                    int const L = x - radius - 1;
-                    int const xl = (L < 0) ? 0 : ((L < w) ? L : (w - 1));
-                    int const R = x + radius;
-                    int const xr = (R < 0) ? 0 : ((R < w) ? R : (w - 1));
-                    for (int yf = (y - radius); yf < (y + radius + 1); yf++)
+                    for (int xk = fine_x[b] + 1; xk <= x; ++xk)
                     {
-                        int const yfs = (yf < 0) ? 0 : ((yf < h) ? yf : (h - 1));
-                        unsigned char* f_line = src.data();
-                        f_line += (yfs * src_stride);
-                        histogram[f_line[xl]]--;
-                        histogram[f_line[xr]]++;
+                        uint16_t const* col_out = &col_fine[colIdx(xk - radius - 1) * 256 + b * 16];
+                        uint16_t const* col_in = &col_fine[colIdx(xk + radius) * 256 + b * 16];
+                        for (int i = 0; i < 16; ++i)
+                        {
+                            fine_bucket[i] += KernelCount(col_in[i] - col_out[i]);
+                        }
                     }
                 }
-                int median = 0;
-                sum = histogram[median];
+                fine_x[b] = x;
+
+                int median = b * 16;
+                sum += fine_bucket[0];
                 while (sum < fsizemed)
                 {
-                    median++;
-                    sum += histogram[median];
+                    ++median;
+                    sum += fine[median];
                 }
+
+                float const origin = src_line[x];
                 float retval = coef * median + (1.0f - coef) * origin + 0.5f;
                 retval = (retval < 0.0f) ? 0.0f : (retval < 255.0f) ? retval : 255.0f;
-                gmean_line[x] = (unsigned char) retval;
+                dst_line[x] = (unsigned char) retval;
             }
+
             src_line += src_stride;
-            gmean_line += gmean_stride;
+            dst_line += dst_stride;
         }
+    }
+}
 
-        src = GrayImage(gmean);
-        gmean = GrayImage();
+GrayImage grayMedian(
+    GrayImage const& src,
+    int const radius,
+    float const coef,
+    RangeExecutor const& executor)
+{
+    GrayImage dst(src);
+    grayMedianInPlace(dst, radius, coef, executor);
+    return dst;
+} // grayMedian
+
+void grayMedianInPlace(
+    GrayImage& src,
+    int const radius,
+    float const coef,
+    RangeExecutor const& executor)
+{
+    if (src.isNull())
+    {
+        return;
+    }
+
+    if ((radius > 0) && (coef != 0.0f))
+    {
+        // Column histograms use 16-bit counters.
+        int const max_radius = 32767;
+        int const r = (radius < max_radius) ? radius : max_radius;
+
+        GrayImage gmean(src.size());
+        if (gmean.isNull())
+        {
+            return;
+        }
+
+        GrayImage const& csrc = src;
+        uint8_t* const gmean_data = gmean.data();
+        int const gmean_stride = gmean.stride();
+
+        executor(0, src.height(), [&](int const y_begin, int const y_end)
+        {
+            if (r <= 127) // (2 * 127 + 1)^2 fits into 16 bits.
+            {
+                grayMedianBand<uint16_t>(csrc, gmean_data, gmean_stride, r, coef, y_begin, y_end);
+            }
+            else
+            {
+                grayMedianBand<uint32_t>(csrc, gmean_data, gmean_stride, r, coef, y_begin, y_end);
+            }
+        });
+
+        src = gmean;
     }
 } // grayMedianInPlace
 
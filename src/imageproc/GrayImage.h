@@ -25,6 +25,7 @@
 #include <QSize>
 #include <QRect>
 #include "imageproc_config.h"
+#include "ParallelFor.h"
 #include "GridAccessor.h"
 #include "IntegralImage.h"
 #include "Binarize.h"
@@ -33,6 +34,8 @@
 namespace imageproc
 {
 
+class LocalStats;
+
 /**
  * \brief A wrapper class around QImage that is always guaranteed to be 8-bit grayscale.
  */
@@ -164,6 +167,9 @@ IMAGEPROC_EXPORT GrayImage grayMapContrast(
  * \brief Threshold Map Images:
  * https://github.com/brandonmpetty/Doxa
  * https://habr.com/ru/articles/907996/
+ *
+ * The versions taking LocalStats reuse window statistics already computed
+ * for the page, see LocalStats.
  */
 IMAGEPROC_EXPORT unsigned int grayBiModalTiledValue(
     GrayImage const& src,
@@ -186,6 +192,10 @@ IMAGEPROC_EXPORT GrayImage grayNiblackMap(
     int radius = 100,
     float k = 0.20f,
     int delta = 0);
+IMAGEPROC_EXPORT GrayImage grayNiblackMap(
+    LocalStats const& stats,
+    float k = 0.20f,
+    int delta = 0);
 IMAGEPROC_EXPORT void grayBGtoMap(
     GrayImage const& src,
     GrayImage& background,
@@ -196,25 +206,44 @@ IMAGEPROC_EXPORT GrayImage graySauvolaMap(
     int radius = 100,
     float k = 0.30f,
     int delta = 0);
+IMAGEPROC_EXPORT GrayImage graySauvolaMap(
+    LocalStats const& stats,
+    float k = 0.30f,
+    int delta = 0);
 IMAGEPROC_EXPORT GrayImage grayWolfMap(
     GrayImage const& src,
     int radius = 100,
     float k = 0.30f,
     int delta = 0);
+IMAGEPROC_EXPORT GrayImage grayWolfMap(
+    LocalStats const& stats,
+    float k = 0.30f,
+    int delta = 0);
 IMAGEPROC_EXPORT GrayImage grayWindowMap(
     GrayImage const& src,
     int radius = 50,
     float k = 1.0f,
     int delta = 0);
+IMAGEPROC_EXPORT GrayImage grayWindowMap(
+    LocalStats const& stats,
+    float k = 1.0f,
+    int delta = 0);
 IMAGEPROC_EXPORT GrayImage grayBradleyMap(
     GrayImage const& src,
     int radius = 100,
     float k = 0.20f);
+IMAGEPROC_EXPORT GrayImage grayBradleyMap(
+    LocalStats const& stats,
+    float k = 0.20f);
 IMAGEPROC_EXPORT GrayImage grayNickMap(
     GrayImage const& src,
     int radius = 100,
     float k = 0.10f,
     int delta = 0);
+IMAGEPROC_EXPORT GrayImage grayNickMap(
+    LocalStats const& stats,
+    float k = 0.10f,
+    int delta = 0);
 IMAGEPROC_EXPORT GrayImage grayGradMap(
     GrayImage const& src,
     int radius = 10,
@@ -225,16 +254,28 @@ IMAGEPROC_EXPORT GrayImage graySinghMap(
     int radius = 100,
     float k = 0.30f,
     int delta = 0);
+IMAGEPROC_EXPORT GrayImage graySinghMap(
+    LocalStats const& stats,
+    float k = 0.30f,
+    int delta = 0);
 IMAGEPROC_EXPORT GrayImage grayFoxMap(
     GrayImage const& src,
     int radius = 100,
     float k = 0.30f,
     int delta = 0);
+IMAGEPROC_EXPORT GrayImage grayFoxMap(
+    LocalStats const& stats,
+    float k = 0.30f,
+    int delta = 0);
 IMAGEPROC_EXPORT GrayImage grayWANMap(
     GrayImage const& src,
     int radius = 100,
     float k = 0.30f,
     int delta = 0);
+IMAGEPROC_EXPORT GrayImage grayWANMap(
+    LocalStats const& stats,
+    float k = 0.30f,
+    int delta = 0);
 IMAGEPROC_EXPORT GrayImage grayMScaleMap(
     GrayImage const& src,
     int radius = 10,
@@ -266,6 +307,13 @@ IMAGEPROC_EXPORT GrayImage grayCurveFilter(
 IMAGEPROC_EXPORT void grayCurveFilterInPlace(
     GrayImage& src, float coef = 0.5f);
 
+/**
+ * @brief The lookup table grayCurveFilterInPlace() applies to an image
+ *        with the given 256 bin histogram.
+ */
+IMAGEPROC_EXPORT void grayCurveFilterTable(
+    unsigned char* table, uint64_t const* histogram, float coef = 0.5f);
+
 /**
  * @brief C-curve.
  *
@@ -277,6 +325,12 @@ IMAGEPROC_EXPORT GrayImage graySqrFilter(
 IMAGEPROC_EXPORT void graySqrFilterInPlace(
     GrayImage& src, float coef = 0.0f);
 
+/**
+ * @brief The lookup table graySqrFilterInPlace() applies.
+ */
+IMAGEPROC_EXPORT void graySqrFilterTable(
+    unsigned char* table, float coef = 0.0f);
+
 /**
  * @brief Engraving GrayImage based GaussBlur.
  */
@@ -368,15 +422,20 @@ IMAGEPROC_EXPORT void grayEMDenoiserInPlace(
 
 /**
  * @brief Median GrayImage.
+ *
+ * Runs in constant time per pixel regardless of the radius.
+ * The executor processes bands of rows, in parallel by default.
  */
 IMAGEPROC_EXPORT GrayImage grayMedian(
     GrayImage const& src,
     int radius = 2,
-    float coef = 0.0f);
+    float coef = 0.0f,
+    RangeExecutor const& executor = &parallelFor);
 IMAGEPROC_EXPORT void grayMedianInPlace(
     GrayImage& src,
     int radius = 2,
-    float coef = 0.0f);
+    float coef = 0.0f,
+    RangeExecutor const& executor = &parallelFor);
 
 /**
  * @brief Subtract BG GrayImage.
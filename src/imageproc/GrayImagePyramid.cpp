@@ -0,0 +1,164 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "GrayImagePyramid.h"
+#include "AffineImageTransform.h"
+#include "AffineTransformedImage.h"
+#include "Scale.h"
+#include <QTransform>
+#include <QMutex>
+#include <QMutexLocker>
+#include <vector>
+#include <algorithm>
+#include <math.h>
+#include <assert.h>
+
+namespace imageproc
+{
+
+namespace
+{
+
+/**
+ * We don't go below this size along the longer side. Consumers
+ * of downscaled images don't go below it either.
+ */
+int const MIN_LEVEL_SIZE = 256;
+
+} // anonymous namespace
+
+struct GrayImagePyramid::SharedState
+{
+    QMutex mutex;
+    QSize origSize;
+    CachingFactory<GrayImage> origImageFactory;
+
+    /** levelSizes[i] is the size of level i. */
+    std::vector<QSize> levelSizes;
+
+    /**
+     * Downscaled levels built so far. downscaled[i] is level i + 1.
+     * Level 0 is cached by origImageFactory.
+     */
+    std::vector<GrayImage> downscaled;
+
+    SharedState(QSize const& orig_size, CachingFactory<GrayImage> const& factory)
+        : origSize(orig_size), origImageFactory(factory) {}
+};
+
+GrayImagePyramid::GrayImagePyramid(
+    QSize const& orig_size, CachingFactory<GrayImage> const& orig_image_factory)
+    :	m_ptrState(std::make_shared<SharedState>(orig_size, orig_image_factory))
+{
+    QSize size(orig_size);
+    m_ptrState->levelSizes.push_back(size);
+    while (std::max(size.width(), size.height()) >= MIN_LEVEL_SIZE * 2)
+    {
+        size = QSize((size.width() + 1) / 2, (size.height() + 1) / 2);
+        m_ptrState->levelSizes.push_back(size);
+    }
+}
+
+QSize const&
+GrayImagePyramid::origSize() const
+{
+    return m_ptrState->origSize;
+}
+
+int
+GrayImagePyramid::numLevels() const
+{
+    return int(m_ptrState->levelSizes.size());
+}
+
+QSize
+GrayImagePyramid::levelSize(int const idx) const
+{
+    assert(idx >= 0 && idx < numLevels());
+    return m_ptrState->levelSizes[idx];
+}
+
+GrayImage
+GrayImagePyramid::level(int const idx) const
+{
+    assert(idx >= 0 && idx < numLevels());
+
+    SharedState& s = *m_ptrState;
+    if (idx == 0)
+    {
+        return s.origImageFactory();
+    }
+
+    QMutexLocker const locker(&s.mutex);
+
+    while (int(s.downscaled.size()) < idx)
+    {
+        GrayImage const prev(
+            s.downscaled.empty() ? s.origImageFactory() : s.downscaled.back()
+        );
+        s.downscaled.push_back(scaleToGray(prev, s.levelSizes[s.downscaled.size() + 1]));
+    }
+
+    return s.downscaled[idx - 1];
+}
+
+int
+GrayImagePyramid::levelIdxFor(QTransform const& orig_to_target) const
+{
+    SharedState const& s = *m_ptrState;
+
+    // How much a unit step along each of the image axes gets scaled.
+    double const x_scale = hypot(orig_to_target.m11(), orig_to_target.m12());
+    double const y_scale = hypot(orig_to_target.m21(), orig_to_target.m22());
+
+    int selected = 0;
+    for (int idx = 1; idx < numLevels(); ++idx)
+    {
+        QSize const size(s.levelSizes[idx]);
+        double const level_x_scale = double(size.width()) / s.origSize.width();
+        double const level_y_scale = double(size.height()) / s.origSize.height();
+        if (level_x_scale < x_scale || level_y_scale < y_scale)
+        {
+            // Would lose detail.
+            break;
+        }
+
+        selected = idx;
+    }
+
+    return selected;
+}
+
+AffineTransformedImage
+GrayImagePyramid::levelFor(
+    AffineImageTransform const& xform, QTransform const& orig_to_target) const
+{
+    assert(xform.origSize() == origSize());
+
+    int const idx = levelIdxFor(orig_to_target);
+    if (idx == 0)
+    {
+        return AffineTransformedImage(level(0), xform);
+    }
+
+    AffineImageTransform level_xform(xform);
+    level_xform.adjustForScaledOrigImage(m_ptrState->levelSizes[idx]);
+    return AffineTransformedImage(level(idx), level_xform);
+}
+
+} // namespace imageproc
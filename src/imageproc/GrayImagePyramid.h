@@ -0,0 +1,109 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef IMAGEPROC_GRAY_IMAGE_PYRAMID_H_
+#define IMAGEPROC_GRAY_IMAGE_PYRAMID_H_
+
+#include "imageproc_config.h"
+#include "CachingFactory.h"
+#include "GrayImage.h"
+#include <QSize>
+#include <memory>
+
+class QTransform;
+
+namespace imageproc
+{
+
+class AffineImageTransform;
+class AffineTransformedImage;
+
+/**
+ * \brief A grayscale version of a page along with its versions downscaled
+ *        by powers of two.
+ *
+ * Level 0 is the full size grayscale image, as produced by the factory
+ * the pyramid was constructed with. Each further level is half the size
+ * of the previous one, rounded up. Levels, including level 0, are built
+ * the first time they are asked for.
+ *
+ * A pyramid is built once per page and passed down the chain of tasks,
+ * so that a stage which only needs a downscaled image picks the closest
+ * level rather than downscaling the full size image once again.
+ *
+ * \note Multiple copies of GrayImagePyramid share the same levels.
+ * \note This class is thread-safe.
+ */
+class IMAGEPROC_EXPORT GrayImagePyramid
+{
+    // Member-wise copying is OK.
+public:
+    /**
+     * \param orig_size The size of the full size image.
+     * \param orig_image_factory Produces the full size grayscale image.
+     */
+    GrayImagePyramid(QSize const& orig_size,
+                     CachingFactory<GrayImage> const& orig_image_factory);
+
+    QSize const& origSize() const;
+
+    /**
+     * \brief Returns the number of levels, including level 0.
+     */
+    int numLevels() const;
+
+    /**
+     * \brief Returns the size of a level, without building it.
+     */
+    QSize levelSize(int idx) const;
+
+    /**
+     * \brief Returns a level, building it and the ones above if necessary.
+     *
+     * \param idx Level index, from 0 to numLevels() - 1.
+     */
+    GrayImage level(int idx) const;
+
+    /**
+     * \brief Picks the smallest level still detailed enough to be mapped
+     *        with the given transformation without upscaling.
+     *
+     * \param orig_to_target Transformation from full size image coordinates
+     *        to the coordinates of what is going to be produced.
+     * \return The index of the selected level.
+     */
+    int levelIdxFor(QTransform const& orig_to_target) const;
+
+    /**
+     * \brief Returns the level picked by levelIdxFor(), along with \p xform
+     *        adjusted to operate on it.
+     *
+     * \param xform A transformation of the full size image.
+     * \param orig_to_target See levelIdxFor().
+     */
+    AffineTransformedImage levelFor(
+        AffineImageTransform const& xform, QTransform const& orig_to_target) const;
+private:
+    struct SharedState;
+
+    std::shared_ptr<SharedState> m_ptrState;
+};
+
+} // namespace imageproc
+
+#endif
@@ -20,6 +20,7 @@
 #include "GrayImage.h"
 #include "BinaryImage.h"
 #include "BitOps.h"
+#include "SimdKernels.h"
 #include <QImage>
 #include <QColor>
 #include <QtGlobal>
@@ -145,13 +146,30 @@ static QImage anyToGrayscale(QImage const& src)
     uint8_t* dst_line = dst.bits();
     int const dst_bpl = dst.bytesPerLine();
 
-    for (int y = 0; y < height; ++y)
+    if (src.format() == QImage::Format_RGB32 || src.format() == QImage::Format_ARGB32)
     {
-        for (int x = 0; x < width; ++x)
+        // For these formats, QImage::pixel() returns the stored value as is.
+        simd::Kernels const& kernels = simd::kernels();
+        uint8_t const* src_line = src.bits();
+        int const src_bpl = src.bytesPerLine();
+
+        for (int y = 0; y < height; ++y)
         {
-            dst_line[x] = static_cast<uint8_t>(qGray(src.pixel(x, y)));
+            kernels.rgb32ToGray(reinterpret_cast<uint32_t const*>(src_line), dst_line, width);
+            src_line += src_bpl;
+            dst_line += dst_bpl;
+        }
+    }
+    else
+    {
+        for (int y = 0; y < height; ++y)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                dst_line[x] = static_cast<uint8_t>(qGray(src.pixel(x, y)));
+            }
+            dst_line += dst_bpl;
         }
-        dst_line += dst_bpl;
     }
 
     dst.setDotsPerMeterX(src.dotsPerMeterX());
@@ -0,0 +1,47 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "IntegralImage.h"
+#include "SimdKernels.h"
+
+namespace imageproc
+{
+
+template<>
+void IntegralImage<uint32_t>::pushRow(uint8_t const* values)
+{
+    beginRow();
+    int const width = m_width - 1; // Excluding the fake column.
+    simd::kernels().integralRow(values, m_pAbove, m_pCur, width);
+    m_lineSum = width > 0 ? m_pCur[width - 1] - m_pAbove[width - 1] : 0;
+    m_pCur += width;
+    m_pAbove += width;
+}
+
+template<>
+void IntegralImage<uint64_t>::pushRowOfSquares(uint8_t const* values)
+{
+    beginRow();
+    int const width = m_width - 1; // Excluding the fake column.
+    simd::kernels().integralRowOfSquares(values, m_pAbove, m_pCur, width);
+    m_lineSum = width > 0 ? m_pCur[width - 1] - m_pAbove[width - 1] : 0;
+    m_pCur += width;
+    m_pAbove += width;
+}
+
+} // namespace imageproc
@@ -24,6 +24,7 @@
 #include <QSize>
 #include <QRect>
 #include <new>
+#include <stdint.h>
 
 namespace imageproc
 {
@@ -68,6 +69,22 @@ public:
      */
     void push(T val);
 
+    /**
+     * \brief Push a whole row of 8-bit values.
+     *
+     * Equivalent to beginRow() followed by push() of each of the
+     * width values.  Vectorized for IntegralImage<uint32_t>.
+     */
+    void pushRow(uint8_t const* values);
+
+    /**
+     * \brief Push squares of a whole row of 8-bit values.
+     *
+     * Equivalent to beginRow() followed by push() of each of the
+     * width squared values.  Vectorized for IntegralImage<uint64_t>.
+     */
+    void pushRowOfSquares(uint8_t const* values);
+
     /**
      * \brief Calculate the sum of values in the given rectangle.
      *
@@ -152,6 +169,37 @@ IntegralImage<T>::beginRow()
     ++m_pAbove;
 }
 
+template<typename T>
+void
+IntegralImage<T>::pushRow(uint8_t const* values)
+{
+    beginRow();
+    int const width = m_width - 1; // Excluding the fake column.
+    for (int i = 0; i < width; ++i)
+    {
+        push(T(values[i]));
+    }
+}
+
+template<typename T>
+void
+IntegralImage<T>::pushRowOfSquares(uint8_t const* values)
+{
+    beginRow();
+    int const width = m_width - 1; // Excluding the fake column.
+    for (int i = 0; i < width; ++i)
+    {
+        T const val(values[i]);
+        push(val * val);
+    }
+}
+
+template<>
+IMAGEPROC_EXPORT void IntegralImage<uint32_t>::pushRow(uint8_t const* values);
+
+template<>
+IMAGEPROC_EXPORT void IntegralImage<uint64_t>::pushRowOfSquares(uint8_t const* values);
+
 template<typename T>
 inline T
 IntegralImage<T>::sum(QRect const& rect) const
@@ -0,0 +1,428 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "LocalStats.h"
+#include <vector>
+#include <algorithm>
+#include <math.h>
+
+namespace imageproc
+{
+
+namespace
+{
+
+struct BandTotals
+{
+    unsigned grayMin;
+    unsigned grayMax;
+    uint64_t graySum;
+    unsigned deviationMin;
+    unsigned deviationMax;
+
+    BandTotals() : grayMin(255), grayMax(0), graySum(0), deviationMin(255), deviationMax(0) {}
+};
+
+/**
+ * Computes the requested maps for rows [y_begin, y_end) using running
+ * per-column sums over the window rows.  Either of mean_data and
+ * deviation_data may be null.  Both point to the first row of a map
+ * having the size of src, and have to be taken outside of parallel code,
+ * as GrayImage::data() may detach.
+ */
+void computeBand(
+    GrayImage const& src, int const radius,
+    uint8_t* const mean_data, int const mean_stride,
+    uint8_t* const deviation_data, int const deviation_stride,
+    int const y_begin, int const y_end, BandTotals& totals)
+{
+    int const w = src.width();
+    int const h = src.height();
+    uint8_t const* const src_data = src.data();
+    int const src_stride = src.stride();
+
+    uint8_t const* src_line = src_data + y_begin * src_stride;
+    for (int y = y_begin; y < y_end; y++)
+    {
+        for (int x = 0; x < w; x++)
+        {
+            unsigned const pixel = src_line[x];
+            totals.grayMin = std::min(totals.grayMin, pixel);
+            totals.grayMax = std::max(totals.grayMax, pixel);
+            totals.graySum += pixel;
+        }
+        src_line += src_stride;
+    }
+
+    if (!mean_data && !deviation_data)
+    {
+        return;
+    }
+
+    // Sums over the window rows [win_top, win_bottom) for each column,
+    // followed by their prefix sums along the current row.
+    std::vector<uint32_t> col_sum(w, 0);
+    std::vector<uint64_t> col_sqsum(deviation_data ? w : 0, 0);
+    std::vector<uint64_t> prefix_sum(w + 1, 0);
+    std::vector<uint64_t> prefix_sqsum(deviation_data ? w + 1 : 0, 0);
+    int win_top = std::max(0, y_begin - radius);
+    int win_bottom = win_top;
+
+    for (int y = y_begin; y < y_end; y++)
+    {
+        int const top = std::max(0, y - radius);
+        int const bottom = std::min(h, y + radius + 1);
+
+        for (; win_bottom < bottom; win_bottom++)
+        {
+            uint8_t const* line = src_data + win_bottom * src_stride;
+            for (int x = 0; x < w; x++)
+            {
+                uint32_t const pixel = line[x];
+                col_sum[x] += pixel;
+            }
+            if (deviation_data)
+            {
+                for (int x = 0; x < w; x++)
+                {
+                    uint32_t const pixel = line[x];
+                    col_sqsum[x] += pixel * pixel;
+                }
+            }
+        }
+        for (; win_top < top; win_top++)
+        {
+            uint8_t const* line = src_data + win_top * src_stride;
+            for (int x = 0; x < w; x++)
+            {
+                uint32_t const pixel = line[x];
+                col_sum[x] -= pixel;
+            }
+            if (deviation_data)
+            {
+                for (int x = 0; x < w; x++)
+                {
+                    uint32_t const pixel = line[x];
+                    col_sqsum[x] -= pixel * pixel;
+                }
+            }
+        }
+
+        for (int x = 0; x < w; x++)
+        {
+            prefix_sum[x + 1] = prefix_sum[x] + col_sum[x];
+        }
+        if (deviation_data)
+        {
+            for (int x = 0; x < w; x++)
+            {
+                prefix_sqsum[x + 1] = prefix_sqsum[x] + col_sqsum[x];
+            }
+        }
+
+        int const rows = bottom - top;
+
+        if (mean_data)
+        {
+            // Note that grayMapMean() has always excluded the column
+            // at x + radius from its window.
+            uint8_t* mean_line = mean_data + y * mean_stride;
+            for (int x = 0; x < w; x++)
+            {
+                int const left = std::max(0, x - radius);
+                int const right = std::min(w, x + radius);
+                int const area = rows * (right - left);
+
+                double const window_sum = (double) (prefix_sum[right] - prefix_sum[left]);
+
+                double const r_area = 1.0 / area;
+                double value = window_sum * r_area;
+
+                value += 0.5;
+                value = (value < 0.0) ? 0.0 : ((value < 255.0) ? value : 255.0);
+                mean_line[x] = (uint8_t) value;
+            }
+        }
+
+        if (deviation_data)
+        {
+            uint8_t* deviation_line = deviation_data + y * deviation_stride;
+            for (int x = 0; x < w; x++)
+            {
+                int const left = std::max(0, x - radius);
+                int const right = std::min(w, x + radius + 1);
+                int const area = rows * (right - left);
+
+                double const window_sum = (double) (prefix_sum[right] - prefix_sum[left]);
+                double const window_sqsum = (double) (prefix_sqsum[right] - prefix_sqsum[left]);
+
+                double const r_area = 1.0 / area;
+                double const window_mean = window_sum * r_area;
+                double const sqmean = window_sqsum * r_area;
+
+                double const variance = sqmean - window_mean * window_mean;
+                double value = sqrt(fabs(variance));
+
+                value += 0.5;
+                value = (value < 0.0) ? 0.0 : ((value < 255.0) ? value : 255.0);
+                uint8_t const result = (uint8_t) value;
+                deviation_line[x] = result;
+                totals.deviationMin = std::min<unsigned>(totals.deviationMin, result);
+                totals.deviationMax = std::max<unsigned>(totals.deviationMax, result);
+            }
+        }
+    }
+}
+
+struct MaxOp
+{
+    static uint8_t neutral()
+    {
+        return 0;
+    }
+
+    uint8_t operator()(uint8_t a, uint8_t b) const
+    {
+        return (a < b) ? b : a;
+    }
+};
+
+struct MinOp
+{
+    static uint8_t neutral()
+    {
+        return 255;
+    }
+
+    uint8_t operator()(uint8_t a, uint8_t b) const
+    {
+        return (a < b) ? a : b;
+    }
+};
+
+/**
+ * The van Herk / Gil-Werman sliding window extremum over a line of n values.
+ * The line is padded with radius neutral values on both sides and split into
+ * blocks of the window size.  Every window then spans at most two blocks and
+ * its extremum is combined from a suffix of one and a prefix of the other.
+ * Both buffers must hold n + 2 * radius values.
+ */
+template<typename Op>
+void slidingExtremum(
+    uint8_t const* in, int const in_step, uint8_t* out, int const out_step,
+    int const n, int const radius, uint8_t* forward, uint8_t* backward)
+{
+    Op const op;
+    int const window = 2 * radius + 1;
+    int const padded = n + 2 * radius;
+
+    for (int p = 0, pos = 0; p < padded; p++, pos++)
+    {
+        int const i = p - radius;
+        uint8_t const v = (i >= 0 && i < n) ? in[i * in_step] : Op::neutral();
+        if (pos == window)
+        {
+            pos = 0;
+        }
+        forward[p] = (pos == 0) ? v : op(forward[p - 1], v);
+    }
+
+    for (int p = padded - 1; p >= 0; p--)
+    {
+        int const i = p - radius;
+        uint8_t const v = (i >= 0 && i < n) ? in[i * in_step] : Op::neutral();
+        backward[p] = ((p == padded - 1) || ((p + 1) % window == 0)) ? v : op(backward[p + 1], v);
+    }
+
+    for (int x = 0; x < n; x++)
+    {
+        out[x * out_step] = op(backward[x], forward[x + 2 * radius]);
+    }
+}
+
+template<typename Op>
+GrayImage windowExtremumImpl(
+    GrayImage const& src, int const radius, RangeExecutor const& executor)
+{
+    int const w = src.width();
+    int const h = src.height();
+    // Windows wider than the image behave as if they were just as wide.
+    int const rx = std::min(radius, w - 1);
+    int const ry = std::min(radius, h - 1);
+
+    GrayImage horizontal(src.size());
+    uint8_t const* const src_data = src.data();
+    int const src_stride = src.stride();
+    uint8_t* const hor_data = horizontal.data();
+    int const hor_stride = horizontal.stride();
+
+    executor(0, h, [&](int y_begin, int y_end)
+    {
+        std::vector<uint8_t> forward(w + 2 * rx);
+        std::vector<uint8_t> backward(w + 2 * rx);
+        for (int y = y_begin; y < y_end; y++)
+        {
+            slidingExtremum<Op>(
+                src_data + y * src_stride, 1, hor_data + y * hor_stride, 1,
+                w, rx, &forward[0], &backward[0]
+            );
+        }
+    });
+
+    GrayImage dst(src.size());
+    uint8_t* const dst_data = dst.data();
+    int const dst_stride = dst.stride();
+
+    executor(0, w, [&](int x_begin, int x_end)
+    {
+        std::vector<uint8_t> forward(h + 2 * ry);
+        std::vector<uint8_t> backward(h + 2 * ry);
+        for (int x = x_begin; x < x_end; x++)
+        {
+            slidingExtremum<Op>(
+                hor_data + x, hor_stride, dst_data + x, dst_stride,
+                h, ry, &forward[0], &backward[0]
+            );
+        }
+    });
+
+    return dst;
+}
+
+} // anonymous namespace
+
+LocalStats::LocalStats(
+    GrayImage const& src, int const radius,
+    int const maps, RangeExecutor const& executor)
+    :   m_src(src),
+        m_executor(executor),
+        m_radius(radius),
+        m_grayMin(255),
+        m_grayMax(0),
+        m_graySum(0),
+        m_deviationMin(255),
+        m_deviationMax(0)
+{
+    if (src.isNull())
+    {
+        return;
+    }
+
+    int const h = src.height();
+    GrayImage* mean = nullptr;
+    GrayImage* deviation = nullptr;
+
+    if (radius <= 0)
+    {
+        if (maps & MEAN)
+        {
+            m_mean = src;
+        }
+        if (maps & DEVIATION)
+        {
+            m_deviation = src;
+        }
+    }
+    else
+    {
+        if (maps & MEAN)
+        {
+            m_mean = GrayImage(src.size());
+            mean = &m_mean;
+        }
+        if (maps & DEVIATION)
+        {
+            m_deviation = GrayImage(src.size());
+            deviation = &m_deviation;
+        }
+    }
+
+    // Every band re-reads up to 2 * radius rows to initialize its column
+    // sums, so we don't make bands much shorter than the window.
+    int const band_height = std::max(32, std::min(2 * std::max(radius, 0) + 1, h));
+    int const num_bands = (h + band_height - 1) / band_height;
+    std::vector<BandTotals> totals(num_bands);
+    uint8_t* const mean_data = mean ? mean->data() : nullptr;
+    int const mean_stride = mean ? mean->stride() : 0;
+    uint8_t* const deviation_data = deviation ? deviation->data() : nullptr;
+    int const deviation_stride = deviation ? deviation->stride() : 0;
+
+    m_executor(0, num_bands, [&](int band_begin, int band_end)
+    {
+        for (int band = band_begin; band < band_end; band++)
+        {
+            int const y_begin = band * band_height;
+            int const y_end = std::min(h, y_begin + band_height);
+            computeBand(
+                src, radius, mean_data, mean_stride, deviation_data, deviation_stride,
+                y_begin, y_end, totals[band]
+            );
+        }
+    });
+
+    for (BandTotals const& band : totals)
+    {
+        m_grayMin = std::min(m_grayMin, band.grayMin);
+        m_grayMax = std::max(m_grayMax, band.grayMax);
+        m_graySum += band.graySum;
+        m_deviationMin = std::min(m_deviationMin, band.deviationMin);
+        m_deviationMax = std::max(m_deviationMax, band.deviationMax);
+    }
+
+    if ((radius <= 0) && (maps & DEVIATION))
+    {
+        m_deviationMin = m_grayMin;
+        m_deviationMax = m_grayMax;
+    }
+}
+
+GrayImage
+LocalStats::windowMax() const
+{
+    return windowExtremum(true);
+}
+
+GrayImage
+LocalStats::windowMin() const
+{
+    return windowExtremum(false);
+}
+
+GrayImage
+LocalStats::windowExtremum(bool const max) const
+{
+    if (m_src.isNull())
+    {
+        return GrayImage();
+    }
+    if (m_radius <= 0)
+    {
+        return m_src;
+    }
+
+    if (max)
+    {
+        return windowExtremumImpl<MaxOp>(m_src, m_radius, m_executor);
+    }
+    else
+    {
+        return windowExtremumImpl<MinOp>(m_src, m_radius, m_executor);
+    }
+}
+
+} // namespace imageproc
@@ -0,0 +1,161 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef IMAGEPROC_LOCALSTATS_H_
+#define IMAGEPROC_LOCALSTATS_H_
+
+#include "imageproc_config.h"
+#include "GrayImage.h"
+#include "ParallelFor.h"
+#include <stdint.h>
+
+namespace imageproc
+{
+
+/**
+ * \brief Window statistics of a grayscale image, shared by the
+ *        threshold-map binarizers.
+ *
+ * Window means and standard deviations are computed together in a single
+ * pass over the image, in parallel bands of rows.  Instead of integral images
+ * spanning the whole page, each band keeps running per-column sums, so the
+ * extra memory is proportional to the image width rather than its area.
+ * The global statistics some binarizers need (the minimum, maximum and sum
+ * of the source pixels, the range of deviations) are gathered in the same
+ * pass.
+ *
+ * The resulting maps are identical to those of grayMapMean() and
+ * grayMapDeviation(), so one LocalStats object may be built per page and
+ * passed to any number of binarizers using the same radius.
+ */
+class IMAGEPROC_EXPORT LocalStats
+{
+public:
+    enum Maps
+    {
+        MEAN = 1,
+        DEVIATION = 2
+    };
+
+    /**
+     * \brief Computes the statistics of \p src over windows of
+     *        (2 * radius + 1) x (2 * radius + 1) pixels.
+     *
+     * \param src The source image.
+     * \param radius The window radius.  With radius <= 0, the maps
+     *        are copies of the source image.
+     * \param maps A combination of MEAN and DEVIATION, selecting
+     *        which maps to build.  The maps not requested are null.
+     * \param executor Used to process bands of rows.
+     */
+    LocalStats(GrayImage const& src, int radius,
+               int maps = MEAN | DEVIATION,
+               RangeExecutor const& executor = &parallelFor);
+
+    GrayImage const& source() const
+    {
+        return m_src;
+    }
+
+    int radius() const
+    {
+        return m_radius;
+    }
+
+    /**
+     * \brief Window means, the same as grayMapMean() would return.
+     */
+    GrayImage const& mean() const
+    {
+        return m_mean;
+    }
+
+    /**
+     * \brief Window standard deviations, the same as grayMapDeviation()
+     *        would return.
+     */
+    GrayImage const& deviation() const
+    {
+        return m_deviation;
+    }
+
+    /**
+     * \brief Window maximums, the same as grayMapMax() would return.
+     *
+     * Computed on demand in O(1) per pixel, regardless of the radius.
+     */
+    GrayImage windowMax() const;
+
+    /**
+     * \brief Window minimums.  The counterpart of windowMax().
+     */
+    GrayImage windowMin() const;
+
+    unsigned grayMin() const
+    {
+        return m_grayMin;
+    }
+
+    unsigned grayMax() const
+    {
+        return m_grayMax;
+    }
+
+    /**
+     * \brief The sum of all source pixels.
+     */
+    uint64_t graySum() const
+    {
+        return m_graySum;
+    }
+
+    /**
+     * \brief The smallest value in the deviation() map, or 255
+     *        if it wasn't built.
+     */
+    unsigned deviationMin() const
+    {
+        return m_deviationMin;
+    }
+
+    /**
+     * \brief The largest value in the deviation() map, or 0
+     *        if it wasn't built.
+     */
+    unsigned deviationMax() const
+    {
+        return m_deviationMax;
+    }
+private:
+    GrayImage windowExtremum(bool max) const;
+
+    GrayImage m_src;
+    GrayImage m_mean;
+    GrayImage m_deviation;
+    RangeExecutor m_executor;
+    int m_radius;
+    unsigned m_grayMin;
+    unsigned m_grayMax;
+    uint64_t m_graySum;
+    unsigned m_deviationMin;
+    unsigned m_deviationMax;
+};
+
+} // namespace imageproc
+
+#endif
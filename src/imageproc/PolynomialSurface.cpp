@@ -126,7 +126,7 @@ PolynomialSurface::PolynomialSurface(
 }
 
 GrayImage
-PolynomialSurface::render(QSize const& size) const
+PolynomialSurface::render(QSize const& size, RangeExecutor const& executor) const
 {
     if (size.isEmpty())
     {
@@ -136,7 +136,6 @@ PolynomialSurface::render(QSize const& size) const
     GrayImage image(size);
     int const width = size.width();
     int const height = size.height();
-    unsigned char* line = image.data();
     int const bpl = image.stride();
     int const num_coeffs = m_coeffs.cols() * m_coeffs.rows();
 
@@ -177,21 +176,26 @@ PolynomialSurface::render(QSize const& size) const
         }
     }
 
-    float const* vert_line = &vert_matrix[0];
-    for (int y = 0; y < height; ++y, line += bpl, vert_line += num_coeffs)
+    unsigned char* const image_data = image.data();
+    executor(0, height, [&](int const y_begin, int const y_end)
     {
-        float const* hor_line = &hor_matrix[0];
-        for (int x = 0; x < width; ++x, hor_line += num_coeffs)
+        unsigned char* line = image_data + y_begin * bpl;
+        float const* vert_line = &vert_matrix[0] + y_begin * num_coeffs;
+        for (int y = y_begin; y < y_end; ++y, line += bpl, vert_line += num_coeffs)
         {
-            float sum = 0.5f / 255.0f; // for rounding purposes.
-            for (int i = 0; i < num_coeffs; ++i)
+            float const* hor_line = &hor_matrix[0];
+            for (int x = 0; x < width; ++x, hor_line += num_coeffs)
             {
-                sum += hor_line[i] * vert_line[i];
+                float sum = 0.5f / 255.0f; // for rounding purposes.
+                for (int i = 0; i < num_coeffs; ++i)
+                {
+                    sum += hor_line[i] * vert_line[i];
+                }
+                int const isum = (int)(sum * 255.0);
+                line[x] = static_cast<unsigned char>(qBound(0, isum, 255));
             }
-            int const isum = (int)(sum * 255.0);
-            line[x] = static_cast<unsigned char>(qBound(0, isum, 255));
         }
-    }
+    });
 
     return image;
 }
@@ -20,6 +20,7 @@
 #define IMAGEPROC_POLYNOMIAL_SURFACE_H_
 
 #include "imageproc_config.h"
+#include "ParallelFor.h"
 #include <Eigen/Core>
 #include <QSize>
 #include <stdint.h>
@@ -116,8 +117,9 @@ public:
      * \brief Visualizes the polynomial surface as a grayscale image.
      *
      * The surface will be stretched / shrinked to fit the new size.
+     * Bands of rows are rendered through \p executor.
      */
-    GrayImage render(QSize const& size) const;
+    GrayImage render(QSize const& size, RangeExecutor const& executor = &serialFor) const;
 private:
     void maybeReduceDegrees(int num_data_points);
 
@@ -21,6 +21,8 @@
 
 #include "imageproc_config.h"
 #include "BinaryImage.h"
+#include "Simd.h"
+#include "SimdWord128.h"
 #include <QPoint>
 #include <QRect>
 #include <QSize>
@@ -68,7 +70,8 @@ void rasterOp(BinaryImage& dst, BinaryImage const& src);
 class RopSrc
 {
 public:
-    static uint32_t transform(uint32_t src, uint32_t /*dst*/)
+    template<typename Word>
+    static Word transform(Word src, Word /*dst*/)
     {
         return src;
     }
@@ -81,7 +84,8 @@ public:
 class RopDst
 {
 public:
-    static uint32_t transform(uint32_t /*src*/, uint32_t dst)
+    template<typename Word>
+    static Word transform(Word /*src*/, Word dst)
     {
         return dst;
     }
@@ -95,7 +99,8 @@ template<typename Arg>
 class RopNot
 {
 public:
-    static uint32_t transform(uint32_t src, uint32_t dst)
+    template<typename Word>
+    static Word transform(Word src, Word dst)
     {
         return ~Arg::transform(src, dst);
     }
@@ -109,7 +114,8 @@ template<typename Arg1, typename Arg2>
 class RopAnd
 {
 public:
-    static uint32_t transform(uint32_t src, uint32_t dst)
+    template<typename Word>
+    static Word transform(Word src, Word dst)
     {
         return Arg1::transform(src, dst) & Arg2::transform(src, dst);
     }
@@ -123,7 +129,8 @@ template<typename Arg1, typename Arg2>
 class RopOr
 {
 public:
-    static uint32_t transform(uint32_t src, uint32_t dst)
+    template<typename Word>
+    static Word transform(Word src, Word dst)
     {
         return Arg1::transform(src, dst) | Arg2::transform(src, dst);
     }
@@ -137,7 +144,8 @@ template<typename Arg1, typename Arg2>
 class RopXor
 {
 public:
-    static uint32_t transform(uint32_t src, uint32_t dst)
+    template<typename Word>
+    static Word transform(Word src, Word dst)
     {
         return Arg1::transform(src, dst) ^ Arg2::transform(src, dst);
     }
@@ -151,10 +159,11 @@ template<typename Arg1, typename Arg2>
 class RopSubtract
 {
 public:
-    static uint32_t transform(uint32_t src, uint32_t dst)
+    template<typename Word>
+    static Word transform(Word src, Word dst)
     {
-        uint32_t lhs = Arg1::transform(src, dst);
-        uint32_t rhs = Arg2::transform(src, dst);
+        Word lhs = Arg1::transform(src, dst);
+        Word rhs = Arg2::transform(src, dst);
         return lhs & (lhs ^ rhs);
     }
 };
@@ -167,10 +176,11 @@ template<typename Arg1, typename Arg2>
 class RopSubtractWhite
 {
 public:
-    static uint32_t transform(uint32_t src, uint32_t dst)
+    template<typename Word>
+    static Word transform(Word src, Word dst)
     {
-        uint32_t lhs = Arg1::transform(src, dst);
-        uint32_t rhs = Arg2::transform(src, dst);
+        Word lhs = Arg1::transform(src, dst);
+        Word rhs = Arg2::transform(src, dst);
         return lhs | ~(lhs ^ rhs);
     }
 };
@@ -306,6 +316,9 @@ void rasterOpInDirection(
         }
         else
         {
+#ifdef IMAGEPROC_HAVE_WORD128
+            bool const wide = dx == 1 && simd::activeInstructionSet() != simd::SCALAR;
+#endif
             for (int i = dr.height(); i > 0; --i,
                     src_span += src_span_delta, dst_span += dst_span_delta)
             {
@@ -318,6 +331,23 @@ void rasterOpInDirection(
                 uint32_t new_dst_word = Rop::transform(src_word, dst_word);
                 dst_span[widx] = (dst_word & ~first_dst_mask) | (new_dst_word & first_dst_mask);
 
+#ifdef IMAGEPROC_HAVE_WORD128
+                if (wide)
+                {
+                    // Process full middle words, Word128::NUM_WORDS at a time.
+                    // All source words are loaded before any destination
+                    // words are stored, so going left to right is safe
+                    // even if src and dst overlap.
+                    int const n = simd::Word128::NUM_WORDS;
+                    for (; widx + n < last_dst_word; widx += n)
+                    {
+                        simd::Word128 const src_words(simd::Word128::load(src_span + widx + 1));
+                        simd::Word128 const dst_words(simd::Word128::load(dst_span + widx + 1));
+                        Rop::transform(src_words, dst_words).store(dst_span + widx + 1);
+                    }
+                }
+#endif
+
                 while ((widx += dx) != last_dst_word)
                 {
                     src_word = src_span[widx];
@@ -43,7 +43,8 @@ int calcNumTerms(int const hor_degree, int const vert_degree)
 
 GrayImage savGolFilter(
     GrayImage const& src, QSize const& window_size,
-    int const hor_degree, int const vert_degree)
+    int const hor_degree, int const vert_degree,
+    RangeExecutor const& executor)
 {
     if (hor_degree < 0 || vert_degree < 0)
     {
@@ -118,92 +119,100 @@ GrayImage savGolFilter(
     // That may help the compiler to emit efficient SSE code.
     int const temp_stride = (width + 3) & ~3;
     AlignedArray<float, 4> temp_array(temp_stride * (height + kh - 1));
-    AlignedArray<float, 4> line_buffer(width + kw - 1);
 
     // Horizontal pass.
-    uint8_t const* src_line = src_data;
-    float* temp_line = temp_array.data() + k_top * temp_stride;
-    for (int y = 0; y < height; ++y)
+    executor(0, height, [&](int const y_begin, int const y_end)
     {
-        // Fill the line buffer.
-        for (int x = 0; x < width; ++x)
+        AlignedArray<float, 4> line_buffer(width + kw - 1);
+        uint8_t const* src_line = src_data + y_begin * src_stride;
+        float* temp_line = temp_array.data() + (k_top + y_begin) * temp_stride;
+        for (int y = y_begin; y < y_end; ++y)
         {
-            line_buffer[x + k_left] = static_cast<float>(src_line[x]);
-        }
+            // Fill the line buffer.
+            for (int x = 0; x < width; ++x)
+            {
+                line_buffer[x + k_left] = static_cast<float>(src_line[x]);
+            }
 
-        // Mirror the edge pixels.
-        std::reverse_copy(
-            line_buffer.data() + k_left + 1,
-            line_buffer.data() + k_left + 1 + k_left,
-            line_buffer.data()
-        );
-        std::reverse_copy(
-            line_buffer.data() + k_left + width - 1 - k_right,
-            line_buffer.data() + k_left + width - 1,
-            line_buffer.data() + k_left + width
-        );
-
-        for (int x = 0; x < width; ++x)
-        {
-            float sum = 0.0f;
-            float const* src = line_buffer.data() + x;
-            for (int i = 0; i < kw; ++i)
+            // Mirror the edge pixels.
+            std::reverse_copy(
+                line_buffer.data() + k_left + 1,
+                line_buffer.data() + k_left + 1 + k_left,
+                line_buffer.data()
+            );
+            std::reverse_copy(
+                line_buffer.data() + k_left + width - 1 - k_right,
+                line_buffer.data() + k_left + width - 1,
+                line_buffer.data() + k_left + width
+            );
+
+            for (int x = 0; x < width; ++x)
             {
-                sum += src[i] * hor_kernel[i];
+                float sum = 0.0f;
+                float const* src = line_buffer.data() + x;
+                for (int i = 0; i < kw; ++i)
+                {
+                    sum += src[i] * hor_kernel[i];
+                }
+                temp_line[x] = sum;
             }
-            temp_line[x] = sum;
-        }
 
-        temp_line += temp_stride;
-        src_line += src_stride;
-    }
+            temp_line += temp_stride;
+            src_line += src_stride;
+        }
+    });
 
-    // Mirror the top and bottom areas in temp_array.
-    for (int x = 0; x < width; ++x)
+    // Columns are independent from here on, so mirroring the top and bottom
+    // areas of a column and running the vertical pass on it go together.
+    executor(0, width, [&](int const x_begin, int const x_end)
     {
-        float* temp_src = temp_array.data() + x + (k_top + 1) * temp_stride;
-        float* temp_dst = temp_src - temp_stride * 2;
-        for (int i = 0; i < k_top; ++i)
+        // Mirror the top and bottom areas in temp_array.
+        for (int x = x_begin; x < x_end; ++x)
         {
-            *temp_dst = *temp_src;
-            temp_dst -= temp_stride;
-            temp_src += temp_stride;
-        }
+            float* temp_src = temp_array.data() + x + (k_top + 1) * temp_stride;
+            float* temp_dst = temp_src - temp_stride * 2;
+            for (int i = 0; i < k_top; ++i)
+            {
+                *temp_dst = *temp_src;
+                temp_dst -= temp_stride;
+                temp_src += temp_stride;
+            }
 
-        temp_dst = temp_array.data() + x + (k_top + height) * temp_stride;
-        temp_src = temp_dst - temp_stride * 2;
-        for (int i = 0; i < k_bottom; ++i)
-        {
-            *temp_dst = *temp_src;
-            temp_dst += temp_stride;
-            temp_src -= temp_stride;
+            temp_dst = temp_array.data() + x + (k_top + height) * temp_stride;
+            temp_src = temp_dst - temp_stride * 2;
+            for (int i = 0; i < k_bottom; ++i)
+            {
+                *temp_dst = *temp_src;
+                temp_dst += temp_stride;
+                temp_src -= temp_stride;
+            }
         }
-    }
-
-    // Vertical pass.
-    for (int x = 0; x < width; ++x)
-    {
-        float const* p_tmp = temp_array.data() + x;
-        uint8_t* p_dst = dst_data + x;
 
-        for (int y = 0; y < height; ++y)
+        // Vertical pass.
+        for (int x = x_begin; x < x_end; ++x)
         {
-            float const* p_tmp1 = p_tmp;
-            float sum = 0.5f; // For rounding purposes.
+            float const* p_tmp = temp_array.data() + x;
+            uint8_t* p_dst = dst_data + x;
 
-            for (int i = 0; i < kh; ++i)
+            for (int y = 0; y < height; ++y)
             {
-                sum += *p_tmp1 * vert_kernel[i];
-                p_tmp1 += temp_stride;
-            }
+                float const* p_tmp1 = p_tmp;
+                float sum = 0.5f; // For rounding purposes.
+
+                for (int i = 0; i < kh; ++i)
+                {
+                    sum += *p_tmp1 * vert_kernel[i];
+                    p_tmp1 += temp_stride;
+                }
 
-            int const val = static_cast<int>(sum);
-            *p_dst = static_cast<uint8_t>(qBound(0, val, 255));
+                int const val = static_cast<int>(sum);
+                *p_dst = static_cast<uint8_t>(qBound(0, val, 255));
 
-            p_dst += dst_stride;
-            p_tmp += temp_stride;
+                p_dst += dst_stride;
+                p_tmp += temp_stride;
+            }
         }
-    }
+    });
 
     return dst;
 }
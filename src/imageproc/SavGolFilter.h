@@ -20,6 +20,7 @@
 #define IMAGEPROC_SAVGOLFILTER_H_
 
 #include "imageproc_config.h"
+#include "ParallelFor.h"
 
 class QImage;
 class QSize;
@@ -42,6 +43,8 @@ class GrayImage;
  *        fit the image area, no filtering will take place.
  * \param hor_degree The degree of a polynomial in horizontal direction.
  * \param vert_degree The degree of a polynomial in vertical direction.
+ * \param executor Processes bands of rows in the horizontal pass and
+ *        bands of columns in the vertical one.
  * \return The filtered grayscale image.
  *
  * \note The window size and degrees are not completely independent.
@@ -53,7 +56,8 @@ class GrayImage;
  */
 IMAGEPROC_EXPORT GrayImage savGolFilter(
     GrayImage const& src, QSize const& window_size,
-    int hor_degree, int vert_degree);
+    int hor_degree, int vert_degree,
+    RangeExecutor const& executor = &serialFor);
 
 } // namespace imageproc
 
@@ -18,6 +18,7 @@
 
 #include "Scale.h"
 #include "GrayImage.h"
+#include "SimdKernels.h"
 #include <QImage>
 #include <QSize>
 #include <stdexcept>
@@ -27,6 +28,26 @@
 namespace imageproc
 {
 
+/**
+ * Returns the sum of \p count consecutive gray levels.  Short spans,
+ * which are the common case, aren't worth an indirect call.
+ */
+static inline unsigned sumSpan(
+    simd::Kernels const& kernels, uint8_t const* src, int const count)
+{
+    if (count >= 16)
+    {
+        return kernels.sumBytes(src, count);
+    }
+
+    unsigned sum = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        sum += src[i];
+    }
+    return sum;
+}
+
 /**
  * This is an optimized implementation for the case when every destination
  * pixel maps exactly to a M x N block of source pixels.
@@ -42,6 +63,8 @@ static GrayImage scaleDownIntGrayToGray(GrayImage const& src, QSize const& dst_s
     int const yscale = sh / dh;
     int const total_area = xscale * yscale;
 
+    simd::Kernels const& kernels = simd::kernels();
+
     GrayImage dst(dst_size);
 
     uint8_t const* src_line = src.data();
@@ -65,10 +88,7 @@ static GrayImage scaleDownIntGrayToGray(GrayImage const& src, QSize const& dst_s
 
             for (int i = 0; i < yscale; ++i, psrc += src_stride)
             {
-                for (int j = 0; j < xscale; ++j)
-                {
-                    gray_level += psrc[j];
-                }
+                gray_level += sumSpan(kernels, psrc, xscale);
             }
 
             unsigned const pix_value = (gray_level + (total_area >> 1)) / total_area;
@@ -269,6 +289,8 @@ static GrayImage scaleGrayToGray(GrayImage const& src, QSize const& dst_size)
     double const dx2sx32 = calc32xRatio2(dw, sw);
     double const dy2sy32 = calc32xRatio2(dh, sh);
 
+    simd::Kernels const& kernels = simd::kernels();
+
     GrayImage dst(dst_size);
 
     uint8_t const* const src_data = src.data();
@@ -324,10 +346,8 @@ static GrayImage scaleGrayToGray(GrayImage const& src, QSize const& dst_size)
 
                     gray_level += src_line[sxleft] * left_area;
 
-                    for (int sx = sxleft + 1; sx < sxright; ++sx)
-                    {
-                        gray_level += src_line[sx] * middle_area;
-                    }
+                    gray_level += sumSpan(kernels, src_line + sxleft + 1, sxright - sxleft - 1)
+                                  * middle_area;
 
                     gray_level += src_line[sxright] * right_area;
                 }
@@ -366,10 +386,8 @@ static GrayImage scaleGrayToGray(GrayImage const& src, QSize const& dst_size)
                 gray_level += src_line[sxleft] * topleft_area;
 
                 // process the top line (without corners)
-                for (int sx = sxleft + 1; sx < sxright; ++sx)
-                {
-                    gray_level += src_line[sx] * top_area;
-                }
+                gray_level += sumSpan(kernels, src_line + sxleft + 1, sxright - sxleft - 1)
+                              * top_area;
 
                 // process the top-right corner
                 gray_level += src_line[sxright] * topright_area;
@@ -381,10 +399,8 @@ static GrayImage scaleGrayToGray(GrayImage const& src, QSize const& dst_size)
                 {
                     gray_level += src_line[sxleft] * left_area;
 
-                    for (int sx = sxleft + 1; sx < sxright; ++sx)
-                    {
-                        gray_level += src_line[sx] << (5 + 5);
-                    }
+                    gray_level += sumSpan(kernels, src_line + sxleft + 1, sxright - sxleft - 1)
+                                  << (5 + 5);
 
                     gray_level += src_line[sxright] * right_area;
 
@@ -395,10 +411,8 @@ static GrayImage scaleGrayToGray(GrayImage const& src, QSize const& dst_size)
                 gray_level += src_line[sxleft] * bottomleft_area;
 
                 // process the bottom line (without corners)
-                for (int sx = sxleft + 1; sx < sxright; ++sx)
-                {
-                    gray_level += src_line[sx] * bottom_area;
-                }
+                gray_level += sumSpan(kernels, src_line + sxleft + 1, sxright - sxleft - 1)
+                              * bottom_area;
 
                 // process the bottom-right corner
                 gray_level += src_line[sxright] * bottomright_area;
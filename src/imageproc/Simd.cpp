@@ -0,0 +1,229 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Simd.h"
+#include "SimdKernels.h"
+#include <QColor>
+#include <atomic>
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#   include <intrin.h>
+#   include <immintrin.h>
+#endif
+
+namespace imageproc
+{
+
+namespace simd
+{
+
+namespace
+{
+
+void rgb32ToGrayScalar(uint32_t const* src, uint8_t* dst, int const count)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        dst[i] = static_cast<uint8_t>(qGray(src[i]));
+    }
+}
+
+void integralRowScalar(
+    uint8_t const* src, uint32_t const* above, uint32_t* cur, int const count)
+{
+    uint32_t line_sum = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        line_sum += src[i];
+        cur[i] = above[i] + line_sum;
+    }
+}
+
+void integralRowOfSquaresScalar(
+    uint8_t const* src, uint64_t const* above, uint64_t* cur, int const count)
+{
+    uint64_t line_sum = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        uint32_t const val = src[i];
+        line_sum += val * val;
+        cur[i] = above[i] + line_sum;
+    }
+}
+
+uint32_t sumBytesScalar(uint8_t const* src, int const count)
+{
+    uint32_t sum = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        sum += src[i];
+    }
+    return sum;
+}
+
+bool cpuSupportsAvx2()
+{
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    int regs[4];
+    __cpuid(regs, 0);
+    if (regs[0] < 7)
+    {
+        return false;
+    }
+    __cpuid(regs, 1);
+    bool const osxsave = (regs[2] & (1 << 27)) != 0;
+    bool const avx = (regs[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx)
+    {
+        return false;
+    }
+    // Check the OS saves the YMM registers on context switches.
+    if ((_xgetbv(0) & 6) != 6)
+    {
+        return false;
+    }
+    __cpuidex(regs, 7, 0);
+    return (regs[1] & (1 << 5)) != 0;
+#else
+    return false;
+#endif
+}
+
+class KernelTables
+{
+public:
+    KernelTables();
+
+    bool available[NEON + 1];
+    Kernels tables[NEON + 1];
+    InstructionSet detected;
+};
+
+KernelTables::KernelTables()
+{
+    for (int isa = SCALAR; isa <= NEON; ++isa)
+    {
+        initScalarKernels(tables[isa]);
+        available[isa] = false;
+    }
+    available[SCALAR] = true;
+
+    available[SSE2] = initSse2Kernels(tables[SSE2]);
+
+    initSse2Kernels(tables[AVX2]);
+    available[AVX2] = initAvx2Kernels(tables[AVX2]) && available[SSE2] && cpuSupportsAvx2();
+
+    available[NEON] = initNeonKernels(tables[NEON]);
+
+    if (available[AVX2])
+    {
+        detected = AVX2;
+    }
+    else if (available[SSE2])
+    {
+        detected = SSE2;
+    }
+    else if (available[NEON])
+    {
+        detected = NEON;
+    }
+    else
+    {
+        detected = SCALAR;
+    }
+}
+
+KernelTables const& kernelTables()
+{
+    static KernelTables const tables;
+    return tables;
+}
+
+std::atomic<int> g_activeInstructionSet(-1);
+
+} // anonymous namespace
+
+void initScalarKernels(Kernels& kernels)
+{
+    kernels.rgb32ToGray = &rgb32ToGrayScalar;
+    kernels.integralRow = &integralRowScalar;
+    kernels.integralRowOfSquares = &integralRowOfSquaresScalar;
+    kernels.sumBytes = &sumBytesScalar;
+}
+
+Kernels const& kernels()
+{
+    return kernelTables().tables[activeInstructionSet()];
+}
+
+InstructionSet detectedInstructionSet()
+{
+    return kernelTables().detected;
+}
+
+InstructionSet activeInstructionSet()
+{
+    int isa = g_activeInstructionSet.load(std::memory_order_relaxed);
+    if (isa < 0)
+    {
+        isa = detectedInstructionSet();
+        g_activeInstructionSet.store(isa, std::memory_order_relaxed);
+    }
+    return static_cast<InstructionSet>(isa);
+}
+
+InstructionSet setActiveInstructionSet(InstructionSet isa)
+{
+    if (!isInstructionSetAvailable(isa))
+    {
+        isa = SCALAR;
+    }
+    g_activeInstructionSet.store(isa, std::memory_order_relaxed);
+    return isa;
+}
+
+bool isInstructionSetAvailable(InstructionSet const isa)
+{
+    if (isa < SCALAR || isa > NEON)
+    {
+        return false;
+    }
+    return kernelTables().available[isa];
+}
+
+char const* instructionSetName(InstructionSet const isa)
+{
+    switch (isa)
+    {
+    case SCALAR:
+        return "scalar";
+    case SSE2:
+        return "SSE2";
+    case AVX2:
+        return "AVX2";
+    case NEON:
+        return "NEON";
+    }
+    return "unknown";
+}
+
+} // namespace simd
+
+} // namespace imageproc
@@ -0,0 +1,80 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef IMAGEPROC_SIMD_H_
+#define IMAGEPROC_SIMD_H_
+
+#include "imageproc_config.h"
+
+namespace imageproc
+{
+
+/**
+ * \brief Runtime selection of vectorized kernels.
+ *
+ * A few hot inner loops (RGB to gray conversion, integral image rows,
+ * box-averaging in scaleToGray(), word-wise raster operations) come in
+ * several flavours, one per instruction set.  The best flavour supported
+ * by both the build and the CPU we are running on is picked on first use.
+ * All flavours produce bit-identical results.
+ */
+namespace simd
+{
+
+enum InstructionSet
+{
+    SCALAR,
+    SSE2,
+    AVX2,
+    NEON
+};
+
+/**
+ * \brief The best instruction set supported by both the build and the CPU.
+ */
+IMAGEPROC_EXPORT InstructionSet detectedInstructionSet();
+
+/**
+ * \brief The instruction set currently in use.
+ *
+ * Defaults to detectedInstructionSet().
+ */
+IMAGEPROC_EXPORT InstructionSet activeInstructionSet();
+
+/**
+ * \brief Forces the use of a particular instruction set.
+ *
+ * Meant for testing and benchmarking.  Requests for an instruction set
+ * that isn't available fall back to the scalar code.
+ *
+ * \return The instruction set actually activated.
+ */
+IMAGEPROC_EXPORT InstructionSet setActiveInstructionSet(InstructionSet isa);
+
+/**
+ * \brief Checks whether the given instruction set may be activated.
+ */
+IMAGEPROC_EXPORT bool isInstructionSetAvailable(InstructionSet isa);
+
+IMAGEPROC_EXPORT char const* instructionSetName(InstructionSet isa);
+
+} // namespace simd
+
+} // namespace imageproc
+
+#endif
@@ -0,0 +1,131 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "SimdKernels.h"
+#ifdef __AVX2__
+#   include <immintrin.h>
+#endif
+
+// This file is compiled with AVX2 code generation enabled (see CMakeLists.txt),
+// so nothing from here may be called without a runtime check.
+
+namespace imageproc
+{
+
+namespace simd
+{
+
+#ifdef __AVX2__
+
+namespace
+{
+
+/**
+ * Computes qGray() = (r * 11 + g * 16 + b * 5) / 32 for 8 pixels.
+ * The results are in the low 8 bits of each 32-bit lane.
+ */
+inline __m256i grayFromRgb32(__m256i const pixels)
+{
+    __m256i const mask = _mm256_set1_epi32(0x00ff00ff);
+    __m256i const br = _mm256_and_si256(pixels, mask);
+    __m256i const ga = _mm256_and_si256(_mm256_srli_epi32(pixels, 8), mask);
+    __m256i const sum = _mm256_add_epi32(
+        _mm256_madd_epi16(br, _mm256_set1_epi32((11 << 16) | 5)),
+        _mm256_madd_epi16(ga, _mm256_set1_epi32(16))
+    );
+    return _mm256_srli_epi32(sum, 5);
+}
+
+void rgb32ToGrayAvx2(uint32_t const* src, uint8_t* dst, int const count)
+{
+    // Packing instructions operate within 128-bit lanes, hence the final permutation.
+    __m256i const order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+    int i = 0;
+    for (; i + 32 <= count; i += 32)
+    {
+        __m256i const* p = reinterpret_cast<__m256i const*>(src + i);
+        __m256i const g0 = grayFromRgb32(_mm256_loadu_si256(p));
+        __m256i const g1 = grayFromRgb32(_mm256_loadu_si256(p + 1));
+        __m256i const g2 = grayFromRgb32(_mm256_loadu_si256(p + 2));
+        __m256i const g3 = grayFromRgb32(_mm256_loadu_si256(p + 3));
+        __m256i const packed = _mm256_packus_epi16(
+            _mm256_packs_epi32(g0, g1), _mm256_packs_epi32(g2, g3)
+        );
+        _mm256_storeu_si256(
+            reinterpret_cast<__m256i*>(dst + i),
+            _mm256_permutevar8x32_epi32(packed, order)
+        );
+    }
+
+    for (; i < count; ++i)
+    {
+        uint32_t const pixel = src[i];
+        uint32_t const r = (pixel >> 16) & 0xff;
+        uint32_t const g = (pixel >> 8) & 0xff;
+        uint32_t const b = pixel & 0xff;
+        dst[i] = static_cast<uint8_t>((r * 11 + g * 16 + b * 5) >> 5);
+    }
+}
+
+uint32_t sumBytesAvx2(uint8_t const* src, int const count)
+{
+    __m256i const zero = _mm256_setzero_si256();
+    __m256i acc = zero;
+    int i = 0;
+    for (; i + 32 <= count; i += 32)
+    {
+        __m256i const bytes = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(src + i));
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(bytes, zero));
+    }
+
+    __m128i const acc128 = _mm_add_epi64(
+        _mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1)
+    );
+    uint32_t sum = static_cast<uint32_t>(_mm_cvtsi128_si32(acc128))
+                   + static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_srli_si128(acc128, 8)));
+    for (; i < count; ++i)
+    {
+        sum += src[i];
+    }
+    return sum;
+}
+
+} // anonymous namespace
+
+bool initAvx2Kernels(Kernels& kernels)
+{
+    // Integral image rows are inherently sequential and don't benefit
+    // from wider vectors, so the SSE2 versions of those are kept.
+    kernels.rgb32ToGray = &rgb32ToGrayAvx2;
+    kernels.sumBytes = &sumBytesAvx2;
+    return true;
+}
+
+#else // __AVX2__
+
+bool initAvx2Kernels(Kernels&)
+{
+    return false;
+}
+
+#endif
+
+} // namespace simd
+
+} // namespace imageproc
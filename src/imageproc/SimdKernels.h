@@ -0,0 +1,95 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef IMAGEPROC_SIMD_KERNELS_H_
+#define IMAGEPROC_SIMD_KERNELS_H_
+
+#include "Simd.h"
+#include <stdint.h>
+
+namespace imageproc
+{
+
+namespace simd
+{
+
+/**
+ * \brief Function table of vectorized kernels.
+ *
+ * Each instruction set overrides those entries it has an implementation for,
+ * leaving the rest pointing to the next best implementation.
+ */
+struct Kernels
+{
+    /**
+     * Converts \p count RGB32 pixels to gray levels, the same way qGray() does.
+     * The alpha channel is ignored.
+     */
+    void (*rgb32ToGray)(uint32_t const* src, uint8_t* dst, int count);
+
+    /**
+     * Computes a row of an integral image: cur[i] = above[i] + sum(src[0..i]).
+     */
+    void (*integralRow)(uint8_t const* src, uint32_t const* above, uint32_t* cur, int count);
+
+    /**
+     * Like integralRow(), but sums squares of the source values.
+     */
+    void (*integralRowOfSquares)(
+        uint8_t const* src, uint64_t const* above, uint64_t* cur, int count);
+
+    /**
+     * Returns the sum of \p count bytes.  The result is only valid
+     * if it fits into 32 bits, which is the case for count < 2^24.
+     */
+    uint32_t (*sumBytes)(uint8_t const* src, int count);
+};
+
+/**
+ * \brief Returns the kernels for activeInstructionSet().
+ */
+Kernels const& kernels();
+
+/**
+ * \brief Installs the scalar kernels.
+ */
+void initScalarKernels(Kernels& kernels);
+
+/**
+ * \brief Overrides entries with SSE2 implementations.
+ * \return false if SSE2 support wasn't compiled in.
+ */
+bool initSse2Kernels(Kernels& kernels);
+
+/**
+ * \brief Overrides entries with AVX2 implementations.
+ * \return false if AVX2 support wasn't compiled in.
+ */
+bool initAvx2Kernels(Kernels& kernels);
+
+/**
+ * \brief Overrides entries with NEON implementations.
+ * \return false if NEON support wasn't compiled in.
+ */
+bool initNeonKernels(Kernels& kernels);
+
+} // namespace simd
+
+} // namespace imageproc
+
+#endif
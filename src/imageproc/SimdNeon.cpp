@@ -0,0 +1,175 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "SimdKernels.h"
+#ifdef __ARM_NEON
+#   include <arm_neon.h>
+#endif
+
+namespace imageproc
+{
+
+namespace simd
+{
+
+#ifdef __ARM_NEON
+
+namespace
+{
+
+void rgb32ToGrayNeon(uint32_t const* src, uint8_t* dst, int const count)
+{
+    uint8x8_t const k5 = vdup_n_u8(5);
+    uint8x8_t const k11 = vdup_n_u8(11);
+    uint8x8_t const k16 = vdup_n_u8(16);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        // On a little-endian machine, the bytes of 0xAARRGGBB are B, G, R, A.
+        uint8x8x4_t const bgra = vld4_u8(reinterpret_cast<uint8_t const*>(src + i));
+        uint16x8_t sum = vmull_u8(bgra.val[0], k5);
+        sum = vmlal_u8(sum, bgra.val[1], k16);
+        sum = vmlal_u8(sum, bgra.val[2], k11);
+        vst1_u8(dst + i, vshrn_n_u16(sum, 5));
+    }
+
+    for (; i < count; ++i)
+    {
+        uint32_t const pixel = src[i];
+        uint32_t const r = (pixel >> 16) & 0xff;
+        uint32_t const g = (pixel >> 8) & 0xff;
+        uint32_t const b = pixel & 0xff;
+        dst[i] = static_cast<uint8_t>((r * 11 + g * 16 + b * 5) >> 5);
+    }
+}
+
+/**
+ * Inclusive prefix sum of four 32-bit lanes.
+ */
+inline uint32x4_t prefixSum4(uint32x4_t v)
+{
+    uint32x4_t const zero = vdupq_n_u32(0);
+    v = vaddq_u32(v, vextq_u32(zero, v, 3));
+    v = vaddq_u32(v, vextq_u32(zero, v, 2));
+    return v;
+}
+
+void integralRowNeon(
+    uint8_t const* src, uint32_t const* above, uint32_t* cur, int const count)
+{
+    uint32_t line_sum = 0;
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        uint16x8_t const vals = vmovl_u8(vld1_u8(src + i));
+        uint32x4_t const lo = vaddq_u32(
+            prefixSum4(vmovl_u16(vget_low_u16(vals))), vdupq_n_u32(line_sum)
+        );
+        uint32x4_t const hi = vaddq_u32(
+            prefixSum4(vmovl_u16(vget_high_u16(vals))), vdupq_n_u32(vgetq_lane_u32(lo, 3))
+        );
+        vst1q_u32(cur + i, vaddq_u32(vld1q_u32(above + i), lo));
+        vst1q_u32(cur + i + 4, vaddq_u32(vld1q_u32(above + i + 4), hi));
+        line_sum = vgetq_lane_u32(hi, 3);
+    }
+
+    for (; i < count; ++i)
+    {
+        line_sum += src[i];
+        cur[i] = above[i] + line_sum;
+    }
+}
+
+/**
+ * Adds squares of 4 values to the integral image row and returns the updated line sum.
+ */
+inline uint64_t integralOfSquares4(
+    uint16x4_t const vals, uint64_t const line_sum, uint64_t const* above, uint64_t* cur)
+{
+    // A sum of four squares of bytes fits into 32 bits.
+    uint32x4_t const sums = prefixSum4(vmull_u16(vals, vals));
+    uint64x2_t const carry = vdupq_n_u64(line_sum);
+    uint64x2_t const lo = vaddq_u64(vmovl_u32(vget_low_u32(sums)), carry);
+    uint64x2_t const hi = vaddq_u64(vmovl_u32(vget_high_u32(sums)), carry);
+    vst1q_u64(cur, vaddq_u64(vld1q_u64(above), lo));
+    vst1q_u64(cur + 2, vaddq_u64(vld1q_u64(above + 2), hi));
+    return vgetq_lane_u64(hi, 1);
+}
+
+void integralRowOfSquaresNeon(
+    uint8_t const* src, uint64_t const* above, uint64_t* cur, int const count)
+{
+    uint64_t line_sum = 0;
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        uint16x8_t const vals = vmovl_u8(vld1_u8(src + i));
+        line_sum = integralOfSquares4(vget_low_u16(vals), line_sum, above + i, cur + i);
+        line_sum = integralOfSquares4(vget_high_u16(vals), line_sum, above + i + 4, cur + i + 4);
+    }
+
+    for (; i < count; ++i)
+    {
+        uint32_t const val = src[i];
+        line_sum += val * val;
+        cur[i] = above[i] + line_sum;
+    }
+}
+
+uint32_t sumBytesNeon(uint8_t const* src, int const count)
+{
+    uint32x4_t acc = vdupq_n_u32(0);
+    int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        acc = vpadalq_u16(acc, vpaddlq_u8(vld1q_u8(src + i)));
+    }
+
+    uint32_t sum = vgetq_lane_u32(acc, 0) + vgetq_lane_u32(acc, 1)
+                   + vgetq_lane_u32(acc, 2) + vgetq_lane_u32(acc, 3);
+    for (; i < count; ++i)
+    {
+        sum += src[i];
+    }
+    return sum;
+}
+
+} // anonymous namespace
+
+bool initNeonKernels(Kernels& kernels)
+{
+    kernels.rgb32ToGray = &rgb32ToGrayNeon;
+    kernels.integralRow = &integralRowNeon;
+    kernels.integralRowOfSquares = &integralRowOfSquaresNeon;
+    kernels.sumBytes = &sumBytesNeon;
+    return true;
+}
+
+#else // __ARM_NEON
+
+bool initNeonKernels(Kernels&)
+{
+    return false;
+}
+
+#endif
+
+} // namespace simd
+
+} // namespace imageproc
@@ -0,0 +1,194 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "SimdKernels.h"
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   define IMAGEPROC_BUILD_SSE2 1
+#   include <emmintrin.h>
+#   include <string.h>
+#endif
+
+namespace imageproc
+{
+
+namespace simd
+{
+
+#ifdef IMAGEPROC_BUILD_SSE2
+
+namespace
+{
+
+/**
+ * Computes qGray() = (r * 11 + g * 16 + b * 5) / 32 for 4 pixels.
+ * The results are in the low 8 bits of each 32-bit lane.
+ */
+inline __m128i grayFromRgb32(__m128i const pixels)
+{
+    __m128i const mask = _mm_set1_epi32(0x00ff00ff);
+    // 16-bit lanes: b, r, b, r, ...
+    __m128i const br = _mm_and_si128(pixels, mask);
+    // 16-bit lanes: g, a, g, a, ...
+    __m128i const ga = _mm_and_si128(_mm_srli_epi32(pixels, 8), mask);
+    __m128i const sum = _mm_add_epi32(
+        _mm_madd_epi16(br, _mm_set1_epi32((11 << 16) | 5)),
+        _mm_madd_epi16(ga, _mm_set1_epi32(16))
+    );
+    return _mm_srli_epi32(sum, 5);
+}
+
+void rgb32ToGraySse2(uint32_t const* src, uint8_t* dst, int const count)
+{
+    int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i const* p = reinterpret_cast<__m128i const*>(src + i);
+        __m128i const g0 = grayFromRgb32(_mm_loadu_si128(p));
+        __m128i const g1 = grayFromRgb32(_mm_loadu_si128(p + 1));
+        __m128i const g2 = grayFromRgb32(_mm_loadu_si128(p + 2));
+        __m128i const g3 = grayFromRgb32(_mm_loadu_si128(p + 3));
+        __m128i const packed = _mm_packus_epi16(_mm_packs_epi32(g0, g1), _mm_packs_epi32(g2, g3));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), packed);
+    }
+
+    for (; i < count; ++i)
+    {
+        uint32_t const pixel = src[i];
+        uint32_t const r = (pixel >> 16) & 0xff;
+        uint32_t const g = (pixel >> 8) & 0xff;
+        uint32_t const b = pixel & 0xff;
+        dst[i] = static_cast<uint8_t>((r * 11 + g * 16 + b * 5) >> 5);
+    }
+}
+
+/**
+ * Inclusive prefix sum of four 32-bit lanes.
+ */
+inline __m128i prefixSum4(__m128i v)
+{
+    v = _mm_add_epi32(v, _mm_slli_si128(v, 4));
+    v = _mm_add_epi32(v, _mm_slli_si128(v, 8));
+    return v;
+}
+
+inline __m128i load4Bytes(uint8_t const* src)
+{
+    int32_t bytes;
+    memcpy(&bytes, src, 4);
+    return _mm_unpacklo_epi16(
+        _mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), _mm_setzero_si128()),
+        _mm_setzero_si128()
+    );
+}
+
+void integralRowSse2(
+    uint8_t const* src, uint32_t const* above, uint32_t* cur, int const count)
+{
+    __m128i carry = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i const sums = _mm_add_epi32(prefixSum4(load4Bytes(src + i)), carry);
+        __m128i const above4 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(above + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(cur + i), _mm_add_epi32(above4, sums));
+        carry = _mm_shuffle_epi32(sums, _MM_SHUFFLE(3, 3, 3, 3));
+    }
+
+    uint32_t line_sum = static_cast<uint32_t>(_mm_cvtsi128_si32(carry));
+    for (; i < count; ++i)
+    {
+        line_sum += src[i];
+        cur[i] = above[i] + line_sum;
+    }
+}
+
+void integralRowOfSquaresSse2(
+    uint8_t const* src, uint64_t const* above, uint64_t* cur, int const count)
+{
+    __m128i const zero = _mm_setzero_si128();
+    __m128i carry = zero;
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i const vals = load4Bytes(src + i);
+        // The upper halves of 32-bit lanes are zero, and squares of bytes
+        // fit into 16 bits, so a 16-bit multiplication is enough.
+        // A sum of four squares still fits into 32 bits.
+        __m128i const sums = prefixSum4(_mm_mullo_epi16(vals, vals));
+        __m128i const lo = _mm_add_epi64(_mm_unpacklo_epi32(sums, zero), carry);
+        __m128i const hi = _mm_add_epi64(_mm_unpackhi_epi32(sums, zero), carry);
+        __m128i* out = reinterpret_cast<__m128i*>(cur + i);
+        __m128i const* in = reinterpret_cast<__m128i const*>(above + i);
+        _mm_storeu_si128(out, _mm_add_epi64(_mm_loadu_si128(in), lo));
+        _mm_storeu_si128(out + 1, _mm_add_epi64(_mm_loadu_si128(in + 1), hi));
+        carry = _mm_unpackhi_epi64(hi, hi);
+    }
+
+    uint64_t line_sum;
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(&line_sum), carry);
+    for (; i < count; ++i)
+    {
+        uint32_t const val = src[i];
+        line_sum += val * val;
+        cur[i] = above[i] + line_sum;
+    }
+}
+
+uint32_t sumBytesSse2(uint8_t const* src, int const count)
+{
+    __m128i const zero = _mm_setzero_si128();
+    __m128i acc = zero;
+    int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i const bytes = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i));
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(bytes, zero));
+    }
+
+    uint32_t sum = static_cast<uint32_t>(_mm_cvtsi128_si32(acc))
+                   + static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_srli_si128(acc, 8)));
+    for (; i < count; ++i)
+    {
+        sum += src[i];
+    }
+    return sum;
+}
+
+} // anonymous namespace
+
+bool initSse2Kernels(Kernels& kernels)
+{
+    kernels.rgb32ToGray = &rgb32ToGraySse2;
+    kernels.integralRow = &integralRowSse2;
+    kernels.integralRowOfSquares = &integralRowOfSquaresSse2;
+    kernels.sumBytes = &sumBytesSse2;
+    return true;
+}
+
+#else // IMAGEPROC_BUILD_SSE2
+
+bool initSse2Kernels(Kernels&)
+{
+    return false;
+}
+
+#endif
+
+} // namespace simd
+
+} // namespace imageproc
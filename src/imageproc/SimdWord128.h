@@ -0,0 +1,125 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef IMAGEPROC_SIMD_WORD128_H_
+#define IMAGEPROC_SIMD_WORD128_H_
+
+#include <stdint.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   include <emmintrin.h>
+#   define IMAGEPROC_HAVE_WORD128 1
+#   define IMAGEPROC_WORD128_SSE2 1
+#elif defined(__ARM_NEON)
+#   include <arm_neon.h>
+#   define IMAGEPROC_HAVE_WORD128 1
+#   define IMAGEPROC_WORD128_NEON 1
+#endif
+
+#ifdef IMAGEPROC_HAVE_WORD128
+
+namespace imageproc
+{
+
+namespace simd
+{
+
+/**
+ * \brief Four 32-bit words to be processed with bitwise operations at once.
+ *
+ * Only the baseline instruction set of the build is used, so no runtime
+ * checks are necessary.  Meant as a drop-in replacement for uint32_t
+ * in the Rop* classes.
+ */
+class Word128
+{
+public:
+    enum { NUM_WORDS = 4 };
+
+#ifdef IMAGEPROC_WORD128_SSE2
+    typedef __m128i Native;
+#else
+    typedef uint32x4_t Native;
+#endif
+
+    explicit Word128(Native v) : m_v(v) {}
+
+    static Word128 load(uint32_t const* p)
+    {
+#ifdef IMAGEPROC_WORD128_SSE2
+        return Word128(_mm_loadu_si128(reinterpret_cast<__m128i const*>(p)));
+#else
+        return Word128(vld1q_u32(p));
+#endif
+    }
+
+    void store(uint32_t* p) const
+    {
+#ifdef IMAGEPROC_WORD128_SSE2
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p), m_v);
+#else
+        vst1q_u32(p, m_v);
+#endif
+    }
+
+    friend Word128 operator&(Word128 a, Word128 b)
+    {
+#ifdef IMAGEPROC_WORD128_SSE2
+        return Word128(_mm_and_si128(a.m_v, b.m_v));
+#else
+        return Word128(vandq_u32(a.m_v, b.m_v));
+#endif
+    }
+
+    friend Word128 operator|(Word128 a, Word128 b)
+    {
+#ifdef IMAGEPROC_WORD128_SSE2
+        return Word128(_mm_or_si128(a.m_v, b.m_v));
+#else
+        return Word128(vorrq_u32(a.m_v, b.m_v));
+#endif
+    }
+
+    friend Word128 operator^(Word128 a, Word128 b)
+    {
+#ifdef IMAGEPROC_WORD128_SSE2
+        return Word128(_mm_xor_si128(a.m_v, b.m_v));
+#else
+        return Word128(veorq_u32(a.m_v, b.m_v));
+#endif
+    }
+
+    friend Word128 operator~(Word128 a)
+    {
+#ifdef IMAGEPROC_WORD128_SSE2
+        return Word128(_mm_xor_si128(a.m_v, _mm_set1_epi32(-1)));
+#else
+        return Word128(vmvnq_u32(a.m_v));
+#endif
+    }
+private:
+    Native m_v;
+};
+
+} // namespace simd
+
+} // namespace imageproc
+
+#endif // IMAGEPROC_HAVE_WORD128
+
+#endif
@@ -0,0 +1,259 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ColorFilter.h"
+#include "BinaryImage.h"
+#include "BWColor.h"
+#include <QImage>
+#include <QRect>
+#include <QColor>
+#include <boost/test/unit_test.hpp>
+#include <math.h>
+#include <stdlib.h>
+
+namespace imageproc
+{
+
+namespace tests
+{
+
+BOOST_AUTO_TEST_SUITE(ColorFilterTestSuite);
+
+namespace
+{
+
+QRgb const RED = qRgb(200, 30, 30);
+QRgb const BLUE = qRgb(30, 40, 180);
+QRgb const CREAM = qRgb(240, 230, 200);
+QRgb const OUTSIDE = qRgb(1, 2, 3);
+
+/**
+ * Every other band of 8 rows is foreground, red on the left and blue
+ * on the right, up to x = 96. The rest is cream background.
+ * The rightmost 16 columns are outside of the zones.
+ */
+class Scene
+{
+public:
+    enum { WIDTH = 128, HEIGHT = 64, FG_END = 96, ZONES_END = 112 };
+
+    Scene()
+        : image(WIDTH, HEIGHT, QImage::Format_RGB32),
+          dst(WIDTH, HEIGHT, QImage::Format_RGB32),
+          mask(WIDTH, HEIGHT, WHITE),
+          zones(WIDTH, HEIGHT, WHITE)
+    {
+        dst.fill(OUTSIDE);
+        zones.fill(QRect(0, 0, ZONES_END, HEIGHT), BLACK);
+        for (int y = 0; y < HEIGHT; ++y)
+        {
+            QRgb* line = (QRgb*)image.scanLine(y);
+            for (int x = 0; x < WIDTH; ++x)
+            {
+                line[x] = CREAM;
+            }
+            if ((y / 8) % 2 == 0)
+            {
+                mask.fill(QRect(0, y, FG_END, 1), BLACK);
+                for (int x = 0; x < FG_END; ++x)
+                {
+                    line[x] = x < FG_END / 2 ? RED : BLUE;
+                }
+            }
+        }
+    }
+
+    static bool isForeground(int x, int y)
+    {
+        return x < FG_END && (y / 8) % 2 == 0;
+    }
+
+    QImage image;
+    QImage dst;
+    BinaryImage mask;
+    BinaryImage zones;
+};
+
+bool closeColors(QRgb const c1, QRgb const c2, int const tolerance = 3)
+{
+    return abs(qRed(c1) - qRed(c2)) <= tolerance
+           && abs(qGreen(c1) - qGreen(c2)) <= tolerance
+           && abs(qBlue(c1) - qBlue(c2)) <= tolerance;
+}
+
+/**
+ * Computes the error hsvKMeansInPlace() is supposed to return,
+ * from the input and the output images.
+ */
+double expectedMse(Scene const& scene)
+{
+    double sum = 0.0;
+    int count = 0;
+    for (int y = 0; y < Scene::HEIGHT; ++y)
+    {
+        for (int x = 0; x < Scene::ZONES_END; ++x)
+        {
+            QRgb const c1 = scene.image.pixel(x, y);
+            QRgb const c2 = scene.dst.pixel(x, y);
+            int const dr = qRed(c1) - qRed(c2);
+            int const dg = qGreen(c1) - qGreen(c2);
+            int const db = qBlue(c1) - qBlue(c2);
+            sum += dr * dr + dg * dg + db * db;
+            ++count;
+        }
+    }
+    return sqrt(sum / count / 3.0) / 255.0;
+}
+
+/**
+ * Checks that every pixel in the zones got the colour \p fg_color
+ * or \p bg_color returns for it, and the ones outside kept theirs.
+ */
+template<typename FgColor, typename BgColor>
+bool checkColors(Scene const& scene, FgColor fg_color, BgColor bg_color)
+{
+    for (int y = 0; y < Scene::HEIGHT; ++y)
+    {
+        for (int x = 0; x < Scene::WIDTH; ++x)
+        {
+            QRgb const actual = scene.dst.pixel(x, y);
+            QRgb expected = OUTSIDE;
+            if (x < Scene::ZONES_END)
+            {
+                expected = Scene::isForeground(x, y) ? fg_color(x) : bg_color(x);
+            }
+            if (!closeColors(actual, expected))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+QRgb originalFg(int const x)
+{
+    return x < Scene::FG_END / 2 ? RED : BLUE;
+}
+
+QRgb originalBg(int)
+{
+    return CREAM;
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(test_clusters_match_colors)
+{
+    int const color_spaces[] = { 0, 1, 2 };
+    for (int const color_space : color_spaces)
+    {
+        // Two foreground clusters and one background one.
+        Scene scene;
+        double const mse = hsvKMeansInPlace(
+                               scene.dst, scene.image, scene.mask, scene.zones,
+                               3, 0, color_space, 0.0f, 0.0f, 0.34f
+                           );
+        BOOST_CHECK(checkColors(scene, &originalFg, &originalBg));
+        BOOST_CHECK_CLOSE(mse, expectedMse(scene), 1.0);
+        BOOST_CHECK(mse < 0.01);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_empty_clusters)
+{
+    // Four foreground clusters for two colours and two background
+    // ones for a single colour leave some of them empty.
+    Scene scene;
+    double const mse = hsvKMeansInPlace(
+                           scene.dst, scene.image, scene.mask, scene.zones,
+                           6, 0, 0, 0.0f, 0.0f, 0.34f
+                       );
+    BOOST_CHECK(checkColors(scene, &originalFg, &originalBg));
+    BOOST_CHECK_CLOSE(mse, expectedMse(scene), 1.0);
+    BOOST_CHECK(mse < 0.01);
+}
+
+BOOST_AUTO_TEST_CASE(test_empty_cluster_reseeded)
+{
+    // With these colours, one of the three foreground clusters
+    // goes empty in HSV and has to be re-seeded to find its colour.
+    QRgb const colors[] = { qRgb(72, 140, 235), qRgb(133, 203, 137), qRgb(129, 144, 192) };
+    int const width = 64;
+    int const height = 64;
+    QImage image(width, height, QImage::Format_RGB32);
+    QImage dst(width, height, QImage::Format_RGB32);
+    BinaryImage mask(width, height, WHITE);
+    BinaryImage const zones(width, height, BLACK);
+    mask.fill(QRect(0, 0, 32, height), BLACK);
+    for (int y = 0; y < height; ++y)
+    {
+        QRgb* line = (QRgb*)image.scanLine(y);
+        for (int x = 0; x < width; ++x)
+        {
+            line[x] = x < 12 ? colors[0] : x < 24 ? colors[1] : x < 32 ? colors[2] : CREAM;
+        }
+    }
+
+    double const mse = hsvKMeansInPlace(dst, image, mask, zones, 4, 0, 0, 0.0f, 0.0f, 0.25f);
+    bool all_close = true;
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            all_close = all_close && closeColors(dst.pixel(x, y), image.pixel(x, y));
+        }
+    }
+    BOOST_CHECK(all_close);
+    BOOST_CHECK(mse < 0.01);
+}
+
+BOOST_AUTO_TEST_CASE(test_foreground_background_separation)
+{
+    // With no foreground clusters, foreground pixels go black,
+    // and the background keeps its colour.
+    Scene no_fg;
+    double const no_fg_mse = hsvKMeansInPlace(
+                                 no_fg.dst, no_fg.image, no_fg.mask, no_fg.zones,
+                                 2, 0, 0, 0.0f, 0.0f, 1.0f
+                             );
+    BOOST_CHECK(checkColors(no_fg, [](int)
+    {
+        return qRgb(0, 0, 0);
+    }, &originalBg));
+    BOOST_CHECK_CLOSE(no_fg_mse, expectedMse(no_fg), 1.0);
+
+    // With no background clusters, background pixels go white, while
+    // the foreground ones keep their colours.
+    Scene no_bg;
+    double const no_bg_mse = hsvKMeansInPlace(
+                                 no_bg.dst, no_bg.image, no_bg.mask, no_bg.zones,
+                                 2, 0, 0, 0.0f, 0.0f, 0.0f
+                             );
+    BOOST_CHECK(checkColors(no_bg, &originalFg, [](int)
+    {
+        return qRgb(255, 255, 255);
+    }));
+    BOOST_CHECK_CLOSE(no_bg_mse, expectedMse(no_bg), 1.0);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace tests
+
+} // namespace imageproc
@@ -0,0 +1,239 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ConnectivityMap.h"
+#include "Connectivity.h"
+#include "BinaryImage.h"
+#include "ParallelFor.h"
+#include "Utils.h"
+#include <QSize>
+#include <QRect>
+#include <QPoint>
+#include <vector>
+#include <algorithm>
+#include <stdlib.h>
+#include <stdint.h>
+#include <boost/test/unit_test.hpp>
+
+namespace imageproc
+{
+
+namespace tests
+{
+
+using namespace utils;
+
+BOOST_AUTO_TEST_SUITE(ConnectivityMapTestSuite);
+
+static bool
+equalMaps(ConnectivityMap const& map1, ConnectivityMap const& map2)
+{
+    if (map1.size() != map2.size() || map1.maxLabel() != map2.maxLabel())
+    {
+        return false;
+    }
+
+    int const num_cells = (map1.size().width() + 2) * (map1.size().height() + 2);
+    return std::equal(
+        map1.paddedData(), map1.paddedData() + num_cells, map2.paddedData()
+    );
+}
+
+static bool
+checkStats(ConnectivityMap const& cmap,
+           std::vector<ConnectivityMap::ComponentStats> const& stats)
+{
+    if (stats.size() != cmap.maxLabel() + 1)
+    {
+        return false;
+    }
+
+    std::vector<ConnectivityMap::ComponentStats> expected(stats.size());
+    int const width = cmap.size().width();
+    int const height = cmap.size().height();
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            uint32_t const label = cmap(x, y);
+            if (label == 0)
+            {
+                continue;
+            }
+
+            ConnectivityMap::ComponentStats& cs = expected[label];
+            if (cs.pixCount == 0)
+            {
+                cs.seed = QPoint(x, y);
+                cs.left = cs.right = x;
+                cs.top = y;
+            }
+            cs.left = std::min(cs.left, x);
+            cs.right = std::max(cs.right, x);
+            cs.bottom = y;
+            ++cs.pixCount;
+            cs.xSum += x;
+            cs.ySum += y;
+        }
+    }
+
+    for (uint32_t label = 1; label < stats.size(); ++label)
+    {
+        ConnectivityMap::ComponentStats const& cs1 = stats[label];
+        ConnectivityMap::ComponentStats const& cs2 = expected[label];
+        if (cs1.seed != cs2.seed || cs1.rect() != cs2.rect() ||
+                cs1.pixCount != cs2.pixCount ||
+                cs1.xSum != cs2.xSum || cs1.ySum != cs2.ySum)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+BOOST_AUTO_TEST_CASE(test_null_image)
+{
+    std::vector<ConnectivityMap::ComponentStats> stats;
+    ConnectivityMap const cmap(BinaryImage(), CONN8, &stats);
+    BOOST_CHECK(cmap.data() == 0);
+    BOOST_CHECK(cmap.maxLabel() == 0);
+    BOOST_CHECK(stats.size() == 1);
+}
+
+BOOST_AUTO_TEST_CASE(test_small_image)
+{
+    static int const inp[] =
+    {
+        0, 0, 1, 1, 0, 0, 0, 0, 0,
+        0, 0, 0, 1, 0, 0, 0, 0, 0,
+        0, 0, 0, 1, 0, 1, 1, 1, 1,
+        1, 1, 0, 1, 1, 0, 1, 0, 0,
+        0, 0, 1, 1, 0, 0, 1, 1, 0,
+        0, 1, 0, 1, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 1, 0, 1, 0,
+        1, 1, 1, 1, 1, 1, 1, 0, 0
+    };
+
+    // Labels follow the raster order of each component's first pixel.
+    static QRect const c4r[] =
+    {
+        QRect(2, 0, 3, 6), QRect(5, 2, 4, 3), QRect(0, 3, 2, 1),
+        QRect(1, 5, 1, 1), QRect(0, 6, 7, 2), QRect(7, 6, 1, 1)
+    };
+    static QRect const c8r[] =
+    {
+        QRect(0, 0, 9, 6), QRect(0, 6, 8, 2)
+    };
+
+    BinaryImage const img(makeBinaryImage(inp, 9, 8));
+
+    std::vector<ConnectivityMap::ComponentStats> stats4;
+    ConnectivityMap const cmap4(img, CONN4, &stats4);
+    BOOST_REQUIRE(cmap4.maxLabel() == 6);
+    for (int i = 0; i < 6; ++i)
+    {
+        BOOST_CHECK(stats4[i + 1].rect() == c4r[i]);
+    }
+    BOOST_CHECK(checkStats(cmap4, stats4));
+
+    std::vector<ConnectivityMap::ComponentStats> stats8;
+    ConnectivityMap const cmap8(img, CONN8, &stats8);
+    BOOST_REQUIRE(cmap8.maxLabel() == 2);
+    for (int i = 0; i < 2; ++i)
+    {
+        BOOST_CHECK(stats8[i + 1].rect() == c8r[i]);
+    }
+    BOOST_CHECK(checkStats(cmap8, stats8));
+}
+
+BOOST_AUTO_TEST_CASE(test_run_at_right_edge)
+{
+    // With the width being a multiple of 32, a run ending at the right edge
+    // of the last row used to make us read a word past the end of the image.
+    int const width = 64;
+    int const height = 3;
+    BinaryImage img(width, height, WHITE);
+    uint32_t* const last_line = img.data() + (height - 1) * img.wordsPerLine();
+    last_line[1] = 0x0000000f; // Pixels 60 to 63.
+    img.data()[0] = 0x80000000; // Pixel 0 on the first row.
+
+    std::vector<ConnectivityMap::ComponentStats> stats;
+    ConnectivityMap const cmap(img, CONN8, &stats);
+    BOOST_REQUIRE(cmap.maxLabel() == 2);
+    BOOST_CHECK(stats[1].rect() == QRect(0, 0, 1, 1));
+    BOOST_CHECK(stats[2].rect() == QRect(60, 2, 4, 1));
+    BOOST_CHECK(checkStats(cmap, stats));
+}
+
+BOOST_AUTO_TEST_CASE(test_against_flood_fill)
+{
+    // The generic constructor still labels by spreading the minimum label,
+    // so it serves as a reference.  Image heights are chosen to produce
+    // a varying number of bands, and padding bits are left random.
+    for (int iteration = 0; iteration < 40; ++iteration)
+    {
+        int const width = 1 + rand() % 200;
+        int const height = 1 + rand() % 300;
+        BinaryImage img(randomBinaryImage(width, height));
+
+        // Thin out the image to get a mix of small and large components.
+        int const extra_layers = iteration % 3;
+        for (int i = 0; i < extra_layers; ++i)
+        {
+            BinaryImage const mask(randomBinaryImage(width, height));
+            int const num_words = height * img.wordsPerLine();
+            for (int w = 0; w < num_words; ++w)
+            {
+                img.data()[w] &= mask.data()[w];
+            }
+        }
+
+        std::vector<uint8_t> pixels(width * height);
+        for (int y = 0; y < height; ++y)
+        {
+            uint32_t const* line = img.data() + y * img.wordsPerLine();
+            for (int x = 0; x < width; ++x)
+            {
+                pixels[y * width + x] = (line[x >> 5] >> (31 - (x & 31))) & 1;
+            }
+        }
+
+        Connectivity const conns[] = { CONN4, CONN8 };
+        for (Connectivity const conn : conns)
+        {
+            ConnectivityMap const reference(
+                QSize(width, height), &pixels[0], width, conn
+            );
+
+            std::vector<ConnectivityMap::ComponentStats> stats;
+            ConnectivityMap const serial(img, conn, &stats, &serialFor);
+            BOOST_REQUIRE(equalMaps(serial, reference));
+            BOOST_REQUIRE(checkStats(serial, stats));
+
+            ConnectivityMap const parallel(img, conn, 0, &parallelFor);
+            BOOST_REQUIRE(equalMaps(parallel, reference));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace tests
+
+} // namespace imageproc
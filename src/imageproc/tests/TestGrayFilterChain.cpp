@@ -0,0 +1,101 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "GrayFilterChain.h"
+#include "GrayImage.h"
+#include "ParallelFor.h"
+#include <QSize>
+#include <boost/test/unit_test.hpp>
+#include <stdint.h>
+#include <stdlib.h>
+
+namespace imageproc
+{
+
+namespace tests
+{
+
+BOOST_AUTO_TEST_SUITE(GrayFilterChainTestSuite);
+
+static GrayImage makeTestImage(QSize const& size)
+{
+    GrayImage img(size);
+    for (int y = 0; y < size.height(); ++y)
+    {
+        for (int x = 0; x < size.width(); ++x)
+        {
+            img.data()[y * img.stride() + x] = static_cast<uint8_t>(
+                (x / 13 + y / 7) % 4 == 0 ? rand() : 90 + (x + y) % 40
+            );
+        }
+    }
+    return img;
+}
+
+BOOST_AUTO_TEST_CASE(test_matches_sequential_filters)
+{
+    // The larger size makes local steps run on several tiles.
+    QSize const sizes[] = { QSize(7, 5), QSize(700, 600) };
+
+    for (QSize const& size : sizes)
+    {
+        GrayImage const src(makeTestImage(size));
+
+        GrayImage expected(src);
+        grayCurveFilterInPlace(expected, 0.4f);
+        graySqrFilterInPlace(expected, 0.3f);
+        grayKnnDenoiserInPlace(expected, 3, 0.5f);
+        grayDespeckleInPlace(expected, 2, 0.7f);
+        grayAutoLevelInPlace(expected, 10, 0.5f);
+        grayCurveFilterInPlace(expected, -0.3f);
+
+        GrayFilterChain filters;
+        filters.addHistogramTable(
+            [](unsigned char* table, uint64_t const* histogram)
+            {
+                grayCurveFilterTable(table, histogram, 0.4f);
+            }
+        );
+        unsigned char sqr_table[256];
+        graySqrFilterTable(sqr_table, 0.3f);
+        filters.addTable(sqr_table);
+        filters.addLocal(3, [](GrayImage& img) { grayKnnDenoiserInPlace(img, 3, 0.5f); });
+        filters.addLocal(2, [](GrayImage& img) { grayDespeckleInPlace(img, 2, 0.7f); });
+        filters.addGlobal([](GrayImage& img) { grayAutoLevelInPlace(img, 10, 0.5f); });
+        filters.addHistogramTable(
+            [](unsigned char* table, uint64_t const* histogram)
+            {
+                grayCurveFilterTable(table, histogram, -0.3f);
+            }
+        );
+
+        GrayImage serial(src);
+        filters.apply(serial, &serialFor);
+        BOOST_CHECK(serial == expected);
+
+        GrayImage parallel(src);
+        filters.apply(parallel, &parallelFor);
+        BOOST_CHECK(parallel == expected);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace tests
+
+} // namespace imageproc
@@ -0,0 +1,206 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "GrayImage.h"
+#include "LocalStats.h"
+#include "ParallelFor.h"
+#include <QSize>
+#include <boost/test/unit_test.hpp>
+#include <algorithm>
+#include <vector>
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+
+namespace imageproc
+{
+
+namespace tests
+{
+
+BOOST_AUTO_TEST_SUITE(GrayImageTestSuite);
+
+static GrayImage makeTestImage(QSize const& size)
+{
+    GrayImage img(size);
+    for (int y = 0; y < size.height(); ++y)
+    {
+        for (int x = 0; x < size.width(); ++x)
+        {
+            // Mix of noise and flat areas.
+            img.data()[y * img.stride() + x] = static_cast<uint8_t>(
+                (x / 17 + y / 5) % 3 == 0 ? rand() : 200 + x % 7
+            );
+        }
+    }
+    return img;
+}
+
+/**
+ * A straightforward median filter, replicating edge pixels.
+ */
+static GrayImage bruteForceMedian(GrayImage const& src, int const radius)
+{
+    int const w = src.width();
+    int const h = src.height();
+    GrayImage dst(src.size());
+    std::vector<uint8_t> window;
+
+    for (int y = 0; y < h; ++y)
+    {
+        for (int x = 0; x < w; ++x)
+        {
+            window.clear();
+            for (int yf = y - radius; yf <= y + radius; ++yf)
+            {
+                int const yc = std::min(std::max(yf, 0), h - 1);
+                for (int xf = x - radius; xf <= x + radius; ++xf)
+                {
+                    int const xc = std::min(std::max(xf, 0), w - 1);
+                    window.push_back(src.data()[yc * src.stride() + xc]);
+                }
+            }
+            // The lower median, if the window size was even.
+            size_t const med_idx = (window.size() - 1) / 2;
+            std::nth_element(window.begin(), window.begin() + med_idx, window.end());
+            dst.data()[y * dst.stride() + x] = window[med_idx];
+        }
+    }
+
+    return dst;
+}
+
+BOOST_AUTO_TEST_CASE(test_median)
+{
+    QSize const sizes[] = { QSize(1, 1), QSize(9, 4), QSize(300, 37) };
+    int const radii[] = { 1, 3, 20 };
+
+    for (QSize const& size : sizes)
+    {
+        GrayImage const src(makeTestImage(size));
+
+        for (int const radius : radii)
+        {
+            GrayImage const expected(bruteForceMedian(src, radius));
+            BOOST_CHECK(grayMedian(src, radius, 1.0f, &serialFor) == expected);
+            BOOST_CHECK(grayMedian(src, radius, 1.0f, &parallelFor) == expected);
+        }
+    }
+}
+
+/**
+ * Window statistics computed the straightforward way.  The mean window
+ * excludes its rightmost column, as grayMapMean() always did.
+ */
+static void bruteForceStats(
+    GrayImage const& src, int const radius,
+    GrayImage& mean, GrayImage& deviation, GrayImage& max, GrayImage& min)
+{
+    int const w = src.width();
+    int const h = src.height();
+    mean = GrayImage(src.size());
+    deviation = GrayImage(src.size());
+    max = GrayImage(src.size());
+    min = GrayImage(src.size());
+
+    for (int y = 0; y < h; ++y)
+    {
+        int const top = std::max(0, y - radius);
+        int const bottom = std::min(h, y + radius + 1);
+        for (int x = 0; x < w; ++x)
+        {
+            int const left = std::max(0, x - radius);
+            int const right = std::min(w, x + radius + 1);
+            uint64_t sum = 0, sqsum = 0, mean_sum = 0;
+            int mean_area = 0;
+            uint8_t vmax = 0, vmin = 255;
+            for (int yf = top; yf < bottom; ++yf)
+            {
+                for (int xf = left; xf < right; ++xf)
+                {
+                    uint8_t const pixel = src.data()[yf * src.stride() + xf];
+                    sum += pixel;
+                    sqsum += pixel * pixel;
+                    vmax = std::max(vmax, pixel);
+                    vmin = std::min(vmin, pixel);
+                    if (xf < x + radius)
+                    {
+                        mean_sum += pixel;
+                        ++mean_area;
+                    }
+                }
+            }
+            double const r_area = 1.0 / ((bottom - top) * (right - left));
+            double const m = sum * r_area;
+            double const d = sqrt(fabs(sqsum * r_area - m * m)) + 0.5;
+            double const r_mean_area = 1.0 / mean_area;
+
+            int const offset = y * src.stride() + x;
+            mean.data()[offset] = (uint8_t) std::min(mean_sum * r_mean_area + 0.5, 255.0);
+            deviation.data()[offset] = (uint8_t) std::min(d, 255.0);
+            max.data()[offset] = vmax;
+            min.data()[offset] = vmin;
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_local_stats)
+{
+    QSize const sizes[] = { QSize(1, 1), QSize(9, 4), QSize(300, 137) };
+    int const radii[] = { 1, 4, 50 };
+
+    for (QSize const& size : sizes)
+    {
+        GrayImage const src(makeTestImage(size));
+
+        for (int const radius : radii)
+        {
+            GrayImage mean, deviation, max, min;
+            bruteForceStats(src, radius, mean, deviation, max, min);
+            unsigned deviation_max = 0;
+            for (int y = 0; y < size.height(); ++y)
+            {
+                for (int x = 0; x < size.width(); ++x)
+                {
+                    deviation_max = std::max<unsigned>(deviation_max, deviation.data()[y * deviation.stride() + x]);
+                }
+            }
+
+            LocalStats const serial(src, radius, LocalStats::MEAN | LocalStats::DEVIATION, &serialFor);
+            LocalStats const parallel(src, radius, LocalStats::MEAN | LocalStats::DEVIATION, &parallelFor);
+            for (LocalStats const* stats : { &serial, &parallel })
+            {
+                BOOST_CHECK(stats->mean() == mean);
+                BOOST_CHECK(stats->deviation() == deviation);
+                BOOST_CHECK(stats->windowMax() == max);
+                BOOST_CHECK(stats->windowMin() == min);
+                BOOST_CHECK_EQUAL(stats->deviationMax(), deviation_max);
+            }
+
+            LocalStats const mean_only(src, radius, LocalStats::MEAN);
+            BOOST_CHECK(mean_only.mean() == mean);
+            BOOST_CHECK(mean_only.deviation().isNull());
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace tests
+
+} // namespace imageproc
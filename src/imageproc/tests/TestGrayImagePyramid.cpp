@@ -0,0 +1,156 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "GrayImagePyramid.h"
+#include "GrayImage.h"
+#include "Scale.h"
+#include "AffineImageTransform.h"
+#include "AffineTransformedImage.h"
+#include "CachingFactory.h"
+#include <QImage>
+#include <QSize>
+#include <QTransform>
+#include <QPointF>
+#include <boost/test/unit_test.hpp>
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+
+namespace imageproc
+{
+
+namespace tests
+{
+
+BOOST_AUTO_TEST_SUITE(GrayImagePyramidTestSuite);
+
+static GrayImage randomImage(QSize const& size)
+{
+    GrayImage img(size);
+    uint8_t* line = img.data();
+    for (int y = 0; y < img.height(); ++y)
+    {
+        for (int x = 0; x < img.width(); ++x)
+        {
+            line[x] = rand() % 256;
+        }
+        line += img.stride();
+    }
+    return img;
+}
+
+BOOST_AUTO_TEST_CASE(test_level_sizes)
+{
+    QSize const orig_size(1001, 600);
+    GrayImagePyramid const pyramid(
+        orig_size, CachingFactory<GrayImage>([orig_size]()
+    {
+        return GrayImage(orig_size);
+    })
+    );
+
+    BOOST_REQUIRE_EQUAL(pyramid.numLevels(), 2);
+    BOOST_CHECK(pyramid.levelSize(0) == orig_size);
+    BOOST_CHECK(pyramid.levelSize(1) == QSize(501, 300));
+}
+
+BOOST_AUTO_TEST_CASE(test_levels_are_lazy_and_shared)
+{
+    int num_calls = 0;
+    GrayImage const orig(randomImage(QSize(1100, 1300)));
+    CachingFactory<GrayImage> const factory([&]()
+    {
+        ++num_calls;
+        return orig;
+    });
+
+    GrayImagePyramid const pyramid(orig.size(), factory);
+    BOOST_CHECK(!factory.isCached());
+
+    GrayImagePyramid const copy(pyramid);
+    GrayImage const level2(copy.level(2));
+    BOOST_CHECK(pyramid.level(2) == level2);
+    BOOST_CHECK_EQUAL(num_calls, 1);
+
+    GrayImage const expected(
+        scaleToGray(scaleToGray(orig, pyramid.levelSize(1)), pyramid.levelSize(2))
+    );
+    BOOST_CHECK(level2 == expected);
+}
+
+BOOST_AUTO_TEST_CASE(test_level_selection)
+{
+    QSize const orig_size(4000, 3000);
+    GrayImagePyramid const pyramid(
+        orig_size, CachingFactory<GrayImage>([orig_size]()
+    {
+        return GrayImage(orig_size);
+    })
+    );
+
+    BOOST_CHECK_EQUAL(pyramid.levelIdxFor(QTransform()), 0);
+    BOOST_CHECK_EQUAL(pyramid.levelIdxFor(QTransform().scale(0.6, 0.6)), 0);
+    BOOST_CHECK_EQUAL(pyramid.levelIdxFor(QTransform().scale(0.5, 0.5)), 1);
+    BOOST_CHECK_EQUAL(pyramid.levelIdxFor(QTransform().scale(0.3, 0.2)), 1);
+    BOOST_CHECK_EQUAL(pyramid.levelIdxFor(QTransform().scale(0.2, 0.2)), 2);
+    BOOST_CHECK_EQUAL(pyramid.levelIdxFor(QTransform().scale(0.01, 0.01)), pyramid.numLevels() - 1);
+
+    // Rotation doesn't change the amount of detail needed.
+    QTransform rotated;
+    rotated.rotate(45.0);
+    rotated.scale(0.5, 0.5);
+    BOOST_CHECK_EQUAL(pyramid.levelIdxFor(rotated), 1);
+}
+
+BOOST_AUTO_TEST_CASE(test_adjusted_transform)
+{
+    QSize const orig_size(2000, 1000);
+    GrayImagePyramid const pyramid(
+        orig_size, CachingFactory<GrayImage>([orig_size]()
+    {
+        return GrayImage(orig_size);
+    })
+    );
+
+    AffineImageTransform xform(orig_size);
+    xform.rotate(30.0);
+
+    QTransform downscale;
+    downscale.scale(0.25, 0.25);
+    AffineTransformedImage const level(
+        pyramid.levelFor(xform, xform.transform() * downscale)
+    );
+
+    BOOST_REQUIRE(level.origImage().size() == pyramid.levelSize(2));
+
+    // The level's transformation has to map into the same coordinates.
+    QPointF const orig_pt(1000.0, 600.0);
+    QPointF const level_pt(orig_pt.x() * 0.25, orig_pt.y() * 0.25);
+    QPointF const delta(xform.transform().map(orig_pt) - level.xform().transform().map(level_pt));
+    BOOST_CHECK(fabs(delta.x()) < 1e-6 && fabs(delta.y()) < 1e-6);
+    BOOST_CHECK(
+        level.xform().transformedCropArea().boundingRect().toRect()
+        == xform.transformedCropArea().boundingRect().toRect()
+    );
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace tests
+
+} // namespace imageproc
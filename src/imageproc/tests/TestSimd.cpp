@@ -0,0 +1,344 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Simd.h"
+#include "Grayscale.h"
+#include "GrayImage.h"
+#include "IntegralImage.h"
+#include "Scale.h"
+#include "RasterOp.h"
+#include "BinaryImage.h"
+#include "GaussBlur.h"
+#include "Grid.h"
+#include "Utils.h"
+#include <QImage>
+#include <QSize>
+#include <QRect>
+#include <QPoint>
+#include <boost/test/unit_test.hpp>
+#include <functional>
+#include <stdint.h>
+#include <stdlib.h>
+
+namespace imageproc
+{
+
+namespace tests
+{
+
+using namespace utils;
+
+BOOST_AUTO_TEST_SUITE(SimdTestSuite);
+
+/**
+ * Runs \p test for every available instruction set other than SCALAR,
+ * passing it the instruction set name.  The active instruction set
+ * is restored afterwards.
+ */
+static void forEachVectorInstructionSet(std::function<void(char const*)> const& test)
+{
+    simd::InstructionSet const saved = simd::activeInstructionSet();
+
+    for (int isa = simd::SCALAR + 1; isa <= simd::NEON; ++isa)
+    {
+        if (simd::isInstructionSetAvailable(simd::InstructionSet(isa)))
+        {
+            simd::setActiveInstructionSet(simd::InstructionSet(isa));
+            test(simd::instructionSetName(simd::InstructionSet(isa)));
+        }
+    }
+
+    simd::setActiveInstructionSet(saved);
+}
+
+template<typename T>
+static T withScalarCode(std::function<T()> const& func)
+{
+    simd::InstructionSet const saved = simd::activeInstructionSet();
+    simd::setActiveInstructionSet(simd::SCALAR);
+    T result(func());
+    simd::setActiveInstructionSet(saved);
+    return result;
+}
+
+static GrayImage randomFullRangeGrayImage(int const width, int const height)
+{
+    GrayImage img(QSize(width, height));
+    uint8_t* line = img.data();
+    for (int y = 0; y < height; ++y, line += img.stride())
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            line[x] = static_cast<uint8_t>(rand());
+        }
+    }
+    return img;
+}
+
+BOOST_AUTO_TEST_CASE(test_detected_is_available)
+{
+    BOOST_CHECK(simd::isInstructionSetAvailable(simd::detectedInstructionSet()));
+    BOOST_TEST_MESSAGE(
+        "Detected instruction set: "
+        << simd::instructionSetName(simd::detectedInstructionSet())
+    );
+}
+
+BOOST_AUTO_TEST_CASE(test_rgb_to_gray)
+{
+    QImage::Format const formats[] = { QImage::Format_RGB32, QImage::Format_ARGB32 };
+    for (QImage::Format const format : formats)
+    {
+        QImage src(163, 37, format);
+        for (int y = 0; y < src.height(); ++y)
+        {
+            QRgb* line = reinterpret_cast<QRgb*>(src.scanLine(y));
+            for (int x = 0; x < src.width(); ++x)
+            {
+                line[x] = (uint32_t(rand() & 0xffff) << 16) | uint32_t(rand() & 0xffff);
+            }
+        }
+
+        QImage const expected(
+            withScalarCode<QImage>([&src]()
+        {
+            return toGrayscale(src);
+        })
+        );
+
+        forEachVectorInstructionSet([&](char const* name)
+        {
+            BOOST_TEST_MESSAGE("Checking RGB to gray with " << name);
+            BOOST_CHECK(toGrayscale(src) == expected);
+        });
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_integral_image_rows)
+{
+    int const width = 131;
+    int const height = 23;
+    GrayImage const src(randomFullRangeGrayImage(width, height));
+
+    IntegralImage<uint32_t> expected(width, height);
+    IntegralImage<uint64_t> expected_sq(width, height);
+    uint8_t const* line = src.data();
+    for (int y = 0; y < height; ++y, line += src.stride())
+    {
+        expected.beginRow();
+        expected_sq.beginRow();
+        for (int x = 0; x < width; ++x)
+        {
+            uint32_t const pixel = line[x];
+            expected.push(pixel);
+            expected_sq.push(pixel * pixel);
+        }
+    }
+
+    forEachVectorInstructionSet([&](char const* name)
+    {
+        BOOST_TEST_MESSAGE("Checking integral image rows with " << name);
+
+        IntegralImage<uint32_t> actual(width, height);
+        IntegralImage<uint64_t> actual_sq(width, height);
+        uint8_t const* line = src.data();
+        for (int y = 0; y < height; ++y, line += src.stride())
+        {
+            actual.pushRow(line);
+            actual_sq.pushRowOfSquares(line);
+        }
+
+        for (int y = 0; y < height; ++y)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                QRect const rect(x, y, width - x, height - y);
+                BOOST_REQUIRE_EQUAL(actual.sum(rect), expected.sum(rect));
+                BOOST_REQUIRE_EQUAL(actual_sq.sum(rect), expected_sq.sum(rect));
+            }
+        }
+    });
+}
+
+BOOST_AUTO_TEST_CASE(test_gray_map_mean_and_deviation)
+{
+    GrayImage const src(randomFullRangeGrayImage(97, 61));
+
+    GrayImage const expected_mean(
+        withScalarCode<GrayImage>([&src]()
+    {
+        return grayMapMean(src, 5);
+    })
+    );
+    GrayImage const expected_deviation(
+        withScalarCode<GrayImage>([&src]()
+    {
+        return grayMapDeviation(src, 5);
+    })
+    );
+
+    forEachVectorInstructionSet([&](char const* name)
+    {
+        BOOST_TEST_MESSAGE("Checking grayMapMean() and grayMapDeviation() with " << name);
+        BOOST_CHECK(grayMapMean(src, 5) == expected_mean);
+        BOOST_CHECK(grayMapDeviation(src, 5) == expected_deviation);
+    });
+}
+
+BOOST_AUTO_TEST_CASE(test_scale_to_gray)
+{
+    GrayImage const src(randomFullRangeGrayImage(640, 96));
+    QSize const dst_sizes[] =
+    {
+        QSize(20, 3), // Integer downscaling with wide spans.
+        QSize(160, 48), // Integer downscaling with narrow spans.
+        QSize(23, 7), // Generic downscaling with wide spans.
+        QSize(301, 50), // Generic downscaling with narrow spans.
+        QSize(33, 95) // Generic scaling, horizontally only.
+    };
+
+    for (QSize const& dst_size : dst_sizes)
+    {
+        GrayImage const expected(
+            withScalarCode<GrayImage>([&]()
+        {
+            return scaleToGray(src, dst_size);
+        })
+        );
+
+        forEachVectorInstructionSet([&](char const* name)
+        {
+            BOOST_TEST_MESSAGE(
+                "Checking scaleToGray() to " << dst_size.width()
+                << 'x' << dst_size.height() << " with " << name
+            );
+            BOOST_CHECK(scaleToGray(src, dst_size) == expected);
+        });
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_raster_op)
+{
+    typedef RopSubtract<RopXor<RopSrc, RopDst>, RopNot<RopAnd<RopSrc, RopDst> > > Rop;
+
+    BinaryImage const src(randomBinaryImage(1000, 20));
+    BinaryImage const dst(randomBinaryImage(1000, 20));
+
+    struct Area
+    {
+        QRect dst_rect;
+        QPoint src_pos;
+    };
+    Area const areas[] =
+    {
+        { QRect(0, 0, 1000, 20), QPoint(0, 0) },
+        { QRect(5, 3, 900, 15), QPoint(37, 0) }, // Src and dst words are aligned.
+        { QRect(37, 1, 600, 19), QPoint(80, 1) }, // Src and dst words are misaligned.
+        { QRect(5, 3, 900, 15), QPoint(69, 3) } // Overlapping when done in place.
+    };
+
+    for (Area const& area : areas)
+    {
+        QRect const& rect = area.dst_rect;
+        QPoint const& sp = area.src_pos;
+
+        BinaryImage expected(dst);
+        BinaryImage expected_in_place(dst);
+        simd::InstructionSet const saved = simd::activeInstructionSet();
+        simd::setActiveInstructionSet(simd::SCALAR);
+        rasterOp<Rop>(expected, rect, src, sp);
+        rasterOp<Rop>(expected_in_place, rect, expected_in_place, sp);
+        simd::setActiveInstructionSet(saved);
+
+        forEachVectorInstructionSet([&](char const* name)
+        {
+            BOOST_TEST_MESSAGE("Checking rasterOp() with " << name);
+
+            BinaryImage actual(dst);
+            rasterOp<Rop>(actual, rect, src, sp);
+            BOOST_CHECK(actual == expected);
+
+            BinaryImage actual_in_place(dst);
+            rasterOp<Rop>(actual_in_place, rect, actual_in_place, sp);
+            BOOST_CHECK(actual_in_place == expected_in_place);
+        });
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_gauss_blur_blocks)
+{
+    // The Young & van Vliet passes process several columns / rows at once
+    // to let the compiler vectorize them.  Check that doesn't affect the results.
+    QSize const size(45, 29);
+    Grid<float> src(size.width(), size.height(), /*padding=*/0);
+    for (int y = 0; y < size.height(); ++y)
+    {
+        for (int x = 0; x < size.width(); ++x)
+        {
+            src(x, y) = float(rand() % 1000) / 7.f;
+        }
+    }
+
+    auto const reader = [](float val)
+    {
+        return val;
+    };
+    auto const writer = [](float& dst, float src)
+    {
+        dst = src;
+    };
+
+    Grid<float> blocked_intermediate(size.width(), size.height(), /*padding=*/0);
+    Grid<float> single_intermediate(size.width(), size.height(), /*padding=*/0);
+    gauss_blur_impl::verticalPass(
+        size, 3.5f, 0, size.width(), src.data(), src.stride(), reader, blocked_intermediate
+    );
+    for (int x = 0; x < size.width(); ++x)
+    {
+        gauss_blur_impl::verticalPass(
+            size, 3.5f, x, x + 1, src.data(), src.stride(), reader, single_intermediate
+        );
+    }
+
+    Grid<float> blocked(size.width(), size.height(), /*padding=*/0);
+    Grid<float> single(size.width(), size.height(), /*padding=*/0);
+    gauss_blur_impl::horizontalPass(
+        size, 2.5f, 0, size.height(), blocked_intermediate, blocked.data(), blocked.stride(), writer
+    );
+    for (int y = 0; y < size.height(); ++y)
+    {
+        gauss_blur_impl::horizontalPass(
+            size, 2.5f, y, y + 1, single_intermediate, single.data(), single.stride(), writer
+        );
+    }
+
+    for (int y = 0; y < size.height(); ++y)
+    {
+        for (int x = 0; x < size.width(); ++x)
+        {
+            BOOST_REQUIRE_EQUAL(blocked_intermediate(x, y), single_intermediate(x, y));
+            BOOST_REQUIRE_EQUAL(blocked(x, y), single(x, y));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace tests
+
+} // namespace imageproc
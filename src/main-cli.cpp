@@ -27,6 +27,9 @@
 
 #include "CommandLine.h"
 #include "ConsoleBatch.h"
+#include "TiffMetadataLoader.h"
+#include "FastImageMetadataLoader.h"
+#include "Trace.h"
 
 
 int main(int argc, char **argv)
@@ -42,6 +45,9 @@ int main(int argc, char **argv)
     QImageReader::setAllocationLimit(0);
 #endif
 
+    TiffMetadataLoader::registerMyself();
+    FastImageMetadataLoader::registerMyself();
+
     // parse command line arguments
     CommandLine cli(app.arguments(), false);
     CommandLine::set(cli);
@@ -52,6 +58,8 @@ int main(int argc, char **argv)
         return 0;
     }
 
+    Trace::setEnabled(cli.hasTrace());
+
     std::unique_ptr<ConsoleBatch> cbatch;
 
     try
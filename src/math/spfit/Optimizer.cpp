@@ -19,9 +19,12 @@
 #include "Optimizer.h"
 #include <Eigen/Core>
 #include <Eigen/QR>
+#include <Eigen/SparseCore>
+#include <Eigen/SparseCholesky>
 #include <boost/foreach.hpp>
 #include <stdexcept>
 #include <algorithm>
+#include <vector>
 #include <cassert>
 
 using namespace Eigen;
@@ -29,15 +32,28 @@ using namespace Eigen;
 namespace spfit
 {
 
+namespace
+{
+
+/**
+ * The sparse solution is rejected if A * x differs from b by more than that,
+ * relative to the norm of b.  LDLT without pivoting doesn't detect
+ * near-singular systems, while this check does.
+ */
+double const MAX_SPARSE_RELATIVE_RESIDUAL = 1e-8;
+
+} // anonymous namespace
+
 Optimizer::Optimizer(size_t num_vars)
     :	m_numVars(num_vars)
-    ,	m_A(num_vars, num_vars)
+    ,	m_solver(SPARSE_LDLT)
+    ,	m_constraints(0, num_vars)
     ,	m_b(num_vars)
     ,	m_x(num_vars)
     ,	m_externalForce(num_vars)
     ,	m_internalForce(num_vars)
+    ,	m_sparsity(num_vars)
 {
-    m_A.setZero();
     m_b.setZero();
     m_x.setZero();
 }
@@ -48,11 +64,10 @@ Optimizer::setConstraints(std::list<LinearFunction> const& constraints)
     size_t const num_constraints = constraints.size();
     size_t const num_dimensions = m_numVars + num_constraints;
 
-    MatrixXd A(num_dimensions, num_dimensions);
-    A.setZero();
+    MatrixXd C(num_constraints, m_numVars);
     VectorXd b(num_dimensions);
     b.setZero();
-    // Matrix A and vector b will have the following layout:
+    // The system of equations we are solving has the following layout:
     //     |N N N L L|      |-D|
     //     |N N N L L|      |-D|
     // A = |N N N L L|  b = |-D|
@@ -64,20 +79,21 @@ Optimizer::setConstraints(std::list<LinearFunction> const& constraints)
     //    to the symmetric C values.
     // D: constant part of the gradient of the function we are optimizing.
     // J: constant part of constraint functions.
+    // Only C is stored in m_constraints, as N is rebuilt by optimize().
 
     std::list<LinearFunction>::const_iterator ctr(constraints.begin());
-    for (size_t i = m_numVars; i < num_dimensions; ++i, ++ctr)
+    for (size_t i = 0; i < num_constraints; ++i, ++ctr)
     {
-        b[i] = -ctr->b;
+        b[m_numVars + i] = -ctr->b;
         for (size_t j = 0; j < m_numVars; ++j)
         {
-            A(i, j) = A(j, i) = ctr->a[j];
+            C(i, j) = ctr->a[j];
         }
     }
 
     m_x.resize(num_dimensions);
     m_x.setZero();
-    m_A.swap(A);
+    m_constraints.swap(C);
     m_b.swap(b);
 }
 
@@ -85,6 +101,7 @@ void
 Optimizer::addExternalForce(QuadraticFunction const& force)
 {
     m_externalForce += force;
+    markNonZeroElements(force);
 }
 
 void
@@ -102,12 +119,14 @@ Optimizer::addExternalForce(QuadraticFunction const& force, std::vector<int> con
         m_externalForce.b[ii] += force.b[i];
     }
     m_externalForce.c += force.c;
+    markNonZeroElements(force, sparse_map);
 }
 
 void
 Optimizer::addInternalForce(QuadraticFunction const& force)
 {
     m_internalForce += force;
+    markNonZeroElements(force);
 }
 
 void
@@ -126,6 +145,51 @@ Optimizer::addInternalForce(
         m_internalForce.b[ii] += force.b[i];
     }
     m_internalForce.c += force.c;
+    markNonZeroElements(force, sparse_map);
+}
+
+/**
+ * Forces covering all the variables, like the ones from
+ * XSpline::controlPointsAttractionForce(), still tend to only couple
+ * neighbouring control points, so we go by actual values rather than
+ * by the dimensions of the matrix.
+ */
+void
+Optimizer::markNonZeroElements(QuadraticFunction const& force)
+{
+    size_t const num_vars = force.numVars();
+    for (size_t i = 0; i < num_vars; ++i)
+    {
+        for (size_t j = 0; j < num_vars; ++j)
+        {
+            if (force.A(i, j) != 0)
+            {
+                // The gradient is (A + A^T) * x + b, so we mark both.
+                m_sparsity.markNonZero(i, j);
+                m_sparsity.markNonZero(j, i);
+            }
+        }
+    }
+}
+
+void
+Optimizer::markNonZeroElements(
+    QuadraticFunction const& force, std::vector<int> const& sparse_map)
+{
+    size_t const num_vars = force.numVars();
+    for (size_t i = 0; i < num_vars; ++i)
+    {
+        int const ii = sparse_map[i];
+        for (size_t j = 0; j < num_vars; ++j)
+        {
+            if (force.A(i, j) != 0)
+            {
+                int const jj = sparse_map[j];
+                m_sparsity.markNonZero(ii, jj);
+                m_sparsity.markNonZero(jj, ii);
+            }
+        }
+    }
 }
 
 OptimizationResult
@@ -136,21 +200,18 @@ Optimizer::optimize(double internal_force_weight)
     m_internalForce *= internal_force_weight;
     m_internalForce += m_externalForce;
 
-    // For the layout of m_A and m_b, see setConstraints()
+    // For the layout of the system, see setConstraints()
     QuadraticFunction::Gradient const grad(m_internalForce.gradient());
     for (size_t i = 0; i < m_numVars; ++i)
     {
         m_b[i] = -grad.b[i];
-        for (size_t j = 0; j < m_numVars; ++j)
-        {
-            m_A(i, j) = grad.A(i, j);
-        }
     }
 
     double const total_force_before = m_internalForce.c;
 
-    auto qr = m_A.colPivHouseholderQr();
-    if (!qr.isInvertible())
+    bool const solved = (m_solver == SPARSE_LDLT && solveSparse(grad.A)) || solveDense(grad.A);
+    m_sparsity = adiff::SparseMap<2>(m_numVars);
+    if (!solved)
     {
         m_externalForce.reset();
         m_internalForce.reset();
@@ -158,7 +219,6 @@ Optimizer::optimize(double internal_force_weight)
         return OptimizationResult(total_force_before, total_force_before);
     }
 
-    m_x = qr.solve(m_b).head(m_numVars);
     double const total_force_after = m_internalForce.evaluate(m_x);
     m_externalForce.reset(); // Now it's finally safe to reset these.
     m_internalForce.reset();
@@ -170,6 +230,96 @@ Optimizer::optimize(double internal_force_weight)
     return OptimizationResult(total_force_before, total_force_after);
 }
 
+/**
+ * Writes the displacements part of the solution to m_x and returns
+ * true on success.  On failure, m_x is left unchanged.
+ */
+bool
+Optimizer::solveSparse(MatrixXd const& grad_A)
+{
+    size_t const num_constraints = m_constraints.rows();
+    size_t const num_dimensions = m_numVars + num_constraints;
+
+    std::vector<Triplet<double>> triplets;
+    triplets.reserve(m_sparsity.numNonZeroElements() + num_constraints * m_numVars * 2);
+
+    for (size_t i = 0; i < m_numVars; ++i)
+    {
+        for (size_t j = 0; j < m_numVars; ++j)
+        {
+            if (m_sparsity.nonZeroElementIdx(i, j) != adiff::SparseMap<2>::ZERO_ELEMENT)
+            {
+                triplets.push_back(Triplet<double>(i, j, grad_A(i, j)));
+            }
+        }
+    }
+
+    for (size_t i = 0; i < num_constraints; ++i)
+    {
+        for (size_t j = 0; j < m_numVars; ++j)
+        {
+            double const coeff = m_constraints(i, j);
+            if (coeff != 0)
+            {
+                triplets.push_back(Triplet<double>(m_numVars + i, j, coeff));
+                triplets.push_back(Triplet<double>(j, m_numVars + i, coeff));
+            }
+        }
+    }
+
+    SparseMatrix<double> A(num_dimensions, num_dimensions);
+    A.setFromTriplets(triplets.begin(), triplets.end());
+
+    // Without pivoting, this only works if the constraints come last,
+    // after the diagonal of the force part has been factored.  Keeping
+    // the natural order also keeps the fill-in within the band.
+    SimplicialLDLT<SparseMatrix<double>, Lower, NaturalOrdering<int>> ldlt(A);
+    if (ldlt.info() != Success)
+    {
+        return false;
+    }
+
+    VectorXd x(ldlt.solve(m_b));
+    if (ldlt.info() != Success || !x.allFinite())
+    {
+        return false;
+    }
+
+    double const residual = (A * x - m_b).norm();
+    if (!(residual <= MAX_SPARSE_RELATIVE_RESIDUAL * m_b.norm()))
+    {
+        return false;
+    }
+
+    m_x = x.head(m_numVars);
+    return true;
+}
+
+/**
+ * \see solveSparse()
+ */
+bool
+Optimizer::solveDense(MatrixXd const& grad_A)
+{
+    size_t const num_constraints = m_constraints.rows();
+    size_t const num_dimensions = m_numVars + num_constraints;
+
+    MatrixXd A(num_dimensions, num_dimensions);
+    A.topLeftCorner(m_numVars, m_numVars) = grad_A;
+    A.topRightCorner(m_numVars, num_constraints) = m_constraints.transpose();
+    A.bottomLeftCorner(num_constraints, m_numVars) = m_constraints;
+    A.bottomRightCorner(num_constraints, num_constraints).setZero();
+
+    auto qr = A.colPivHouseholderQr();
+    if (!qr.isInvertible())
+    {
+        return false;
+    }
+
+    m_x = qr.solve(m_b).head(m_numVars);
+    return true;
+}
+
 void
 Optimizer::undoLastStep()
 {
@@ -184,29 +334,31 @@ Optimizer::undoLastStep()
 void
 Optimizer::adjustConstraints(double direction)
 {
-    size_t const num_dimensions = m_b.size();
-    for (size_t i = m_numVars; i < num_dimensions; ++i)
+    size_t const num_constraints = m_constraints.rows();
+    for (size_t i = 0; i < num_constraints; ++i)
     {
         // See setConstraints() for more information
-        // on the layout of m_A and m_b.
+        // on the layout of the system.
         double c = 0;
         for (size_t j = 0; j < m_numVars; ++j)
         {
-            c += m_A(i, j) * m_x[j];
+            c += m_constraints(i, j) * m_x[j];
         }
-        m_b[i] -= c * direction;
+        m_b[m_numVars + i] -= c * direction;
     }
 }
 
 void
 Optimizer::swap(Optimizer& other)
 {
-    m_A.swap(other.m_A);
+    m_constraints.swap(other.m_constraints);
     m_b.swap(other.m_b);
     m_x.swap(other.m_x);
     m_externalForce.swap(other.m_externalForce);
     m_internalForce.swap(other.m_internalForce);
+    std::swap(m_sparsity, other.m_sparsity);
     std::swap(m_numVars, other.m_numVars);
+    std::swap(m_solver, other.m_solver);
 }
 
 } // namespace spfit
@@ -26,6 +26,7 @@
 #include "VirtualFunction.h"
 #include "LinearFunction.h"
 #include "QuadraticFunction.h"
+#include "adiff/SparseMap.h"
 #include <Eigen/Core>
 #include <vector>
 #include <list>
@@ -37,8 +38,35 @@ class MATH_EXPORT Optimizer
 {
     // Member-wise copying is OK.
 public:
+    enum Solver
+    {
+        /**
+         * Solves the system of equations with a sparse LDLT decomposition,
+         * falling back to DENSE_QR should it fail.  Forces coming from
+         * spline fitting only couple nearby control points, which makes
+         * the system banded.
+         */
+        SPARSE_LDLT,
+
+        /**
+         * Solves the system of equations with a dense QR decomposition
+         * with column pivoting.
+         */
+        DENSE_QR
+    };
+
     Optimizer(size_t num_vars = 0);
 
+    Solver solver() const
+    {
+        return m_solver;
+    }
+
+    void setSolver(Solver solver)
+    {
+        m_solver = solver;
+    }
+
     /**
      * Sets linear constraints in the form of b^T * x + c = 0
      * Note that x in the above formula is not a vector of coordinates
@@ -95,14 +123,34 @@ public:
 
     void swap(Optimizer& other);
 private:
+    void markNonZeroElements(QuadraticFunction const& force);
+
+    void markNonZeroElements(QuadraticFunction const& force, std::vector<int> const& sparse_map);
+
+    bool solveSparse(Eigen::MatrixXd const& grad_A);
+
+    bool solveDense(Eigen::MatrixXd const& grad_A);
+
     void adjustConstraints(double direction);
 
     size_t m_numVars;
-    Eigen::MatrixXd m_A;
+    Solver m_solver;
+
+    /**
+     * Rows are constraints, columns are variables.
+     * \see setConstraints()
+     */
+    Eigen::MatrixXd m_constraints;
     Eigen::VectorXd m_b;
     Eigen::VectorXd m_x;
     QuadraticFunction m_externalForce;
     QuadraticFunction m_internalForce;
+
+    /**
+     * Elements of the quadratic part of the forces that were
+     * touched since the last call to optimize().
+     */
+    adiff::SparseMap<2> m_sparsity;
 };
 
 
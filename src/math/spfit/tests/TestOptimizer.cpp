@@ -0,0 +1,205 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Optimizer.h"
+#include "OptimizationResult.h"
+#include "QuadraticFunction.h"
+#include "LinearFunction.h"
+#include "XSpline.h"
+#include <Eigen/Core>
+#include <QPointF>
+#include <QElapsedTimer>
+#include <boost/test/unit_test.hpp>
+#include <list>
+#include <vector>
+#include <stdlib.h>
+
+using namespace Eigen;
+
+namespace spfit
+{
+
+namespace tests
+{
+
+BOOST_AUTO_TEST_SUITE(OptimizerTestSuite);
+
+static double frand(double from, double to)
+{
+    double const rand_0_1 = rand() / double(RAND_MAX);
+    return from + (to - from) * rand_0_1;
+}
+
+/**
+ * Forces resembling the ones SplineFitter produces: attraction of spline
+ * samples, each of which depends on 4 adjacent control points, and
+ * XSpline::controlPointsAttractionForce() as the internal force.
+ */
+class SplineLikeForces
+{
+public:
+    SplineLikeForces(int num_control_points)
+        : m_internalForce(num_control_points * 2)
+    {
+        XSpline spline;
+        for (int i = 0; i < num_control_points; ++i)
+        {
+            spline.appendControlPoint(QPointF(i * 10, frand(-5, 5)), 1);
+        }
+        m_internalForce = spline.controlPointsAttractionForce();
+
+        int const num_vars = 8;
+        for (int first_cp = 0; first_cp + 4 <= num_control_points; ++first_cp)
+        {
+            for (int sample = 0; sample < 3; ++sample)
+            {
+                MatrixXd L(2, num_vars);
+                for (int i = 0; i < L.size(); ++i)
+                {
+                    L.data()[i] = frand(-1, 1);
+                }
+                Vector2d const target(frand(-5, 5), frand(-5, 5));
+
+                QuadraticFunction f(num_vars);
+                f.A = L.transpose() * L;
+                f.b = -2.0 * L.transpose() * target;
+                f.c = target.squaredNorm();
+                m_externalForces.push_back(f);
+
+                std::vector<int> sparse_map(num_vars);
+                for (int i = 0; i < num_vars; ++i)
+                {
+                    sparse_map[i] = first_cp * 2 + i;
+                }
+                m_sparseMaps.push_back(sparse_map);
+            }
+        }
+
+        // Pin the first and the last control points.
+        int const last_var = num_control_points * 2 - 1;
+        int const pinned_vars[] = { 0, 1, last_var - 1, last_var };
+        for (int var : pinned_vars)
+        {
+            LinearFunction constraint(num_control_points * 2);
+            constraint.a[var] = 1;
+            constraint.b = frand(-1, 1);
+            m_constraints.push_back(constraint);
+        }
+    }
+
+    void apply(Optimizer& optimizer) const
+    {
+        optimizer.setConstraints(m_constraints);
+        optimizer.addInternalForce(m_internalForce);
+        for (size_t i = 0; i < m_externalForces.size(); ++i)
+        {
+            optimizer.addExternalForce(m_externalForces[i], m_sparseMaps[i]);
+        }
+    }
+private:
+    QuadraticFunction m_internalForce;
+    std::vector<QuadraticFunction> m_externalForces;
+    std::vector<std::vector<int>> m_sparseMaps;
+    std::list<LinearFunction> m_constraints;
+};
+
+BOOST_AUTO_TEST_CASE(test_sparse_matches_dense)
+{
+    int const sizes[] = { 4, 5, 12, 50 };
+    for (int num_control_points : sizes)
+    {
+        SplineLikeForces const forces(num_control_points);
+
+        Optimizer sparse(num_control_points * 2);
+        sparse.setSolver(Optimizer::SPARSE_LDLT);
+        forces.apply(sparse);
+        OptimizationResult const sparse_res(sparse.optimize(0.5));
+
+        Optimizer dense(num_control_points * 2);
+        dense.setSolver(Optimizer::DENSE_QR);
+        forces.apply(dense);
+        OptimizationResult const dense_res(dense.optimize(0.5));
+
+        BOOST_REQUIRE_CLOSE(sparse_res.forceAfter(), dense_res.forceAfter(), 1e-06);
+        for (int i = 0; i < num_control_points * 2; ++i)
+        {
+            BOOST_REQUIRE_SMALL(
+                sparse.displacementVector()[i] - dense.displacementVector()[i], 1e-06
+            );
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_singular_system)
+{
+    // Nothing holds the variables in place, which the sparse solver
+    // should detect and report as no improvement, just like the dense one.
+    Optimizer optimizer(6);
+    optimizer.setSolver(Optimizer::SPARSE_LDLT);
+    QuadraticFunction force(2);
+    force.A.setIdentity();
+    force.b.setConstant(1);
+    std::vector<int> const sparse_map = { 2, 3 };
+    optimizer.addExternalForce(force, sparse_map);
+
+    OptimizationResult const res(optimizer.optimize(1.0));
+    BOOST_CHECK_EQUAL(res.forceBefore(), res.forceAfter());
+    for (int i = 0; i < 6; ++i)
+    {
+        BOOST_CHECK_EQUAL(optimizer.displacementVector()[i], 0.0);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(benchmark_sparse_vs_dense)
+{
+    int const sizes[] = { 10, 50, 200 };
+    int const iterations = 10;
+    for (int num_control_points : sizes)
+    {
+        SplineLikeForces const forces(num_control_points);
+        Optimizer::Solver const solvers[] = { Optimizer::DENSE_QR, Optimizer::SPARSE_LDLT };
+        qint64 elapsed_us[2] = { 0, 0 };
+
+        for (int s = 0; s < 2; ++s)
+        {
+            Optimizer optimizer(num_control_points * 2);
+            optimizer.setSolver(solvers[s]);
+            for (int i = 0; i < iterations; ++i)
+            {
+                forces.apply(optimizer);
+
+                QElapsedTimer timer;
+                timer.start();
+                optimizer.optimize(0.5);
+                elapsed_us[s] += timer.nsecsElapsed() / 1000;
+            }
+        }
+
+        BOOST_TEST_MESSAGE(
+            "Optimizer with " << num_control_points << " control points: dense QR "
+            << elapsed_us[0] / iterations << " us, sparse LDLT "
+            << elapsed_us[1] / iterations << " us per iteration"
+        );
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace tests
+
+} // namespace spfit
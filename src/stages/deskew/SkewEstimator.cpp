@@ -0,0 +1,190 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "SkewEstimator.h"
+#include "TaskStatus.h"
+#include "DebugImages.h"
+#include "imageproc/AffineImageTransform.h"
+#include "imageproc/AffineTransformedImage.h"
+#include "imageproc/AffineTransform.h"
+#include "imageproc/BinaryImage.h"
+#include "imageproc/Binarize.h"
+#include "imageproc/BWColor.h"
+#include "imageproc/GrayImage.h"
+#include "imageproc/GrayImagePyramid.h"
+#include "imageproc/RasterOp.h"
+#include "imageproc/ReduceThreshold.h"
+#include "imageproc/UpscaleIntegerTimes.h"
+#include "imageproc/SeedFill.h"
+#include "imageproc/Connectivity.h"
+#include "imageproc/Morphology.h"
+#include <QImage>
+#include <QSize>
+#include <QRect>
+#include <Qt>
+#include <algorithm>
+#include <math.h>
+
+using namespace imageproc;
+
+namespace deskew
+{
+
+namespace
+{
+
+/**
+ * In COARSE_TO_FINE mode, the page is downscaled to fit this size.
+ * That's about half the resolution of a 300 DPI page, which is what
+ * SkewFinder's default fine reduction is tuned for.
+ */
+int const FINE_WORKING_SIZE = 1800;
+
+/** Enhancement radii for the full resolution image. */
+int const FULL_RETINEX_RADIUS = 31;
+int const FULL_BINARIZATION_RADIUS = 7;
+
+} // anonymous namespace
+
+Skew
+SkewEstimator::estimateSkew(
+    TaskStatus const& status,
+    std::shared_ptr<AcceleratableOperations> const& accel_ops,
+    GrayImagePyramid const& pyramid, AffineImageTransform const& xform,
+    Mode const mode, DebugImages* const dbg)
+{
+    SkewFinder skew_finder;
+    BinaryImage bw_image;
+
+    QSize const crop_size(xform.transformedCropArea().boundingRect().size().toSize());
+    int const crop_dim = std::max(crop_size.width(), crop_size.height());
+
+    if (mode == FULL_RESOLUTION || crop_dim <= FINE_WORKING_SIZE)
+    {
+        // Without downscaling, COARSE_TO_FINE would be the same thing.
+        GrayImage trim_image(
+            accel_ops->affineTransform(
+                pyramid.level(0), xform.transform(),
+                xform.transformedCropArea().boundingRect().toRect(),
+                OutsidePixels::assumeColor(Qt::white)
+            )
+        );
+        //bw_image = binarizeGrad(trim_image, 7, 0.75, 0.0);
+        //bw_image = binarizeEdgeDiv(trim_image, 7, -1.0, 1.0, 0.0);
+        bw_image = binarizeEdgeDiv(
+                       grayRetinex(trim_image, FULL_RETINEX_RADIUS, 1.0),
+                       FULL_BINARIZATION_RADIUS, 0.0, 1.0, 0.0
+                   );
+    }
+    else
+    {
+        AffineImageTransform working_xform(xform);
+        working_xform.scaleTo(
+            QSize(FINE_WORKING_SIZE, FINE_WORKING_SIZE), Qt::KeepAspectRatio
+        );
+        double const scale = double(FINE_WORKING_SIZE) / crop_dim;
+
+        AffineTransformedImage const level(
+            pyramid.levelFor(working_xform, working_xform.transform())
+        );
+        GrayImage trim_image(
+            accel_ops->affineTransform(
+                level.origImage(), level.xform().transform(),
+                level.xform().transformedCropArea().boundingRect().toRect(),
+                OutsidePixels::assumeColor(Qt::white)
+            )
+        );
+
+        // Radii follow the resolution.
+        int const retinex_radius = std::max(1, qRound(FULL_RETINEX_RADIUS * scale));
+        int const binarization_radius = std::max(
+            1, qRound(FULL_BINARIZATION_RADIUS * scale)
+        );
+        bw_image = binarizeEdgeDiv(
+                       grayRetinex(trim_image, retinex_radius, 1.0),
+                       binarization_radius, 0.0, 1.0, 0.0
+                   );
+
+        // So do the reductions, with the part of the downscaling they
+        // no longer have to do taken off.
+        int const levels_done = qRound(log2(1.0 / scale));
+        skew_finder.setCoarseReduction(
+            std::max(0, SkewFinder::DEFAULT_COARSE_REDUCTION - levels_done)
+        );
+        skew_finder.setFineReduction(
+            std::max(0, SkewFinder::DEFAULT_FINE_REDUCTION - levels_done)
+        );
+    }
+
+    if (dbg)
+    {
+        dbg->add(bw_image, "bw_image");
+    }
+
+    status.throwIfCancelled();
+
+    cleanup(status, bw_image);
+    if (dbg)
+    {
+        dbg->add(bw_image, "after_cleanup");
+    }
+
+    status.throwIfCancelled();
+
+    return skew_finder.findSkew(bw_image);
+}
+
+void
+SkewEstimator::cleanup(TaskStatus const& status, BinaryImage& image)
+{
+    // We don't have to clean up every piece of garbage.
+    // The only concern are the horizontal shadows, which we remove here.
+
+    BinaryImage reduced_image;
+
+    {
+        ReduceThreshold reductor(image);
+        while (reductor.image().width() >= 2000 && reductor.image().height() >= 2000)
+        {
+            reductor.reduce(2);
+        }
+        reduced_image = reductor.image();
+    }
+
+    status.throwIfCancelled();
+
+    QSize const brick(200, 14);
+    BinaryImage opened(openBrick(reduced_image, brick, BLACK));
+    reduced_image.release();
+
+    status.throwIfCancelled();
+
+    BinaryImage seed(upscaleIntegerTimes(opened, image.size(), WHITE));
+    opened.release();
+
+    status.throwIfCancelled();
+
+    BinaryImage garbage(seedFill(seed, image, CONN8));
+    seed.release();
+
+    status.throwIfCancelled();
+
+    rasterOp<RopSubtract<RopDst, RopSrc> >(image, garbage);
+}
+
+} // namespace deskew
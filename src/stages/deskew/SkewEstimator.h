@@ -0,0 +1,84 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DESKEW_SKEWESTIMATOR_H_
+#define DESKEW_SKEWESTIMATOR_H_
+
+#include "acceleration/AcceleratableOperations.h"
+#include "imageproc/SkewFinder.h"
+#include <memory>
+
+class TaskStatus;
+class DebugImages;
+
+namespace imageproc
+{
+class BinaryImage;
+class AffineImageTransform;
+class GrayImagePyramid;
+}
+
+namespace deskew
+{
+
+class SkewEstimator
+{
+public:
+    enum Mode
+    {
+        /**
+         * The full size image is enhanced and binarized, then reduced
+         * by SkewFinder for its coarse and fine searches.
+         */
+        FULL_RESOLUTION,
+
+        /**
+         * The image is enhanced and binarized at about the resolution
+         * of SkewFinder's fine search, starting from the closest pyramid
+         * level. Enhancement radii and SkewFinder's reductions are scaled
+         * along with the image. Pages that don't need downscaling are
+         * processed as in FULL_RESOLUTION mode. deskew::Task only uses
+         * this mode if the "settings/deskew_coarse_to_fine" key is set.
+         */
+        COARSE_TO_FINE
+    };
+
+    /**
+     * \brief Estimates the skew of a page.
+     *
+     * \param status Used to check for cancellation.
+     * \param accel_ops OpenCL-acceleratable operations.
+     * \param pyramid A grayscale pyramid of the original image.
+     * \param xform A transformation of the original image. The skew
+     *        is estimated for the area it crops to.
+     * \param mode See Mode.
+     * \param dbg An optional sink for debugging images.
+     */
+    static imageproc::Skew estimateSkew(
+        TaskStatus const& status,
+        std::shared_ptr<AcceleratableOperations> const& accel_ops,
+        imageproc::GrayImagePyramid const& pyramid,
+        imageproc::AffineImageTransform const& xform,
+        Mode mode = FULL_RESOLUTION, DebugImages* dbg = nullptr);
+private:
+    static void cleanup(TaskStatus const& status, imageproc::BinaryImage& img);
+};
+
+} // namespace deskew
+
+#endif
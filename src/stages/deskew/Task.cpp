@@ -29,14 +29,17 @@
 #include <QPainter>
 #include <QPolygonF>
 #include <QTransform>
+#include <QSettings>
 #include "Task.h"
 #include "Filter.h"
 #include "OptionsWidget.h"
 #include "Settings.h"
 #include "Params.h"
 #include "Dependencies.h"
+#include "SkewEstimator.h"
 #include "TaskStatus.h"
 #include "DebugImagesImpl.h"
+#include "Trace.h"
 #include "stages/select_content/Task.h"
 #include "FilterUiInterface.h"
 #include "ImageView.h"
@@ -50,20 +53,9 @@
 #include "dewarping/TopBottomEdgeTracer.h"
 #include "imageproc/AffineImageTransform.h"
 #include "imageproc/AffineTransformedImage.h"
-#include "imageproc/AffineTransform.h"
-#include "imageproc/BinaryImage.h"
-#include "imageproc/BinaryThreshold.h"
-#include "imageproc/Binarize.h"
-#include "imageproc/BWColor.h"
 #include "imageproc/GrayImage.h"
 #include "imageproc/OrthogonalRotation.h"
 #include "imageproc/SkewFinder.h"
-#include "imageproc/RasterOp.h"
-#include "imageproc/ReduceThreshold.h"
-#include "imageproc/UpscaleIntegerTimes.h"
-#include "imageproc/SeedFill.h"
-#include "imageproc/Connectivity.h"
-#include "imageproc/Morphology.h"
 #include "math/LineBoundedByRect.h"
 #include "math/XSpline.h"
 
@@ -212,9 +204,12 @@ Task::process(
     std::shared_ptr<AcceleratableOperations> const& accel_ops,
     QImage const& orig_image,
     CachingFactory<imageproc::GrayImage> const& gray_orig_image_factory,
+    imageproc::GrayImagePyramid const& gray_pyramid,
     AffineImageTransform const& orig_image_transform,
     OrthogonalRotation const& pre_rotation)
 {
+    TraceSpan const span("stage", "deskew", orig_image.size());
+
     status.throwIfCancelled();
 
     Dependencies const deps(orig_image_transform.origCropArea(), pre_rotation);
@@ -243,22 +238,22 @@ Task::process(
     {
     case DistortionType::NONE:
         return processNoDistortion(
-                   status, accel_ops, orig_image, gray_orig_image_factory,
+                   status, accel_ops, orig_image, gray_orig_image_factory, gray_pyramid,
                    orig_image_transform, *params
                );
     case DistortionType::ROTATION:
         return processRotationDistortion(
-                   status, accel_ops, orig_image, gray_orig_image_factory,
+                   status, accel_ops, orig_image, gray_orig_image_factory, gray_pyramid,
                    orig_image_transform, *params
                );
     case DistortionType::PERSPECTIVE:
         return processPerspectiveDistortion(
-                   status, accel_ops, orig_image, gray_orig_image_factory,
+                   status, accel_ops, orig_image, gray_orig_image_factory, gray_pyramid,
                    orig_image_transform, *params
                );
     case DistortionType::WARP:
         return processWarpDistortion(
-                   status, accel_ops, orig_image, gray_orig_image_factory,
+                   status, accel_ops, orig_image, gray_orig_image_factory, gray_pyramid,
                    orig_image_transform, *params
                );
     } // switch
@@ -272,6 +267,7 @@ Task::processNoDistortion(
     std::shared_ptr<AcceleratableOperations> const& accel_ops,
     QImage const& orig_image,
     CachingFactory<imageproc::GrayImage> const& gray_orig_image_factory,
+    imageproc::GrayImagePyramid const& gray_pyramid,
     AffineImageTransform const& orig_image_transform, Params& params)
 {
     // Necessary to update dependencies.
@@ -280,7 +276,7 @@ Task::processNoDistortion(
     if (m_ptrNextTask)
     {
         return m_ptrNextTask->process(
-                   status, accel_ops, orig_image, gray_orig_image_factory,
+                   status, accel_ops, orig_image, gray_orig_image_factory, gray_pyramid,
                    std::make_shared<AffineImageTransform>(orig_image_transform)
                );
     }
@@ -302,6 +298,7 @@ Task::processRotationDistortion(
     std::shared_ptr<AcceleratableOperations> const& accel_ops,
     QImage const& orig_image,
     CachingFactory<imageproc::GrayImage> const& gray_orig_image_factory,
+    imageproc::GrayImagePyramid const& gray_pyramid,
     AffineImageTransform const& orig_image_transform, Params& params)
 {
     if (!params.rotationParams().isValid())
@@ -314,44 +311,18 @@ Task::processRotationDistortion(
 
         if (transformed_crop_rect.isValid())
         {
-            /*
-            QImage trim_image(
-                accel_ops->affineTransform(
-                    gray_orig_image_factory(), orig_image_transform.transform(),
-                    transformed_crop_rect, OutsidePixels::assumeColor(Qt::white)
+            // Coarse to fine estimation is faster, but until it proves
+            // to find the same angles, it has to be asked for.
+            bool const coarse_to_fine = QSettings().value(
+                                            "settings/deskew_coarse_to_fine", false
+                                        ).toBool();
+            Skew const skew(
+                SkewEstimator::estimateSkew(
+                    status, accel_ops, gray_pyramid, orig_image_transform,
+                    coarse_to_fine ? SkewEstimator::COARSE_TO_FINE
+                    : SkewEstimator::FULL_RESOLUTION, m_ptrDbg.get()
                 )
             );
-            BinaryImage bw_image(
-                trim_image,
-                BinaryThreshold::otsuThreshold(gray_orig_image_factory())
-            );
-            trim_image = QImage();
-            */
-            GrayImage trim_image(
-                accel_ops->affineTransform(
-                    gray_orig_image_factory(), orig_image_transform.transform(),
-                    transformed_crop_rect, OutsidePixels::assumeColor(Qt::white)
-                )
-            );
-            //BinaryImage bw_image(binarizeGrad(trim_image, 7, 0.75, 0.0));
-            //BinaryImage bw_image(binarizeEdgeDiv(trim_image, 7, -1.0, 1.0, 0.0));
-            BinaryImage bw_image(binarizeEdgeDiv(grayRetinex(trim_image, 31, 1.0), 7, 0.0, 1.0, 0.0));
-            trim_image = GrayImage();
-            if (m_ptrDbg.get())
-            {
-                m_ptrDbg->add(bw_image, "bw_image");
-            }
-
-            cleanup(status, bw_image);
-            if (m_ptrDbg.get())
-            {
-                m_ptrDbg->add(bw_image, "after_cleanup");
-            }
-
-            status.throwIfCancelled();
-
-            SkewFinder skew_finder;
-            Skew const skew(skew_finder.findSkew(bw_image));
 
             if (skew.confidence() >= skew.GOOD_CONFIDENCE)
             {
@@ -373,7 +344,7 @@ Task::processRotationDistortion(
     {
         double const angle = params.rotationParams().compensationAngleDeg();
         return m_ptrNextTask->process(
-                   status, accel_ops, orig_image, gray_orig_image_factory,
+                   status, accel_ops, orig_image, gray_orig_image_factory, gray_pyramid,
                    std::make_shared<AffineImageTransform>(
                        orig_image_transform.adjusted(
                            [angle](AffineImageTransform& xform)
@@ -402,6 +373,7 @@ Task::processPerspectiveDistortion(
     std::shared_ptr<AcceleratableOperations> const& accel_ops,
     QImage const& orig_image,
     CachingFactory<imageproc::GrayImage> const& gray_orig_image_factory,
+    imageproc::GrayImagePyramid const& gray_pyramid,
     AffineImageTransform const& orig_image_transform, Params& params)
 {
     if (!params.perspectiveParams().isValid())
@@ -477,7 +449,8 @@ Task::processPerspectiveDistortion(
             )
         );
         return m_ptrNextTask->process(
-                   status, accel_ops, orig_image, gray_orig_image_factory, perspective_transform
+                   status, accel_ops, orig_image, gray_orig_image_factory,
+                   gray_pyramid, perspective_transform
                );
     }
     else
@@ -498,6 +471,7 @@ Task::processWarpDistortion(
     std::shared_ptr<AcceleratableOperations> const& accel_ops,
     QImage const& orig_image,
     CachingFactory<imageproc::GrayImage> const& gray_orig_image_factory,
+    imageproc::GrayImagePyramid const& gray_pyramid,
     AffineImageTransform const& orig_image_transform, Params& params)
 {
     if (!params.dewarpingParams().isValid())
@@ -572,7 +546,8 @@ Task::processWarpDistortion(
             )
         );
         return m_ptrNextTask->process(
-                   status, accel_ops, orig_image, gray_orig_image_factory, dewarping_transform
+                   status, accel_ops, orig_image, gray_orig_image_factory,
+                   gray_pyramid, dewarping_transform
                );
     }
     else
@@ -587,44 +562,6 @@ Task::processWarpDistortion(
     }
 }
 
-void
-Task::cleanup(TaskStatus const& status, BinaryImage& image)
-{
-    // We don't have to clean up every piece of garbage.
-    // The only concern are the horizontal shadows, which we remove here.
-
-    BinaryImage reduced_image;
-
-    {
-        ReduceThreshold reductor(image);
-        while (reductor.image().width() >= 2000 && reductor.image().height() >= 2000)
-        {
-            reductor.reduce(2);
-        }
-        reduced_image = reductor.image();
-    }
-
-    status.throwIfCancelled();
-
-    QSize const brick(200, 14);
-    BinaryImage opened(openBrick(reduced_image, brick, BLACK));
-    reduced_image.release();
-
-    status.throwIfCancelled();
-
-    BinaryImage seed(upscaleIntegerTimes(opened, image.size(), WHITE));
-    opened.release();
-
-    status.throwIfCancelled();
-
-    BinaryImage garbage(seedFill(seed, image, CONN8));
-    seed.release();
-
-    status.throwIfCancelled();
-
-    rasterOp<RopSubtract<RopDst, RopSrc> >(image, garbage);
-}
-
 
 /*======================== Task::NoDistortionUiUpdater =====================*/
 
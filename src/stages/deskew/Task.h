@@ -35,8 +35,8 @@ class DebugImagesImpl;
 
 namespace imageproc
 {
-class BinaryImage;
 class GrayImage;
+class GrayImagePyramid;
 class AffineImageTransform;
 class AffineTransformedImage;
 };
@@ -69,6 +69,7 @@ public:
         std::shared_ptr<AcceleratableOperations> const& accel_ops,
         QImage const& orig_image,
         CachingFactory<imageproc::GrayImage> const& gray_orig_image_factory,
+        imageproc::GrayImagePyramid const& gray_pyramid,
         imageproc::AffineImageTransform const& orig_image_transform,
         OrthogonalRotation const& pre_rotation);
 private:
@@ -82,6 +83,7 @@ private:
         std::shared_ptr<AcceleratableOperations> const& accel_ops,
         QImage const& orig_image,
         CachingFactory<imageproc::GrayImage> const& gray_orig_image_factory,
+        imageproc::GrayImagePyramid const& gray_pyramid,
         imageproc::AffineImageTransform const& orig_image_transform, Params& params);
 
     FilterResultPtr processRotationDistortion(
@@ -89,6 +91,7 @@ private:
         std::shared_ptr<AcceleratableOperations> const& accel_ops,
         QImage const& orig_image,
         CachingFactory<imageproc::GrayImage> const& gray_orig_image_factory,
+        imageproc::GrayImagePyramid const& gray_pyramid,
         imageproc::AffineImageTransform const& orig_image_transform, Params& params);
 
     FilterResultPtr processPerspectiveDistortion(
@@ -96,6 +99,7 @@ private:
         std::shared_ptr<AcceleratableOperations> const& accel_ops,
         QImage const& orig_image,
         CachingFactory<imageproc::GrayImage> const& gray_orig_image_factory,
+        imageproc::GrayImagePyramid const& gray_pyramid,
         imageproc::AffineImageTransform const& orig_image_transform, Params& params);
 
     FilterResultPtr processWarpDistortion(
@@ -103,10 +107,9 @@ private:
         std::shared_ptr<AcceleratableOperations> const& accel_ops,
         QImage const& orig_image,
         CachingFactory<imageproc::GrayImage> const& gray_orig_image_factory,
+        imageproc::GrayImagePyramid const& gray_pyramid,
         imageproc::AffineImageTransform const& orig_image_transform, Params& params);
 
-    static void cleanup(TaskStatus const& status, imageproc::BinaryImage& img);
-
     IntrusivePtr<Filter> m_ptrFilter;
     IntrusivePtr<Settings> m_ptrSettings;
     IntrusivePtr<select_content::Task> m_ptrNextTask;
@@ -22,6 +22,7 @@
 #include "Settings.h"
 #include "stages/page_split/Task.h"
 #include "TaskStatus.h"
+#include "Trace.h"
 #include "ImageView.h"
 #include "FilterUiInterface.h"
 #include "imageproc/AffineImageTransform.h"
@@ -95,10 +96,13 @@ Task::process(
     std::shared_ptr<AcceleratableOperations> const& accel_ops,
     QImage const& orig_image,
     CachingFactory<imageproc::GrayImage> const& gray_orig_image_factory,
+    imageproc::GrayImagePyramid const& gray_pyramid,
     AffineImageTransform const& orig_image_transform)
 {
     // This function is executed from the worker thread.
 
+    TraceSpan const span("stage", "fix_orientation", orig_image.size());
+
     status.throwIfCancelled();
 
     OrthogonalRotation const rotation(m_ptrSettings->getRotationFor(m_imageId));
@@ -112,7 +116,7 @@ Task::process(
     if (m_ptrNextTask)
     {
         return m_ptrNextTask->process(
-                   status, accel_ops, orig_image, gray_orig_image_factory,
+                   status, accel_ops, orig_image, gray_orig_image_factory, gray_pyramid,
                    rotated_transform, rotation
                );
     }
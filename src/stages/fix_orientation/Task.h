@@ -39,6 +39,7 @@ class Task;
 namespace imageproc
 {
 class GrayImage;
+class GrayImagePyramid;
 }
 
 namespace fix_orientation
@@ -65,6 +66,7 @@ public:
         std::shared_ptr<AcceleratableOperations> const& accel_ops,
         QImage const& orig_image,
         CachingFactory<imageproc::GrayImage> const& gray_orig_image_factory,
+        imageproc::GrayImagePyramid const& gray_pyramid,
         imageproc::AffineImageTransform const& orig_image_transform);
 private:
     class UiUpdater;
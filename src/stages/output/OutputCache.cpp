@@ -0,0 +1,390 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "OutputCache.h"
+#include "Params.h"
+#include "ColorParams.h"
+#include "MetricsOptions.h"
+#include "AtomicFileOverwriter.h"
+#include "../../Utils.h"
+#include "RoundingHasher.h"
+#include "CommandLine.h"
+#include "TiffWriter.h"
+#include "version.h"
+#include "zones/ZoneSet.h"
+#include <QImage>
+#include <QRectF>
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryFile>
+#include <QDir>
+#include <QByteArray>
+#include <QDomDocument>
+#include <QDomElement>
+#include <QDomNamedNodeMap>
+#include <QSettings>
+#include <QStandardPaths>
+#include <QMutexLocker>
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace output
+{
+
+namespace
+{
+
+/**
+ * Hashes the pixels of an image together with the properties that
+ * end up in output files. Scan line padding is skipped, as it may
+ * contain garbage.
+ */
+void hashImage(RoundingHasher& hash, QImage const& image)
+{
+    hash << image.size() << int(image.format());
+    hash << image.dotsPerMeterX() << image.dotsPerMeterY();
+    for (QRgb const rgb : image.colorTable())
+    {
+        hash << unsigned(rgb);
+    }
+
+    int const bytes_per_line = (image.width() * image.depth() + 7) / 8;
+    for (int y = 0; y < image.height(); ++y)
+    {
+        hash << QByteArray::fromRawData(
+                 reinterpret_cast<char const*>(image.constScanLine(y)), bytes_per_line
+             );
+    }
+}
+
+/**
+ * Hashes an XML element in a canonical form. QDomDocument::toByteArray()
+ * won't do, as the order it writes attributes in may change from run to run.
+ */
+void hashElement(RoundingHasher& hash, QDomElement const& el)
+{
+    hash << "<" << el.tagName().toUtf8();
+
+    std::vector<std::pair<QString, QString>> attrs;
+    QDomNamedNodeMap const attr_map(el.attributes());
+    for (int i = 0; i < attr_map.count(); ++i)
+    {
+        QDomNode const attr(attr_map.item(i));
+        attrs.emplace_back(attr.nodeName(), attr.nodeValue());
+    }
+    std::sort(attrs.begin(), attrs.end());
+    for (auto const& attr : attrs)
+    {
+        hash << " " << attr.first.toUtf8() << "=" << attr.second.toUtf8();
+    }
+    hash << ">";
+
+    for (QDomNode node(el.firstChild()); !node.isNull(); node = node.nextSibling())
+    {
+        if (node.isElement())
+        {
+            hashElement(hash, node.toElement());
+        }
+        else if (node.isText())
+        {
+            hash << node.nodeValue().toUtf8();
+        }
+    }
+
+    hash << "</>";
+}
+
+bool copyData(QFile& src, QIODevice& dst)
+{
+    QByteArray buf;
+    while (!(buf = src.read(1 << 20)).isEmpty())
+    {
+        if (dst.write(buf) != buf.size())
+        {
+            return false;
+        }
+    }
+
+    return src.error() == QFile::NoError;
+}
+
+bool copyFile(QString const& from, QString const& to)
+{
+    QFile src(from);
+    if (!src.open(QIODevice::ReadOnly))
+    {
+        return false;
+    }
+
+    AtomicFileOverwriter overwriter;
+    QIODevice* const dst = overwriter.startWriting(to);
+    if (!dst || !copyData(src, *dst))
+    {
+        return false;
+    }
+
+    return overwriter.commit();
+}
+
+/**
+ * Copies a file under a unique temporary name next to \p target_path.
+ *
+ * \return The path of the copy, or an empty string on failure.
+ */
+QString copyToTempFile(QString const& from, QString const& target_path)
+{
+    QFile src(from);
+    if (!src.open(QIODevice::ReadOnly))
+    {
+        return QString();
+    }
+
+    QString temp_path;
+    bool ok = false;
+    {
+        // Destroyed before renaming, see AtomicFileOverwriter::commit().
+        QTemporaryFile dst(target_path);
+        dst.setAutoRemove(false);
+        if (!dst.open())
+        {
+            return QString();
+        }
+        temp_path = dst.fileName();
+        ok = copyData(src, dst);
+    }
+
+    if (!ok)
+    {
+        QFile::remove(temp_path);
+        return QString();
+    }
+
+    return temp_path;
+}
+
+bool writeMetrics(QString const& file_path, MetricsOptions const& metrics)
+{
+    QDomDocument doc;
+    doc.appendChild(metrics.toXml(doc, "metrics"));
+    QByteArray const data(doc.toByteArray());
+
+    AtomicFileOverwriter overwriter;
+    QIODevice* const dst = overwriter.startWriting(file_path);
+    if (!dst || dst->write(data) != data.size())
+    {
+        return false;
+    }
+
+    return overwriter.commit();
+}
+
+} // anonymous namespace
+
+OutputCache&
+OutputCache::instance()
+{
+    static OutputCache cache;
+    return cache;
+}
+
+OutputCache::OutputCache()
+{
+    QString const default_dir(
+        QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QStringLiteral("/output")
+    );
+
+    QSettings settings;
+    m_cacheDir = settings.value("settings/output_cache_dir", default_dir).toString();
+    m_maxBytes = settings.value("settings/output_cache_size_mb", 1024).toLongLong() << 20;
+    if (m_cacheDir.isEmpty())
+    {
+        m_maxBytes = 0;
+    }
+}
+
+QString
+OutputCache::key(
+    QImage const& orig_image, QString const& transform_fingerprint,
+    QRectF const& content_rect, QRectF const& outer_rect,
+    Params const& params, ZoneSet const& picture_zones, ZoneSet const& fill_zones)
+{
+    RoundingHasher hash(QCryptographicHash::Sha1);
+
+    // Different versions may well produce different output.
+    hash << "OutputCache-1 " << VERSION;
+
+    // So do different TIFF encoding options.
+    for (bool const bitonal : { false, true })
+    {
+        TiffWriter::Options const& tiff = CommandLine::get().getTiffOptions(bitonal);
+        hash << int(tiff.codec) << int(tiff.predictor) << tiff.quality << tiff.rowsPerStrip;
+    }
+
+    hashImage(hash, orig_image);
+    hash << transform_fingerprint.toUtf8();
+    hash << content_rect << outer_rect;
+
+    ColorParams color_params(params.colorParams());
+    color_params.setMetricsOptions(MetricsOptions());
+    Params input_params(params);
+    input_params.setColorParams(color_params);
+
+    QDomDocument doc;
+    hashElement(hash, input_params.toXml(doc, "params"));
+    hashElement(hash, picture_zones.toXml(doc, "picture-zones"));
+    hashElement(hash, fill_zones.toXml(doc, "fill-zones"));
+
+    return QString::fromUtf8(hash.result().toHex());
+}
+
+bool
+OutputCache::fetch(
+    QString const& key, QString const& out_file_path,
+    QString const& automask_file_path, QString const& speckles_file_path,
+    MetricsOptions& metrics)
+{
+    if (!isEnabled())
+    {
+        return false;
+    }
+
+    QString const metrics_path(entryPath(key, ".xml"));
+    QDomDocument doc;
+    {
+        QFile file(metrics_path);
+        if (!file.open(QIODevice::ReadOnly) || !doc.setContent(&file))
+        {
+            return false;
+        }
+    }
+
+    // Check that everything we need is there before copying anything.
+    std::vector<std::pair<QString, QString>> copies;
+    copies.emplace_back(entryPath(key, ".tif"), out_file_path);
+    if (!automask_file_path.isEmpty())
+    {
+        copies.emplace_back(entryPath(key, ".automask.tif"), automask_file_path);
+    }
+    if (!speckles_file_path.isEmpty())
+    {
+        copies.emplace_back(entryPath(key, ".speckles.tif"), speckles_file_path);
+    }
+    for (auto const& copy : copies)
+    {
+        if (!QFile::exists(copy.first))
+        {
+            return false;
+        }
+    }
+
+    for (auto const& copy : copies)
+    {
+        if (!copyFile(copy.first, copy.second))
+        {
+            return false;
+        }
+    }
+
+    metrics = MetricsOptions(doc.documentElement());
+
+    // Rewriting the metrics file marks the entry as recently used.
+    QMutexLocker const locker(&m_mutex);
+    writeMetrics(metrics_path, metrics);
+
+    return true;
+}
+
+void
+OutputCache::store(
+    QString const& key, QString const& out_file_path,
+    QString const& automask_file_path, QString const& speckles_file_path,
+    MetricsOptions const& metrics)
+{
+    if (!isEnabled())
+    {
+        return;
+    }
+
+    std::vector<std::pair<QString, QString>> copies;
+    copies.emplace_back(out_file_path, entryPath(key, ".tif"));
+    if (!automask_file_path.isEmpty())
+    {
+        copies.emplace_back(automask_file_path, entryPath(key, ".automask.tif"));
+    }
+    if (!speckles_file_path.isEmpty())
+    {
+        copies.emplace_back(speckles_file_path, entryPath(key, ".speckles.tif"));
+    }
+
+    // An entry that doesn't fit would be evicted right away.
+    qint64 entry_bytes = 0;
+    for (auto const& copy : copies)
+    {
+        entry_bytes += QFileInfo(copy.first).size();
+    }
+    if (entry_bytes > m_maxBytes || !QDir().mkpath(m_cacheDir))
+    {
+        return;
+    }
+
+    // Copying is done without holding the lock, under temporary names.
+    std::vector<QString> temp_paths;
+    for (auto const& copy : copies)
+    {
+        QString const temp_path(copyToTempFile(copy.first, copy.second));
+        if (temp_path.isEmpty())
+        {
+            break;
+        }
+        temp_paths.push_back(temp_path);
+    }
+
+    QMutexLocker const locker(&m_mutex);
+
+    bool ok = temp_paths.size() == copies.size();
+    if (ok)
+    {
+        // The metrics file goes last, as it's what marks an entry as complete.
+        QFile::remove(entryPath(key, ".xml"));
+        for (size_t i = 0; i < copies.size(); ++i)
+        {
+            ok = ok && ::Utils::overwritingRename(temp_paths[i], copies[i].second);
+        }
+        ok = ok && writeMetrics(entryPath(key, ".xml"), metrics);
+    }
+
+    for (QString const& temp_path : temp_paths)
+    {
+        // Whatever wasn't renamed into place.
+        QFile::remove(temp_path);
+    }
+
+    if (ok)
+    {
+        ::Utils::trimCacheDir(m_cacheDir, m_maxBytes);
+    }
+}
+
+QString
+OutputCache::entryPath(QString const& key, char const* suffix) const
+{
+    return m_cacheDir + QChar('/') + key + QLatin1String(suffix);
+}
+
+} // namespace output
@@ -0,0 +1,119 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OUTPUT_OUTPUT_CACHE_H_
+#define OUTPUT_OUTPUT_CACHE_H_
+
+#include "NonCopyable.h"
+#include <QString>
+#include <QMutex>
+
+class QImage;
+class QRectF;
+class ZoneSet;
+
+namespace output
+{
+
+class Params;
+class MetricsOptions;
+
+/**
+ * \brief An on-disk cache of finished output files, shared across projects.
+ *
+ * Entries are addressed by a hash of everything that affects the output:
+ * the pixels of the original image, the transform fingerprint, the content
+ * and outer rectangles, the non-derived output parameters and the zones.
+ * Nothing project-specific goes into the key, so moving a project, starting
+ * a new one from the same images, or toggling a parameter back and forth
+ * all lead to cache hits.
+ *
+ * An entry consists of the output image, optionally the automask and
+ * speckles images, plus an XML file with the metrics computed during
+ * generation. The XML file is written last, and it's rewritten whenever
+ * the entry is fetched, which makes it the last-used time for LRU eviction.
+ *
+ * The cache location and size limit come from the "settings/output_cache_dir"
+ * and "settings/output_cache_size_mb" keys. They are read once, when the
+ * cache is first accessed. A size limit of zero disables the cache.
+ */
+class OutputCache
+{
+    DECLARE_NON_COPYABLE(OutputCache)
+public:
+    /** \brief Returns the process-wide instance. */
+    static OutputCache& instance();
+
+    bool isEnabled() const
+    {
+        return m_maxBytes > 0;
+    }
+
+    /**
+     * \brief Computes the key of an output image.
+     *
+     * The metrics options that are part of \p params are the results of
+     * output generation rather than its inputs, so they are ignored.
+     */
+    static QString key(
+        QImage const& orig_image, QString const& transform_fingerprint,
+        QRectF const& content_rect, QRectF const& outer_rect,
+        Params const& params, ZoneSet const& picture_zones, ZoneSet const& fill_zones);
+
+    /**
+     * \brief Copies a cached entry to the given locations.
+     *
+     * \param key The key returned by key().
+     * \param out_file_path Where to put the output image.
+     * \param automask_file_path Where to put the automask, or an empty string
+     *        if it's not needed.
+     * \param speckles_file_path Where to put the speckles image, or an empty
+     *        string if it's not needed.
+     * \param metrics Receives the metrics stored with the entry.
+     * \return true on success, false if there is no complete entry or
+     *         copying failed.
+     */
+    bool fetch(QString const& key, QString const& out_file_path,
+               QString const& automask_file_path, QString const& speckles_file_path,
+               MetricsOptions& metrics);
+
+    /**
+     * \brief Stores freshly written output files under the given key.
+     *
+     * Pass an empty string for files that weren't written. Entries larger
+     * than the size limit aren't stored. Evicts the least recently used
+     * entries if the size limit is exceeded.
+     */
+    void store(QString const& key, QString const& out_file_path,
+               QString const& automask_file_path, QString const& speckles_file_path,
+               MetricsOptions const& metrics);
+private:
+    OutputCache();
+
+    QString entryPath(QString const& key, char const* suffix) const;
+
+    QString m_cacheDir;
+    qint64 m_maxBytes;
+
+    /** Serializes stores and evictions within this process. */
+    QMutex m_mutex;
+};
+
+} // namespace output
+
+#endif
@@ -52,10 +52,13 @@
 #include "PictureLayerProperty.h"
 #include "FillColorProperty.h"
 #include "Grid.h"
+#include "StageCache.h"
+#include "Trace.h"
 #include "dewarping/DistortionModel.h"
 #include "imageproc/AffineImageTransform.h"
 #include "imageproc/AffineTransform.h"
 #include "imageproc/GrayImage.h"
+#include "imageproc/GrayFilterChain.h"
 #include "imageproc/BinaryImage.h"
 #include "imageproc/BinaryThreshold.h"
 #include "imageproc/Binarize.h"
@@ -281,6 +284,8 @@ OutputGenerator::process(
     imageproc::BinaryImage* out_speckles_image,
     DebugImages* const dbg)
 {
+    TraceSpan const span("output", "process", m_outRect.size());
+
     assert(!orig_image.isNull());
 
     if (m_contentRect.isEmpty())
@@ -318,8 +323,24 @@ OutputGenerator::process(
                                   );
     QColor const bg_color(dominant_gray, dominant_gray, dominant_gray);
 
+    QString const transformed_key(
+        m_sourceKey.isEmpty() ? QString() :
+        QStringLiteral("%1|%2|%3,%4,%5x%6|%7").arg(
+            m_sourceKey, m_ptrImageTransform->fingerprint(),
+            QString::number(m_outRect.x()), QString::number(m_outRect.y()),
+            QString::number(m_outRect.width()), QString::number(m_outRect.height()),
+            QString::number(bg_color.rgba(), 16)
+        )
+    );
     QImage transformed_image(
-        m_ptrImageTransform->materialize(orig_image, m_outRect, bg_color, accel_ops)
+        StageCache::instance().getOrCompute(
+            QStringLiteral("output/transformed-1"), transformed_key,
+            StageCache::MEMORY_AND_DISK, [&]()
+    {
+        TraceSpan const span("output", "materialize", m_outRect.size());
+        return m_ptrImageTransform->materialize(orig_image, m_outRect, bg_color, accel_ops);
+    }
+        )
     );
     if (transformed_image.hasAlphaChannel())
     {
@@ -799,6 +820,8 @@ OutputGenerator::estimateBinarizationMask(
     DebugImages* const dbg,
     float const coef) const
 {
+    TraceSpan const span("output", "estimateBinarizationMask", gray_source.size());
+
     QSize const downscaled_size(gray_source.size().scaled(1600, 1600, Qt::KeepAspectRatio));
     GrayImage downscaled(scaleToGray(gray_source, downscaled_size));
 
@@ -1120,6 +1143,8 @@ OutputGenerator::smoothToGrayscale(
     QImage const& src,
     std::shared_ptr<AcceleratableOperations> const& accel_ops)
 {
+    TraceSpan const span("output", "smoothToGrayscale", src.size());
+
     int const min_dim = std::min(src.width(), src.height());
     int window;
     int degree;
@@ -1160,6 +1185,8 @@ OutputGenerator::adjustThreshold(BinaryThreshold threshold) const
 BinaryImage
 OutputGenerator::binarize(QImage const& image, BinaryImage const& mask) const
 {
+    TraceSpan const span("output", "binarize", image.size());
+
     BlackWhiteOptions const& black_white_options = m_colorParams.blackWhiteOptions();
     BinaryImage binarized;
     if ((image.format() == QImage::Format_Mono) || (image.format() == QImage::Format_MonoLSB))
@@ -1325,53 +1352,149 @@ OutputGenerator::colored(
     TaskStatus const& status,
     DebugImages* const dbg)
 {
+    TraceSpan const span("output", "colored", image.size());
+
     // Color filters begin
     GrayImage gout = GrayImage(image);
     if (!gout.isNull())
     {
-        grayCurveFilterInPlace(gout, color_options.curveCoef());
+        // Pointwise steps are fused into a single lookup table, and
+        // steps with a bounded neighbourhood are run on tiles, in parallel.
+        // The rest are run on the whole image, in the same order as ever.
+        GrayFilterChain filters;
 
-        graySqrFilterInPlace(gout, color_options.sqrCoef());
+        float const curve_coef = color_options.curveCoef();
+        if (curve_coef != 0.0f)
+        {
+            filters.addHistogramTable(
+                [curve_coef](unsigned char* table, uint64_t const* histogram)
+                {
+                    grayCurveFilterTable(table, histogram, curve_coef);
+                }
+            );
+        }
 
-        grayRISundefectInPlace(gout, color_options.RISundefectSize(), color_options.RISundefectCoef());
+        float const sqr_coef = color_options.sqrCoef();
+        if (sqr_coef != 0.0f)
+        {
+            unsigned char table[256];
+            graySqrFilterTable(table, sqr_coef);
+            filters.addTable(table);
+        }
 
-        grayAutoLevelInPlace(gout, color_options.autoLevelSize(), color_options.autoLevelCoef());
+        filters.addGlobal([&color_options](GrayImage& img)
+        {
+            grayRISundefectInPlace(img, color_options.RISundefectSize(), color_options.RISundefectCoef());
+        });
 
-        grayBalanceInPlace(gout, color_options.balanceSize(), color_options.balanceCoef());
+        filters.addGlobal([&color_options](GrayImage& img)
+        {
+            grayAutoLevelInPlace(img, color_options.autoLevelSize(), color_options.autoLevelCoef());
+        });
 
-        grayOverBlurInPlace(gout, color_options.overblurSize(), color_options.overblurCoef());
+        filters.addGlobal([&color_options](GrayImage& img)
+        {
+            grayBalanceInPlace(img, color_options.balanceSize(), color_options.balanceCoef());
+        });
 
-        grayRetinexInPlace(gout, color_options.retinexSize(), color_options.retinexCoef());
+        filters.addGlobal([&color_options](GrayImage& img)
+        {
+            grayOverBlurInPlace(img, color_options.overblurSize(), color_options.overblurCoef());
+        });
 
-        graySubtractBGInPlace(gout, color_options.subtractbgSize(), color_options.subtractbgCoef());
+        filters.addGlobal([&color_options](GrayImage& img)
+        {
+            grayRetinexInPlace(img, color_options.retinexSize(), color_options.retinexCoef());
+        });
 
-        grayEqualizeInPlace(gout, color_options.equalizeSize(), color_options.equalizeCoef());
+        filters.addGlobal([&color_options](GrayImage& img)
+        {
+            graySubtractBGInPlace(img, color_options.subtractbgSize(), color_options.subtractbgCoef());
+        });
 
-        grayWienerInPlace(gout, color_options.wienerSize(), (255.0f * color_options.wienerCoef() * color_options.wienerCoef()));
+        filters.addGlobal([&color_options](GrayImage& img)
+        {
+            grayEqualizeInPlace(img, color_options.equalizeSize(), color_options.equalizeCoef());
+        });
 
-        grayKnnDenoiserInPlace(gout, color_options.knndRadius(), color_options.knndCoef());
+        filters.addGlobal([&color_options](GrayImage& img)
+        {
+            grayWienerInPlace(img, color_options.wienerSize(), (255.0f * color_options.wienerCoef() * color_options.wienerCoef()));
+        });
 
-        grayEMDenoiserInPlace(gout, color_options.emdRadius(), color_options.emdCoef());
+        if ((color_options.knndRadius() > 0) && (color_options.knndCoef() > 0.0))
+        {
+            filters.addLocal(
+                color_options.knndRadius(),
+                [&color_options](GrayImage& img)
+                {
+                    grayKnnDenoiserInPlace(img, color_options.knndRadius(), color_options.knndCoef());
+                }
+            );
+        }
+
+        filters.addGlobal([&color_options](GrayImage& img)
+        {
+            grayEMDenoiserInPlace(img, color_options.emdRadius(), color_options.emdCoef());
+        });
+
+        if ((color_options.cdespeckleRadius() > 0) && (color_options.cdespeckleCoef() != 0.0))
+        {
+            filters.addLocal(
+                color_options.cdespeckleRadius(),
+                [&color_options](GrayImage& img)
+                {
+                    grayDespeckleInPlace(img, color_options.cdespeckleRadius(), color_options.cdespeckleCoef());
+                }
+            );
+        }
 
-        grayDespeckleInPlace(gout, color_options.cdespeckleRadius(), color_options.cdespeckleCoef());
+        filters.addGlobal([&color_options](GrayImage& img)
+        {
+            graySigmaInPlace(img, color_options.sigmaSize(), color_options.sigmaCoef());
+        });
 
-        graySigmaInPlace(gout, color_options.sigmaSize(), color_options.sigmaCoef());
+        filters.addGlobal([&color_options](GrayImage& img)
+        {
+            grayBlurInPlace(img, color_options.blurSize(), color_options.blurCoef());
+        });
 
-        grayBlurInPlace(gout, color_options.blurSize(), color_options.blurCoef());
+        filters.addGlobal([&color_options](GrayImage& img)
+        {
+            grayScreenInPlace(img, color_options.screenSize(), color_options.screenCoef());
+        });
 
-        grayScreenInPlace(gout, color_options.screenSize(), color_options.screenCoef());
+        filters.addGlobal([&color_options](GrayImage& img)
+        {
+            grayEdgeDivInPlace(img, color_options.edgedivSize(), color_options.edgedivCoef(), color_options.edgedivCoef());
+        });
 
-        grayEdgeDivInPlace(gout, color_options.edgedivSize(), color_options.edgedivCoef(), color_options.edgedivCoef());
+        filters.addGlobal([&color_options](GrayImage& img)
+        {
+            grayRobustInPlace(img, color_options.robustSize(), color_options.robustCoef());
+        });
 
-        grayRobustInPlace(gout, color_options.robustSize(), color_options.robustCoef());
+        filters.addGlobal([&color_options](GrayImage& img)
+        {
+            grayGrainInPlace(img, color_options.grainSize(), color_options.grainCoef());
+        });
 
-        grayGrainInPlace(gout, color_options.grainSize(), color_options.grainCoef());
+        filters.addGlobal([&color_options](GrayImage& img)
+        {
+            grayComixInPlace(img, color_options.comixSize(), color_options.comixCoef());
+        });
 
-        grayComixInPlace(gout, color_options.comixSize(), color_options.comixCoef());
+        filters.addGlobal([&color_options](GrayImage& img)
+        {
+            grayGravureInPlace(img, color_options.gravureSize(), color_options.gravureCoef());
+        });
 
-        grayGravureInPlace(gout, color_options.gravureSize(), color_options.gravureCoef());
+        filters.addGlobal([&color_options](GrayImage& img)
+        {
+            grayDots8InPlace(img, color_options.dots8Size(), color_options.dots8Coef());
+        });
 
-        grayDots8InPlace(gout, color_options.dots8Size(), color_options.dots8Coef());
+        filters.apply(gout);
 
         double const norm_coef = color_options.normalizeCoef();
         if (norm_coef > 0.0)
@@ -1457,6 +1580,8 @@ OutputGenerator::maybeDespeckleInPlace(
     TaskStatus const& status,
     DebugImages* dbg) const
 {
+    TraceSpan const span("output", "maybeDespeckleInPlace", image.size());
+
     if (out_speckles_img)
     {
         *out_speckles_img = image;
@@ -1483,6 +1608,8 @@ OutputGenerator::morphologicalSmoothInPlace(
     BinaryImage& bin_img,
     std::shared_ptr<AcceleratableOperations> const& accel_ops)
 {
+    TraceSpan const span("output", "morphologicalSmoothInPlace", bin_img.size());
+
     std::vector<Grid<char>> patterns;
 
     // When removing black noise, remove small ones first.
@@ -29,6 +29,7 @@
 #include <QRect>
 #include <QTransform>
 #include <QColor>
+#include <QString>
 #include <QPointF>
 #include <QLineF>
 #include <QPolygonF>
@@ -129,6 +130,17 @@ public:
      */
     std::function<QPointF(QPointF const&)> outputToOrigMapper() const;
 
+    /**
+     * \brief Identifies the original image for caching purposes.
+     *
+     * If set, typically to StageCache::sourceKey(), the original image
+     * transformed into output space gets cached between runs.
+     */
+    void setSourceKey(QString const& source_key)
+    {
+        m_sourceKey = source_key;
+    }
+
     MetricsOptions metrics;
 
 private:
@@ -251,6 +263,8 @@ private:
      */
     QRect m_outRect;
 
+    QString m_sourceKey;
+
     /**
      * The content rectangle in output image coordinates. That is, if there are
      * no margins, m_contentRect is going to be:
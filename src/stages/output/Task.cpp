@@ -37,10 +37,13 @@
 #include "OutputParams.h"
 #include "OutputImageParams.h"
 #include "OutputFileParams.h"
+#include "OutputCache.h"
+#include "MetricsOptions.h"
 #include "OutputMargins.h"
 #include "RenderParams.h"
 #include "FilterUiInterface.h"
 #include "TaskStatus.h"
+#include "Trace.h"
 #include "BasicImageView.h"
 #include "ImageViewTab.h"
 #include "TabbedImageView.h"
@@ -58,6 +61,7 @@
 #include "ThumbnailPixmapCache.h"
 #include "DebugImagesImpl.h"
 #include "OutputGenerator.h"
+#include "StageCache.h"
 #include "CachingFactory.h"
 #include "TiffWriter.h"
 #include "ImageLoader.h"
@@ -155,6 +159,8 @@ Task::process(
     std::shared_ptr<AbstractImageTransform const> const& orig_image_transform,
     QRectF const& content_rect, QRectF const& outer_rect)
 {
+    TraceSpan const span("stage", "output", orig_image.size());
+
     double const scaling_factor = m_ptrSettings->scalingFactor();
     std::shared_ptr<AbstractImageTransform> const scaled_transform(orig_image_transform->clone());
     QTransform const post_scale_xform(scaled_transform->scale(scaling_factor, scaling_factor));
@@ -200,6 +206,8 @@ Task::processScaled(
     OutputGenerator generator(
         orig_image_transform, content_rect, outer_rect, params
     );
+    QString const source_key(StageCache::sourceKey(m_pageId.imageId()));
+    generator.setSourceKey(source_key);
 
     OutputImageParams new_output_image_params(
         orig_image_transform->fingerprint(),
@@ -289,6 +297,52 @@ Task::processScaled(
     BinaryImage automask_img;
     BinaryImage speckles_img;
 
+    // Even in batch processing mode we should still write automask, because it
+    // will be needed when we view the results back in interactive mode.
+    // The same applies even more to speckles file, as we need it not only
+    // for visualization purposes, but also for re-doing despeckling at
+    // different levels without going through the whole output generation process.
+    bool const write_automask = render_params.mixedOutput();
+    bool const write_speckles_file = params.despeckleLevel() != DESPECKLE_OFF &&
+                                     params.colorParams().colorMode() != ColorParams::COLOR_GRAYSCALE;
+
+    OutputCache& output_cache = OutputCache::instance();
+    auto const make_cache_key = [&]()
+    {
+        return OutputCache::key(
+                   orig_image, orig_image_transform->fingerprint(),
+                   content_rect, outer_rect, params,
+                   new_picture_zones, new_fill_zones
+               );
+    };
+    QString cache_key;
+    MetricsOptions cached_metrics;
+    bool from_cache = false;
+
+    if (need_reprocess && output_cache.isEnabled())
+    {
+        // The same output may have been generated before, possibly
+        // by a different project. If so, the cached files are put in
+        // place and then loaded as if they were never out of date.
+        cache_key = make_cache_key();
+
+        if (write_automask)
+        {
+            // See the comments on creating automask_dir below.
+            QDir().mkdir(automask_dir);
+        }
+        if (!write_speckles_file || QDir().mkpath(speckles_dir))
+        {
+            from_cache = output_cache.fetch(
+                             cache_key, out_file_path,
+                             write_automask ? automask_file_path : QString(),
+                             write_speckles_file ? speckles_file_path : QString(),
+                             cached_metrics
+                         );
+            need_reprocess = !from_cache;
+        }
+    }
+
     if (!need_reprocess)
     {
         QFile out_file(out_file_path);
@@ -319,17 +373,52 @@ Task::processScaled(
         }
     }
 
-    if (need_reprocess)
+    // Whether out_img was generated or fetched from the cache, this
+    // stores its metrics and output params, and updates its thumbnail.
+    auto const update_page = [&](MetricsOptions const& metrics, bool const files_written)
+    {
+        Params const page_params(m_ptrSettings->getParams(m_pageId));
+        ColorParams color_params(page_params.colorParams());
+        color_params.setMetricsOptions(metrics);
+        m_ptrSettings->setColorParams(m_pageId, color_params);
+        OptionsWidget* const opt_widget = m_ptrFilter->optionsWidget();
+        opt_widget->preUpdateUI(m_pageId);
+
+        if (!files_written)
+        {
+            m_ptrSettings->removeOutputParams(m_pageId);
+        }
+        else
+        {
+            // Note that we can't reuse *_file_info objects
+            // as we've just overwritten those files.
+            OutputParams const out_params(
+                new_output_image_params,
+                OutputFileParams(QFileInfo(out_file_path)),
+                write_automask ? OutputFileParams(QFileInfo(automask_file_path))
+                : OutputFileParams(),
+                write_speckles_file ? OutputFileParams(QFileInfo(speckles_file_path))
+                : OutputFileParams(),
+                new_picture_zones, new_fill_zones
+            );
+
+            m_ptrSettings->setOutputParams(m_pageId, out_params);
+        }
+
+        m_ptrThumbnailCache->recreateThumbnail(
+            PageId(ImageId(out_file_path)),
+            out_img, AffineImageTransform(generator.outputImageSize())
+        );
+    };
+
+    if (from_cache && !need_reprocess)
     {
-        // Even in batch processing mode we should still write automask, because it
-        // will be needed when we view the results back in interactive mode.
-        // The same applies even more to speckles file, as we need it not only
-        // for visualization purposes, but also for re-doing despeckling at
-        // different levels without going through the whole output generation process.
-        bool const write_automask = render_params.mixedOutput();
-        bool const write_speckles_file = params.despeckleLevel() != DESPECKLE_OFF &&
-                                         params.colorParams().colorMode() != ColorParams::COLOR_GRAYSCALE;
+        deleteMutuallyExclusiveOutputFiles();
+        update_page(cached_metrics, true);
+    }
 
+    if (need_reprocess)
+    {
         automask_img = BinaryImage();
         speckles_img = BinaryImage();
 
@@ -340,12 +429,6 @@ Task::processScaled(
                       write_speckles_file ? &speckles_img : nullptr,
                       m_ptrDbg.get()
                   );
-        Params params = m_ptrSettings->getParams(m_pageId);
-        ColorParams color_params(params.colorParams());
-        color_params.setMetricsOptions(generator.metrics);
-        m_ptrSettings->setColorParams(m_pageId, color_params);
-        OptionsWidget* const opt_widget = m_ptrFilter->optionsWidget();
-        opt_widget->preUpdateUI(m_pageId);
 
         if (write_speckles_file && speckles_img.isNull())
         {
@@ -357,7 +440,10 @@ Task::processScaled(
 
         bool invalidate_params = false;
 
-        if (!TiffWriter::writeImage(out_file_path, out_img))
+        CommandLine const& cli = CommandLine::get();
+        bool const bitonal_output = (out_img.format() == QImage::Format_Mono ||
+                                     out_img.format() == QImage::Format_MonoLSB);
+        if (!TiffWriter::writeImage(out_file_path, out_img, cli.getTiffOptions(bitonal_output)))
         {
             invalidate_params = true;
         }
@@ -376,7 +462,8 @@ Task::processScaled(
             // Also note that QDir::mkdir() will fail if the directory already exists,
             // so we ignore its return value here.
 
-            if (!TiffWriter::writeImage(automask_file_path, automask_img.toQImage()))
+            if (!TiffWriter::writeImage(
+                        automask_file_path, automask_img.toQImage(), cli.getTiffOptions(true)))
             {
                 invalidate_params = true;
             }
@@ -387,37 +474,28 @@ Task::processScaled(
             {
                 invalidate_params = true;
             }
-            else if (!TiffWriter::writeImage(speckles_file_path, speckles_img.toQImage()))
+            else if (!TiffWriter::writeImage(
+                             speckles_file_path, speckles_img.toQImage(), cli.getTiffOptions(true)))
             {
                 invalidate_params = true;
             }
         }
 
-        if (invalidate_params)
-        {
-            m_ptrSettings->removeOutputParams(m_pageId);
-        }
-        else
+        update_page(generator.metrics, !invalidate_params);
+
+        if (!invalidate_params && output_cache.isEnabled())
         {
-            // Note that we can't reuse *_file_info objects
-            // as we've just overwritten those files.
-            OutputParams const out_params(
-                new_output_image_params,
-                OutputFileParams(QFileInfo(out_file_path)),
-                write_automask ? OutputFileParams(QFileInfo(automask_file_path))
-                : OutputFileParams(),
-                write_speckles_file ? OutputFileParams(QFileInfo(speckles_file_path))
-                : OutputFileParams(),
-                new_picture_zones, new_fill_zones
+            if (cache_key.isEmpty())
+            {
+                cache_key = make_cache_key();
+            }
+            output_cache.store(
+                cache_key, out_file_path,
+                write_automask ? automask_file_path : QString(),
+                write_speckles_file ? speckles_file_path : QString(),
+                generator.metrics
             );
-
-            m_ptrSettings->setOutputParams(m_pageId, out_params);
         }
-
-        m_ptrThumbnailCache->recreateThumbnail(
-            PageId(ImageId(out_file_path)),
-            out_img, AffineImageTransform(generator.outputImageSize())
-        );
     }
 
     DespeckleState const despeckle_state(
@@ -444,7 +522,19 @@ Task::processScaled(
     {
         return orig_image_transform->materialize(orig_image, out_rect, Qt::transparent, accel_ops);
     };
-    auto cached_transform_orig_image = cachingFactory<QImage>(transform_orig_image);
+    QString const transformed_orig_key(
+        source_key.isEmpty() ? QString() :
+        QStringLiteral("%1|%2|%3,%4,%5x%6").arg(
+            source_key, orig_image_transform->fingerprint(),
+            QString::number(out_rect.x()), QString::number(out_rect.y()),
+            QString::number(out_rect.width()), QString::number(out_rect.height())
+        )
+    );
+    auto cached_transform_orig_image = StageCache::instance().factory(
+                                           QStringLiteral("output/transformed-orig-1"),
+                                           transformed_orig_key, StageCache::MEMORY_AND_DISK,
+                                           transform_orig_image
+                                       );
 
     auto downscaled_transform_orig_image = [cached_transform_orig_image, accel_ops]()
     {
@@ -31,10 +31,12 @@
 #include "Utils.h"
 #include "FilterUiInterface.h"
 #include "TaskStatus.h"
+#include "Trace.h"
 #include "ImageView.h"
 #include "BasicImageView.h"
 #include "ContentBox.h"
 #include "PageLayout.h"
+#include "StageCache.h"
 #include "stages/output/Task.h"
 #include "imageproc/AffineTransformedImage.h"
 
@@ -107,6 +109,8 @@ Task::process(
     boost::optional<AffineTransformedImage> pre_transformed_image,
     ContentBox const& content_box)
 {
+    TraceSpan const span("stage", "page_layout", orig_image.size());
+
     status.throwIfCancelled();
 
     QSizeF agg_hard_size_before;
@@ -148,8 +152,9 @@ Task::process(
 
         if (!pre_transformed_image)
         {
-            pre_transformed_image = orig_image_transform->toAffine(
-                                        orig_image, Qt::transparent, accel_ops
+            pre_transformed_image = StageCache::toAffine(
+                                        m_pageId.imageId(), orig_image, *orig_image_transform,
+                                        Qt::transparent, accel_ops
                                     );
         }
 
@@ -25,7 +25,9 @@
 #include "ProjectPages.h"
 #include "DebugImages.h"
 #include "foundation/Span.h"
+#include "imageproc/AffineImageTransform.h"
 #include "imageproc/AffineTransformedImage.h"
+#include "imageproc/GrayImagePyramid.h"
 #include "imageproc/AffineTransform.h"
 #include "imageproc/Binarize.h"
 #include "imageproc/BinaryThreshold.h"
@@ -48,6 +50,7 @@
 #include <boost/foreach.hpp>
 #include <QRect>
 #include <QRectF>
+#include <QSize>
 #include <QSizeF>
 #include <QImage>
 #include <QPointF>
@@ -78,6 +81,12 @@ using namespace imageproc;
 namespace
 {
 
+/**
+ * cutAtWhitespace() downscales the image to fit this size.
+ * More details than that are of no use to us.
+ */
+QSize const MAX_WORKING_SIZE(3000, 3000);
+
 double lineCenterX(QLineF const& line)
 {
     return 0.5 * (line.p1().x() + line.p2().x());
@@ -279,6 +288,28 @@ PageLayoutEstimator::estimatePageLayout(
     return cutAtWhitespace(layout_type, image, accel_ops, dbg);
 }
 
+PageLayout
+PageLayoutEstimator::estimatePageLayout(
+    LayoutType const layout_type, GrayImagePyramid const& pyramid,
+    AffineImageTransform const& xform,
+    std::shared_ptr<AcceleratableOperations> const& accel_ops,
+    DebugImages* const dbg)
+{
+    if (layout_type == SINGLE_PAGE_UNCUT)
+    {
+        return PageLayout(xform.transformedCropArea().boundingRect());
+    }
+
+    // cutAtWhitespace() is the most demanding of the detectors.
+    AffineImageTransform downscaled_xform(xform);
+    downscaled_xform.scaleTo(MAX_WORKING_SIZE, Qt::KeepAspectRatio);
+
+    return estimatePageLayout(
+               layout_type, pyramid.levelFor(xform, downscaled_xform.transform()),
+               accel_ops, dbg
+           );
+}
+
 namespace
 {
 
@@ -414,7 +445,7 @@ PageLayoutEstimator::cutAtWhitespace(
         AffineTransformedImage const downscaled = image.withAdjustedTransform(
                     [](AffineImageTransform& xform)
         {
-            xform.scaleTo(QSize(3000, 3000), Qt::KeepAspectRatio);
+            xform.scaleTo(MAX_WORKING_SIZE, Qt::KeepAspectRatio);
             xform.translateSoThatPointBecomes(
                 xform.transformedCropArea().boundingRect().topLeft(), QPointF(0.0, 0.0)
             );
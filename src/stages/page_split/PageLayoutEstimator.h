@@ -34,7 +34,9 @@ class Span;
 
 namespace imageproc
 {
+class AffineImageTransform;
 class AffineTransformedImage;
+class GrayImagePyramid;
 }
 
 namespace imageproc
@@ -68,6 +70,21 @@ public:
         LayoutType layout_type, imageproc::AffineTransformedImage const& image,
         std::shared_ptr<AcceleratableOperations> const& accel_ops,
         DebugImages* dbg = nullptr);
+
+    /**
+     * \brief Estimates the page layout on the smallest level of a pyramid
+     *        that still has all the detail the estimation needs.
+     *
+     * \param layout_type See above.
+     * \param pyramid A grayscale pyramid of the image.
+     * \param xform A transformation of the full size image.
+     * \param dbg An optional sink for debugging images.
+     */
+    static PageLayout estimatePageLayout(
+        LayoutType layout_type, imageproc::GrayImagePyramid const& pyramid,
+        imageproc::AffineImageTransform const& xform,
+        std::shared_ptr<AcceleratableOperations> const& accel_ops,
+        DebugImages* dbg = nullptr);
 private:
     static std::unique_ptr<PageLayout> tryCutAtFoldingLine(
         LayoutType layout_type, imageproc::AffineTransformedImage const& image,
@@ -18,6 +18,7 @@
 
 #include "Task.h"
 #include "TaskStatus.h"
+#include "Trace.h"
 #include "Filter.h"
 #include "OptionsWidget.h"
 #include "Settings.h"
@@ -36,6 +37,7 @@
 #include "DebugImagesImpl.h"
 #include "imageproc/AffineTransformedImage.h"
 #include "imageproc/GrayImage.h"
+#include "imageproc/GrayImagePyramid.h"
 #include "stages/deskew/Task.h"
 #include <QImage>
 #include <QObject>
@@ -127,9 +129,12 @@ Task::process(
     std::shared_ptr<AcceleratableOperations> const& accel_ops,
     QImage const& orig_image,
     CachingFactory<imageproc::GrayImage> const& gray_orig_image_factory,
+    imageproc::GrayImagePyramid const& gray_pyramid,
     imageproc::AffineImageTransform const& orig_image_transform,
     OrthogonalRotation const& rotation)
 {
+    TraceSpan const span("stage", "page_split", orig_image.size());
+
     status.throwIfCancelled();
 
     Settings::Record record(m_ptrSettings->getPageRecord(m_pageInfo.imageId()));
@@ -147,9 +152,8 @@ Task::process(
         if (!params || !deps.compatibleWith(*params))
         {
             new_layout = PageLayoutEstimator::estimatePageLayout(
-                             record.combinedLayoutType(),
-                             AffineTransformedImage(gray_orig_image_factory(), orig_image_transform),
-                             accel_ops, m_ptrDbg.get()
+                             record.combinedLayoutType(), gray_pyramid,
+                             orig_image_transform, accel_ops, m_ptrDbg.get()
                          );
             status.throwIfCancelled();
         }
@@ -212,7 +216,7 @@ Task::process(
             )
         );
         return m_ptrNextTask->process(
-                   status, accel_ops, orig_image, gray_orig_image_factory,
+                   status, accel_ops, orig_image, gray_orig_image_factory, gray_pyramid,
                    cropping_transform, rotation
                );
     }
@@ -37,6 +37,7 @@ class QImage;
 namespace imageproc
 {
 class GrayImage;
+class GrayImagePyramid;
 class AffineImageTransform;
 class AffineTransformedImage;
 }
@@ -72,6 +73,7 @@ public:
         std::shared_ptr<AcceleratableOperations> const& accel_ops,
         QImage const& orig_image,
         CachingFactory<imageproc::GrayImage> const& gray_orig_image_factory,
+        imageproc::GrayImagePyramid const& gray_pyramid,
         imageproc::AffineImageTransform const& orig_image_transform,
         OrthogonalRotation const& rotation);
 private:
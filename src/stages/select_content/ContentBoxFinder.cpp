@@ -26,6 +26,7 @@
 #include <boost/foreach.hpp>
 #include <QRect>
 #include <QRectF>
+#include <QSize>
 #include <QPolygonF>
 #include <QImage>
 #include <QColor>
@@ -39,7 +40,9 @@
 #include "TaskStatus.h"
 #include "DebugImages.h"
 #include "Despeckle.h"
+#include "imageproc/AffineImageTransform.h"
 #include "imageproc/AffineTransformedImage.h"
+#include "imageproc/GrayImagePyramid.h"
 #include "imageproc/BinaryImage.h"
 #include "imageproc/BinaryThreshold.h"
 #include "imageproc/Binarize.h"
@@ -92,6 +95,11 @@ private:
 namespace
 {
 
+/**
+ * The image is downscaled to fit this size before looking for content.
+ */
+QSize const WORKING_SIZE(1500, 1500);
+
 struct PreferHorizontal
 {
     bool operator()(QRect const& lhs, QRect const& rhs) const
@@ -112,13 +120,49 @@ struct PreferVertical
 
 } // anonymous namespace
 
+QRectF
+ContentBoxFinder::findContentBox(TaskStatus const& status,
+                                 std::shared_ptr<AcceleratableOperations> const& accel_ops,
+                                 GrayImagePyramid const& pyramid,
+                                 AffineImageTransform const& xform, DebugImages* dbg)
+{
+    AffineImageTransform downscaled_transform(xform);
+    downscaled_transform.scaleTo(WORKING_SIZE, Qt::KeepAspectRatio);
+
+    AffineTransformedImage const level(
+        pyramid.levelFor(xform, downscaled_transform.transform())
+    );
+
+    // Downscaling averages the darkest pixels away, so take it from the
+    // full size image, which is cached by the pyramid anyway.
+    return findContentBox(
+               status, accel_ops, GrayImage(level.origImage()), level.xform(),
+               darkestGrayLevel(pyramid.level(0)), dbg
+           );
+}
+
 QRectF
 ContentBoxFinder::findContentBox(TaskStatus const& status,
                                  std::shared_ptr<AcceleratableOperations> const& accel_ops,
                                  AffineTransformedImage const& image, DebugImages* dbg)
 {
-    AffineImageTransform downscaled_transform(image.xform());
-    downscaled_transform.scaleTo(QSize(1500, 1500), Qt::KeepAspectRatio);
+    GrayImage const gray_orig_image(image.origImage());
+
+    return findContentBox(
+               status, accel_ops, gray_orig_image, image.xform(),
+               darkestGrayLevel(gray_orig_image), dbg
+           );
+}
+
+QRectF
+ContentBoxFinder::findContentBox(TaskStatus const& status,
+                                 std::shared_ptr<AcceleratableOperations> const& accel_ops,
+                                 GrayImage const& gray_orig_image,
+                                 AffineImageTransform const& xform,
+                                 unsigned char const darkest_gray_level, DebugImages* dbg)
+{
+    AffineImageTransform downscaled_transform(xform);
+    downscaled_transform.scaleTo(WORKING_SIZE, Qt::KeepAspectRatio);
 
     QRect const downscaled_rect(
         downscaled_transform.transformedCropArea().boundingRect().toRect()
@@ -128,9 +172,6 @@ ContentBoxFinder::findContentBox(TaskStatus const& status,
         return QRectF();
     }
 
-    GrayImage const gray_orig_image(image.origImage());
-
-    uint8_t const darkest_gray_level = darkestGrayLevel(gray_orig_image);
     QColor const outside_color(darkest_gray_level, darkest_gray_level, darkest_gray_level);
 
     QImage gray150(
@@ -31,9 +31,12 @@ class QRectF;
 namespace imageproc
 {
 class BinaryImage;
+class GrayImage;
 class ConnComp;
 class SEDM;
+class AffineImageTransform;
 class AffineTransformedImage;
+class GrayImagePyramid;
 }
 
 namespace select_content
@@ -47,9 +50,34 @@ public:
         std::shared_ptr<AcceleratableOperations> const& accel_ops,
         imageproc::AffineTransformedImage const& image,
         DebugImages* dbg = 0);
+
+    /**
+     * \brief Same as above, but works on the closest level of a pyramid
+     *        rather than on the full size image.
+     *
+     * \param pyramid A grayscale pyramid of the image.
+     * \param xform A transformation of the full size image.
+     */
+    static QRectF findContentBox(
+        TaskStatus const& status,
+        std::shared_ptr<AcceleratableOperations> const& accel_ops,
+        imageproc::GrayImagePyramid const& pyramid,
+        imageproc::AffineImageTransform const& xform,
+        DebugImages* dbg = 0);
 private:
     class Garbage;
 
+    /**
+     * \param darkest_gray_level The colour to fill the areas outside
+     *        of \p gray_orig_image with.
+     */
+    static QRectF findContentBox(
+        TaskStatus const& status,
+        std::shared_ptr<AcceleratableOperations> const& accel_ops,
+        imageproc::GrayImage const& gray_orig_image,
+        imageproc::AffineImageTransform const& xform,
+        unsigned char darkest_gray_level, DebugImages* dbg);
+
     static void segmentGarbage(
         imageproc::BinaryImage const& garbage,
         imageproc::BinaryImage& hor_garbage,
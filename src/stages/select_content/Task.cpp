@@ -25,13 +25,16 @@
 #include "Params.h"
 #include "Settings.h"
 #include "TaskStatus.h"
+#include "Trace.h"
 #include "ContentBoxFinder.h"
 #include "FilterUiInterface.h"
 #include "ImageView.h"
 #include "OrthogonalRotation.h"
+#include "StageCache.h"
 #include "imageproc/AbstractImageTransform.h"
 #include "imageproc/AffineImageTransform.h"
 #include "imageproc/AffineTransformedImage.h"
+#include "imageproc/GrayImagePyramid.h"
 #include "stages/page_layout/Task.h"
 #include <QObject>
 #include <QTransform>
@@ -100,8 +103,11 @@ Task::process(
     std::shared_ptr<AcceleratableOperations> const& accel_ops,
     QImage const& orig_image,
     CachingFactory<imageproc::GrayImage> const& gray_orig_image_factory,
+    imageproc::GrayImagePyramid const& gray_pyramid,
     std::shared_ptr<AbstractImageTransform const> const& orig_image_transform)
 {
+    TraceSpan const span("stage", "select_content", orig_image.size());
+
     assert(!orig_image.isNull());
     assert(orig_image_transform);
 
@@ -135,13 +141,27 @@ Task::process(
 
     if (!params.get())
     {
-        dewarped = orig_image_transform->toAffine(
-                       orig_image, Qt::transparent, accel_ops
+        dewarped = StageCache::toAffine(
+                       m_pageId.imageId(), orig_image, *orig_image_transform,
+                       Qt::transparent, accel_ops
                    );
 
-        QRectF const content_rect(
-            ContentBoxFinder::findContentBox(status, accel_ops, *dewarped, m_ptrDbg.get())
-        );
+        QRectF content_rect;
+        if (orig_image_transform->isAffine())
+        {
+            // Without dewarping, a downscaled level of the original
+            // image is as good as the full size one.
+            content_rect = ContentBoxFinder::findContentBox(
+                               status, accel_ops, gray_pyramid,
+                               orig_image_transform->toAffine(), m_ptrDbg.get()
+                           );
+        }
+        else
+        {
+            content_rect = ContentBoxFinder::findContentBox(
+                               status, accel_ops, *dewarped, m_ptrDbg.get()
+                           );
+        }
 
         params.reset(
             new Params(
@@ -166,8 +186,9 @@ Task::process(
     {
         if (!dewarped)
         {
-            dewarped = orig_image_transform->toAffine(
-                           orig_image, Qt::transparent, accel_ops
+            dewarped = StageCache::toAffine(
+                           m_pageId.imageId(), orig_image, *orig_image_transform,
+                           Qt::transparent, accel_ops
                        );
         }
 
@@ -36,6 +36,7 @@ class QImage;
 namespace imageproc
 {
 class GrayImage;
+class GrayImagePyramid;
 class AbstractImageTransform;
 }
 
@@ -66,6 +67,7 @@ public:
         std::shared_ptr<AcceleratableOperations> const& accel_ops,
         QImage const& orig_image,
         CachingFactory<imageproc::GrayImage> const& gray_orig_image_factory,
+        imageproc::GrayImagePyramid const& gray_pyramid,
         std::shared_ptr<imageproc::AbstractImageTransform const> const& orig_image_transform);
 private:
     class UiUpdater;
@@ -0,0 +1,170 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Despeckle.h"
+#include "TaskStatus.h"
+#include "PerformanceTimer.h"
+#include "imageproc/BinaryImage.h"
+#include "imageproc/BWColor.h"
+#include <QThreadPool>
+#include <QSize>
+#include <QRect>
+#include <boost/test/unit_test.hpp>
+#include <random>
+#include <algorithm>
+#include <stdio.h>
+
+namespace Tests
+{
+
+using namespace imageproc;
+
+BOOST_AUTO_TEST_SUITE(DespeckleTestSuite);
+
+#define LOG_PERFORMANCE 0
+
+namespace
+{
+
+class NoCancelStatus : public TaskStatus
+{
+public:
+    virtual void cancel() {}
+
+    virtual bool isCancelled() const
+    {
+        return false;
+    }
+
+    virtual void throwIfCancelled() const {}
+};
+
+/**
+ * Lines of glyph-sized blobs within page margins, with speckles of
+ * one to three pixels scattered over the whole page.
+ */
+BinaryImage makePage(QSize const& size, unsigned const seed)
+{
+    std::mt19937 rng(seed);
+    int const width = size.width();
+    int const height = size.height();
+    int const scale = std::max(1, width / 1240);
+
+    BinaryImage page(size, WHITE);
+    QRect const text_area(width / 10, height / 8, width * 8 / 10, height * 7 / 10);
+    for (int y = text_area.top(); y < text_area.bottom(); y += 40 * scale)
+    {
+        for (int x = text_area.left(); x < text_area.right();)
+        {
+            int const glyph_width = (8 + rng() % 14) * scale;
+            int const glyph_height = (18 + rng() % 8) * scale;
+            page.fill(QRect(x, y, glyph_width, glyph_height).intersected(page.rect()), BLACK);
+            x += glyph_width + (3 + rng() % 6) * scale;
+            if (rng() % 9 == 0)
+            {
+                // Word spacing.
+                x += 15 * scale;
+            }
+        }
+        if (rng() % 6 == 0)
+        {
+            // Paragraph spacing.
+            y += 60 * scale;
+        }
+    }
+
+    int const num_speckles = width * height / 400;
+    for (int i = 0; i < num_speckles; ++i)
+    {
+        int const speckle_size = 1 + rng() % 3;
+        QRect const speckle(rng() % width, rng() % height, speckle_size, speckle_size);
+        page.fill(speckle.intersected(page.rect()), BLACK);
+    }
+
+    return page;
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(test_independent_of_thread_count)
+{
+    // Distance propagation is done speculatively in parallel bands.
+    // Whatever the number of threads, the result must be the same.
+    NoCancelStatus const status;
+    int const orig_max_threads = QThreadPool::globalInstance()->maxThreadCount();
+
+    // DESPECKLE_CAUTIOUS, DESPECKLE_NORMAL, DESPECKLE_AGGRESSIVE.
+    double const factors[] = { 1.5, 2.5, 3.5 };
+    for (double const factor : factors)
+    {
+        BinaryImage const page(makePage(QSize(620, 1754), unsigned(factor * 10)));
+
+        QThreadPool::globalInstance()->setMaxThreadCount(1);
+        BinaryImage const serial(Despeckle::despeckle(page, factor, status));
+
+        QThreadPool::globalInstance()->setMaxThreadCount(4);
+        BinaryImage const banded(Despeckle::despeckle(page, factor, status));
+
+        BOOST_CHECK(serial != page);
+        BOOST_CHECK(serial == banded);
+    }
+
+    QThreadPool::globalInstance()->setMaxThreadCount(orig_max_threads);
+}
+
+BOOST_AUTO_TEST_CASE(test_performance)
+{
+#if LOG_PERFORMANCE
+    // A4 at 300 and 600 DPI, A3 at 600 DPI.
+    QSize const sizes[] = { QSize(2480, 3508), QSize(4960, 7016), QSize(7016, 9920) };
+#else
+    QSize const sizes[] = { QSize(620, 877) };
+#endif
+    struct Level
+    {
+        char const* name;
+        double factor;
+    };
+    Level const levels[] =
+    {
+        { "CAUTIOUS", 1.5 }, { "NORMAL", 2.5 }, { "AGGRESSIVE", 3.5 }
+    };
+
+    NoCancelStatus const status;
+    for (QSize const& size : sizes)
+    {
+        BinaryImage const page(makePage(size, size.width()));
+        for (Level const& level : levels)
+        {
+#if LOG_PERFORMANCE
+            PerformanceTimer ptimer;
+#endif
+            BinaryImage const despeckled(Despeckle::despeckle(page, level.factor, status));
+#if LOG_PERFORMANCE
+            char prefix[64];
+            sprintf(prefix, "[Despeckle] %dx%d %s:", size.width(), size.height(), level.name);
+            ptimer.print(prefix);
+#endif
+            BOOST_CHECK(despeckled.size() == size);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace Tests
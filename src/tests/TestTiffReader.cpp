@@ -0,0 +1,493 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "TiffReader.h"
+#include "PerformanceTimer.h"
+#include <QImage>
+#include <QFile>
+#include <QTemporaryFile>
+#include <QString>
+#include <QSize>
+#include <QByteArray>
+#include <QColor>
+#include <boost/test/unit_test.hpp>
+#include <tiff.h>
+#include <tiffio.h>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+namespace Tests
+{
+
+BOOST_AUTO_TEST_SUITE(TiffReaderTestSuite);
+
+#define LOG_PERFORMANCE 0
+
+namespace
+{
+
+struct PageLayout
+{
+    int width;
+    int height;
+    int bits_per_sample;
+    int samples_per_pixel;
+    int photometric;
+    int compression;
+    int tile_size; // 0 for strips
+    int orientation; // 0 to leave the tag out
+};
+
+/**
+ * Random samples, as libtiff expects them for the given layout:
+ * packed MSB first for less than 8 bits, native endian for 16 bits.
+ */
+std::vector<uint8_t> randomSamples(PageLayout const& layout, int row_bytes)
+{
+    std::mt19937 rng(layout.width * 31 + layout.bits_per_sample);
+    std::uniform_int_distribution<int> dist(0, 255);
+
+    std::vector<uint8_t> data(row_bytes * layout.height);
+    for (size_t i = 0; i < data.size(); ++i)
+    {
+        data[i] = static_cast<uint8_t>(dist(rng));
+    }
+    return data;
+}
+
+int rowBytes(PageLayout const& layout)
+{
+    return (layout.width * layout.samples_per_pixel * layout.bits_per_sample + 7) / 8;
+}
+
+int sampleAt(PageLayout const& layout, std::vector<uint8_t> const& data, int x, int y, int s)
+{
+    uint8_t const* row = &data[rowBytes(layout) * y];
+    int const idx = x * layout.samples_per_pixel + s;
+    if (layout.bits_per_sample == 16)
+    {
+        return ((uint16_t const*)row)[idx];
+    }
+    else if (layout.bits_per_sample == 8)
+    {
+        return row[idx];
+    }
+
+    int const bit = idx * layout.bits_per_sample;
+    int const shift = 8 - layout.bits_per_sample - (bit & 7);
+    return (row[bit >> 3] >> shift) & ((1 << layout.bits_per_sample) - 1);
+}
+
+void writePage(QString const& path, PageLayout const& layout, std::vector<uint8_t> const& data)
+{
+    TIFF* tif = TIFFOpen(QFile::encodeName(path).constData(), "w");
+    BOOST_REQUIRE(tif);
+
+    TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, uint32_t(layout.width));
+    TIFFSetField(tif, TIFFTAG_IMAGELENGTH, uint32_t(layout.height));
+    TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, uint16_t(layout.bits_per_sample));
+    TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, uint16_t(layout.samples_per_pixel));
+    TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, uint16_t(layout.photometric));
+    TIFFSetField(tif, TIFFTAG_COMPRESSION, uint16_t(layout.compression));
+    TIFFSetField(tif, TIFFTAG_PLANARCONFIG, uint16_t(PLANARCONFIG_CONTIG));
+    if (layout.orientation)
+    {
+        TIFFSetField(tif, TIFFTAG_ORIENTATION, uint16_t(layout.orientation));
+    }
+    if (layout.samples_per_pixel == 4)
+    {
+        uint16_t const extra = EXTRASAMPLE_UNASSALPHA;
+        TIFFSetField(tif, TIFFTAG_EXTRASAMPLES, uint16_t(1), &extra);
+    }
+
+    int const row_bytes = rowBytes(layout);
+    if (layout.tile_size == 0)
+    {
+        int const rows_per_strip = 16;
+        TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, uint32_t(rows_per_strip));
+        for (int y = 0, strip = 0; y < layout.height; y += rows_per_strip, ++strip)
+        {
+            int const rows = std::min(rows_per_strip, layout.height - y);
+            TIFFWriteEncodedStrip(
+                tif, strip, (void*)&data[row_bytes * y], row_bytes * rows
+            );
+        }
+    }
+    else
+    {
+        int const ts = layout.tile_size;
+        TIFFSetField(tif, TIFFTAG_TILEWIDTH, uint32_t(ts));
+        TIFFSetField(tif, TIFFTAG_TILELENGTH, uint32_t(ts));
+
+        int const tile_row_bytes = (ts * layout.samples_per_pixel * layout.bits_per_sample + 7) / 8;
+        std::vector<uint8_t> tile(tile_row_bytes * ts);
+        int const bits_per_pixel = layout.samples_per_pixel * layout.bits_per_sample;
+        for (int ty = 0; ty < layout.height; ty += ts)
+        {
+            for (int tx = 0; tx < layout.width; tx += ts)
+            {
+                std::fill(tile.begin(), tile.end(), 0);
+                int const x_bytes = (tx * bits_per_pixel) / 8;
+                int const copy_bytes = std::min(
+                    tile_row_bytes, row_bytes - x_bytes
+                );
+                for (int y = 0; y < ts && ty + y < layout.height; ++y)
+                {
+                    memcpy(&tile[tile_row_bytes * y],
+                           &data[row_bytes * (ty + y) + x_bytes], copy_bytes);
+                }
+                TIFFWriteTile(tif, &tile[0], tx, ty, 0, 0);
+            }
+        }
+    }
+
+    TIFFClose(tif);
+}
+
+QImage readPage(QString const& path)
+{
+    QFile file(path);
+    BOOST_REQUIRE(file.open(QIODevice::ReadOnly));
+    return TiffReader::readImage(file);
+}
+
+/** Expected gray level or ARGB value of a pixel, as the original samples describe it. */
+QRgb expectedPixel(PageLayout const& layout, std::vector<uint8_t> const& data, int x, int y)
+{
+    int const max_value = (1 << layout.bits_per_sample) - 1;
+    int channels[4];
+    for (int s = 0; s < layout.samples_per_pixel; ++s)
+    {
+        int const v = sampleAt(layout, data, x, y, s);
+        channels[s] = (v * 255 + max_value / 2) / max_value;
+    }
+
+    if (layout.samples_per_pixel == 1)
+    {
+        int const gray = layout.photometric == PHOTOMETRIC_MINISWHITE
+                         ? 255 - channels[0] : channels[0];
+        return qRgb(gray, gray, gray);
+    }
+    else if (layout.samples_per_pixel == 3)
+    {
+        return qRgb(channels[0], channels[1], channels[2]);
+    }
+    else
+    {
+        return qRgba(channels[0], channels[1], channels[2], channels[3]);
+    }
+}
+
+bool matchesSamples(QImage const& image, PageLayout const& layout, std::vector<uint8_t> const& data)
+{
+    if (image.width() != layout.width || image.height() != layout.height)
+    {
+        return false;
+    }
+
+    // 16-bit samples may round either way.
+    int const tolerance = layout.bits_per_sample == 16 ? 1 : 0;
+
+    for (int y = 0; y < layout.height; ++y)
+    {
+        for (int x = 0; x < layout.width; ++x)
+        {
+            QRgb const expected = expectedPixel(layout, data, x, y);
+            QRgb const actual = image.pixel(x, y);
+            if (abs(qRed(expected) - qRed(actual)) > tolerance
+                    || abs(qGreen(expected) - qGreen(actual)) > tolerance
+                    || abs(qBlue(expected) - qBlue(actual)) > tolerance
+                    || abs(qAlpha(expected) - qAlpha(actual)) > tolerance)
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+void checkRoundTrip(PageLayout const& layout, QImage::Format expected_format)
+{
+    QTemporaryFile file;
+    BOOST_REQUIRE(file.open());
+    QString const path(file.fileName());
+    file.close();
+
+    std::vector<uint8_t> const data(randomSamples(layout, rowBytes(layout)));
+    writePage(path, layout, data);
+
+    QImage const image(readPage(path));
+    BOOST_REQUIRE(!image.isNull());
+    BOOST_CHECK(image.format() == expected_format);
+    BOOST_CHECK(matchesSamples(image, layout, data));
+}
+
+void writeGrayDirectory(TIFF* tif, int width, int height, uint8_t level)
+{
+    TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, uint32_t(width));
+    TIFFSetField(tif, TIFFTAG_IMAGELENGTH, uint32_t(height));
+    TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, uint16_t(8));
+    TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, uint16_t(1));
+    TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, uint16_t(PHOTOMETRIC_MINISBLACK));
+    TIFFSetField(tif, TIFFTAG_COMPRESSION, uint16_t(COMPRESSION_LZW));
+    TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, uint32_t(16));
+
+    // 4 pixel wide stripes of level and level + 1.
+    std::vector<uint8_t> line(width);
+    for (int x = 0; x < width; ++x)
+    {
+        line[x] = static_cast<uint8_t>(level + (x / 4) % 2);
+    }
+    for (int y = 0; y < height; ++y)
+    {
+        TIFFWriteScanline(tif, &line[0], y, 0);
+    }
+}
+
+/**
+ * Writes a striped gray page, optionally accompanied by
+ * a reduced resolution version of a different level as a SubIFD.
+ */
+void writePageWithReducedImage(
+    QString const& path, QSize const& full_size, uint8_t full_level,
+    QSize const& reduced_size, uint8_t reduced_level)
+{
+    TIFF* tif = TIFFOpen(QFile::encodeName(path).constData(), "w");
+    BOOST_REQUIRE(tif);
+
+    if (!reduced_size.isEmpty())
+    {
+        // The actual offset is filled in by libtiff once the SubIFD is written.
+        toff_t offset = 0;
+        TIFFSetField(tif, TIFFTAG_SUBIFD, uint16_t(1), &offset);
+    }
+    writeGrayDirectory(tif, full_size.width(), full_size.height(), full_level);
+    BOOST_REQUIRE(TIFFWriteDirectory(tif));
+
+    if (!reduced_size.isEmpty())
+    {
+        TIFFSetField(tif, TIFFTAG_SUBFILETYPE, uint32_t(FILETYPE_REDUCEDIMAGE));
+        writeGrayDirectory(tif, reduced_size.width(), reduced_size.height(), reduced_level);
+        BOOST_REQUIRE(TIFFWriteDirectory(tif));
+    }
+
+    TIFFClose(tif);
+}
+
+QImage readScaledPage(QString const& path, QSize const& hint)
+{
+    QFile file(path);
+    BOOST_REQUIRE(file.open(QIODevice::ReadOnly));
+    return TiffReader::readScaledImage(file, 0, hint);
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(test_bilevel)
+{
+    PageLayout const strips = { 333, 101, 1, 1, PHOTOMETRIC_MINISWHITE, COMPRESSION_CCITTFAX4, 0 };
+    checkRoundTrip(strips, QImage::Format_Mono);
+
+    PageLayout const tiles = { 333, 101, 1, 1, PHOTOMETRIC_MINISBLACK, COMPRESSION_LZW, 64 };
+    checkRoundTrip(tiles, QImage::Format_Mono);
+}
+
+BOOST_AUTO_TEST_CASE(test_gray)
+{
+    PageLayout const gray4 = { 257, 99, 4, 1, PHOTOMETRIC_MINISBLACK, COMPRESSION_NONE, 0 };
+    checkRoundTrip(gray4, QImage::Format_Indexed8);
+
+    PageLayout const gray8 = { 257, 99, 8, 1, PHOTOMETRIC_MINISWHITE, COMPRESSION_LZW, 32 };
+    checkRoundTrip(gray8, QImage::Format_Indexed8);
+
+    PageLayout const gray16 = { 257, 99, 16, 1, PHOTOMETRIC_MINISBLACK, COMPRESSION_ADOBE_DEFLATE, 0 };
+    checkRoundTrip(gray16, QImage::Format_Indexed8);
+}
+
+BOOST_AUTO_TEST_CASE(test_color)
+{
+    PageLayout const rgb8 = { 201, 77, 8, 3, PHOTOMETRIC_RGB, COMPRESSION_LZW, 0 };
+    checkRoundTrip(rgb8, QImage::Format_RGB32);
+
+    PageLayout const rgb16 = { 201, 77, 16, 3, PHOTOMETRIC_RGB, COMPRESSION_ADOBE_DEFLATE, 48 };
+    checkRoundTrip(rgb16, QImage::Format_RGB32);
+
+    PageLayout const rgba8 = { 201, 77, 8, 4, PHOTOMETRIC_RGB, COMPRESSION_NONE, 0 };
+    checkRoundTrip(rgba8, QImage::Format_ARGB32);
+}
+
+BOOST_AUTO_TEST_CASE(test_bottom_left_orientation)
+{
+    // The first row stored in the file is the bottom one.
+    PageLayout const layouts[] = {
+        { 201, 77, 8, 3, PHOTOMETRIC_RGB, COMPRESSION_LZW, 0, ORIENTATION_BOTLEFT },
+        { 201, 77, 16, 1, PHOTOMETRIC_MINISBLACK, COMPRESSION_NONE, 32, ORIENTATION_BOTLEFT }
+    };
+
+    for (PageLayout const& layout : layouts)
+    {
+        QTemporaryFile file;
+        BOOST_REQUIRE(file.open());
+        QString const path(file.fileName());
+        file.close();
+
+        std::vector<uint8_t> const data(randomSamples(layout, rowBytes(layout)));
+        writePage(path, layout, data);
+
+        QImage const image(readPage(path));
+        BOOST_REQUIRE(!image.isNull());
+        BOOST_CHECK(matchesSamples(image.mirrored(false, true), layout, data));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_scaled_without_reduced_image)
+{
+    QTemporaryFile file;
+    BOOST_REQUIRE(file.open());
+    QString const path(file.fileName());
+    file.close();
+    writePageWithReducedImage(path, QSize(400, 300), 100, QSize(), 0);
+
+    // A factor of 8 averages two 4 pixel wide stripes of levels
+    // 100 and 101 into 100.5, which gets rounded up.
+    QImage const image(readScaledPage(path, QSize(50, 50)));
+    BOOST_REQUIRE(!image.isNull());
+    BOOST_CHECK(image.size() == QSize(50, 38));
+    BOOST_CHECK(image.allGray());
+    BOOST_CHECK_EQUAL(qGray(image.pixel(10, 10)), 101);
+    BOOST_CHECK_EQUAL(qGray(image.pixel(49, 37)), 101);
+}
+
+BOOST_AUTO_TEST_CASE(test_scaled_with_reduced_image)
+{
+    QTemporaryFile file;
+    BOOST_REQUIRE(file.open());
+    QString const path(file.fileName());
+    file.close();
+    writePageWithReducedImage(path, QSize(400, 300), 100, QSize(200, 150), 200);
+
+    // The reduced image is large enough, so it's the one being decimated.
+    QImage const reduced(readScaledPage(path, QSize(100, 100)));
+    BOOST_REQUIRE(!reduced.isNull());
+    BOOST_CHECK(reduced.width() >= 100 && reduced.height() >= 75);
+    BOOST_CHECK_EQUAL(qGray(reduced.pixel(0, 0)), 200);
+
+    // Here it's too small, so we fall back to the full resolution image.
+    QImage const full(readScaledPage(path, QSize(300, 300)));
+    BOOST_REQUIRE(!full.isNull());
+    BOOST_CHECK(full.width() >= 300 && full.height() >= 225);
+    BOOST_CHECK(qGray(full.pixel(0, 0)) == 100 || qGray(full.pixel(0, 0)) == 101);
+}
+
+/**
+ * Compares the native decoding path with what we used to do
+ * for anything but bilevel and 8-bit gray images.
+ */
+BOOST_AUTO_TEST_CASE(test_damaged_strip)
+{
+    PageLayout const layout = { 201, 77, 8, 1, PHOTOMETRIC_MINISBLACK, COMPRESSION_LZW, 0, 0 };
+
+    QTemporaryFile file;
+    BOOST_REQUIRE(file.open());
+    QString const path(file.fileName());
+    file.close();
+    writePage(path, layout, randomSamples(layout, rowBytes(layout)));
+
+    TIFF* tif = TIFFOpen(QFile::encodeName(path).constData(), "r");
+    BOOST_REQUIRE(tif);
+    toff_t* offsets = 0;
+    BOOST_REQUIRE(TIFFGetField(tif, TIFFTAG_STRIPOFFSETS, &offsets));
+    toff_t const damaged_offset = offsets[1];
+    TIFFClose(tif);
+
+    // Codes this big can't come at the start of an LZW strip.
+    QFile damaged(path);
+    BOOST_REQUIRE(damaged.open(QIODevice::ReadWrite));
+    BOOST_REQUIRE(damaged.seek(damaged_offset));
+    BOOST_REQUIRE(damaged.write(QByteArray(8, char(0xff))) == 8);
+    damaged.close();
+
+    BOOST_CHECK(readPage(path).isNull());
+}
+
+BOOST_AUTO_TEST_CASE(test_native_vs_rgba_decoding)
+{
+    PageLayout const layout = { 1700, 2200, 16, 3, PHOTOMETRIC_RGB, COMPRESSION_LZW, 0 };
+
+    QTemporaryFile file;
+    BOOST_REQUIRE(file.open());
+    QString const path(file.fileName());
+    file.close();
+    writePage(path, layout, randomSamples(layout, rowBytes(layout)));
+
+#if LOG_PERFORMANCE
+    PerformanceTimer ptimer1;
+#endif
+    std::vector<uint32_t> rgba(layout.width * layout.height);
+    TIFF* tif = TIFFOpen(QFile::encodeName(path).constData(), "r");
+    BOOST_REQUIRE(tif);
+    BOOST_REQUIRE(TIFFReadRGBAImageOriented(
+                      tif, layout.width, layout.height, &rgba[0], ORIENTATION_TOPLEFT, 0
+                  ));
+    TIFFClose(tif);
+    QImage control(layout.width, layout.height, QImage::Format_RGB32);
+    for (int y = 0; y < layout.height; ++y)
+    {
+        QRgb* line = (QRgb*)control.scanLine(y);
+        for (int x = 0; x < layout.width; ++x)
+        {
+            uint32_t const abgr = rgba[y * layout.width + x];
+            line[x] = qRgb(TIFFGetR(abgr), TIFFGetG(abgr), TIFFGetB(abgr));
+        }
+    }
+#if LOG_PERFORMANCE
+    ptimer1.print("[TiffReader] TIFFReadRGBAImageOriented():");
+    PerformanceTimer ptimer2;
+#endif
+    QImage const output(readPage(path));
+#if LOG_PERFORMANCE
+    ptimer2.print("[TiffReader] Native decoding:");
+#endif
+
+    BOOST_REQUIRE(output.size() == control.size());
+    bool close_enough = true;
+    for (int y = 0; y < layout.height && close_enough; ++y)
+    {
+        for (int x = 0; x < layout.width; ++x)
+        {
+            QRgb const a = output.pixel(x, y);
+            QRgb const b = control.pixel(x, y);
+            if (abs(qRed(a) - qRed(b)) > 1 || abs(qGreen(a) - qGreen(b)) > 1
+                    || abs(qBlue(a) - qBlue(b)) > 1)
+            {
+                close_enough = false;
+                break;
+            }
+        }
+    }
+    BOOST_CHECK(close_enough);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace Tests
@@ -0,0 +1,304 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "TiffWriter.h"
+#include "TiffReader.h"
+#include "PerformanceTimer.h"
+#include <QImage>
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryFile>
+#include <QString>
+#include <QColor>
+#include <QVector>
+#include <boost/test/unit_test.hpp>
+#include <iostream>
+#include <stdlib.h>
+
+namespace Tests
+{
+
+BOOST_AUTO_TEST_SUITE(TiffWriterTestSuite);
+
+#define LOG_PERFORMANCE 0
+
+namespace
+{
+
+TiffWriter::Codec const ALL_CODECS[] =
+{
+    TiffWriter::CODEC_DEFAULT, TiffWriter::CODEC_NONE, TiffWriter::CODEC_LZW,
+    TiffWriter::CODEC_DEFLATE, TiffWriter::CODEC_ZSTD, TiffWriter::CODEC_JPEG,
+    TiffWriter::CODEC_G4
+};
+
+#if LOG_PERFORMANCE
+char const* const CODEC_NAMES[] =
+{
+    "default", "none", "lzw", "deflate", "zstd", "jpeg", "g4"
+};
+#endif
+
+/**
+ * Something resembling a scanned page: a smooth background
+ * with dark text-like blocks on it.
+ */
+QImage makePage(QSize const& size, QImage::Format const format)
+{
+    QImage rgb(size, QImage::Format_RGB32);
+    for (int y = 0; y < size.height(); ++y)
+    {
+        QRgb* line = reinterpret_cast<QRgb*>(rgb.scanLine(y));
+        for (int x = 0; x < size.width(); ++x)
+        {
+            int const bg = 230 + (x + y) % 17;
+            bool const ink = (y / 12) % 3 != 0 && (x / 7) % 5 != 0 && (x * 13 + y * 7) % 11 < 8;
+            line[x] = ink ? qRgb(20, 20, 40 + x % 30) : qRgb(bg, bg - 5, bg - 10);
+        }
+    }
+
+    if (format == QImage::Format_Indexed8)
+    {
+        QVector<QRgb> gray_table(256);
+        for (int i = 0; i < 256; ++i)
+        {
+            gray_table[i] = qRgb(i, i, i);
+        }
+        return rgb.convertToFormat(format, gray_table);
+    }
+
+    return rgb.convertToFormat(format);
+}
+
+QImage readBack(QString const& path)
+{
+    QFile file(path);
+    BOOST_REQUIRE(file.open(QIODevice::ReadOnly));
+    return TiffReader::readImage(file);
+}
+
+bool closeEnough(QImage const& a, QImage const& b, int const tolerance)
+{
+    if (a.size() != b.size())
+    {
+        return false;
+    }
+
+    for (int y = 0; y < a.height(); ++y)
+    {
+        for (int x = 0; x < a.width(); ++x)
+        {
+            QRgb const pa = a.pixel(x, y);
+            QRgb const pb = b.pixel(x, y);
+            if (abs(qRed(pa) - qRed(pb)) > tolerance
+                    || abs(qGreen(pa) - qGreen(pb)) > tolerance
+                    || abs(qBlue(pa) - qBlue(pb)) > tolerance)
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+void checkRoundTrip(QImage const& image, TiffWriter::Options const& options)
+{
+    QTemporaryFile file;
+    BOOST_REQUIRE(file.open());
+    QString const path(file.fileName());
+    file.close();
+
+    BOOST_REQUIRE(TiffWriter::writeImage(path, image, options));
+
+    // JPEG is lossy, but not that much at the default quality.
+    bool const lossy = options.codec == TiffWriter::CODEC_JPEG &&
+                       image.format() != QImage::Format_Mono;
+    BOOST_CHECK(closeEnough(readBack(path), image, lossy ? 48 : 0));
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(test_codecs)
+{
+    QSize const size(333, 257);
+    QImage const images[] =
+    {
+        makePage(size, QImage::Format_RGB32),
+        makePage(size, QImage::Format_Indexed8),
+        makePage(size, QImage::Format_Mono)
+    };
+
+    for (TiffWriter::Codec const codec : ALL_CODECS)
+    {
+        if (!TiffWriter::isCodecSupported(codec))
+        {
+            continue;
+        }
+
+        for (int predictor = 0; predictor < 2; ++predictor)
+        {
+            TiffWriter::Options options;
+            options.codec = codec;
+            options.predictor = predictor != 0;
+            // Many small strips, so that several batches get compressed in parallel.
+            options.rowsPerStrip = 10;
+
+            for (QImage const& image : images)
+            {
+                checkRoundTrip(image, options);
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_inverted_gray_palette)
+{
+    // Gray colours, but not in the order of their indices, so the indices
+    // can't be written as gray levels.
+    QImage image(makePage(QSize(131, 97), QImage::Format_Indexed8));
+    QVector<QRgb> inverted_table(256);
+    for (int i = 0; i < 256; ++i)
+    {
+        inverted_table[i] = qRgb(255 - i, 255 - i, 255 - i);
+    }
+    image.setColorTable(inverted_table);
+
+    for (TiffWriter::Codec const codec : ALL_CODECS)
+    {
+        if (!TiffWriter::isCodecSupported(codec))
+        {
+            continue;
+        }
+
+        TiffWriter::Options options;
+        options.codec = codec;
+
+        QTemporaryFile file;
+        BOOST_REQUIRE(file.open());
+        QString const path(file.fileName());
+        file.close();
+
+        BOOST_REQUIRE(TiffWriter::writeImage(path, image, options));
+        // Not being grayscale, it's never written as JPEG.
+        BOOST_CHECK(closeEnough(readBack(path), image, 0));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_strip_writer)
+{
+    QImage const image(makePage(QSize(201, 150), QImage::Format_Indexed8));
+
+    QTemporaryFile file;
+    BOOST_REQUIRE(file.open());
+    QString const path(file.fileName());
+
+    TiffWriter::Options options;
+    options.rowsPerStrip = 16;
+
+    {
+        TiffWriter::StripWriter writer(
+            file, image.size(), image.format(), image.colorTable(), options
+        );
+        BOOST_REQUIRE(writer.isOk());
+
+        // Chunks not aligned with strips.
+        int const chunks[] = { 1, 20, 33, 96 };
+        int y = 0;
+        for (int const rows : chunks)
+        {
+            BOOST_REQUIRE(writer.writeLines(image.copy(0, y, image.width(), rows)));
+            y += rows;
+        }
+        BOOST_REQUIRE(writer.finish());
+    }
+
+    BOOST_CHECK(closeEnough(readBack(path), image, 0));
+}
+
+BOOST_AUTO_TEST_CASE(test_incomplete_image)
+{
+    QImage const image(makePage(QSize(50, 40), QImage::Format_RGB32));
+
+    QTemporaryFile file;
+    BOOST_REQUIRE(file.open());
+
+    TiffWriter::StripWriter writer(file, image.size(), image.format(), image.colorTable());
+    BOOST_REQUIRE(writer.writeLines(image.copy(0, 0, image.width(), 39)));
+    BOOST_CHECK(!writer.finish());
+}
+
+BOOST_AUTO_TEST_CASE(test_parse_codec)
+{
+    TiffWriter::Codec codec = TiffWriter::CODEC_DEFAULT;
+    BOOST_CHECK(TiffWriter::parseCodec("Deflate", codec));
+    BOOST_CHECK(codec == TiffWriter::CODEC_DEFLATE);
+    BOOST_CHECK(TiffWriter::parseCodec("g4", codec));
+    BOOST_CHECK(codec == TiffWriter::CODEC_G4);
+    BOOST_CHECK(!TiffWriter::parseCodec("lzma", codec));
+    BOOST_CHECK(codec == TiffWriter::CODEC_G4);
+}
+
+/**
+ * Compares the speed and the output size of the codecs
+ * on an A4 page at 300 DPI.
+ */
+BOOST_AUTO_TEST_CASE(test_codec_performance)
+{
+    QSize const size(2480, 3508);
+    QImage const images[] =
+    {
+        makePage(size, QImage::Format_RGB32),
+        makePage(size, QImage::Format_Indexed8),
+        makePage(size, QImage::Format_Mono)
+    };
+
+    for (size_t i = 0; i < sizeof(ALL_CODECS) / sizeof(ALL_CODECS[0]); ++i)
+    {
+        if (!TiffWriter::isCodecSupported(ALL_CODECS[i]))
+        {
+            continue;
+        }
+
+        for (QImage const& image : images)
+        {
+            TiffWriter::Options options;
+            options.codec = ALL_CODECS[i];
+            options.predictor = true;
+
+            QTemporaryFile file;
+            BOOST_REQUIRE(file.open());
+            QString const path(file.fileName());
+            file.close();
+
+#if LOG_PERFORMANCE
+            PerformanceTimer ptimer;
+#endif
+            BOOST_REQUIRE(TiffWriter::writeImage(path, image, options));
+#if LOG_PERFORMANCE
+            std::cout << "[TiffWriter] " << CODEC_NAMES[i] << ", depth " << image.depth()
+                      << ": " << QFileInfo(path).size() / 1024 << " KiB" << std::endl;
+            ptimer.print("[TiffWriter] writeImage():");
+#endif
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace Tests
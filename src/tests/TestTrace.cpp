@@ -0,0 +1,164 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Trace.h"
+#include <QTemporaryFile>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QString>
+#include <QSize>
+#include <boost/test/unit_test.hpp>
+#include <sstream>
+#include <string>
+#include <chrono>
+
+namespace Tests
+{
+
+BOOST_AUTO_TEST_SUITE(TraceTestSuite);
+
+namespace
+{
+
+void spin(std::chrono::milliseconds const duration)
+{
+    auto const end = std::chrono::steady_clock::now() + duration;
+    while (std::chrono::steady_clock::now() < end)
+    {
+    }
+}
+
+QJsonArray writeAndReadEvents()
+{
+    QTemporaryFile file;
+    BOOST_REQUIRE(file.open());
+    BOOST_REQUIRE(Trace::writeChromeTrace(file.fileName()));
+
+    QFile reader(file.fileName());
+    BOOST_REQUIRE(reader.open(QIODevice::ReadOnly));
+    QJsonDocument const doc(QJsonDocument::fromJson(reader.readAll()));
+    BOOST_REQUIRE(doc.isObject());
+    return doc.object().value("traceEvents").toArray();
+}
+
+/**
+ * Enables tracing for the duration of a test case and
+ * leaves it disabled and empty afterwards.
+ */
+class TraceScope
+{
+public:
+    TraceScope()
+    {
+        Trace::clear();
+        Trace::setEnabled(true);
+    }
+
+    ~TraceScope()
+    {
+        Trace::setEnabled(false);
+        Trace::clear();
+    }
+};
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(test_disabled)
+{
+    Trace::clear();
+    Trace::setEnabled(false);
+    {
+        TraceSpan const span("stage", "ignored");
+    }
+    BOOST_CHECK(writeAndReadEvents().isEmpty());
+}
+
+BOOST_AUTO_TEST_CASE(test_chrome_trace)
+{
+    TraceScope const scope;
+    {
+        TraceSpan span("stage", "with \"quotes\"");
+        span.setImageSize(QSize(300, 200));
+    }
+
+    QJsonArray const events(writeAndReadEvents());
+    BOOST_REQUIRE_EQUAL(events.size(), 1);
+
+    QJsonObject const event(events[0].toObject());
+    BOOST_CHECK(event.value("name").toString() == "with \"quotes\"");
+    BOOST_CHECK(event.value("cat").toString() == "stage");
+    BOOST_CHECK(event.value("ph").toString() == "X");
+    BOOST_CHECK(event.value("dur").toDouble() >= 0.0);
+
+    QJsonObject const args(event.value("args").toObject());
+    BOOST_CHECK_EQUAL(args.value("width").toInt(), 300);
+    BOOST_CHECK_EQUAL(args.value("height").toInt(), 200);
+}
+
+BOOST_AUTO_TEST_CASE(test_self_time)
+{
+    TraceScope const scope;
+    {
+        TraceSpan const outer("stage", "outer");
+        spin(std::chrono::milliseconds(20));
+        {
+            TraceSpan const inner("stage", "inner");
+            TraceSpan const other("accel", "other");
+            spin(std::chrono::milliseconds(40));
+        }
+    }
+
+    qint64 outer_dur = 0, outer_self = 0, inner_dur = 0, other_dur = 0;
+    for (QJsonValue const& value : writeAndReadEvents())
+    {
+        QJsonObject const event(value.toObject());
+        QString const name(event.value("name").toString());
+        qint64 const dur = qint64(event.value("dur").toDouble());
+        if (name == "outer")
+        {
+            outer_dur = dur;
+            outer_self = qint64(event.value("args").toObject().value("self_us").toDouble());
+        }
+        else if (name == "inner")
+        {
+            inner_dur = dur;
+        }
+        else if (name == "other")
+        {
+            other_dur = dur;
+        }
+    }
+
+    // A nested span of the same category is excluded from the self time,
+    // while one of a different category doesn't affect its parent.
+    BOOST_CHECK_GE(inner_dur, other_dur);
+    BOOST_CHECK_EQUAL(outer_self, outer_dur - inner_dur);
+    BOOST_CHECK_GE(outer_self, 20000);
+    BOOST_CHECK_LT(outer_self, outer_dur);
+
+    std::ostringstream summary;
+    Trace::printSummary(summary);
+    BOOST_CHECK(summary.str().find("outer") != std::string::npos);
+    BOOST_CHECK(summary.str().find("inner") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace Tests